@@ -432,6 +432,16 @@ void ColorLightBehaviour::deriveMissingColorChannels()
 }
 
 
+long ColorLightBehaviour::hardwareChannelMode()
+{
+  // same logic as deriveColorMode(), but without changing anything
+  if (hue->needsApplying() || saturation->needsApplying()) return colorLightModeHueSaturation;
+  if (cieX->needsApplying() || cieY->needsApplying()) return colorLightModeXY;
+  if (ct->needsApplying()) return colorLightModeCt;
+  return colorMode;
+}
+
+
 void ColorLightBehaviour::appliedColorValues()
 {
   brightness->channelValueApplied(true);
@@ -238,6 +238,9 @@ namespace p44 {
     /// mark Color Light values applied (flags channels applied depending on colormode)
     void appliedColorValues();
 
+    /// @return the color mode that applying the pending channel values will use (see deriveColorMode())
+    virtual long hardwareChannelMode();
+
     /// step through transitions
     /// @param aStepSize how much to step. Default is zero and means starting transition
     /// @return true if there's another step to take, false if end of transition already reached
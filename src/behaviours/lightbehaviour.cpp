@@ -127,6 +127,21 @@ Brightness LightBehaviour::brightnessForHardware()
 }
 
 
+Brightness LightBehaviour::brightnessForHardware(Brightness aBrightness)
+{
+  if (!isEnabled()) {
+    // disabled lights are off
+    return 0;
+  }
+  else if (isDimmable()) {
+    return aBrightness;
+  }
+  else {
+    return aBrightness >= onThreshold ? brightness->getMax() : brightness->getMin();
+  }
+}
+
+
 void LightBehaviour::syncBrightnessFromHardware(Brightness aBrightness, bool aAlwaysSync)
 {
   if (
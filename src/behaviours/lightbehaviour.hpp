@@ -148,6 +148,11 @@ namespace p44 {
     ///   above onThreshold, brightnessForHardware() will return the max channel value and 0 otherwise.
     Brightness brightnessForHardware();
 
+    /// return the brightness the hardware would get for a given brightness channel value
+    /// @param aBrightness the brightness channel value
+    /// @return brightness (same switching logic as brightnessForHardware(), but not taking transitions into account)
+    Brightness brightnessForHardware(Brightness aBrightness);
+
     /// sync channel brightness from actual hardware value
     /// @param aBrightness current brightness value read back from hardware
     /// @note this wraps the dimmable/switch functionality (does not change channel value when onThreshold
@@ -30,6 +30,8 @@
 
 #include "dalicomm.hpp"
 
+#include "tracer.hpp"
+
 using namespace p44;
 
 
@@ -159,8 +161,10 @@ void DaliComm::setConnectionSpecification(const char *aConnectionSpec, uint16_t
 }
 
 
-void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, SerialOperationPtr aOperation, OperationQueuePtr aQueueP, ErrorPtr aError)
+void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, uint32_t aTraceId, SerialOperationPtr aOperation, OperationQueuePtr aQueueP, ErrorPtr aError)
 {
+  TRACE_ID_SCOPE(aTraceId);
+  TRACE_INSTANT("DALI bridge response", Error::isOK(aError) ? "" : aError->description());
   if (expectedBridgeResponses>0) expectedBridgeResponses--;
   if (expectedBridgeResponses<BUFFERED_BRIDGE_RESPONSES_LOW) {
     responsesInSequence = false; // allow buffered sends without waiting for answers again
@@ -189,6 +193,7 @@ void DaliComm::bridgeResponseHandler(DaliBridgeResultCB aBridgeResultHandler, Se
 void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, DaliBridgeResultCB aResultCB, int aWithDelay)
 {
   FOCUSLOG("DALI bridge command:  %s (%02X)  %02X %02X (%d pending responses)\n", bridgeCmdName(aCmd), aCmd, aDali1, aDali2, expectedBridgeResponses);
+  TRACE_INSTANT("DALI bridge command", string_format("%s %02X %02X", bridgeCmdName(aCmd), aDali1, aDali2));
   // reset connection closing timeout
   MainLoop::currentMainLoop().cancelExecutionTicket(connectionTimeoutTicket);
   if (closeAfterIdleTime!=Never) {
@@ -198,7 +203,7 @@ void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, D
   SerialOperationSendAndReceive *opP = NULL;
   if (aCmd<8) {
     // single byte command
-    opP = new SerialOperationSendAndReceive(1, &aCmd, 2, boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, _1, _2, _3));
+    opP = new SerialOperationSendAndReceive(1, &aCmd, 2, boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, globalTracer.getCurrentId(), _1, _2, _3));
   }
   else {
     // 3 byte command
@@ -206,7 +211,7 @@ void DaliComm::sendBridgeCommand(uint8_t aCmd, uint8_t aDali1, uint8_t aDali2, D
     cmd3[0] = aCmd;
     cmd3[1] = aDali1;
     cmd3[2] = aDali2;
-    opP = new SerialOperationSendAndReceive(3, cmd3, 2, boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, _1, _2, _3));
+    opP = new SerialOperationSendAndReceive(3, cmd3, 2, boost::bind(&DaliComm::bridgeResponseHandler, this, aResultCB, globalTracer.getCurrentId(), _1, _2, _3));
   }
   if (opP) {
     expectedBridgeResponses++;
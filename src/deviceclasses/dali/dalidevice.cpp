@@ -197,9 +197,28 @@ void DaliBusDevice::groupMembershipResponse(StatusCB aCompletedCB, uint16_t aUse
 
 
 
-void DaliBusDevice::updateParams(StatusCB aCompletedCB)
+void DaliBusDevice::updateParams(StatusCB aCompletedCB, bool aQueryLevel)
 {
   if (isDummy) aCompletedCB(ErrorPtr());
+  if (aQueryLevel) {
+    // query actual arc power level first (but not being able to get it is not an error)
+    currentBrightness = 0; // default to 0
+    updateActualLevel(boost::bind(&DaliBusDevice::queryMinLevel, this, aCompletedCB));
+  }
+  else {
+    // actual level will be queried later
+    currentBrightness = -1; // unknown, makes sure next setBrightness() is actually sent
+    queryMinLevel(aCompletedCB);
+  }
+}
+
+
+void DaliBusDevice::updateActualLevel(StatusCB aCompletedCB)
+{
+  if (isDummy) {
+    aCompletedCB(ErrorPtr());
+    return;
+  }
   // query actual arc power level
   daliDeviceContainer.daliComm->daliSendQuery(
     addressForQuery(),
@@ -211,14 +230,24 @@ void DaliBusDevice::updateParams(StatusCB aCompletedCB)
 
 void DaliBusDevice::queryActualLevelResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError)
 {
-  currentBrightness = 0; // default to 0
-  if (Error::isOK(aError) && !aNoOrTimeout) {
-    isPresent = true; // answering a query means presence
-    // this is my current arc power, save it as brightness for dS system side queries
-    currentBrightness = arcpowerToBrightness(aResponse);
-    LOG(LOG_DEBUG, "DaliBusDevice: retrieved current dimming level: arc power = %d, brightness = %0.1f\n", aResponse, currentBrightness);
+  if (Error::isOK(aError)) {
+    if (aNoOrTimeout) {
+      aError = ErrorPtr(new DaliCommError(DaliCommErrorMissingData));
+    }
+    else {
+      isPresent = true; // answering a query means presence
+      // this is my current arc power, save it as brightness for dS system side queries
+      currentBrightness = arcpowerToBrightness(aResponse);
+      LOG(LOG_DEBUG, "DaliBusDevice: retrieved current dimming level: arc power = %d, brightness = %0.1f\n", aResponse, currentBrightness);
+    }
   }
-  // next: query the minimum dimming level
+  aCompletedCB(aError);
+}
+
+
+void DaliBusDevice::queryMinLevel(StatusCB aCompletedCB)
+{
+  // query the minimum dimming level
   daliDeviceContainer.daliComm->daliSendQuery(
     addressForQuery(),
     DALICMD_QUERY_MIN_LEVEL,
@@ -545,15 +574,21 @@ string DaliDimmerDevice::getExtraInfo()
 void DaliDimmerDevice::initializeDevice(StatusCB aCompletedCB, bool aFactoryReset)
 {
   // - sync cached channel values from actual device
-  brightnessDimmer->updateParams(boost::bind(&DaliDimmerDevice::brightnessDimmerSynced, this, aCompletedCB, aFactoryReset, _1));
+  //   (unless last known state could be restored - in this case, actual level is queried later in the background)
+  brightnessDimmer->updateParams(
+    boost::bind(&DaliDimmerDevice::brightnessDimmerSynced, this, aCompletedCB, aFactoryReset, _1),
+    !output->hasRestoredState()
+  );
 }
 
 
 void DaliDimmerDevice::brightnessDimmerSynced(StatusCB aCompletedCB, bool aFactoryReset, ErrorPtr aError)
 {
   if (Error::isOK(aError)) {
-    // save brightness now
-    output->getChannelByIndex(0)->syncChannelValue(brightnessDimmer->currentBrightness);
+    // save brightness now (if known)
+    if (brightnessDimmer->currentBrightness>=0) {
+      output->getChannelByIndex(0)->syncChannelValue(brightnessDimmer->currentBrightness);
+    }
     // initialize the light behaviour with the minimal dimming level
     LightBehaviourPtr l = boost::static_pointer_cast<LightBehaviour>(output);
     l->initMinBrightness(brightnessDimmer->minBrightness);
@@ -617,6 +652,32 @@ void DaliDimmerDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 }
 
 
+void DaliDimmerDevice::syncChannelValues(SimpleCB aDoneCB)
+{
+  brightnessDimmer->updateActualLevel(boost::bind(&DaliDimmerDevice::actualLevelSynced, this, aDoneCB, _1));
+}
+
+
+void DaliDimmerDevice::actualLevelSynced(SimpleCB aDoneCB, ErrorPtr aError)
+{
+  if (Error::isOK(aError) && brightnessDimmer->currentBrightness>=0) {
+    output->getChannelByIndex(0)->syncChannelValue(brightnessDimmer->currentBrightness);
+  }
+  inherited::syncChannelValues(aDoneCB);
+}
+
+
+long DaliDimmerDevice::channelHardwareLevel(ChannelBehaviour &aChannel, double aValue)
+{
+  LightBehaviourPtr lightBehaviour = boost::dynamic_pointer_cast<LightBehaviour>(output);
+  if (lightBehaviour && aChannel.getChannelType()==channeltype_brightness) {
+    // 8-bit arc power
+    return brightnessDimmer->brightnessToArcpower(lightBehaviour->brightnessForHardware(aValue));
+  }
+  return inherited::channelHardwareLevel(aChannel, aValue);
+}
+
+
 // optimized DALI dimming implementation
 void DaliDimmerDevice::dimChannel(DsChannelType aChannelType, DsDimMode aDimMode)
 {
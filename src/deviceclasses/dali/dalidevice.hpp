@@ -99,7 +99,14 @@ namespace p44 {
     virtual void initialize(StatusCB aCompletedCB, uint16_t aUsedGroupsMask);
 
     /// update parameters from device to local vars
-    void updateParams(StatusCB aCompletedCB);
+    /// @param aCompletedCB will be called when parameters are updated
+    /// @param aQueryLevel if set, the actual output level is queried as well. Otherwise, currentBrightness
+    ///   is set to unknown (<0), to be queried later with updateActualLevel()
+    void updateParams(StatusCB aCompletedCB, bool aQueryLevel = true);
+
+    /// update currentBrightness from the actual output level of the device
+    /// @param aCompletedCB will be called when done, with error if device did not answer
+    void updateActualLevel(StatusCB aCompletedCB);
 
     /// update status information from device
     void updateStatus(StatusCB aCompletedCB);
@@ -149,6 +156,7 @@ namespace p44 {
     void groupMembershipResponse(StatusCB aCompletedCB, uint16_t aUsedGroupsMask, DaliAddress aShortAddress, uint16_t aGroups, ErrorPtr aError);
 
     void queryActualLevelResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
+    void queryMinLevel(StatusCB aCompletedCB);
     void queryMinLevelResponse(StatusCB aCompletedCB, bool aNoOrTimeout, uint8_t aResponse, ErrorPtr aError);
 
     void dimRepeater(DaliAddress aDaliAddress, uint8_t aCommand, MLMicroSeconds aCycleStartTime);
@@ -295,6 +303,17 @@ namespace p44 {
     ///   in a single channel (and not switching between color modes etc.)
     virtual void applyChannelValues(SimpleCB aDoneCB, bool aForDimming);
 
+    /// get the quantized level the hardware would actually output for a channel value
+    /// @param aChannel the channel
+    /// @param aValue the channel value
+    /// @return DALI arc power for the brightness channel, or HARDWARE_LEVEL_UNKNOWN
+    virtual long channelHardwareLevel(ChannelBehaviour &aChannel, double aValue);
+
+    /// synchronize channel values by reading them back from the device's hardware
+    /// @param aDoneCB will be called when values are updated with actual hardware values
+    virtual void syncChannelValues(SimpleCB aDoneCB);
+    virtual bool canSyncChannelValues() { return true; };
+
     /// start or stop dimming (optimized DALI version)
     /// @param aChannel the channelType to start or stop dimming for
     /// @param aDimMode according to DsDimMode: 1=start dimming up, -1=start dimming down, 0=stop dimming
@@ -345,6 +364,7 @@ namespace p44 {
   private:
 
     void brightnessDimmerSynced(StatusCB aCompletedCB, bool aFactoryReset, ErrorPtr aError);
+    void actualLevelSynced(SimpleCB aDoneCB, ErrorPtr aError);
     void checkPresenceResponse(PresenceCB aPresenceResultHandler);
     void disconnectableHandler(bool aForgetParams, DisconnectCB aDisconnectResultHandler, bool aPresent);
 
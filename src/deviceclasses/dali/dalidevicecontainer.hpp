@@ -84,6 +84,9 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "DALI"; }
 
+    /// @return max number of devices initialized concurrently (all devices share the bus, so one at a time)
+    virtual int maxParallelDeviceInits() { return 1; }
+
     /// ungroup a previously grouped device
     /// @param aDevice the device to ungroup
     /// @param aRequest the API request that causes the ungroup, will be sent an OK when ungrouping is complete
@@ -121,6 +121,9 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "EnOcean"; }
 
+    /// @return min interval between presence checks (none needed, presence is derived from received telegrams without radio traffic)
+    virtual MLMicroSeconds presenceCheckInterval() { return 0; }
+
     /// @return hardware GUID in URN format to identify hardware as uniquely as possible
     /// - enoceanaddress:XXXXXXXX = 8 hex digits enOcean device address
     virtual string hardwareGUID() { return string_format("enoceanaddress:%08lX", enoceanComm.modemAddress()); };
@@ -47,7 +47,7 @@ ExternalDevice::ExternalDevice(DeviceClassContainer *aClassContainerP, JsonCommP
   deviceConnection->relatedObject = this;
   // install handlers on device connection
   deviceConnection->setConnectionStatusHandler(boost::bind(&ExternalDevice::handleDeviceConnectionStatus, this, _2));
-  deviceConnection->setMessageHandler(boost::bind(&ExternalDevice::handleDeviceApiJsonMessage, this, _1, _2));
+  deviceConnection->setArenaMessageHandler(boost::bind(&ExternalDevice::handleDeviceApiJsonMessage, this, _1, _2));
   deviceConnection->setClearHandlersAtClose(); // close must break retain cycles so this object won't cause a mem leak
 }
 
@@ -102,16 +102,17 @@ void ExternalDevice::closeConnection()
 
 
 
-void ExternalDevice::handleDeviceApiJsonMessage(ErrorPtr aError, JsonObjectPtr aMessage)
+void ExternalDevice::handleDeviceApiJsonMessage(ErrorPtr aError, JsonArenaPtr aArena)
 {
   // device API request
   if (Error::isOK(aError)) {
     // not JSON level error, try to process
-    LOG(LOG_INFO,"device -> externalDeviceContainer (JSON) message received: %s\n", aMessage->c_strValue());
+    JsonNode *message = aArena->root();
+    LOG(LOG_INFO,"device -> externalDeviceContainer (JSON) message received: %s\n", message->c_strValue());
     // extract message type
-    JsonObjectPtr o = aMessage->get("message");
+    JsonNode *o = message->get("message");
     if (o) {
-      aError = processJsonMessage(o->stringValue(), aMessage);
+      aError = processJsonMessage(o->stringValue(), message);
     }
     else {
       sendDeviceApiStatusMessage(TextError::err("missing 'message' field"));
@@ -156,7 +157,7 @@ void ExternalDevice::handleDeviceApiSimpleMessage(ErrorPtr aError, string aMessa
 }
 
 
-void ExternalDevice::sendDeviceApiJsonMessage(JsonObjectPtr aMessage)
+void ExternalDevice::sendDeviceApiJsonMessage(JsonNode *aMessage)
 {
   LOG(LOG_INFO,"device <- externalDeviceContainer (JSON) message sent: %s\n", aMessage->c_strValue());
   deviceConnection->sendMessage(aMessage);
@@ -186,19 +187,20 @@ void ExternalDevice::sendDeviceApiStatusMessage(ErrorPtr aError)
   }
   else {
     // create JSON response
-    JsonObjectPtr message = JsonObject::newObj();
-    message->add("message", JsonObject::newString("status"));
+    JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+    JsonNode *message = arena->newObj();
+    message->add("message", arena->newString("status"));
     if (!Error::isOK(aError)) {
       LOG(LOG_INFO,"device API error: %s\n", aError->description().c_str());
       // error, return error response
-      message->add("status", JsonObject::newString("error"));
-      message->add("errorcode", JsonObject::newInt32((int32_t)aError->getErrorCode()));
-      message->add("errormessage", JsonObject::newString(aError->getErrorMessage()));
-      message->add("errordomain", JsonObject::newString(aError->getErrorDomain()));
+      message->add("status", arena->newString("error"));
+      message->add("errorcode", arena->newInt32((int32_t)aError->getErrorCode()));
+      message->add("errormessage", arena->newString(aError->getErrorMessage()));
+      message->add("errordomain", arena->newString(aError->getErrorDomain()));
     }
     else {
       // no error, return result (if any)
-      message->add("status", JsonObject::newString("ok"));
+      message->add("status", arena->newString("ok"));
     }
     // send it
     sendDeviceApiJsonMessage(message);
@@ -207,7 +209,7 @@ void ExternalDevice::sendDeviceApiStatusMessage(ErrorPtr aError)
 
 
 
-ErrorPtr ExternalDevice::processJsonMessage(string aMessageType, JsonObjectPtr aMessage)
+ErrorPtr ExternalDevice::processJsonMessage(string aMessageType, JsonNode *aMessage)
 {
   ErrorPtr err;
   if (aMessageType=="bye") {
@@ -277,10 +279,10 @@ ErrorPtr ExternalDevice::processSimpleMessage(string aMessageType, string aValue
 
 
 
-ErrorPtr ExternalDevice::processInputJson(char aInputType, JsonObjectPtr aParams)
+ErrorPtr ExternalDevice::processInputJson(char aInputType, JsonNode *aParams)
 {
   uint32_t index = 0;
-  JsonObjectPtr o = aParams->get("index");
+  JsonNode *o = aParams->get("index");
   if (o) index = o->int32Value();
   o = aParams->get("value");
   if (o) {
@@ -376,11 +378,12 @@ void ExternalDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
           sendDeviceApiSimpleMessage(m);
         }
         else {
-          JsonObjectPtr message = JsonObject::newObj();
-          message->add("message", JsonObject::newString("channel"));
-          message->add("index", JsonObject::newInt32((int)i));
-          message->add("type", JsonObject::newInt32(cb->getChannelType())); // informational
-          message->add("value", JsonObject::newDouble(cb->getChannelValue()));
+          JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+          JsonNode *message = arena->newObj();
+          message->add("message", arena->newString("channel"));
+          message->add("index", arena->newInt32((int)i));
+          message->add("type", arena->newInt32(cb->getChannelType())); // informational
+          message->add("value", arena->newDouble(cb->getChannelValue()));
           sendDeviceApiJsonMessage(message);
         }
         cb->channelValueApplied();
@@ -419,9 +422,10 @@ void ExternalDevice::changeChannelMovement(size_t aChannelIndex, SimpleCB aDoneC
     sendDeviceApiSimpleMessage(m);
   }
   else {
-    JsonObjectPtr message = JsonObject::newObj();
-    message->add("message", JsonObject::newString("move"));
-    message->add("direction", JsonObject::newInt32(aNewDirection));
+    JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+    JsonNode *message = arena->newObj();
+    message->add("message", arena->newString("move"));
+    message->add("direction", arena->newInt32(aNewDirection));
     sendDeviceApiJsonMessage(message);
   }
   if (aDoneCB) aDoneCB();
@@ -438,8 +442,9 @@ void ExternalDevice::syncChannelValues(SimpleCB aDoneCB)
       sendDeviceApiSimpleMessage("SYNC");
     }
     else {
-      JsonObjectPtr message = JsonObject::newObj();
-      message->add("message", JsonObject::newString("sync"));
+      JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+      JsonNode *message = arena->newObj();
+      message->add("message", arena->newString("sync"));
       sendDeviceApiJsonMessage(message);
     }
   }
@@ -453,9 +458,9 @@ void ExternalDevice::syncChannelValues(SimpleCB aDoneCB)
 #pragma mark - external device configuration
 
 
-ErrorPtr ExternalDevice::configureDevice(JsonObjectPtr aInitParams)
+ErrorPtr ExternalDevice::configureDevice(JsonNode *aInitParams)
 {
-  JsonObjectPtr o;
+  JsonNode *o;
   // get protocol type for further communication
   if (aInitParams->get("protocol", o)) {
     string p = o->stringValue();
@@ -570,8 +575,8 @@ ErrorPtr ExternalDevice::configureDevice(JsonObjectPtr aInitParams)
   // check for buttons
   if (aInitParams->get("buttons", o)) {
     for (int i=0; i<o->arrayLength(); i++) {
-      JsonObjectPtr o2 = o->arrayGet(i);
-      JsonObjectPtr o3;
+      JsonNode *o2 = o->arrayGet(i);
+      JsonNode *o3;
       // set defaults
       int buttonId = 0;
       DsButtonType buttonType = buttonType_single;
@@ -593,8 +598,8 @@ ErrorPtr ExternalDevice::configureDevice(JsonObjectPtr aInitParams)
   // check for binary inputs
   if (aInitParams->get("inputs", o)) {
     for (int i=0; i<o->arrayLength(); i++) {
-      JsonObjectPtr o2 = o->arrayGet(i);
-      JsonObjectPtr o3;
+      JsonNode *o2 = o->arrayGet(i);
+      JsonNode *o3;
       // set defaults
       DsBinaryInputType inputType = binInpType_none;
       DsUsageHint usage = usage_undefined;
@@ -616,8 +621,8 @@ ErrorPtr ExternalDevice::configureDevice(JsonObjectPtr aInitParams)
   // check for sensors
   if (aInitParams->get("sensors", o)) {
     for (int i=0; i<o->arrayLength(); i++) {
-      JsonObjectPtr o2 = o->arrayGet(i);
-      JsonObjectPtr o3;
+      JsonNode *o2 = o->arrayGet(i);
+      JsonNode *o3;
       // set defaults
       DsSensorType sensorType = sensorType_none;
       DsUsageHint usage = usage_undefined;
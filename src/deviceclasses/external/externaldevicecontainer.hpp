@@ -94,6 +94,7 @@ namespace p44 {
     ///   a direct remote control for a lamp) are included. Just reading a channel state does not call this method.
     /// @note implementation must use channel's syncChannelValue() method
     virtual void syncChannelValues(SimpleCB aDoneCB);
+    virtual bool canSyncChannelValues() { return querySync; };
 
     /// start or stop dimming channel of this device. Usually implemented in device specific manner in subclasses.
     /// @param aChannel the channelType to start or stop dimming for
@@ -113,16 +114,16 @@ namespace p44 {
     void closeConnection();
 
     void handleDeviceConnectionStatus(ErrorPtr aError);
-    void handleDeviceApiJsonMessage(ErrorPtr aError, JsonObjectPtr aMessage);
+    void handleDeviceApiJsonMessage(ErrorPtr aError, JsonArenaPtr aArena);
     void handleDeviceApiSimpleMessage(ErrorPtr aError, string aMessage);
-    void sendDeviceApiJsonMessage(JsonObjectPtr aMessage);
+    void sendDeviceApiJsonMessage(JsonNode *aMessage);
     void sendDeviceApiSimpleMessage(string aMessage);
     void sendDeviceApiStatusMessage(ErrorPtr aError);
 
-    ErrorPtr processJsonMessage(string aMessageType, JsonObjectPtr aMessage);
+    ErrorPtr processJsonMessage(string aMessageType, JsonNode *aMessage);
     ErrorPtr processSimpleMessage(string aMessageType, string aValue);
-    ErrorPtr configureDevice(JsonObjectPtr aInitParams);
-    ErrorPtr processInputJson(char aInputType, JsonObjectPtr aParams);
+    ErrorPtr configureDevice(JsonNode *aInitParams);
+    ErrorPtr processInputJson(char aInputType, JsonNode *aParams);
 
     ErrorPtr processInput(char aInputType, uint32_t aIndex, double aValue);
 
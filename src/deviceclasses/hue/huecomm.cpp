@@ -29,6 +29,8 @@
 
 #include "huecomm.hpp"
 
+#include "tracer.hpp"
+
 using namespace p44;
 
 
@@ -42,6 +44,7 @@ HueApiOperation::HueApiOperation(HueComm &aHueComm, HttpMethods aMethod, const c
   resultHandler(aResultHandler),
   completed(false)
 {
+  traceId = globalTracer.getCurrentId();
 }
 
 
@@ -65,6 +68,10 @@ bool HueApiOperation::initiate()
     case httpMethodDELETE : methodStr = "DELETE"; break;
     default : methodStr = "GET"; data.reset(); break;
   }
+  if (globalTracer.enabled()) {
+    TRACE_ID_SCOPE(traceId);
+    TRACE_INSTANT("hue HTTP request", string_format("%s %s", methodStr, url.c_str()));
+  }
   hueComm.bridgeAPIComm.jsonRequest(url.c_str(), boost::bind(&HueApiOperation::processAnswer, this, _1, _2), methodStr, data);
   // executed
   return inherited::initiate();
@@ -74,6 +81,8 @@ bool HueApiOperation::initiate()
 
 void HueApiOperation::processAnswer(JsonObjectPtr aJsonResponse, ErrorPtr aError)
 {
+  TRACE_ID_SCOPE(traceId);
+  TRACE_INSTANT("hue HTTP answer", Error::isOK(aError) ? "" : aError->description());
   error = aError;
   if (Error::isOK(error)) {
     // pre-process response in case of non-GET
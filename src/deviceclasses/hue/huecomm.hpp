@@ -92,6 +92,7 @@ namespace p44 {
     bool completed;
     ErrorPtr error;
     HueApiResultCB resultHandler;
+    uint32_t traceId; ///< trace id of the operation that caused this API call
 
     void processAnswer(JsonObjectPtr aJsonResponse, ErrorPtr aError);
 
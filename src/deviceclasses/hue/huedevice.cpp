@@ -246,6 +246,28 @@ void HueDevice::disconnectableHandler(bool aForgetParams, DisconnectCB aDisconne
 
 
 
+long HueDevice::channelHardwareLevel(ChannelBehaviour &aChannel, double aValue)
+{
+  LightBehaviourPtr l = boost::dynamic_pointer_cast<LightBehaviour>(output);
+  if (l) {
+    switch (aChannel.getChannelType()) {
+      case channeltype_brightness: {
+        Brightness b = l->brightnessForHardware(aValue);
+        if (b==0) return 0; // off
+        return (long)((b-HUEAPI_OFFSET_BRIGHTNESS)*HUEAPI_FACTOR_BRIGHTNESS+0.5)+1; // on with bri 0..255
+      }
+      case channeltype_hue: return (long)(aValue*HUEAPI_FACTOR_HUE+0.5);
+      case channeltype_saturation: return (long)(aValue*HUEAPI_FACTOR_SATURATION+0.5);
+      case channeltype_colortemp: return (long)aValue; // mired
+      case channeltype_cie_x:
+      case channeltype_cie_y: return (long)(aValue*10000+0.5); // bridge uses 4 decimals
+      default: break;
+    }
+  }
+  return inherited::channelHardwareLevel(aChannel, aValue);
+}
+
+
 void HueDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 {
   // Update of light state needed
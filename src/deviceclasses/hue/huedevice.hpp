@@ -104,12 +104,19 @@ namespace p44 {
     ///   updating the device hardware, channelValueApplied() must be called on the channels that had isChannelUpdatePending().
     virtual void applyChannelValues(SimpleCB aDoneCB, bool aForDimming);
 
+    /// get the quantized level the hardware would actually output for a channel value
+    /// @param aChannel the channel
+    /// @param aValue the channel value
+    /// @return value as sent to the hue API, or HARDWARE_LEVEL_UNKNOWN
+    virtual long channelHardwareLevel(ChannelBehaviour &aChannel, double aValue);
+
     /// synchronize channel values by reading them back from the device's hardware (if possible)
     /// @param aDoneCB will be called when values are updated with actual hardware values
     /// @note this method is only called at startup and before saving scenes to make sure changes done to the outputs directly (e.g. using
     ///   a direct remote control for a lamp) are included. Just reading a channel state does not call this method.
     /// @note implementation must use channel's syncChannelValue() method
     virtual void syncChannelValues(SimpleCB aDoneCB);
+    virtual bool canSyncChannelValues() { return true; };
 
     /// @}
 
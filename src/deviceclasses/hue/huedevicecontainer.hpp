@@ -93,6 +93,9 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "hue"; }
 
+    /// @return min interval between presence checks (each is a GET to the bridge, which is shared with light commands)
+    virtual MLMicroSeconds presenceCheckInterval() { return 500*MilliSecond; }
+
     /// @return hardware GUID in URN format to identify hardware as uniquely as possible
     /// - uuid:UUUUUUU = UUID
     virtual string hardwareGUID() { return string_format("uuid:%s", bridgeUuid.c_str()); };
@@ -38,7 +38,6 @@ LedChainDevice::LedChainDevice(LedChainDeviceContainer *aClassContainerP, uint16
   inherited(aClassContainerP),
   firstLED(aFirstLED),
   numLEDs(aNumLEDs),
-  transitionTicket(0),
   startSoftEdge(0),
   endSoftEdge(0),
   r(0), g(0), b(0)
@@ -116,13 +115,11 @@ void LedChainDevice::disconnect(bool aForgetParams, DisconnectCB aDisconnectResu
 }
 
 
-#define TRANSITION_STEP_TIME (10*MilliSecond)
-
 void LedChainDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 {
   MLMicroSeconds transitionTime = 0;
   // abort previous transition
-  MainLoop::currentMainLoop().cancelExecutionTicket(transitionTicket);
+  getDeviceContainer().getTransitionEngine().stopTransition(*this);
   // full color device
   RGBColorLightBehaviourPtr cl = boost::dynamic_pointer_cast<RGBColorLightBehaviour>(output);
   if (cl) {
@@ -134,7 +131,7 @@ void LedChainDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
       //   TODO: depending to what channel has changed, take transition time from that channel. For now always using brightness transition time
       transitionTime = cl->transitionTimeToNewBrightness();
       cl->colorTransitionStep(); // init
-      applyChannelValueSteps(aForDimming, transitionTime==0 ? 1 : (double)TRANSITION_STEP_TIME/transitionTime);
+      getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&LedChainDevice::applyChannelValueSteps, this, aForDimming, _1));
     }
     // consider applied
     cl->appliedColorValues();
@@ -143,7 +140,7 @@ void LedChainDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 }
 
 
-void LedChainDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
+bool LedChainDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
 {
   // RGB, RGBW or RGBWA dimmer
   RGBColorLightBehaviourPtr cl = boost::dynamic_pointer_cast<RGBColorLightBehaviour>(output);
@@ -158,18 +155,16 @@ void LedChainDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
       shortDesc().c_str(),
       (int)r, (int)g, (int)b
     );
-    // not yet complete, schedule next step
-    transitionTicket = MainLoop::currentMainLoop().executeOnce(
-      boost::bind(&LedChainDevice::applyChannelValueSteps, this, aForDimming, aStepSize),
-      TRANSITION_STEP_TIME
-    );
-    return; // will be called later again
+    // not yet complete, engine will call again for next step
+    return true;
   }
   if (!aForDimming) LOG(LOG_INFO,
     "Ledchain device %s: final values R=%d, G=%d, B=%d\n",
     shortDesc().c_str(),
     (int)r, (int)g, (int)b
   );
+  // transition complete
+  return false;
 }
 
 
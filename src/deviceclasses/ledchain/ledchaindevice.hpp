@@ -55,8 +55,6 @@ namespace p44 {
 
     long long ledChainDeviceRowID; ///< the ROWID this device was created from (0=none)
 
-    long transitionTicket;
-
     /// current color values
     double r,g,b;
 
@@ -138,7 +136,7 @@ namespace p44 {
 
   private:
 
-    virtual void applyChannelValueSteps(bool aForDimming, double aStepSize);
+    bool applyChannelValueSteps(bool aForDimming, double aStepSize);
 
   };
   typedef boost::intrusive_ptr<LedChainDevice> LedChainDevicePtr;
@@ -108,6 +108,16 @@ void LedChainDeviceContainer::triggerRenderingRange(uint16_t aFirst, uint16_t aN
 }
 
 
+void LedChainDeviceContainer::transitionFrameDone()
+{
+  if (renderTicket) {
+    // all segments have been stepped for this frame, render now rather than waiting for the render timer
+    MainLoop::currentMainLoop().cancelExecutionTicket(renderTicket);
+    render();
+  }
+}
+
+
 static inline void increase(uint8_t &aByte, uint8_t aAmount, uint8_t aMax = 255)
 {
   uint16_t r = aByte+aAmount;
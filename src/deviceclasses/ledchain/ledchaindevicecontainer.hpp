@@ -108,6 +108,12 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "WS281x LED Chains"; }
 
+    /// @return minimum interval between dim steps (LEDs are rendered locally and are fast, allow smooth dimming)
+    virtual MLMicroSeconds minDimStepInterval() { return 50*MilliSecond; }
+
+    /// render all LED changes of a transition frame at once
+    virtual void transitionFrameDone();
+
   private:
 
     static bool segmentCompare(LedChainDevicePtr aFirst, LedChainDevicePtr aSecond);
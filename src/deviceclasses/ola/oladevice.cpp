@@ -27,6 +27,8 @@
 #include "colorlightbehaviour.hpp"
 #include "movinglightbehaviour.hpp"
 
+#include "tracer.hpp"
+
 
 using namespace p44;
 
@@ -72,8 +74,7 @@ OlaDevice::OlaDevice(OlaDeviceContainer *aClassContainerP, const string &aDevice
   redChannel(dmxNone),
   greenChannel(dmxNone),
   blueChannel(dmxNone),
-  amberChannel(dmxNone),
-  transitionTicket(0)
+  amberChannel(dmxNone)
 {
   // evaluate config
   string config = aDeviceConfig;
@@ -179,13 +180,26 @@ void OlaDevice::setDMXChannel(DmxChannel aChannel, DmxValue aChannelValue)
 }
 
 
-#define TRANSITION_STEP_TIME (10*MilliSecond)
+long OlaDevice::channelHardwareLevel(ChannelBehaviour &aChannel, double aValue)
+{
+  if (
+    olaType==ola_dimmer && aChannel.getChannelType()==channeltype_brightness &&
+    !getDeviceContainer().getTransitionEngine().isTransitionRunning(*this) // running transition must be restarted
+  ) {
+    // single channel dimmer: 8-bit DMX value
+    LightBehaviourPtr l = boost::dynamic_pointer_cast<LightBehaviour>(output);
+    if (l) return (DmxValue)(l->brightnessForHardware(aValue)*255/100);
+  }
+  // color dimmers mix all channels into the DMX values, can't tell per channel
+  return inherited::channelHardwareLevel(aChannel, aValue);
+}
+
 
 void OlaDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 {
   MLMicroSeconds transitionTime = 0;
   // abort previous transition
-  MainLoop::currentMainLoop().cancelExecutionTicket(transitionTicket);
+  getDeviceContainer().getTransitionEngine().stopTransition(*this);
   // generic device, show changed channels
   if (olaType==ola_dimmer) {
     // single channel dimmer
@@ -193,7 +207,7 @@ void OlaDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
     if (l && l->brightnessNeedsApplying()) {
       transitionTime = l->transitionTimeToNewBrightness();
       l->brightnessTransitionStep(); // init
-      applyChannelValueSteps(aForDimming, transitionTime==0 ? 1 : (double)TRANSITION_STEP_TIME/transitionTime);
+      getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&OlaDevice::applyChannelValueSteps, this, aForDimming, _1));
     }
     // consider applied
     l->brightnessApplied();
@@ -212,7 +226,7 @@ void OlaDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
         transitionTime = cl->transitionTimeToNewBrightness();
         cl->colorTransitionStep(); // init
         if (ml) ml->positionTransitionStep(); // init
-        applyChannelValueSteps(aForDimming, transitionTime==0 ? 1 : (double)TRANSITION_STEP_TIME/transitionTime);
+        getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&OlaDevice::applyChannelValueSteps, this, aForDimming, _1));
       }
       // consider applied
       if (ml) ml->appliedPosition();
@@ -223,7 +237,7 @@ void OlaDevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 }
 
 
-void OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
+bool OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
 {
   // generic device, show changed channels
   if (olaType==ola_dimmer) {
@@ -231,15 +245,12 @@ void OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
     LightBehaviourPtr l = boost::dynamic_pointer_cast<LightBehaviour>(output);
     double w = l->brightnessForHardware()*255/100;
     setDMXChannel(whiteChannel,(DmxValue)w);
+    TRACE_INSTANT("DMX update", string_format("%d=%d", whiteChannel, (int)w));
     // next step
     if (l->brightnessTransitionStep(aStepSize)) {
       LOG(LOG_DEBUG, "OLA device %s: transitional DMX512 value %d=%d\n", shortDesc().c_str(), whiteChannel, (int)w);
-      // not yet complete, schedule next step
-      transitionTicket = MainLoop::currentMainLoop().executeOnce(
-        boost::bind(&OlaDevice::applyChannelValueSteps, this, aForDimming, aStepSize),
-        TRANSITION_STEP_TIME
-      );
-      return; // will be called later again
+      // not yet complete, engine will call again for next step
+      return true;
     }
     if (!aForDimming) LOG(LOG_INFO, "OLA device %s: final DMX512 channel %d=%d\n", shortDesc().c_str(), whiteChannel, (int)w);
     l->brightnessApplied(); // confirm having applied the new brightness
@@ -272,6 +283,7 @@ void OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
     setDMXChannel(redChannel,(DmxValue)r);
     setDMXChannel(greenChannel,(DmxValue)g);
     setDMXChannel(blueChannel,(DmxValue)b);
+    TRACE_INSTANT("DMX update", string_format("%d..: R=%d G=%d B=%d", redChannel, (int)r, (int)g, (int)b));
     // there might be position as well
     double h = 0;
     double v = 0;
@@ -292,12 +304,8 @@ void OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
         whiteChannel, (int)w, amberChannel, (int)a,
         hPosChannel, (int)h, vPosChannel, (int)v
       );
-      // not yet complete, schedule next step
-      transitionTicket = MainLoop::currentMainLoop().executeOnce(
-        boost::bind(&OlaDevice::applyChannelValueSteps, this, aForDimming, aStepSize),
-        TRANSITION_STEP_TIME
-      );
-      return; // will be called later again
+      // not yet complete, engine will call again for next step
+      return true;
     }
     if (!aForDimming) LOG(LOG_INFO,
       "OLA device %s: final DMX512 values R(%hd)=%d, G(%hd)=%d, B(%hd)=%d, W(%hd)=%d, A(%hd)=%d, H(%hd)=%d, V(%hd)=%d\n",
@@ -307,6 +315,8 @@ void OlaDevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
       hPosChannel, (int)h, vPosChannel, (int)v
     );
   }
+  // transition complete
+  return false;
 }
 
 
@@ -59,7 +59,6 @@ namespace p44 {
     DmxChannel hPosChannel;
     DmxChannel vPosChannel;
 
-    long transitionTicket;
 
   public:
 
@@ -81,6 +80,12 @@ namespace p44 {
     ///   in a single channel (and not switching between color modes etc.)
     virtual void applyChannelValues(SimpleCB aDoneCB, bool aForDimming);
 
+    /// get the quantized level the hardware would actually output for a channel value
+    /// @param aChannel the channel
+    /// @param aValue the channel value
+    /// @return DMX value for the brightness channel of single channel dimmers, or HARDWARE_LEVEL_UNKNOWN
+    virtual long channelHardwareLevel(ChannelBehaviour &aChannel, double aValue);
+
     /// @}
 
     OlaDeviceContainer &getOlaDeviceContainer();
@@ -139,7 +144,7 @@ namespace p44 {
 
   private:
 
-    virtual void applyChannelValueSteps(bool aForDimming, double aStepSize);
+    bool applyChannelValueSteps(bool aForDimming, double aStepSize);
 
   };
   typedef boost::intrusive_ptr<OlaDevice> OlaDevicePtr;
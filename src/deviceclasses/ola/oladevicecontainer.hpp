@@ -101,6 +101,9 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "OLA/DMX512"; }
 
+    /// @return minimum interval between dim steps (DMX512 universe is refreshed continuously, allow smooth dimming)
+    virtual MLMicroSeconds minDimStepInterval() { return 50*MilliSecond; }
+
   private:
 
     OlaDevicePtr addOlaDevice(string aDeviceType, string aDeviceConfig);
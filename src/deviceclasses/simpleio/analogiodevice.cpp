@@ -30,8 +30,7 @@ using namespace p44;
 
 AnalogIODevice::AnalogIODevice(StaticDeviceContainer *aClassContainerP, const string &aDeviceConfig) :
   StaticDevice((DeviceClassContainer *)aClassContainerP),
-  analogIOType(analogio_unknown),
-  transitionTicket(0)
+  analogIOType(analogio_unknown)
 {
   string ioname = aDeviceConfig;
   string mode = "dimmer"; // default to dimmer
@@ -119,13 +118,11 @@ AnalogIODevice::AnalogIODevice(StaticDeviceContainer *aClassContainerP, const st
 
 
 
-#define TRANSITION_STEP_TIME (10*MilliSecond)
-
 void AnalogIODevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 {
   MLMicroSeconds transitionTime = 0;
   // abort previous transition
-  MainLoop::currentMainLoop().cancelExecutionTicket(transitionTicket);
+  getDeviceContainer().getTransitionEngine().stopTransition(*this);
   // generic device, show changed channels
   if (analogIOType==analogio_dimmer) {
     // single channel PWM dimmer
@@ -133,7 +130,7 @@ void AnalogIODevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
     if (l && l->brightnessNeedsApplying()) {
       transitionTime = l->transitionTimeToNewBrightness();
       l->brightnessTransitionStep(); // init
-      applyChannelValueSteps(aForDimming, transitionTime==0 ? 1 : (double)TRANSITION_STEP_TIME/transitionTime);
+      getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&AnalogIODevice::applyChannelValueSteps, this, aForDimming, _1));
     }
     // consider applied
     l->brightnessApplied();
@@ -150,7 +147,7 @@ void AnalogIODevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
         //   TODO: depending to what channel has changed, take transition time from that channel. For now always using brightness transition time
         transitionTime = cl->transitionTimeToNewBrightness();
         cl->colorTransitionStep(); // init
-        applyChannelValueSteps(aForDimming, transitionTime==0 ? 1 : (double)TRANSITION_STEP_TIME/transitionTime);
+        getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&AnalogIODevice::applyChannelValueSteps, this, aForDimming, _1));
       } // if needs update
       // consider applied
       cl->appliedColorValues();
@@ -172,7 +169,7 @@ void AnalogIODevice::applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
 
 
 
-void AnalogIODevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
+bool AnalogIODevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
 {
   // generic device, show changed channels
   if (analogIOType==analogio_dimmer) {
@@ -184,12 +181,8 @@ void AnalogIODevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
     // next step
     if (l->brightnessTransitionStep(aStepSize)) {
       LOG(LOG_DEBUG, "AnalogIO device %s: transitional PWM value: %.2f\n", shortDesc().c_str(), w);
-      // not yet complete, schedule next step
-      transitionTicket = MainLoop::currentMainLoop().executeOnce(
-        boost::bind(&AnalogIODevice::applyChannelValueSteps, this, aForDimming, aStepSize),
-        TRANSITION_STEP_TIME
-      );
-      return; // will be called later again
+      // not yet complete, engine will call again for next step
+      return true;
     }
     if (!aForDimming) LOG(LOG_INFO, "AnalogIO device %s: final PWM value: %.2f\n", shortDesc().c_str(), w);
   }
@@ -221,15 +214,13 @@ void AnalogIODevice::applyChannelValueSteps(bool aForDimming, double aStepSize)
     // next step
     if (cl->colorTransitionStep(aStepSize)) {
       LOG(LOG_DEBUG, "AnalogIO device %s: transitional RGBW values: R=%.2f G=%.2f, B=%.2f, W=%.2f\n", shortDesc().c_str(), r, g, b, w);
-      // not yet complete, schedule next step
-      transitionTicket = MainLoop::currentMainLoop().executeOnce(
-        boost::bind(&AnalogIODevice::applyChannelValueSteps, this, aForDimming, aStepSize),
-        TRANSITION_STEP_TIME
-      );
-      return; // will be called later again
+      // not yet complete, engine will call again for next step
+      return true;
     }
     if (!aForDimming) LOG(LOG_INFO, "AnalogIO device %s: final RGBW values: R=%.2f G=%.2f, B=%.2f, W=%.2f\n", shortDesc().c_str(), r, g, b, w);
   }
+  // transition complete
+  return false;
 }
 
 
@@ -52,7 +52,6 @@ namespace p44 {
 
     AnalogIoType analogIOType;
 
-    long transitionTicket;
 
   public:
     AnalogIODevice(StaticDeviceContainer *aClassContainerP, const string &aDeviceConfig);
@@ -98,7 +97,7 @@ namespace p44 {
 
   private:
 
-    virtual void applyChannelValueSteps(bool aForDimming, double aStepSize);
+    bool applyChannelValueSteps(bool aForDimming, double aStepSize);
 
   };
 
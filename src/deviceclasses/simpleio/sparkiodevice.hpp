@@ -205,6 +205,7 @@ namespace p44 {
     ///   a direct remote control for a lamp) are included. Just reading a channel state does not call this method.
     /// @note implementation must use channel's syncChannelValue() method
     virtual void syncChannelValues(SimpleCB aDoneCB);
+    virtual bool canSyncChannelValues() { return true; };
 
     /// @}
 
@@ -31,6 +31,9 @@ namespace p44 {
     ///   Will be appended to product name to create modelName() for vdcs
     virtual string vdcModelSuffix() { return "UPnP"; }
 
+    /// @return min interval between presence checks (each is a multicast SSDP search)
+    virtual MLMicroSeconds presenceCheckInterval() { return 1*Second; }
+
   private:
     SsdpSearchPtr m_dmr_search;
 
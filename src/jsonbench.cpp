@@ -0,0 +1,102 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Compares parsing and generating typical vDC API messages with json-c based JsonObjects and with JsonArena
+
+#include "jsonobject.hpp"
+#include "jsonarena.hpp"
+
+#define DEFAULT_ITERATIONS 20000
+
+using namespace p44;
+
+
+// small message, like most vDC API notifications
+static const char *smallMessage =
+  "{\"jsonrpc\":\"2.0\",\"method\":\"callScene\",\"params\":{\"dSUID\":\"198C033E330755E78015F97AD093DD1C00\","
+  "\"scene\":5,\"force\":false,\"group\":1,\"zone_id\":0}}";
+
+
+// larger message, like a getProperty result for all devices of a vdc
+static string largeMessage()
+{
+  string m = "{\"jsonrpc\":\"2.0\",\"id\":\"42\",\"result\":{\"x-p44-devices\":{";
+  for (int i=0; i<50; i++) {
+    if (i>0) m += ",";
+    m += string_format(
+      "\"198C033E330755E78015F97AD093DD%02X00\":{\"name\":\"Device %d\",\"model\":\"Dimmer\",\"primaryGroup\":1,"
+      "\"zoneID\":%d,\"progMode\":false,\"outputDescription\":{\"function\":1,\"outputUsage\":0,\"variableRamp\":true,"
+      "\"maxPower\":300.5},\"channelStates\":{\"brightness\":{\"value\":%.1f,\"age\":1.25}},"
+      "\"buttonInputSettings\":[{\"group\":1,\"mode\":0,\"function\":0,\"setsLocalPriority\":false,\"callsPresent\":false}]}",
+      i, i, i%5, i*2.0
+    );
+  }
+  m += "}}}";
+  return m;
+}
+
+
+static void bench(const char *aName, const string &aText, int aIterations)
+{
+  size_t len = aText.size();
+  // json-c
+  MLMicroSeconds start = MainLoop::now();
+  size_t outSize = 0;
+  for (int i=0; i<aIterations; i++) {
+    JsonObjectPtr o = JsonObject::objFromText(aText.c_str(), len);
+    outSize += o->json_c_str() ? strlen(o->json_c_str()) : 0;
+  }
+  MLMicroSeconds jsonc = MainLoop::now()-start;
+  // arena
+  start = MainLoop::now();
+  size_t arenaOutSize = 0;
+  for (int i=0; i<aIterations; i++) {
+    JsonArenaPtr a = JsonArena::arenaFromText(aText.c_str(), len);
+    string out;
+    a->root()->appendJson(out);
+    arenaOutSize += out.size();
+  }
+  MLMicroSeconds arena = MainLoop::now()-start;
+  printf(
+    "%-6s message (%5zu bytes): json-c %8.2f uS, arena %8.2f uS per parse+generate, arena/json-c = %.2f\n",
+    aName, len,
+    (double)jsonc/aIterations, (double)arena/aIterations,
+    jsonc>0 ? (double)arena/jsonc : 0
+  );
+  if (outSize/aIterations!=arenaOutSize/aIterations) {
+    printf("       note: generated text differs in size (json-c %zu, arena %zu bytes)\n", outSize/aIterations, arenaOutSize/aIterations);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  int iterations = DEFAULT_ITERATIONS;
+  if (argc>1) iterations = atoi(argv[1]);
+  if (iterations<=0) {
+    fprintf(stderr, "usage:\n  %s [iterations]\n", argv[0]);
+    exit(1);
+  }
+  SETLOGLEVEL(LOG_WARNING);
+  bench("small", smallMessage, iterations);
+  bench("large", largeMessage(), iterations/50>0 ? iterations/50 : 1);
+  return 0;
+}
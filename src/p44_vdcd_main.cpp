@@ -58,6 +58,7 @@
 #endif
 
 #include "digitalio.hpp"
+#include "tracer.hpp"
 
 
 #define DEFAULT_USE_PROTOBUF_API 1 // 0: no, 1: yes
@@ -363,6 +364,10 @@ public:
       { 'l', "loglevel",      true,  "level;set max level of log message detail to show on stdout" },
       { 0  , "errlevel",      true,  "level;set max level for log messages to go to stderr as well" },
       { 0  , "mainloopstats", true,  "interval;0=no stats, 1..N interval (5Sec steps)" },
+      { 0  , "announcewindow", true, "count;max number of device announcements awaiting acknowledgement from vdSM at the same time" },
+      { 0  , "resyncinterval", true, "milliseconds;min time between reading back restored output states from two devices after startup (0=none, default=1000)" },
+      { 0  , "writebudget",   true,  "kbytes;max settings data written to flash per hour on average (0=unlimited, default)" },
+      { 0  , "trace",         true,  "events;trace vDC API notifications to outputs in ring buffer of given size (see p44 cfg API 'trace')" },
       { 0  , "dontlogerrors", false, "don't duplicate error messages (see --errlevel) on stdout" },
       { 's', "sqlitedir",     true,  "dirpath;set SQLite DB directory (default = " DEFAULT_DBDIR ")" },
       { 0  , "icondir",       true,  "icon directory;specifiy path to directory containing device icons" },
@@ -487,6 +492,35 @@ public:
         p44VdcHost->setMainloopStatsInterval(mainloopStatsInterval);
       }
 
+      // - set announcement window
+      int announceWindow;
+      if (getIntOption("announcewindow", announceWindow)) {
+        p44VdcHost->setAnnounceWindow(announceWindow);
+      }
+
+      // - set rate limit for background re-sync of restored output states
+      int resyncInterval;
+      if (getIntOption("resyncinterval", resyncInterval)) {
+        p44VdcHost->setOutputResyncInterval(resyncInterval*MilliSecond);
+      }
+
+      // - set flash write budget for settings
+      int writeBudget;
+      if (getIntOption("writebudget", writeBudget)) {
+        p44VdcHost->setSettingsWriteBudget((uint64_t)writeBudget*1024);
+      }
+
+      // - enable tracing
+      int traceEvents;
+      if (getIntOption("trace", traceEvents)) {
+        if (traceEvents<0 || traceEvents>TRACE_MAX_EVENTS) {
+          LOG(LOG_ERR, "Invalid --trace buffer size %d, must be 0..%d - tracing not enabled\n", traceEvents, TRACE_MAX_EVENTS);
+        }
+        else {
+          globalTracer.setBufferSize(traceEvents);
+        }
+      }
+
       // - set API
       int protobufapi = DEFAULT_USE_PROTOBUF_API;
       getIntOption("protobufapi", protobufapi);
@@ -763,6 +797,16 @@ public:
   }
 
 
+  virtual void cleanup(int aExitCode)
+  {
+    // make sure all changed settings are written before exiting
+    if (p44VdcHost) {
+      p44VdcHost->flushSettings();
+      p44VdcHost->getDsParamStore().stopWriteBehind();
+    }
+  }
+
+
 
   virtual void initialized(ErrorPtr aError)
   {
@@ -0,0 +1,826 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "jsonarena.hpp"
+
+#include <math.h>
+
+using namespace p44;
+
+
+/// size of the first memory chunk of an arena. Typical vDC API messages fit into this
+#define JSONARENA_FIRST_CHUNK_SIZE 1024
+/// chunk sizes double until this size is reached
+#define JSONARENA_MAX_CHUNK_SIZE (64*1024)
+/// max nesting depth of objects and arrays the parser accepts (same as json-c default)
+#define JSONARENA_MAX_DEPTH 32
+/// max length of a number token
+#define JSONARENA_MAX_NUMBER_LEN 64
+
+
+#pragma mark - JsonArena memory management
+
+
+JsonArena::JsonArena() :
+  chunks(NULL),
+  nextChunkSize(JSONARENA_FIRST_CHUNK_SIZE),
+  totalAllocated(0),
+  rootNode(NULL),
+  parseP(NULL),
+  parseEnd(NULL),
+  parseDepth(0),
+  parseErr(JsonArenaErrorOK)
+{
+}
+
+
+JsonArena::~JsonArena()
+{
+  // free all chunks, which also frees all nodes and strings at once
+  while (chunks) {
+    Chunk *c = chunks;
+    chunks = c->prev;
+    free(c);
+  }
+}
+
+
+void *JsonArena::alloc(size_t aSize)
+{
+  // keep everything 8-byte aligned
+  aSize = (aSize+7) & ~(size_t)7;
+  if (!chunks || chunks->used+aSize>chunks->size) {
+    // need a new chunk
+    size_t sz = nextChunkSize;
+    if (aSize>sz) sz = aSize; // oversized allocation gets a chunk of its own
+    Chunk *c = (Chunk *)malloc(sizeof(Chunk)+sz);
+    c->prev = chunks;
+    c->size = sz;
+    c->used = 0;
+    chunks = c;
+    if (nextChunkSize<JSONARENA_MAX_CHUNK_SIZE) nextChunkSize *= 2;
+  }
+  void *p = (uint8_t *)(chunks+1)+chunks->used;
+  chunks->used += aSize;
+  totalAllocated += aSize;
+  return p;
+}
+
+
+const char *JsonArena::newCString(const char *aCStr, size_t aLen)
+{
+  char *s = (char *)alloc(aLen+1);
+  if (aLen>0) memcpy(s, aCStr, aLen);
+  s[aLen] = 0;
+  return s;
+}
+
+
+bool JsonArena::retain(JsonArena *aOtherArena)
+{
+  if (!aOtherArena || aOtherArena==this) return true;
+  // most of the time, the same other arena is retained repeatedly, so just check the last one
+  if (retainedArenas.size()>0 && retainedArenas.back().get()==aOtherArena) return true;
+  for (ArenaVector::iterator pos = retainedArenas.begin(); pos!=retainedArenas.end(); ++pos) {
+    if (pos->get()==aOtherArena) return true;
+  }
+  // prevent simple retain cycles, which would leak both arenas
+  for (ArenaVector::iterator pos = aOtherArena->retainedArenas.begin(); pos!=aOtherArena->retainedArenas.end(); ++pos) {
+    if (pos->get()==this) return false;
+  }
+  retainedArenas.push_back(JsonArenaPtr(aOtherArena));
+  return true;
+}
+
+
+
+#pragma mark - node factories
+
+
+JsonNode::JsonNode(JsonArena *aArena, JsonNodeType aType) :
+  arena(aArena),
+  next(NULL),
+  key(NULL),
+  nodeType(aType),
+  linked(false)
+{
+  memset(&v, 0, sizeof(v));
+}
+
+
+JsonNode *JsonArena::newNode(JsonNodeType aType)
+{
+  return new (alloc(sizeof(JsonNode))) JsonNode(this, aType);
+}
+
+
+JsonNode *JsonArena::newBool(bool aBool)
+{
+  JsonNode *n = newNode(jsonnode_boolean);
+  n->v.boolVal = aBool;
+  return n;
+}
+
+
+JsonNode *JsonArena::newInt64(int64_t aInt64)
+{
+  JsonNode *n = newNode(jsonnode_int);
+  n->v.intVal = aInt64;
+  return n;
+}
+
+
+JsonNode *JsonArena::newDouble(double aDouble)
+{
+  JsonNode *n = newNode(jsonnode_double);
+  n->v.doubleVal = aDouble;
+  return n;
+}
+
+
+JsonNode *JsonArena::newString(const char *aCStr)
+{
+  if (!aCStr) return newNull();
+  return newString(aCStr, strlen(aCStr));
+}
+
+
+JsonNode *JsonArena::newString(const char *aCStr, size_t aLen)
+{
+  JsonNode *n = newNode(jsonnode_string);
+  n->v.str.chars = newCString(aCStr, aLen);
+  n->v.str.len = aLen;
+  return n;
+}
+
+
+JsonNode *JsonArena::newString(const string &aString, bool aEmptyIsNull)
+{
+  if (aEmptyIsNull && aString.empty()) return newNull();
+  return newString(aString.c_str(), aString.size());
+}
+
+
+JsonNode *JsonArena::copyNode(const JsonNode *aNode)
+{
+  if (!aNode) return newNull();
+  JsonNode *n = newNode(aNode->nodeType);
+  switch (aNode->nodeType) {
+    case jsonnode_string:
+      n->v.str.chars = newCString(aNode->v.str.chars, aNode->v.str.len);
+      n->v.str.len = aNode->v.str.len;
+      break;
+    case jsonnode_object:
+    case jsonnode_array:
+      for (JsonNode *c = aNode->v.list.first; c; c = c->next) {
+        JsonNode *cc = copyNode(c);
+        if (c->key) cc->key = newCString(c->key, strlen(c->key));
+        n->link(cc);
+      }
+      break;
+    default:
+      n->v = aNode->v; // simple value
+      break;
+  }
+  return n;
+}
+
+
+
+#pragma mark - JsonNode members and elements
+
+
+void JsonNode::link(JsonNode *aNode)
+{
+  aNode->next = NULL;
+  aNode->linked = true;
+  if (v.list.last)
+    v.list.last->next = aNode;
+  else
+    v.list.first = aNode;
+  v.list.last = aNode;
+  v.list.count++;
+}
+
+
+JsonNode *JsonNode::unlink(JsonNode *aNode, JsonNode *aPrev)
+{
+  JsonNode *nxt = aNode->next;
+  if (aPrev)
+    aPrev->next = nxt;
+  else
+    v.list.first = nxt;
+  if (v.list.last==aNode) v.list.last = aPrev;
+  v.list.count--;
+  v.list.cursorNode = NULL; // invalidate array cursor
+  aNode->next = NULL;
+  aNode->linked = false;
+  return nxt;
+}
+
+
+JsonNode *JsonNode::linkable(JsonNode *aNode)
+{
+  if (!aNode) return arena->newNull();
+  // can be linked as-is if not yet member elsewhere, but node's arena must live as long as ours
+  if (aNode->linked || !arena->retain(aNode->arena)) {
+    // must copy
+    return arena->copyNode(aNode);
+  }
+  return aNode;
+}
+
+
+void JsonNode::add(const char *aKey, JsonNode *aNode)
+{
+  if (nodeType!=jsonnode_object || !aKey) return;
+  del(aKey); // replace existing member
+  JsonNode *n = linkable(aNode);
+  n->key = arena->newCString(aKey, strlen(aKey));
+  link(n);
+}
+
+
+JsonNode *JsonNode::findMember(const char *aKey) const
+{
+  if (nodeType!=jsonnode_object || !aKey) return NULL;
+  for (JsonNode *n = v.list.first; n; n = n->next) {
+    if (strcmp(n->key, aKey)==0) return n;
+  }
+  return NULL;
+}
+
+
+JsonNode *JsonNode::get(const char *aKey) const
+{
+  JsonNode *n = findMember(aKey);
+  if (n && n->nodeType==jsonnode_null) return NULL;
+  return n;
+}
+
+
+bool JsonNode::get(const char *aKey, JsonNode *&aNode) const
+{
+  JsonNode *n = findMember(aKey);
+  if (!n) return false;
+  aNode = n->nodeType==jsonnode_null ? NULL : n;
+  return true;
+}
+
+
+const char *JsonNode::getCString(const char *aKey) const
+{
+  JsonNode *n = get(aKey);
+  if (n) return n->c_strValue();
+  return NULL;
+}
+
+
+void JsonNode::del(const char *aKey)
+{
+  if (nodeType!=jsonnode_object || !aKey) return;
+  JsonNode *prev = NULL;
+  for (JsonNode *n = v.list.first; n; n = n->next) {
+    if (strcmp(n->key, aKey)==0) {
+      unlink(n, prev);
+      return;
+    }
+    prev = n;
+  }
+}
+
+
+void JsonNode::arrayAppend(JsonNode *aNode)
+{
+  if (nodeType!=jsonnode_array) return;
+  link(linkable(aNode));
+}
+
+
+JsonNode *JsonNode::arrayGet(int aAtIndex)
+{
+  if (nodeType!=jsonnode_array || aAtIndex<0 || aAtIndex>=v.list.count) return NULL;
+  JsonNode *n;
+  int i;
+  if (v.list.cursorNode && v.list.cursorIndex<=aAtIndex) {
+    // continue from last accessed element (usual case when iterating)
+    n = v.list.cursorNode;
+    i = v.list.cursorIndex;
+  }
+  else {
+    n = v.list.first;
+    i = 0;
+  }
+  while (i<aAtIndex) { n = n->next; i++; }
+  v.list.cursorNode = n;
+  v.list.cursorIndex = i;
+  return n;
+}
+
+
+void JsonNode::arrayPut(int aAtIndex, JsonNode *aNode)
+{
+  if (nodeType!=jsonnode_array || aAtIndex<0) return;
+  // extend array with nulls if needed
+  while (v.list.count<aAtIndex) link(arena->newNull());
+  JsonNode *n = linkable(aNode);
+  if (aAtIndex==v.list.count) {
+    link(n);
+    return;
+  }
+  // replace existing element
+  JsonNode *prev = NULL;
+  JsonNode *old = v.list.first;
+  for (int i=0; i<aAtIndex; i++) { prev = old; old = old->next; }
+  n->next = old->next;
+  n->linked = true;
+  if (prev) prev->next = n; else v.list.first = n;
+  if (v.list.last==old) v.list.last = n;
+  old->next = NULL;
+  old->linked = false;
+  v.list.cursorNode = NULL;
+}
+
+
+
+#pragma mark - JsonNode simple values
+
+
+bool JsonNode::boolValue() const
+{
+  switch (nodeType) {
+    case jsonnode_boolean: return v.boolVal;
+    case jsonnode_int: return v.intVal!=0;
+    case jsonnode_double: return v.doubleVal!=0;
+    case jsonnode_string: return v.str.len>0;
+    default: return false;
+  }
+}
+
+
+int64_t JsonNode::int64Value() const
+{
+  switch (nodeType) {
+    case jsonnode_boolean: return v.boolVal ? 1 : 0;
+    case jsonnode_int: return v.intVal;
+    case jsonnode_double: return (int64_t)v.doubleVal;
+    case jsonnode_string: return strtoll(v.str.chars, NULL, 10);
+    default: return 0;
+  }
+}
+
+
+double JsonNode::doubleValue() const
+{
+  switch (nodeType) {
+    case jsonnode_boolean: return v.boolVal ? 1 : 0;
+    case jsonnode_int: return v.intVal;
+    case jsonnode_double: return v.doubleVal;
+    case jsonnode_string: return strtod(v.str.chars, NULL);
+    default: return 0;
+  }
+}
+
+
+const char *JsonNode::c_strValue() const
+{
+  if (nodeType==jsonnode_string) return v.str.chars;
+  // like json-c, return JSON representation for non-strings
+  string s = json_str();
+  return arena->newCString(s.c_str(), s.size());
+}
+
+
+size_t JsonNode::stringLength() const
+{
+  if (nodeType==jsonnode_string) return v.str.len;
+  return json_str().size();
+}
+
+
+string JsonNode::stringValue() const
+{
+  if (nodeType==jsonnode_string) return string(v.str.chars, v.str.len);
+  return json_str();
+}
+
+
+void JsonNode::setString(const char *aCStr, size_t aLen)
+{
+  nodeType = jsonnode_string;
+  v.str.chars = arena->newCString(aCStr, aLen);
+  v.str.len = aLen;
+}
+
+
+void JsonNode::setObject()
+{
+  nodeType = jsonnode_object;
+  memset(&v, 0, sizeof(v));
+}
+
+
+void JsonNode::setArray()
+{
+  nodeType = jsonnode_array;
+  memset(&v, 0, sizeof(v));
+}
+
+
+
+#pragma mark - generating JSON text
+
+
+static void appendJsonString(string &aJson, const char *aStr, size_t aLen)
+{
+  aJson += '"';
+  const char *p = aStr;
+  const char *e = aStr+aLen;
+  while (p<e) {
+    // copy runs of chars not needing escape at once
+    const char *r = p;
+    while (r<e && (uint8_t)*r>=0x20 && *r!='"' && *r!='\\') r++;
+    if (r>p) { aJson.append(p, r-p); p = r; }
+    if (p>=e) break;
+    char c = *p++;
+    switch (c) {
+      case '"': aJson += "\\\""; break;
+      case '\\': aJson += "\\\\"; break;
+      case '\n': aJson += "\\n"; break;
+      case '\r': aJson += "\\r"; break;
+      case '\t': aJson += "\\t"; break;
+      case '\b': aJson += "\\b"; break;
+      case '\f': aJson += "\\f"; break;
+      default: string_format_append(aJson, "\\u%04x", (uint8_t)c); break;
+    }
+  }
+  aJson += '"';
+}
+
+
+void JsonNode::appendJson(string &aJson) const
+{
+  char buf[32];
+  switch (nodeType) {
+    case jsonnode_null:
+      aJson += "null";
+      break;
+    case jsonnode_boolean:
+      aJson += v.boolVal ? "true" : "false";
+      break;
+    case jsonnode_int:
+      snprintf(buf, sizeof(buf), "%lld", (long long)v.intVal);
+      aJson += buf;
+      break;
+    case jsonnode_double:
+      if (isnan(v.doubleVal) || isinf(v.doubleVal)) {
+        aJson += "null"; // not representable in JSON
+      }
+      else {
+        // shortest representation that reads back as the same double (15 digits are enough for most values, some need 17)
+        for (int prec=15; prec<=17; prec++) {
+          snprintf(buf, sizeof(buf), "%.*g", prec, v.doubleVal);
+          if (strtod(buf, NULL)==v.doubleVal) break;
+        }
+        aJson += buf;
+        // make sure it still reads as a double
+        if (!strpbrk(buf, ".eE")) aJson += ".0";
+      }
+      break;
+    case jsonnode_string:
+      appendJsonString(aJson, v.str.chars, v.str.len);
+      break;
+    case jsonnode_object: {
+      aJson += '{';
+      for (const JsonNode *n = v.list.first; n; n = n->next) {
+        if (n!=v.list.first) aJson += ',';
+        appendJsonString(aJson, n->key, strlen(n->key));
+        aJson += ':';
+        n->appendJson(aJson);
+      }
+      aJson += '}';
+      break;
+    }
+    case jsonnode_array: {
+      aJson += '[';
+      for (const JsonNode *n = v.list.first; n; n = n->next) {
+        if (n!=v.list.first) aJson += ',';
+        n->appendJson(aJson);
+      }
+      aJson += ']';
+      break;
+    }
+  }
+}
+
+
+string JsonNode::json_str() const
+{
+  string s;
+  appendJson(s);
+  return s;
+}
+
+
+
+#pragma mark - parsing JSON text
+
+
+ErrorPtr JsonArena::parse(const char *aJsonText, size_t aLen, JsonNode *&aRootNode)
+{
+  parseP = aJsonText;
+  parseEnd = aJsonText+aLen;
+  parseDepth = 0;
+  parseErr = JsonArenaErrorOK;
+  aRootNode = parseValue();
+  if (aRootNode) {
+    rootNode = aRootNode;
+    skipWhiteSpace();
+    if (parseP<parseEnd) {
+      // root node is valid, but there's more text
+      return ErrorPtr(new JsonArenaError(JsonArenaErrorTrailing, string_format("extra text after JSON value at offset %ld", (long)(parseP-aJsonText))));
+    }
+    return ErrorPtr();
+  }
+  switch (parseErr) {
+    case JsonArenaErrorIncomplete:
+      return ErrorPtr(new JsonArenaError(parseErr, "incomplete JSON text"));
+    case JsonArenaErrorDepth:
+      return ErrorPtr(new JsonArenaError(parseErr, string_format("nesting too deep at offset %ld", (long)(parseP-aJsonText))));
+    default:
+      return ErrorPtr(new JsonArenaError(JsonArenaErrorSyntax, string_format("unexpected character at offset %ld", (long)(parseP-aJsonText))));
+  }
+}
+
+
+JsonArenaPtr JsonArena::arenaFromText(const char *aJsonText, ssize_t aMaxChars)
+{
+  if (aMaxChars<0) aMaxChars = strlen(aJsonText);
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  JsonNode *root;
+  ErrorPtr err = arena->parse(aJsonText, aMaxChars, root);
+  if (!root) return JsonArenaPtr();
+  return arena;
+}
+
+
+void JsonArena::skipWhiteSpace()
+{
+  while (parseP<parseEnd && (*parseP==' ' || *parseP=='\t' || *parseP=='\n' || *parseP=='\r')) parseP++;
+}
+
+
+JsonNode *JsonArena::parseValue()
+{
+  skipWhiteSpace();
+  if (parseP>=parseEnd) {
+    parseErr = JsonArenaErrorIncomplete;
+    return NULL;
+  }
+  switch (*parseP) {
+    case '{':
+    case '[': {
+      bool isObj = *parseP=='{';
+      char closing = isObj ? '}' : ']';
+      if (++parseDepth>JSONARENA_MAX_DEPTH) {
+        parseErr = JsonArenaErrorDepth;
+        return NULL;
+      }
+      parseP++;
+      JsonNode *container = newNode(isObj ? jsonnode_object : jsonnode_array);
+      skipWhiteSpace();
+      if (parseP<parseEnd && *parseP==closing) {
+        // empty
+        parseP++;
+        parseDepth--;
+        return container;
+      }
+      while (true) {
+        const char *k = NULL;
+        if (isObj) {
+          // member name
+          skipWhiteSpace();
+          if (parseP>=parseEnd) { parseErr = JsonArenaErrorIncomplete; return NULL; }
+          if (*parseP!='"') { parseErr = JsonArenaErrorSyntax; return NULL; }
+          size_t kl;
+          if (!parseString(k, kl)) return NULL;
+          skipWhiteSpace();
+          if (parseP>=parseEnd) { parseErr = JsonArenaErrorIncomplete; return NULL; }
+          if (*parseP!=':') { parseErr = JsonArenaErrorSyntax; return NULL; }
+          parseP++;
+        }
+        JsonNode *n = parseValue();
+        if (!n) return NULL;
+        n->key = k;
+        container->link(n);
+        skipWhiteSpace();
+        if (parseP>=parseEnd) { parseErr = JsonArenaErrorIncomplete; return NULL; }
+        if (*parseP==',') {
+          parseP++;
+          continue;
+        }
+        if (*parseP==closing) {
+          parseP++;
+          break;
+        }
+        parseErr = JsonArenaErrorSyntax;
+        return NULL;
+      }
+      parseDepth--;
+      return container;
+    }
+    case '"': {
+      const char *s;
+      size_t l;
+      if (!parseString(s, l)) return NULL;
+      JsonNode *n = newNode(jsonnode_string);
+      n->v.str.chars = s;
+      n->v.str.len = l;
+      return n;
+    }
+    case 't':
+      if (!parseLiteral("true")) return NULL;
+      return newBool(true);
+    case 'f':
+      if (!parseLiteral("false")) return NULL;
+      return newBool(false);
+    case 'n':
+      if (!parseLiteral("null")) return NULL;
+      return newNull();
+    default:
+      if (*parseP=='-' || isdigit(*parseP)) return parseNumber();
+      parseErr = JsonArenaErrorSyntax;
+      return NULL;
+  }
+}
+
+
+bool JsonArena::parseLiteral(const char *aLiteral)
+{
+  const char *p = parseP;
+  while (*aLiteral) {
+    if (p>=parseEnd) { parseErr = JsonArenaErrorIncomplete; return false; }
+    if (*p!=*aLiteral) { parseErr = JsonArenaErrorSyntax; return false; }
+    p++; aLiteral++;
+  }
+  parseP = p;
+  return true;
+}
+
+
+JsonNode *JsonArena::parseNumber()
+{
+  const char *p = parseP;
+  bool isDouble = false;
+  while (p<parseEnd && (isdigit(*p) || *p=='-' || *p=='+' || *p=='.' || *p=='e' || *p=='E')) {
+    if (*p=='.' || *p=='e' || *p=='E') isDouble = true;
+    p++;
+  }
+  size_t len = p-parseP;
+  if (len>=JSONARENA_MAX_NUMBER_LEN) { parseErr = JsonArenaErrorSyntax; return NULL; }
+  // strtoxx need a terminated string
+  char buf[JSONARENA_MAX_NUMBER_LEN];
+  memcpy(buf, parseP, len);
+  buf[len] = 0;
+  char *e;
+  JsonNode *n;
+  if (isDouble)
+    n = newDouble(strtod(buf, &e));
+  else
+    n = newInt64(strtoll(buf, &e, 10));
+  if (e!=buf+len) {
+    // a number cut off at the end of the text (like "-" or "1e") might still be completed by more text
+    parseErr = p>=parseEnd ? JsonArenaErrorIncomplete : JsonArenaErrorSyntax;
+    return NULL;
+  }
+  parseP = p;
+  return n;
+}
+
+
+// append UTF-8 representation of a unicode code point
+static char *putUTF8(char *aP, uint32_t aCodePoint)
+{
+  if (aCodePoint<0x80) {
+    *aP++ = (char)aCodePoint;
+  }
+  else if (aCodePoint<0x800) {
+    *aP++ = (char)(0xC0 | (aCodePoint>>6));
+    *aP++ = (char)(0x80 | (aCodePoint & 0x3F));
+  }
+  else if (aCodePoint<0x10000) {
+    *aP++ = (char)(0xE0 | (aCodePoint>>12));
+    *aP++ = (char)(0x80 | ((aCodePoint>>6) & 0x3F));
+    *aP++ = (char)(0x80 | (aCodePoint & 0x3F));
+  }
+  else {
+    *aP++ = (char)(0xF0 | (aCodePoint>>18));
+    *aP++ = (char)(0x80 | ((aCodePoint>>12) & 0x3F));
+    *aP++ = (char)(0x80 | ((aCodePoint>>6) & 0x3F));
+    *aP++ = (char)(0x80 | (aCodePoint & 0x3F));
+  }
+  return aP;
+}
+
+
+static bool getHex4(const char *aP, uint32_t &aValue)
+{
+  aValue = 0;
+  for (int i=0; i<4; i++) {
+    char c = aP[i];
+    aValue <<= 4;
+    if (c>='0' && c<='9') aValue += c-'0';
+    else if (c>='a' && c<='f') aValue += c-'a'+10;
+    else if (c>='A' && c<='F') aValue += c-'A'+10;
+    else return false;
+  }
+  return true;
+}
+
+
+bool JsonArena::parseString(const char *&aStr, size_t &aLen)
+{
+  // parseP is on opening quote
+  const char *start = parseP+1;
+  const char *p = start;
+  bool hasEscapes = false;
+  while (p<parseEnd && *p!='"') {
+    if (*p=='\\') { hasEscapes = true; p++; }
+    p++;
+  }
+  if (p>=parseEnd) {
+    parseErr = JsonArenaErrorIncomplete;
+    return false;
+  }
+  // p is on closing quote now
+  if (!hasEscapes) {
+    // plain copy
+    aLen = p-start;
+    aStr = newCString(start, aLen);
+    parseP = p+1;
+    return true;
+  }
+  // decode escapes. Decoded string is never longer than the escaped version
+  char *s = (char *)alloc(p-start+1);
+  char *d = s;
+  const char *q = start;
+  while (q<p) {
+    if (*q!='\\') {
+      *d++ = *q++;
+      continue;
+    }
+    q++; // skip backslash
+    switch (*q++) {
+      case '"': *d++ = '"'; break;
+      case '\\': *d++ = '\\'; break;
+      case '/': *d++ = '/'; break;
+      case 'b': *d++ = '\b'; break;
+      case 'f': *d++ = '\f'; break;
+      case 'n': *d++ = '\n'; break;
+      case 'r': *d++ = '\r'; break;
+      case 't': *d++ = '\t'; break;
+      case 'u': {
+        uint32_t cp;
+        if (q+4>p || !getHex4(q, cp)) { parseP = q; parseErr = JsonArenaErrorSyntax; return false; }
+        q += 4;
+        if (cp>=0xD800 && cp<0xDC00 && q+6<=p && q[0]=='\\' && q[1]=='u') {
+          // high surrogate, try to combine with following low surrogate
+          uint32_t lo;
+          if (getHex4(q+2, lo) && lo>=0xDC00 && lo<0xE000) {
+            cp = 0x10000 + ((cp-0xD800)<<10) + (lo-0xDC00);
+            q += 6;
+          }
+        }
+        d = putUTF8(d, cp);
+        break;
+      }
+      default:
+        parseP = q-1;
+        parseErr = JsonArenaErrorSyntax;
+        return false;
+    }
+  }
+  *d = 0;
+  aStr = s;
+  aLen = d-s;
+  parseP = p+1;
+  return true;
+}
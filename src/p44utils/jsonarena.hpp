@@ -0,0 +1,355 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44utils__jsonarena__
+#define __p44utils__jsonarena__
+
+#include "p44_common.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+
+  // Errors
+  typedef enum {
+    JsonArenaErrorOK,
+    JsonArenaErrorIncomplete, ///< text ended before JSON value was complete
+    JsonArenaErrorSyntax, ///< unexpected character in JSON text
+    JsonArenaErrorDepth, ///< nesting of objects/arrays too deep
+    JsonArenaErrorTrailing, ///< non-whitespace text after complete JSON value
+    JsonArenaErrorSize, ///< JSON text exceeds size limit
+  } JsonArenaErrors;
+
+  class JsonArenaError : public Error
+  {
+  public:
+    static const char *domain() { return "JsonArena"; }
+    virtual const char *getErrorDomain() const { return JsonArenaError::domain(); };
+    JsonArenaError(JsonArenaErrors aError) : Error(ErrorCode(aError)) {};
+    JsonArenaError(JsonArenaErrors aError, std::string aErrorMessage) : Error(ErrorCode(aError), aErrorMessage) {};
+  };
+
+
+  /// JSON value types of arena nodes
+  typedef enum {
+    jsonnode_null,
+    jsonnode_boolean,
+    jsonnode_int,
+    jsonnode_double,
+    jsonnode_string,
+    jsonnode_object,
+    jsonnode_array,
+  } JsonNodeType;
+
+
+  class JsonArena;
+  class JsonNode;
+
+  /// shared pointer for JSON arena
+  typedef boost::intrusive_ptr<JsonArena> JsonArenaPtr;
+
+
+  /// a single JSON value living in a JsonArena
+  /// @note JsonNodes are plain, non-refcounted structures allocated from their arena. They are never freed
+  ///   individually, but all at once when the arena is deleted. So a JsonNode pointer is valid only
+  ///   as long as the arena it was allocated from is kept alive (usually by holding a JsonArenaPtr).
+  /// @note the read accessors deliberately mimic JsonObject, so code can be ported from json-c
+  ///   based JsonObjects to arena nodes with minimal changes.
+  class JsonNode
+  {
+    friend class JsonArena;
+
+    JsonArena *arena; ///< the arena this node was allocated from
+    JsonNode *next; ///< next sibling within parent object or array
+    const char *key; ///< member name if this node is a member of an object
+    JsonNodeType nodeType; ///< JSON type
+    bool linked; ///< set if this node is already member of an object or array
+
+    union {
+      bool boolVal;
+      int64_t intVal;
+      double doubleVal;
+      struct {
+        const char *chars; ///< always NUL terminated
+        size_t len;
+      } str;
+      struct {
+        JsonNode *first;
+        JsonNode *last;
+        int count;
+        JsonNode *cursorNode; ///< last accessed array element, makes sequential arrayGet() O(1)
+        int cursorIndex; ///< index of cursorNode
+      } list;
+    } v;
+
+    JsonNode(JsonArena *aArena, JsonNodeType aType);
+
+    void link(JsonNode *aNode);
+    JsonNode *unlink(JsonNode *aNode, JsonNode *aPrev);
+    JsonNode *linkable(JsonNode *aNode);
+
+  public:
+
+    /// get the arena this node lives in
+    JsonArena &getArena() { return *arena; };
+
+    /// get type
+    /// @return type code
+    JsonNodeType type() const { return nodeType; };
+
+    /// check type
+    /// @param aRefType type to check for
+    /// @return true if object matches given type
+    bool isType(JsonNodeType aRefType) const { return nodeType==aRefType; };
+
+    /// string representation of object.
+    string json_str() const;
+
+    /// append string representation of object to a string
+    /// @param aJson string to append JSON text to
+    void appendJson(string &aJson) const;
+
+
+    /// @name object members
+    /// @{
+
+    /// add node for key
+    /// @param aKey key of object
+    /// @param aNode node to add. If aNode already is member of another object or array, a copy will be added.
+    ///   If aNode is NULL, a null node is added.
+    /// @note replaces existing member with same key, if any
+    void add(const char *aKey, JsonNode *aNode);
+
+    /// get member node by key
+    /// @param aKey key of member
+    /// @return the member node or NULL if member does not exist or has null value
+    /// @note to distinguish between having no such key and having the key with
+    ///   a null value, use get(aKey,aNode) instead
+    JsonNode *get(const char *aKey) const;
+
+    /// get member node by key
+    /// @param aKey key of member
+    /// @param aNode will be set to the member node when return value is true, NULL if value is null
+    /// @return true if key exists (but aNode might still be NULL in case of a null value)
+    bool get(const char *aKey, JsonNode *&aNode) const;
+
+    /// find member node by key
+    /// @param aKey key of member
+    /// @return the member node (which might be of jsonnode_null type) or NULL if no member with that key exists
+    JsonNode *findMember(const char *aKey) const;
+
+    /// get member's string value by key
+    /// @return NULL if key does not exists or actually has null value, string otherwise
+    /// @note the returned C string pointer is valid only as long as the arena exists
+    const char *getCString(const char *aKey) const;
+
+    /// delete member by key
+    void del(const char *aKey);
+
+    /// get first member (or array element) for iterating
+    /// @return first member node, NULL if none
+    JsonNode *firstChild() const { return nodeType==jsonnode_object || nodeType==jsonnode_array ? v.list.first : NULL; };
+
+    /// @return the next sibling within the parent object or array
+    JsonNode *nextSibling() const { return next; };
+
+    /// @return the member name of this node if it is a member of an object, NULL otherwise
+    const char *keyName() const { return key; };
+
+    /// @}
+
+
+    /// @name array elements
+    /// @{
+
+    /// get array length
+    /// @return length of array. Returns 0 for empty arrays and all non-array objects
+    int arrayLength() const { return nodeType==jsonnode_array ? v.list.count : 0; };
+
+    /// append to array
+    /// @param aNode node to append. If aNode already is member of another object or array, a copy will be appended
+    void arrayAppend(JsonNode *aNode);
+
+    /// get from a specific position in the array
+    /// @param aAtIndex index position to return value for
+    /// @return NULL pointer if element does not exist, value otherwise
+    JsonNode *arrayGet(int aAtIndex);
+
+    /// put at specific position in array
+    /// @param aAtIndex index position to put value to (overwriting existing value at that position)
+    /// @param aNode node to store in the array
+    void arrayPut(int aAtIndex, JsonNode *aNode);
+
+    /// @}
+
+
+    /// @name simple values
+    /// @{
+
+    bool boolValue() const;
+    int32_t int32Value() const { return (int32_t)int64Value(); };
+    int64_t int64Value() const;
+    double doubleValue() const;
+    const char *c_strValue() const;
+    size_t stringLength() const;
+    string stringValue() const;
+    string lowercaseStringValue() const { return lowerCase(stringValue()); };
+
+    /// change type and value of node in place
+    /// @note changing type of an object or array orphans its members (memory is reclaimed with the arena)
+    void setNull() { nodeType = jsonnode_null; };
+    void setBool(bool aBool) { nodeType = jsonnode_boolean; v.boolVal = aBool; };
+    void setInt64(int64_t aInt64) { nodeType = jsonnode_int; v.intVal = aInt64; };
+    void setDouble(double aDouble) { nodeType = jsonnode_double; v.doubleVal = aDouble; };
+    void setString(const char *aCStr, size_t aLen);
+    void setString(const string &aString) { setString(aString.c_str(), aString.size()); };
+    void setObject();
+    void setArray();
+
+    /// @}
+
+  };
+
+
+  /// Memory arena for JSON nodes and strings.
+  /// All nodes and string data of a parsed JSON message (or a JSON message being built for sending) are
+  /// bump-allocated from a few larger memory chunks, and freed all at once when the arena is deleted.
+  /// Compared to json-c, this avoids one heap allocation (plus refcounting) per JSON value.
+  class JsonArena : public P44Obj
+  {
+    typedef P44Obj inherited;
+    friend class JsonNode;
+
+    struct Chunk {
+      Chunk *prev;
+      size_t size;
+      size_t used;
+      // chunk data follows
+    };
+    Chunk *chunks; ///< most recent chunk, older chunks linked via prev
+    size_t nextChunkSize; ///< size for the next chunk to allocate
+    size_t totalAllocated; ///< total payload bytes allocated
+
+    JsonNode *rootNode; ///< root node (e.g. result of parse())
+
+    typedef vector<JsonArenaPtr> ArenaVector;
+    ArenaVector retainedArenas; ///< other arenas which have nodes referenced from this arena
+
+    // parser state
+    const char *parseP;
+    const char *parseEnd;
+    int parseDepth;
+    JsonArenaErrors parseErr;
+
+  public:
+
+    JsonArena();
+    virtual ~JsonArena();
+
+    /// allocate memory from the arena
+    /// @param aSize number of bytes needed
+    /// @return pointer to 8-byte aligned memory, valid for the lifetime of the arena
+    void *alloc(size_t aSize);
+
+    /// copy string into the arena
+    /// @param aCStr string to copy (need not be NUL terminated)
+    /// @param aLen length of the string
+    /// @return NUL terminated copy of aCStr, valid for the lifetime of the arena
+    const char *newCString(const char *aCStr, size_t aLen);
+
+    /// make sure another arena lives at least as long as this arena
+    /// @param aOtherArena arena which has nodes linked into nodes of this arena
+    /// @return false if aOtherArena cannot be retained because it already retains this arena (retain cycle)
+    bool retain(JsonArena *aOtherArena);
+
+    /// @return number of bytes allocated for nodes and strings so far
+    size_t allocatedBytes() { return totalAllocated; };
+
+
+    /// @name root node
+    /// @{
+
+    /// @return the root node (result of a parse, or explicitly set with setRoot)
+    JsonNode *root() { return rootNode; };
+
+    /// set the root node
+    void setRoot(JsonNode *aRootNode) { rootNode = aRootNode; };
+
+    /// @}
+
+
+    /// @name parsing
+    /// @{
+
+    /// parse JSON text into nodes in this arena
+    /// @param aJsonText the JSON text
+    /// @param aLen length of the JSON text
+    /// @param aRootNode will be set to the root node of the parsed JSON value (also available as root())
+    /// @return empty or JsonArenaError. JsonArenaErrorIncomplete means that the text ended before the JSON value
+    ///   was complete, which might be ok if more text is expected to arrive
+    ErrorPtr parse(const char *aJsonText, size_t aLen, JsonNode *&aRootNode);
+
+    /// create new arena from text
+    /// @param aJsonText the JSON text
+    /// @param aMaxChars max number of chars to parse, -1 to parse up to NUL terminator
+    /// @return new arena with root() set to the parsed JSON value, or empty pointer on parse error
+    static JsonArenaPtr arenaFromText(const char *aJsonText, ssize_t aMaxChars = -1);
+
+    /// @}
+
+
+    /// @name node factories
+    /// @{
+
+    JsonNode *newNode(JsonNodeType aType);
+    JsonNode *newObj() { return newNode(jsonnode_object); };
+    JsonNode *newArray() { return newNode(jsonnode_array); };
+    JsonNode *newNull() { return newNode(jsonnode_null); };
+    JsonNode *newBool(bool aBool);
+    JsonNode *newInt32(int32_t aInt32) { return newInt64(aInt32); };
+    JsonNode *newInt64(int64_t aInt64);
+    JsonNode *newDouble(double aDouble);
+    JsonNode *newString(const char *aCStr);
+    JsonNode *newString(const char *aCStr, size_t aLen);
+    JsonNode *newString(const string &aString, bool aEmptyIsNull = false);
+
+    /// create a deep copy of a node (possibly from another arena) in this arena
+    /// @param aNode node to copy
+    /// @return copy of the node, allocated from this arena
+    JsonNode *copyNode(const JsonNode *aNode);
+
+    /// @}
+
+  private:
+
+    // parser
+    JsonNode *parseValue();
+    bool parseString(const char *&aStr, size_t &aLen);
+    JsonNode *parseNumber();
+    bool parseLiteral(const char *aLiteral);
+    void skipWhiteSpace();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__p44utils__jsonarena__) */
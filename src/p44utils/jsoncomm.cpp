@@ -46,13 +46,23 @@ JsonComm::~JsonComm()
 void JsonComm::setMessageHandler(JSonMessageCB aJsonMessageHandler)
 {
   rawMessageHandler = NULL;
+  arenaMessageHandler = NULL;
   jsonMessageHandler = aJsonMessageHandler;
 }
 
 
+void JsonComm::setArenaMessageHandler(JsonArenaMessageCB aArenaMessageHandler)
+{
+  rawMessageHandler = NULL;
+  jsonMessageHandler = NULL;
+  arenaMessageHandler = aArenaMessageHandler;
+}
+
+
 void JsonComm::setRawMessageHandler(TextLineCB aRawMessageHandler)
 {
   jsonMessageHandler = NULL;
+  arenaMessageHandler = NULL;
   rawMessageHandler = aRawMessageHandler;
 }
 
@@ -100,6 +110,29 @@ void JsonComm::gotData(ErrorPtr aError)
               textLine.clear();
             }
           }
+          else if (arenaMessageHandler) {
+            // collect message text for the arena parser
+            if (!ignoreUntilNextEOM) {
+              if (eom>bom) messageBuffer.append((const char *)buf+bom, eom-bom);
+              if (messageBuffer.size()>MAX_JSON_MESSAGE_SIZE) {
+                // runaway message, discard up to next EOM
+                messageBuffer.clear();
+                ignoreUntilNextEOM = true;
+                arenaMessageHandler(ErrorPtr(new JsonArenaError(JsonArenaErrorSize, "JSON message too large")), JsonArenaPtr());
+              }
+              else if (messageComplete) {
+                // end of message, must parse completely now
+                parseArenaMessage(true);
+              }
+              else {
+                // parsing before EOM makes sense only when text could be complete JSON object or array
+                size_t l = messageBuffer.find_last_not_of(' ');
+                if (l!=string::npos && (messageBuffer[l]=='}' || messageBuffer[l]==']')) {
+                  parseArenaMessage(false);
+                }
+              }
+            }
+          }
           else {
             // create JSON tokener to parse message, if none found already
             if (!tokener) {
@@ -152,15 +185,46 @@ void JsonComm::gotData(ErrorPtr aError)
     if (jsonMessageHandler) {
       jsonMessageHandler(aError, JsonObjectPtr());
     }
+    else if (arenaMessageHandler) {
+      arenaMessageHandler(aError, JsonArenaPtr());
+    }
     else if (rawMessageHandler) {
       rawMessageHandler(aError, "");
     }
     ignoreUntilNextEOM = false;
+    messageBuffer.clear();
     if (tokener) json_tokener_reset(tokener);
   }
 }
 
 
+void JsonComm::parseArenaMessage(bool aAtEOM)
+{
+  if (messageBuffer.find_first_not_of(' ')==string::npos) {
+    // nothing but whitespace (e.g. empty line), no message
+    messageBuffer.clear();
+    return;
+  }
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  JsonNode *root;
+  ErrorPtr err = arena->parse(messageBuffer.c_str(), messageBuffer.size(), root);
+  if (!root && !aAtEOM && Error::isError(err, JsonArenaError::domain(), JsonArenaErrorIncomplete)) {
+    // incomplete JSON, which is fine before EOM - wait for more data
+    return;
+  }
+  // complete message (extra text after the JSON value is ignored, like with json-c) or real error,
+  // including JSON still incomplete at EOM
+  messageBuffer.clear();
+  if (!aAtEOM) ignoreUntilNextEOM = true; // rest of this message is ignored
+  if (arenaMessageHandler) {
+    if (root)
+      arenaMessageHandler(ErrorPtr(), arena);
+    else
+      arenaMessageHandler(err, JsonArenaPtr());
+  }
+}
+
+
 ErrorPtr JsonComm::sendMessage(JsonObjectPtr aJsonObject)
 {
   string json_string = aJsonObject->json_c_str();
@@ -169,6 +233,18 @@ ErrorPtr JsonComm::sendMessage(JsonObjectPtr aJsonObject)
 }
 
 
+ErrorPtr JsonComm::sendMessage(const JsonNode *aJsonNode)
+{
+  string json_string;
+  if (aJsonNode)
+    aJsonNode->appendJson(json_string);
+  else
+    json_string = "null";
+  json_string.append("\n");
+  return sendRaw(json_string);
+}
+
+
 ErrorPtr JsonComm::sendRaw(string &aRawBytes)
 {
   ErrorPtr err;
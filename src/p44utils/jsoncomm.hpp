@@ -25,16 +25,24 @@
 #include "socketcomm.hpp"
 
 #include "jsonobject.hpp"
+#include "jsonarena.hpp"
 
 using namespace std;
 
 namespace p44 {
 
+  /// max size of a single JSON message received by a JsonComm using the arena parser
+  #define MAX_JSON_MESSAGE_SIZE (1024*1024)
+
   class JsonComm;
 
   /// generic callback for delivering a received JSON object or an error occurred when receiving JSON
   typedef boost::function<void (ErrorPtr aError, JsonObjectPtr aJsonObject)> JSonMessageCB;
 
+  /// callback for delivering a received JSON message parsed into a JsonArena, or an error occurred when receiving JSON
+  /// @param aArena the arena containing the received message as its root() node
+  typedef boost::function<void (ErrorPtr aError, JsonArenaPtr aArena)> JsonArenaMessageCB;
+
   /// generic callback for delivering a received Text line
   typedef boost::function<void (ErrorPtr aError, string aTextLine)> TextLineCB;
 
@@ -46,6 +54,7 @@ namespace p44 {
     typedef SocketComm inherited;
 
     JSonMessageCB jsonMessageHandler;
+    JsonArenaMessageCB arenaMessageHandler;
     TextLineCB rawMessageHandler;
 
     // Raw message receiving
@@ -54,6 +63,7 @@ namespace p44 {
     // JSON parsing
     struct json_tokener* tokener;
     bool ignoreUntilNextEOM;
+    string messageBuffer; ///< accumulates message text for the arena parser
 
     // JSON sending
     string transmitBuffer;
@@ -69,6 +79,11 @@ namespace p44 {
     /// @note setting the JSON message handler will disable raw message processing
     void setMessageHandler(JSonMessageCB aJsonMessageHandler);
 
+    /// install callback for received JSON messages, parsed into a JsonArena rather than json-c objects
+    /// @param aArenaMessageHandler will be called when a JSON message has been received
+    /// @note setting the arena message handler will disable raw and json-c message processing
+    void setArenaMessageHandler(JsonArenaMessageCB aArenaMessageHandler);
+
     /// install callback for received raw messages (single line)
     /// @param aRawMessageHandler will be called when a complete text line has been received
     /// @note setting the raw message handler will disable JSON message processing
@@ -80,6 +95,11 @@ namespace p44 {
     /// @result empty or Error object in case of error sending message
     ErrorPtr sendMessage(JsonObjectPtr aJsonObject);
 
+    /// send a JSON message from a JsonArena node
+    /// @param aJsonNode the JSON that is to be sent
+    /// @result empty or Error object in case of error sending message
+    ErrorPtr sendMessage(const JsonNode *aJsonNode);
+
 
     /// send raw text
     /// @param aRawBytes bytes to be sent
@@ -91,11 +111,12 @@ namespace p44 {
 
     /// clear all callbacks
     /// @note this is important because handlers might cause retain cycles when they have smart ptr arguments
-    virtual void clearCallbacks() { jsonMessageHandler = NULL; inherited::clearCallbacks(); }
+    virtual void clearCallbacks() { jsonMessageHandler = NULL; arenaMessageHandler = NULL; inherited::clearCallbacks(); }
 
 
   private:
     void gotData(ErrorPtr aError);
+    void parseArenaMessage(bool aAtEOM);
     void canSendData(ErrorPtr aError);
     
   };
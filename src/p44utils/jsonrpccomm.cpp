@@ -34,27 +34,50 @@
 using namespace p44;
 
 
+JsonRpcBatch::JsonRpcBatch(uint32_t aSerial) :
+  serial(aSerial),
+  responses(NULL),
+  callCount(0),
+  dispatching(false),
+  timeoutTicket(0)
+{
+  arena = JsonArenaPtr(new JsonArena);
+  responses = arena->newArray();
+}
+
+
 JsonRpcComm::JsonRpcComm(MainLoop &aMainLoop) :
   inherited(aMainLoop),
   requestIdCounter(0),
-  reportAllErrors(false)
+  reportAllErrors(false),
+  batchSerialCounter(0),
+  batchTimeout(JSONRPC_BATCH_TIMEOUT)
 {
   // set myself as handler of incoming JSON objects (which are supposed to be JSON-RPC 2.0
-  setMessageHandler(boost::bind(&JsonRpcComm::gotJson, this, _1, _2));
+  setArenaMessageHandler(boost::bind(&JsonRpcComm::gotJson, this, _1, _2));
 }
 
 
 JsonRpcComm::~JsonRpcComm()
 {
+  forgetBatches();
 }
 
 
 void JsonRpcComm::setRequestHandler(JsonRpcRequestCB aJsonRpcRequestHandler)
 {
+  arenaRequestHandler = NULL;
   jsonRequestHandler = aJsonRpcRequestHandler;
 }
 
 
+void JsonRpcComm::setArenaRequestHandler(JsonRpcArenaRequestCB aArenaRequestHandler)
+{
+  jsonRequestHandler = NULL;
+  arenaRequestHandler = aArenaRequestHandler;
+}
+
+
 static JsonObjectPtr jsonRPCObj()
 {
   JsonObjectPtr obj = JsonObject::newObj();
@@ -64,6 +87,23 @@ static JsonObjectPtr jsonRPCObj()
 }
 
 
+JsonNode *JsonRpcComm::newJsonRpcNode(JsonArena &aArena)
+{
+  JsonNode *obj = aArena.newObj();
+  // the mandatory version string all objects need to have
+  obj->add("jsonrpc", aArena.newString("2.0"));
+  return obj;
+}
+
+
+// convert arena node into JsonObject for handlers still using json-c based JsonObjects
+static JsonObjectPtr jsonObjFromNode(const JsonNode *aNode)
+{
+  if (!aNode || aNode->isType(jsonnode_null)) return JsonObjectPtr();
+  return JsonObject::objFromText(aNode->json_str().c_str());
+}
+
+
 
 #pragma mark - sending outgoing requests and responses
 
@@ -84,7 +124,32 @@ ErrorPtr JsonRpcComm::sendRequest(const char *aMethod, JsonObjectPtr aParams, Js
     // add the ID so the callee can include it in the response
     request->add("id", JsonObject::newInt32(requestIdCounter));
     // remember it in our map
-    pendingAnswers[requestIdCounter] = aResponseHandler;
+    pendingAnswers[requestIdCounter].jsonResponseHandler = aResponseHandler;
+  }
+  // now send
+  FOCUSLOG("Sending JSON-RPC 2.0 request message:\n  %s\n", request->c_strValue());
+  return sendMessage(request);
+}
+
+
+ErrorPtr JsonRpcComm::sendRequest(const char *aMethod, const JsonNode *aParams, JsonRpcArenaResponseCB aResponseHandler)
+{
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  JsonNode *request = newJsonRpcNode(*arena);
+  // the method or notification name
+  request->add("method", arena->newString(aMethod));
+  // the optional parameters
+  if (aParams) {
+    request->add("params", arena->copyNode(aParams));
+  }
+  // in any case, count this call (even if it is a notification)
+  requestIdCounter++;
+  // in case this is a method call (i.e. a answer handler is specified), add the call ID
+  if (aResponseHandler) {
+    // add the ID so the callee can include it in the response
+    request->add("id", arena->newInt32(requestIdCounter));
+    // remember it in our map
+    pendingAnswers[requestIdCounter].arenaResponseHandler = aResponseHandler;
   }
   // now send
   FOCUSLOG("Sending JSON-RPC 2.0 request message:\n  %s\n", request->c_strValue());
@@ -94,19 +159,47 @@ ErrorPtr JsonRpcComm::sendRequest(const char *aMethod, JsonObjectPtr aParams, Js
 
 ErrorPtr JsonRpcComm::sendResult(const char *aJsonRpcId, JsonObjectPtr aResult)
 {
+  string peerId;
+  JsonRpcBatchPtr batch;
+  if (!batchForId(aJsonRpcId, peerId, batch)) return ErrorPtr(); // stale answer, dropped
   JsonObjectPtr response = jsonRPCObj();
   // add the result, can be NULL
   response->add("result", aResult);
   // add the ID so the caller can associate with a previous request
-  response->add("id", JsonObject::newString(aJsonRpcId));
+  response->add("id", JsonObject::newString(peerId));
   // now send
   FOCUSLOG("Sending JSON-RPC 2.0 result message:\n  %s\n", response->c_strValue());
+  if (batch) {
+    // answer to a batch member, must be collected into the batch response
+    JsonArenaPtr arena = JsonArena::arenaFromText(response->c_strValue());
+    if (arena) return sendResponse(batch, aJsonRpcId, arena->root());
+  }
   return sendMessage(response);
 }
 
 
+ErrorPtr JsonRpcComm::sendResult(const char *aJsonRpcId, const JsonNode *aResult)
+{
+  string peerId;
+  JsonRpcBatchPtr batch;
+  if (!batchForId(aJsonRpcId, peerId, batch)) return ErrorPtr(); // stale answer, dropped
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  JsonNode *response = newJsonRpcNode(*arena);
+  // add the result, can be NULL
+  response->add("result", aResult ? arena->copyNode(aResult) : NULL);
+  // add the ID so the caller can associate with a previous request
+  response->add("id", arena->newString(peerId));
+  // now send
+  FOCUSLOG("Sending JSON-RPC 2.0 result message:\n  %s\n", response->c_strValue());
+  return sendResponse(batch, aJsonRpcId, response);
+}
+
+
 ErrorPtr JsonRpcComm::sendError(const char *aJsonRpcId, uint32_t aErrorCode, const char *aErrorMessage, JsonObjectPtr aErrorData)
 {
+  string peerId;
+  JsonRpcBatchPtr batch;
+  if (!batchForId(aJsonRpcId, peerId, batch)) return ErrorPtr(); // stale answer, dropped
   JsonObjectPtr response = jsonRPCObj();
   // create the error object
   JsonObjectPtr errorObj = JsonObject::newObj();
@@ -126,158 +219,348 @@ ErrorPtr JsonRpcComm::sendError(const char *aJsonRpcId, uint32_t aErrorCode, con
   // add the error object
   response->add("error", errorObj);
   // add the ID so the caller can associate with a previous request
-  response->add("id", aJsonRpcId ? JsonObject::newString(aJsonRpcId) : JsonObjectPtr());
+  response->add("id", aJsonRpcId ? JsonObject::newString(peerId) : JsonObjectPtr());
   // now send
   FOCUSLOG("Sending JSON-RPC 2.0 error message:\n  %s\n", response->c_strValue());
+  if (batch) {
+    // answer to a batch member, must be collected into the batch response
+    JsonArenaPtr arena = JsonArena::arenaFromText(response->c_strValue());
+    if (arena) return sendResponse(batch, aJsonRpcId, arena->root());
+  }
   return sendMessage(response);
 }
 
 
+ErrorPtr JsonRpcComm::sendError(const char *aJsonRpcId, uint32_t aErrorCode, const char *aErrorMessage, const JsonNode *aErrorData)
+{
+  string peerId;
+  JsonRpcBatchPtr batch;
+  if (!batchForId(aJsonRpcId, peerId, batch)) return ErrorPtr(); // stale answer, dropped
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  JsonNode *response = newJsonRpcNode(*arena);
+  // create the error object
+  JsonNode *errorObj = arena->newObj();
+  errorObj->add("code", arena->newInt32(aErrorCode));
+  if (aErrorMessage) {
+    errorObj->add("message", arena->newString(aErrorMessage));
+  }
+  else {
+    errorObj->add("message", arena->newString(string_format("Error code %d (0x%X)", aErrorCode, aErrorCode)));
+  }
+  // add the data object if any
+  if (aErrorData) {
+    errorObj->add("data", arena->copyNode(aErrorData));
+  }
+  // add the error object
+  response->add("error", errorObj);
+  // add the ID so the caller can associate with a previous request
+  response->add("id", aJsonRpcId ? arena->newString(peerId) : NULL);
+  // now send
+  FOCUSLOG("Sending JSON-RPC 2.0 error message:\n  %s\n", response->c_strValue());
+  return sendResponse(batch, aJsonRpcId, response);
+}
+
+
 ErrorPtr JsonRpcComm::sendError(const char *aJsonRpcId, ErrorPtr aErrorToSend)
 {
   if (!Error::isOK(aErrorToSend)) {
-    return sendError(aJsonRpcId, (uint32_t)aErrorToSend->getErrorCode(), aErrorToSend->getErrorMessage());
+    return sendError(aJsonRpcId, (uint32_t)aErrorToSend->getErrorCode(), aErrorToSend->getErrorMessage(), (const JsonNode *)NULL);
   }
   return ErrorPtr();
 }
 
 
+bool JsonRpcComm::batchForId(const char *aJsonRpcId, string &aPeerId, JsonRpcBatchPtr &aBatch)
+{
+  aBatch.reset();
+  if (!aJsonRpcId) {
+    // responses without id (errors for invalid requests) belong to the batch being dispatched, if any
+    aPeerId.clear();
+    aBatch = dispatchingBatch;
+    return true;
+  }
+  // ids of batch members are tagged with the batch serial number
+  const char *sep = strrchr(aJsonRpcId, JSONRPC_BATCH_ID_SEPARATOR);
+  if (!sep) {
+    // not a batch member
+    aPeerId = aJsonRpcId;
+    return true;
+  }
+  // never let the tag go back to the peer
+  aPeerId.assign(aJsonRpcId, sep-aJsonRpcId);
+  uint32_t serial = (uint32_t)strtoul(sep+1, NULL, 10);
+  for (BatchList::iterator pos = pendingBatches.begin(); pos!=pendingBatches.end(); ++pos) {
+    if ((*pos)->serial==serial) {
+      JsonRpcBatch::IdMap::iterator ipos = (*pos)->pendingIds.find(aJsonRpcId);
+      if (ipos==(*pos)->pendingIds.end()) break; // already answered
+      aBatch = *pos;
+      return true;
+    }
+  }
+  // batch is complete or has timed out already, peer got its response (or error) for this id
+  LOG(LOG_WARNING, "JSON-RPC 2.0: dropped late answer for id '%s' of batch #%u\n", aPeerId.c_str(), serial);
+  return false;
+}
+
+
+ErrorPtr JsonRpcComm::sendResponse(JsonRpcBatchPtr aBatch, const char *aJsonRpcId, JsonNode *aResponse)
+{
+  if (!aBatch) {
+    // not part of a batch, send immediately
+    return sendMessage(aResponse);
+  }
+  // collect into batch response
+  aBatch->responses->arrayAppend(aResponse);
+  if (aJsonRpcId) aBatch->pendingIds.erase(aJsonRpcId);
+  checkBatchComplete(aBatch);
+  return ErrorPtr();
+}
+
+
+void JsonRpcComm::checkBatchComplete(JsonRpcBatchPtr aBatch)
+{
+  if (aBatch->dispatching || !aBatch->pendingIds.empty()) return; // not yet complete
+  // all method calls of the batch are answered
+  mainLoop.cancelExecutionTicket(aBatch->timeoutTicket);
+  pendingBatches.remove(aBatch);
+  if (aBatch->responses->arrayLength()>0) {
+    // send all responses as one array (batch consisting of notifications only has no response at all)
+    FOCUSLOG("Sending JSON-RPC 2.0 batch response with %d responses\n", aBatch->responses->arrayLength());
+    sendMessage(aBatch->responses);
+  }
+}
+
+
+void JsonRpcComm::batchTimedOut(JsonRpcBatchPtr aBatch)
+{
+  aBatch->timeoutTicket = 0;
+  LOG(LOG_WARNING, "JSON-RPC 2.0: batch #%u timed out with %zu unanswered method calls\n", aBatch->serial, aBatch->pendingIds.size());
+  // answer the remaining calls with an error, last one completes the batch and sends the response
+  JsonRpcBatch::IdMap ids = aBatch->pendingIds; // copy, answering removes the ids
+  for (JsonRpcBatch::IdMap::iterator pos = ids.begin(); pos!=ids.end(); ++pos) {
+    sendError(pos->first.c_str(), JSONRPC_SERVER_ERROR, "Batch member not answered in time");
+  }
+}
+
+
+void JsonRpcComm::forgetBatches()
+{
+  for (BatchList::iterator pos = pendingBatches.begin(); pos!=pendingBatches.end(); ++pos) {
+    mainLoop.cancelExecutionTicket((*pos)->timeoutTicket);
+  }
+  pendingBatches.clear();
+}
+
+
 
 #pragma mark - handling incoming requests and responses
 
 
-void JsonRpcComm::gotJson(ErrorPtr aError, JsonObjectPtr aJsonObject)
+void JsonRpcComm::gotJson(ErrorPtr aError, JsonArenaPtr aArena)
 {
   JsonRpcCommPtr keepMeAlive(this); // make sure this object lives until routine terminates
   ErrorPtr respErr;
-  bool safeError = false; // set when reporting error is safe (i.e. not error possibly generated by malformed error, to prevent error loops)
-  JsonObjectPtr idObj;
-  const char *idString = NULL;
+  bool mustReport = false; // set for errors that must be reported even if reportAllErrors is not set
   if (Error::isOK(aError)) {
     // received proper JSON, now check JSON-RPC specifics
-    FOCUSLOG("Received JSON message:\n  %s\n", aJsonObject->c_strValue());
-    if (aJsonObject->isType(json_type_array)) {
-      respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - batch mode not supported by this implementation"));
+    JsonNode *message = aArena->root();
+    FOCUSLOG("Received JSON message:\n  %s\n", message->c_strValue());
+    if (message->isType(jsonnode_array)) {
+      if (message->arrayLength()==0) {
+        respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - empty batch"));
+        mustReport = true; // JSON-RPC 2.0 requires an error response for an empty batch
+      }
+      else {
+        processBatch(message);
+      }
+    }
+    else {
+      processMessage(message);
     }
-    else if (!aJsonObject->isType(json_type_object)) {
-      respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - request must be JSON object"));
+  }
+  else {
+    // no proper JSON received, create error response
+    if (aError->isDomain(JsonError::domain()) || aError->isDomain(JsonArenaError::domain())) {
+      // some kind of parsing error
+      respErr = ErrorPtr(new JsonRpcError(JSONRPC_PARSE_ERROR, aError->description()));
     }
     else {
-      // check request object fields
-      const char *method = NULL;
-      JsonObjectPtr o = aJsonObject->get("jsonrpc");
-      if (!o)
-        respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - missing 'jsonrpc'"));
-      else if (o->stringValue()!="2.0")
-        respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - wrong version in 'jsonrpc'"));
-      else {
-        // get ID param (must be present for all messages except notification)
-        idObj = aJsonObject->get("id");
-        if (idObj) idString = idObj->c_strValue();
-        JsonObjectPtr paramsObj = aJsonObject->get("params");
-        // JSON-RPC version is correct, check other params
-        method = aJsonObject->getCString("method");
-        if (method) {
-          // this is a request (responses don't have the method member)
-          safeError = idObj!=NULL; // reporting error is safe if this is a method call. Other errors are reported only when reportAllErrors is set
-          if (*method==0)
-            respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - empty 'method'"));
+      // some other type of server error
+      respErr = ErrorPtr(new JsonRpcError(JSONRPC_SERVER_ERROR, aError->description()));
+    }
+  }
+  // auto-generate error response for internally created errors
+  if (!Error::isOK(respErr)) {
+    if (reportAllErrors || mustReport)
+      sendError(NULL, respErr);
+    else
+      LOG(LOG_WARNING,"Received data that generated error which can't be sent back: Code=%d, Message='%s'\n", respErr->getErrorCode(), respErr->description().c_str());
+  }
+}
+
+
+void JsonRpcComm::processBatch(JsonNode *aBatch)
+{
+  JsonRpcBatchPtr batch = JsonRpcBatchPtr(new JsonRpcBatch(++batchSerialCounter));
+  // group members for dispatching
+  typedef vector<JsonNode *> MemberVector;
+  vector<MemberVector> groups;
+  map<string, size_t> groupIndices;
+  for (JsonNode *member = aBatch->firstChild(); member; member = member->nextSibling()) {
+    string groupKey;
+    if (member->isType(jsonnode_object)) {
+      JsonNode *o;
+      if (!batchGroupingParam.empty() && (o = member->get("params")) && (o = o->get(batchGroupingParam.c_str()))) {
+        o->appendJson(groupKey);
+      }
+    }
+    map<string, size_t>::iterator pos = groupIndices.find(groupKey);
+    if (pos==groupIndices.end()) {
+      // first member of a new group
+      groupIndices[groupKey] = groups.size();
+      groups.push_back(MemberVector(1, member));
+    }
+    else {
+      groups[pos->second].push_back(member);
+    }
+  }
+  FOCUSLOG("Dispatching JSON-RPC 2.0 batch with %d members in %zu groups\n", aBatch->arrayLength(), groups.size());
+  // dispatch
+  batch->dispatching = true;
+  pendingBatches.push_back(batch);
+  dispatchingBatch = batch;
+  for (size_t g=0; g<groups.size(); g++) {
+    for (MemberVector::iterator pos = groups[g].begin(); pos!=groups[g].end(); ++pos) {
+      processMessage(*pos, batch);
+    }
+  }
+  dispatchingBatch.reset();
+  batch->dispatching = false;
+  // send response now if all method calls were answered synchronously
+  checkBatchComplete(batch);
+  if (!batch->pendingIds.empty()) {
+    // make sure the batch gets answered even if some request handler never answers
+    batch->timeoutTicket = mainLoop.executeOnce(boost::bind(&JsonRpcComm::batchTimedOut, this, batch), batchTimeout);
+  }
+}
+
+
+void JsonRpcComm::processMessage(JsonNode *aMessage, JsonRpcBatchPtr aBatch)
+{
+  ErrorPtr respErr;
+  bool safeError = false; // set when reporting error is safe (i.e. not error possibly generated by malformed error, to prevent error loops)
+  JsonNode *idObj = NULL;
+  const char *idString = NULL;
+  string taggedId;
+  if (!aMessage->isType(jsonnode_object)) {
+    respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - request must be JSON object"));
+  }
+  else {
+    // check request object fields
+    const char *method = NULL;
+    JsonNode *o = aMessage->get("jsonrpc");
+    if (!o)
+      respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - missing 'jsonrpc'"));
+    else if (strcmp(o->c_strValue(), "2.0")!=0)
+      respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - wrong version in 'jsonrpc'"));
+    else {
+      // get ID param (must be present for all messages except notification)
+      idObj = aMessage->get("id");
+      if (idObj) idString = idObj->c_strValue();
+      JsonNode *paramsObj = aMessage->get("params");
+      // JSON-RPC version is correct, check other params
+      method = aMessage->getCString("method");
+      if (method && idString && aBatch) {
+        // method call within a batch: tag the id, so the response gets collected into this batch
+        taggedId = string_format("%s%c%u.%u", idString, JSONRPC_BATCH_ID_SEPARATOR, aBatch->serial, ++aBatch->callCount);
+        aBatch->pendingIds[taggedId] = idString;
+        idString = taggedId.c_str();
+      }
+      if (method) {
+        // this is a request (responses don't have the method member)
+        safeError = idObj!=NULL; // reporting error is safe if this is a method call. Other errors are reported only when reportAllErrors is set
+        if (*method==0)
+          respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - empty 'method'"));
+        else {
+          // looks like a valid method or notification call
+          if (!jsonRequestHandler && !arenaRequestHandler) {
+            // no handler -> method cannot be executed
+            respErr = ErrorPtr(new JsonRpcError(JSONRPC_METHOD_NOT_FOUND, "Method not found"));
+          }
           else {
-            // looks like a valid method or notification call
-            if (!jsonRequestHandler) {
-              // no handler -> method cannot be executed
-              respErr = ErrorPtr(new JsonRpcError(JSONRPC_METHOD_NOT_FOUND, "Method not found"));
+            if (paramsObj && !paramsObj->isType(jsonnode_array) && !paramsObj->isType(jsonnode_object)) {
+              // invalid param object
+              respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - 'params' must be object or array"));
             }
             else {
-              if (paramsObj && !paramsObj->isType(json_type_array) && !paramsObj->isType(json_type_object)) {
-                // invalid param object
-                respErr = ErrorPtr(new JsonRpcError(JSONRPC_INVALID_REQUEST, "Invalid Request - 'params' must be object or array"));
-              }
-              else {
-                // call handler to execute method or notification
-                jsonRequestHandler(method, idString, paramsObj);
-              }
+              // call handler to execute method or notification
+              if (arenaRequestHandler)
+                arenaRequestHandler(method, idString, paramsObj);
+              else
+                jsonRequestHandler(method, idString, jsonObjFromNode(paramsObj));
             }
           }
         }
-        else {
-          // this is a response (requests always have a method member)
-          // - check if result or error
-          JsonObjectPtr respObj;
-          if (!aJsonObject->get("result", respObj)) {
-            // must be error, need further decoding
-            respObj = aJsonObject->get("error");
-            if (!respObj)
-              respErr = ErrorPtr(new JsonRpcError(JSONRPC_INTERNAL_ERROR, "Internal JSON-RPC error - response with neither 'result' nor 'error'"));
-            else {
-              // dissect error object
-              ErrorCode errCode = JSONRPC_INTERNAL_ERROR; // Internal RPC error
-              const char *errMsg = "malformed Error response";
-              // - try to get error code
-              JsonObjectPtr o = respObj->get("code");
-              if (o) errCode = o->int32Value();
-              // - try to get error message
-              o = respObj->get("message");
-              if (o) errMsg = o->c_strValue();
-              // compose error object from this
-              respErr = ErrorPtr(new JsonRpcError(errCode, errMsg));
-              // also get optional data element
-              respObj = respObj->get("data");
-            }
+      }
+      else {
+        // this is a response (requests always have a method member)
+        // - check if result or error
+        JsonNode *respObj;
+        if (!aMessage->get("result", respObj)) {
+          // must be error, need further decoding
+          respObj = aMessage->get("error");
+          if (!respObj)
+            respErr = ErrorPtr(new JsonRpcError(JSONRPC_INTERNAL_ERROR, "Internal JSON-RPC error - response with neither 'result' nor 'error'"));
+          else {
+            // dissect error object
+            ErrorCode errCode = JSONRPC_INTERNAL_ERROR; // Internal RPC error
+            const char *errMsg = "malformed Error response";
+            // - try to get error code
+            JsonNode *o = respObj->get("code");
+            if (o) errCode = o->int32Value();
+            // - try to get error message
+            o = respObj->get("message");
+            if (o) errMsg = o->c_strValue();
+            // compose error object from this
+            respErr = ErrorPtr(new JsonRpcError(errCode, errMsg));
+            // also get optional data element
+            respObj = respObj->get("data");
           }
-          // Now we have either result or error.data in respObj, and respErr is Ok or contains the error code + message
-          if (!idObj) {
+        }
+        // Now we have either result or error.data in respObj, and respErr is Ok or contains the error code + message
+        if (!idObj) {
+          // errors without ID cannot be associated with calls made earlier, so just log the error
+          LOG(LOG_WARNING,"JSON-RPC 2.0 warning: Received response with no or NULL 'id' that cannot be dispatched:\n  %s\n", aMessage->c_strValue());
+        }
+        else {
+          // dispatch by ID
+          uint32_t requestId = idObj->int32Value();
+          PendingAnswerMap::iterator pos = pendingAnswers.find(requestId);
+          if (pos==pendingAnswers.end()) {
             // errors without ID cannot be associated with calls made earlier, so just log the error
-            LOG(LOG_WARNING,"JSON-RPC 2.0 warning: Received response with no or NULL 'id' that cannot be dispatched:\n  %s\n", aJsonObject->c_strValue());
+            LOG(LOG_WARNING,"JSON-RPC 2.0 error: Received response with unknown 'id'=%d : %s\n", requestId, aMessage->c_strValue());
           }
           else {
-            // dispatch by ID
-            uint32_t requestId = idObj->int32Value();
-            PendingAnswerMap::iterator pos = pendingAnswers.find(requestId);
-            if (pos==pendingAnswers.end()) {
-              // errors without ID cannot be associated with calls made earlier, so just log the error
-              LOG(LOG_WARNING,"JSON-RPC 2.0 error: Received response with unknown 'id'=%d : %s\n", requestId, aJsonObject->c_strValue());
-            }
-            else {
-              // found callback
-              JsonRpcResponseCB cb = pos->second;
-              pendingAnswers.erase(pos); // erase
-              cb(requestId, respErr, respObj); // call
-            }
-            respErr.reset(); // handled
+            // found callback
+            PendingAnswer pa = pos->second;
+            pendingAnswers.erase(pos); // erase
+            // call
+            if (pa.arenaResponseHandler)
+              pa.arenaResponseHandler(requestId, respErr, respObj);
+            else if (pa.jsonResponseHandler)
+              pa.jsonResponseHandler(requestId, respErr, jsonObjFromNode(respObj));
           }
+          respErr.reset(); // handled
         }
       }
     }
   }
-  else {
-    // no proper JSON received, create error response
-    if (aError->isDomain(JsonError::domain())) {
-      // some kind of parsing error
-      respErr = ErrorPtr(new JsonRpcError(JSONRPC_PARSE_ERROR, aError->description()));
-    }
-    else {
-      // some other type of server error
-      respErr = ErrorPtr(new JsonRpcError(JSONRPC_SERVER_ERROR, aError->description()));
-    }
-  }
   // auto-generate error response for internally created errors
+  // - invalid members of a batch must always be answered with an error (with id null if no id could be found)
   if (!Error::isOK(respErr)) {
-    if (safeError || reportAllErrors)
+    if (safeError || reportAllErrors || (aBatch && respErr->getErrorCode()==JSONRPC_INVALID_REQUEST))
       sendError(idString, respErr);
     else
       LOG(LOG_WARNING,"Received data that generated error which can't be sent back: Code=%d, Message='%s'\n", respErr->getErrorCode(), respErr->description().c_str());
   }
 }
-
-
-
-
-
-
-
-
-
-
-
-
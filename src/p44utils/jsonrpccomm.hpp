@@ -63,6 +63,46 @@ namespace p44 {
   ///   in case of an error returned via JSON-RPC from the remote peer.
   typedef boost::function<void (int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData)> JsonRpcResponseCB;
 
+  /// callback for delivering a received JSON-RPC method or notification request with params as JsonArena node
+  /// @param aMethod If this is a method call, this is the JSON-RPC (2.0) method or notification requested by the peer.
+  /// @param aJsonRpcId the client id. The handler must use this id when calling sendResult(). If this is a notification request, aJsonRpcId is NULL.
+  /// @param aParams the params node, NULL if none. The node (and its arena) is only guaranteed to exist during the callback,
+  ///   the handler must retain aParams->getArena() to keep it beyond that.
+  typedef boost::function<void (const char *aMethod, const char *aJsonRpcId, JsonNode *aParams)> JsonRpcArenaRequestCB;
+
+  /// callback for delivering a received JSON-RPC method result as JsonArena node
+  /// @note same as JsonRpcResponseCB, but with aResultOrErrorData as JsonArena node (see JsonRpcArenaRequestCB for lifetime)
+  typedef boost::function<void (int32_t aResponseId, ErrorPtr &aError, JsonNode *aResultOrErrorData)> JsonRpcArenaResponseCB;
+
+
+  /// separator between the peer's id and the batch serial number in ids of batch members passed to request handlers
+  #define JSONRPC_BATCH_ID_SEPARATOR '\x1E'
+
+  /// time after which method calls of a batch still not answered are answered with an error, so the batch response gets sent
+  #define JSONRPC_BATCH_TIMEOUT (30*Second)
+
+  /// state of a JSON-RPC batch (array of requests) being processed
+  /// @note method calls within a batch are passed to the request handler with an id tagged with the batch serial number
+  ///   and the member's index (peer's id, JSONRPC_BATCH_ID_SEPARATOR, serial, '.', index). This way, responses are routed
+  ///   to the batch the request came in with, even when the peer re-uses ids across batches and single requests, or
+  ///   within the same batch.
+  class JsonRpcBatch : public P44Obj
+  {
+    friend class JsonRpcComm;
+
+    uint32_t serial; ///< batch serial number, used to tag ids of batch members
+    JsonArenaPtr arena; ///< arena for the batch response
+    JsonNode *responses; ///< array collecting the responses of the batch members
+    typedef map<string, string> IdMap;
+    IdMap pendingIds; ///< tagged ids of method calls in this batch not yet answered, mapped to the peer's id
+    uint32_t callCount; ///< number of method calls dispatched so far, used to tag ids
+    bool dispatching; ///< set while batch members are being dispatched
+    long timeoutTicket; ///< for answering method calls not answered within JSONRPC_BATCH_TIMEOUT
+
+    JsonRpcBatch(uint32_t aSerial);
+  };
+  typedef boost::intrusive_ptr<JsonRpcBatch> JsonRpcBatchPtr;
+
 
   typedef boost::intrusive_ptr<JsonRpcComm> JsonRpcCommPtr;
   /// A class providing low level access to the DALI bus
@@ -71,12 +111,24 @@ namespace p44 {
     typedef JsonComm inherited;
 
     JsonRpcRequestCB jsonRequestHandler;
+    JsonRpcArenaRequestCB arenaRequestHandler;
     int32_t requestIdCounter;
     bool reportAllErrors;
 
-    typedef map<int32_t, JsonRpcResponseCB> PendingAnswerMap;
+    typedef struct {
+      JsonRpcResponseCB jsonResponseHandler;
+      JsonRpcArenaResponseCB arenaResponseHandler;
+    } PendingAnswer;
+    typedef map<int32_t, PendingAnswer> PendingAnswerMap;
     PendingAnswerMap pendingAnswers;
 
+    typedef list<JsonRpcBatchPtr> BatchList;
+    BatchList pendingBatches; ///< batches waiting for answers of their method calls
+    uint32_t batchSerialCounter;
+    JsonRpcBatchPtr dispatchingBatch; ///< batch currently being dispatched
+    string batchGroupingParam; ///< name of the params member used to group batch members for dispatching
+    MLMicroSeconds batchTimeout; ///< time after which unanswered method calls of a batch are answered with an error
+
   public:
 
     JsonRpcComm(MainLoop &aMainLoop);
@@ -84,14 +136,33 @@ namespace p44 {
 
     /// install callback for received JSON-RPC requests
     /// @param aJsonRpcRequestHandler will be called when a JSON-RPC request has been received
+    /// @note incoming messages are always parsed into a JsonArena. Params are converted into JsonObjects
+    ///   for this handler, so performance critical users should use setArenaRequestHandler() instead.
     void setRequestHandler(JsonRpcRequestCB aJsonRpcRequestHandler);
 
+    /// install callback for received JSON-RPC requests, delivering params as JsonArena nodes
+    /// @param aArenaRequestHandler will be called when a JSON-RPC request has been received
+    /// @note setting the arena request handler disables the JsonObject based request handler
+    void setArenaRequestHandler(JsonRpcArenaRequestCB aArenaRequestHandler);
+
     /// If reportAllErrors is set, all errors generated by incoming data will be reported back to the
     /// sender (including JSON parsing and JSON-RPC syntax errors in responses).
     /// If not set, only errors generated by actual JSON-RPC method calls will be reported
     /// @param aReportAllErrors set to report all errors (default is false).
     void setReportAllErrors(bool aReportAllErrors) { reportAllErrors = aReportAllErrors; };
 
+    /// set the params member used for grouping members of a batch request
+    /// @param aParamName name of a member of "params" (such as a target object ID). Batch members with the same
+    ///   value for that member are dispatched one after another, groups in order of their first appearance in the batch.
+    ///   Empty string (default) dispatches batch members in the order received.
+    /// @note batch responses are collected and sent as one array when all method calls of the batch are answered
+    void setBatchGroupingParam(const string aParamName) { batchGroupingParam = aParamName; };
+
+    /// set the time after which method calls of a batch still not answered get an error response
+    /// @param aTimeout timeout, default is JSONRPC_BATCH_TIMEOUT
+    /// @note without this, a request handler never answering would prevent the batch response from ever being sent
+    void setBatchTimeout(MLMicroSeconds aTimeout) { batchTimeout = aTimeout; };
+
     /// send a JSON-RPC request
     /// @param aMethod the JSON-RPC (2.0) method or notification request to be sent
     /// @param aParams the parameters for the method or notification request as a JsonObject. Can be NULL.
@@ -101,6 +172,13 @@ namespace p44 {
     /// @return empty or Error object in case of error
     ErrorPtr sendRequest(const char *aMethod, JsonObjectPtr aParams, JsonRpcResponseCB aResponseHandler = JsonRpcResponseCB());
 
+    /// send a JSON-RPC request with params from a JsonArena node
+    /// @param aMethod the JSON-RPC (2.0) method or notification request to be sent
+    /// @param aParams the parameters for the method or notification request as a JsonArena node. Can be NULL.
+    /// @param aResponseHandler if the request is a method call, this handler will be called when the method result arrives
+    /// @return empty or Error object in case of error
+    ErrorPtr sendRequest(const char *aMethod, const JsonNode *aParams, JsonRpcArenaResponseCB aResponseHandler);
+
     /// @return Id generated for last sendRequest. 
     int32_t lastRequestId() { return requestIdCounter; };
 
@@ -110,6 +188,12 @@ namespace p44 {
     /// @result empty or Error object in case of error sending result response
     ErrorPtr sendResult(const char *aJsonRpcId, JsonObjectPtr aResult);
 
+    /// send a JSON-RPC result from a JsonArena node
+    /// @param aJsonRpcId this must be the aJsonRpcId as received in the JsonRpcRequestCB handler.
+    /// @param aResult the result as a JsonArena node. Can be NULL for procedure calls without return value
+    /// @result empty or Error object in case of error sending result response
+    ErrorPtr sendResult(const char *aJsonRpcId, const JsonNode *aResult);
+
     /// send a JSON-RPC error (answer for unsuccesful method call)
     /// @param aJsonRpcId this must be the aJsonRpcId as received in the JsonRpcRequestCB handler.
     /// @param aErrorCode the error code
@@ -118,6 +202,14 @@ namespace p44 {
     /// @result empty or Error object in case of error sending error response
     ErrorPtr sendError(const char *aJsonRpcId, uint32_t aErrorCode, const char *aErrorMessage = NULL, JsonObjectPtr aErrorData = JsonObjectPtr());
 
+    /// send a JSON-RPC error with error data from a JsonArena node
+    /// @param aJsonRpcId this must be the aJsonRpcId as received in the JsonRpcRequestCB handler.
+    /// @param aErrorCode the error code
+    /// @param aErrorMessage the error message or NULL to generate a standard text
+    /// @param aErrorData the "data" member for the JSON-RPC error object, can be NULL
+    /// @result empty or Error object in case of error sending error response
+    ErrorPtr sendError(const char *aJsonRpcId, uint32_t aErrorCode, const char *aErrorMessage, const JsonNode *aErrorData);
+
     /// send p44utils::Error object as JSON-RPC error
     /// @param aJsonRpcId this must be the aJsonRpcId as received in the JsonRpcRequestCB handler.
     /// @param aErrorToSend From this error object, getErrorCode() and description() will be used as "code" and "message" members
@@ -127,10 +219,18 @@ namespace p44 {
 
     /// clear all callbacks
     /// @note this is important because handlers might cause retain cycles when they have smart ptr arguments
-    virtual void clearCallbacks() { jsonRequestHandler = NULL; inherited::clearCallbacks(); }
+    virtual void clearCallbacks() { jsonRequestHandler = NULL; arenaRequestHandler = NULL; forgetBatches(); inherited::clearCallbacks(); }
 
   private:
-    void gotJson(ErrorPtr aError, JsonObjectPtr aJsonObject);
+    void gotJson(ErrorPtr aError, JsonArenaPtr aArena);
+    void processMessage(JsonNode *aMessage, JsonRpcBatchPtr aBatch = JsonRpcBatchPtr());
+    void processBatch(JsonNode *aBatch);
+    JsonNode *newJsonRpcNode(JsonArena &aArena);
+    bool batchForId(const char *aJsonRpcId, string &aPeerId, JsonRpcBatchPtr &aBatch);
+    ErrorPtr sendResponse(JsonRpcBatchPtr aBatch, const char *aJsonRpcId, JsonNode *aResponse);
+    void checkBatchComplete(JsonRpcBatchPtr aBatch);
+    void batchTimedOut(JsonRpcBatchPtr aBatch);
+    void forgetBatches();
 
   };
   
@@ -31,14 +31,327 @@
 using namespace p44;
 
 
+#pragma mark - PreloadedRows
+
+
+PreloadedRows::PreloadedRows(sqlite3pp::database &aDb) :
+  inherited(aDb),
+  currentRowsP(NULL)
+{
+}
+
+
+PreloadedRows::~PreloadedRows()
+{
+  for (ParentRowsMap::iterator pos = parentRows.begin(); pos!=parentRows.end(); ++pos) {
+    for (RowVector::iterator rpos = pos->second.begin(); rpos!=pos->second.end(); ++rpos) {
+      for (value_row::iterator vpos = rpos->begin(); vpos!=rpos->end(); ++vpos) {
+        sqlite3_value_free(*vpos);
+      }
+    }
+  }
+}
+
+
+int PreloadedRows::load(const char *aSelectAllSQL)
+{
+  // temporarily use our own statement to run the query
+  int rc = prepare(aSelectAllSQL);
+  if (rc!=SQLITE_OK) return rc;
+  int numCols = column_count();
+  while ((rc = step())==SQLITE_ROW) {
+    const char *parent = nonNullCStr((const char *)sqlite3_column_text(stmt_, 1));
+    parentOfRow[sqlite3_column_int64(stmt_, 0)] = parent; // column 0 is the ROWID
+    RowVector &rows = parentRows[parent];
+    rows.push_back(value_row());
+    value_row &row = rows.back();
+    row.reserve(numCols);
+    for (int i=0; i<numCols; i++) {
+      row.push_back(sqlite3_value_dup(sqlite3_column_value(stmt_, i)));
+    }
+  }
+  finish(); // from now on, rows are served from memory only
+  return rc==SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+
+void PreloadedRows::invalidate(const char *aParentIdentifier)
+{
+  invalidParents.insert(aParentIdentifier);
+}
+
+
+void PreloadedRows::invalidateRow(uint64_t aRowId)
+{
+  map<uint64_t, string>::iterator pos = parentOfRow.find(aRowId);
+  if (pos!=parentOfRow.end()) invalidate(pos->second.c_str());
+}
+
+
+bool PreloadedRows::covers(const char *aParentIdentifier)
+{
+  return invalidParents.find(aParentIdentifier)==invalidParents.end();
+}
+
+
+int PreloadedRows::bind(int idx, char const* value, bool fstatic)
+{
+  if (idx!=1) return SQLITE_RANGE;
+  ParentRowsMap::iterator pos = parentRows.find(nonNullCStr(value));
+  currentRowsP = pos!=parentRows.end() ? &(pos->second) : NULL;
+  return SQLITE_OK;
+}
+
+
+PreloadedRows::iterator PreloadedRows::begin()
+{
+  if (!currentRowsP || currentRowsP->empty()) return end();
+  return iterator(&currentRowsP->front(), &currentRowsP->front()+currentRowsP->size());
+}
+
+
+
+#pragma mark - ParamStore dirty list
+
+
+ParamStore::ParamStore() :
+  dirtyHead(NULL),
+  dirtyTail(NULL),
+  dirtyCount(0),
+  preloading(false),
+  writeBudget(0),
+  budgetLevel(0),
+  budgetLevelTime(Never)
+{
+  totalWriteStats.rowWrites = 0;
+  totalWriteStats.rowDeletes = 0;
+  totalWriteStats.bytesWritten = 0;
+}
+
+
+ParamStore::~ParamStore()
+{
+  endPreload();
+  // parameter sets might outlive the store, make sure they don't try to unlink themselves later
+  while (popDirty()) {};
+}
+
+
+void ParamStore::enqueueDirty(PersistentParams *aParams)
+{
+  aParams->prevDirty = dirtyTail;
+  aParams->nextDirty = NULL;
+  if (dirtyTail) dirtyTail->nextDirty = aParams;
+  else dirtyHead = aParams;
+  dirtyTail = aParams;
+  aParams->queuedDirty = true;
+  dirtyCount++;
+}
+
+
+void ParamStore::dequeueDirty(PersistentParams *aParams)
+{
+  if (aParams->prevDirty) aParams->prevDirty->nextDirty = aParams->nextDirty;
+  else dirtyHead = aParams->nextDirty;
+  if (aParams->nextDirty) aParams->nextDirty->prevDirty = aParams->prevDirty;
+  else dirtyTail = aParams->prevDirty;
+  aParams->nextDirty = NULL;
+  aParams->prevDirty = NULL;
+  aParams->queuedDirty = false;
+  dirtyCount--;
+}
+
+
+PersistentParams *ParamStore::popDirty()
+{
+  PersistentParams *p = dirtyHead;
+  if (p) dequeueDirty(p);
+  return p;
+}
+
+
+void ParamStore::noteSave(PersistentParams *aParams, bool aInserted)
+{
+  // only saves within a transaction can get lost after being made clean
+  if (transactionPending()) uncommittedSaves.push_back(make_pair(aParams, aInserted));
+}
+
+
+void ParamStore::forgetSaves(PersistentParams *aParams)
+{
+  for (UncommittedSaveVector::iterator pos = uncommittedSaves.begin(); pos!=uncommittedSaves.end(); ) {
+    if (pos->first==aParams)
+      pos = uncommittedSaves.erase(pos);
+    else
+      ++pos;
+  }
+}
+
+
+void ParamStore::writeBehindFailed(SQLite3RowSnapshot &aSnapshot)
+{
+  // the update was not written, parameter set must be saved again
+  PersistentParams *p = static_cast<PersistentParams *>(aSnapshot.getOwner());
+  p->markDirty();
+}
+
+
+void ParamStore::transactionEnded(bool aCommitted)
+{
+  if (!aCommitted) {
+    // all rows written in the transaction are rolled back: parameter sets must be saved again
+    LOG(LOG_WARNING, "ParamStore: transaction rolled back, %zu parameter sets marked dirty again\n", uncommittedSaves.size());
+    for (UncommittedSaveVector::iterator pos = uncommittedSaves.begin(); pos!=uncommittedSaves.end(); ++pos) {
+      if (pos->second) pos->first->rowid = 0; // inserted row does not exist, must be inserted again
+      pos->first->markDirty();
+    }
+  }
+  uncommittedSaves.clear();
+}
+
+
+#pragma mark - ParamStore preloading
+
+
+void ParamStore::startPreload()
+{
+  preloading = true;
+}
+
+
+void ParamStore::endPreload()
+{
+  preloading = false;
+  for (PreloadMap::iterator pos = preloads.begin(); pos!=preloads.end(); ++pos) {
+    delete pos->second;
+  }
+  preloads.clear();
+}
+
+
+PreloadedRows *ParamStore::preloadedRows(const string &aLoadAllSQL, const string &aSelectAllSQL, const char *aParentIdentifier)
+{
+  if (!preloading) return NULL;
+  PreloadMap::iterator pos = preloads.find(aLoadAllSQL);
+  if (pos==preloads.end()) {
+    // first access to this table: read all rows at once
+    PreloadedRows *rowsP = new PreloadedRows(*this);
+    if (rowsP->load(aSelectAllSQL.c_str())!=SQLITE_OK) {
+      // possibly schema not up to date, let normal query handle it
+      delete rowsP;
+      return NULL;
+    }
+    FOCUSLOG("preloaded all rows: %s\n", aSelectAllSQL.c_str());
+    pos = preloads.insert(make_pair(aLoadAllSQL, rowsP)).first;
+  }
+  if (!pos->second->covers(aParentIdentifier)) return NULL;
+  return pos->second;
+}
+
+
+void ParamStore::invalidatePreload(const char *aTableName, const char *aParentIdentifier, uint64_t aRowId)
+{
+  if (preloads.empty()) return;
+  // Note: load-all SQL has the table name in its FROM clause
+  string from = string_format(" FROM %s WHERE ", aTableName);
+  for (PreloadMap::iterator pos = preloads.begin(); pos!=preloads.end(); ) {
+    if (pos->first.find(from)!=string::npos) {
+      if (aParentIdentifier) {
+        pos->second->invalidate(aParentIdentifier);
+      }
+      else if (aRowId!=0) {
+        pos->second->invalidateRow(aRowId);
+      }
+      else {
+        // no parent known: forget entire table, will be re-read on next access
+        delete pos->second;
+        preloads.erase(pos++);
+        continue;
+      }
+    }
+    ++pos;
+  }
+}
+
+
+
+#pragma mark - ParamStore write statistics and budget
+
+
+void ParamStore::accountWrite(const char *aTableName, size_t aBytes, bool aDelete)
+{
+  TableWriteStatsMap::iterator pos = tableWriteStats.find(aTableName);
+  if (pos==tableWriteStats.end()) {
+    ParamWriteStats s = { 0, 0, 0 };
+    pos = tableWriteStats.insert(make_pair(string(aTableName), s)).first;
+  }
+  if (aDelete) {
+    pos->second.rowDeletes++;
+    totalWriteStats.rowDeletes++;
+  }
+  else {
+    pos->second.rowWrites++;
+    totalWriteStats.rowWrites++;
+  }
+  pos->second.bytesWritten += aBytes;
+  totalWriteStats.bytesWritten += aBytes;
+  if (writeBudget>0) {
+    drainBudget();
+    budgetLevel += aBytes;
+  }
+}
+
+
+void ParamStore::drainBudget()
+{
+  MLMicroSeconds now = MainLoop::now();
+  if (budgetLevelTime!=Never) {
+    budgetLevel -= (double)writeBudget*(now-budgetLevelTime)/Hour;
+    if (budgetLevel<0) budgetLevel = 0;
+  }
+  budgetLevelTime = now;
+}
+
+
+void ParamStore::setWriteBudget(uint64_t aBytesPerHour)
+{
+  writeBudget = aBytesPerHour;
+  budgetLevel = 0;
+  budgetLevelTime = Never;
+}
+
+
+bool ParamStore::writeBudgetExceeded()
+{
+  if (writeBudget==0) return false;
+  drainBudget();
+  return budgetLevel>writeBudget;
+}
+
+
+
+#pragma mark - PersistentParams
+
+
 PersistentParams::PersistentParams(ParamStore &aParamStore) :
   paramStore(aParamStore),
   dirty(false),
+  queuedDirty(false),
+  nextDirty(NULL),
+  prevDirty(NULL),
   rowid(false)
 {
 }
 
 
+PersistentParams::~PersistentParams()
+{
+  if (queuedDirty) paramStore.dequeueDirty(this);
+  if (!paramStore.uncommittedSaves.empty()) paramStore.forgetSaves(this);
+  paramStore.forgetWriteOwner(this);
+}
+
+
 
 static const size_t numKeys = 1;
 
@@ -74,6 +387,10 @@ static string fieldDeclaration(const FieldDefinition *aFieldDefP)
 
 void PersistentParams::checkAndUpdateSchema()
 {
+  // schema changes must not interfere with queued writes
+  paramStore.flushWriteBehind();
+  // preloaded rows might not match the new schema
+  paramStore.invalidatePreload(tableName(), NULL, 0);
   // check for table
   string sql = string_format("SELECT name FROM sqlite_master WHERE name ='%s' and type='table'", tableName());
   sqlite3pp::query qry(paramStore, sql.c_str());
@@ -118,6 +435,8 @@ void PersistentParams::checkAndUpdateSchema()
         cmd.execute();
     }
   }
+  // schema has changed, cached statements must be prepared again
+  paramStore.clearStatementCache();
 }
 
 
@@ -139,31 +458,47 @@ size_t PersistentParams::appendfieldList(string &sql, bool keyFields, bool aAppe
 
 
 // helper for implementation of loadChildren()
-sqlite3pp::query *PersistentParams::newLoadAllQuery(const char *aParentIdentifier)
+string PersistentParams::selectAllSQL()
 {
-  sqlite3pp::query * queryP = new sqlite3pp::query(paramStore);
   string sql = "SELECT ROWID";
   // key fields
   appendfieldList(sql, true , true, false);
   // other fields
   appendfieldList(sql, false, true, false);
+  string_format_append(sql, " FROM %s", tableName());
+  return sql;
+}
+
+
+sqlite3pp::query *PersistentParams::newLoadAllQuery(const char *aParentIdentifier)
+{
+  string selectAll = selectAllSQL();
   // limit to entries linked to parent
-  string_format_append(sql, " FROM %s WHERE %s='%s'", tableName(), getKeyDef(0)->fieldName, aParentIdentifier);
+  string sql = selectAll;
+  string_format_append(sql, " WHERE %s=?", getKeyDef(0)->fieldName);
   FOCUSLOG("newLoadAllQuery for parent='%s': %s\n", aParentIdentifier, sql.c_str());
-  // now execute query
-  if (queryP->prepare(sql.c_str())!=SQLITE_OK) {
+  // make sure we read what was written before
+  paramStore.flushWriteBehind();
+  // when bulk loading, serve from preloaded rows
+  sqlite3pp::query *queryP = paramStore.preloadedRows(sql, selectAll, aParentIdentifier);
+  if (queryP==NULL) {
+    // get prepared query
+    queryP = paramStore.cachedQuery(sql);
+  }
+  if (queryP==NULL) {
     FOCUSLOG("- query not successful - assume wrong schema -> calling checkAndUpdateSchema()\n");
     // - error could mean schema is not up to date
-    queryP->reset();
     checkAndUpdateSchema();
     FOCUSLOG("newLoadAllQuery: retrying newLoadAllQuery after schema update: %s\n", sql.c_str());
-    if (queryP->prepare(sql.c_str())!=SQLITE_OK) {
+    queryP = paramStore.cachedQuery(sql);
+    if (queryP==NULL) {
       LOG(LOG_ERR, "newLoadAllQuery: %s - failed: %s\n", sql.c_str(), paramStore.error()->description().c_str());
       // error now means something is really wrong
-      delete queryP;
       return NULL;
     }
   }
+  // bind the parent
+  queryP->bind(1, aParentIdentifier, false); // text not static
   return queryP;
 }
 
@@ -197,9 +532,10 @@ ErrorPtr PersistentParams::loadFromStore(const char *aParentIdentifier)
       int index = 0;
       uint64_t flags; // storage to distribute flags over hierarchy
       loadFromRow(row, index, &flags); // might set dirty when assigning properties...
-      dirty = false; // ...so: just loaded: make clean
+      setClean(); // ...so: just loaded: make clean
     }
-    delete queryP; queryP = NULL;
+    queryP->reset(); // done with the cached query
+    queryP = NULL;
   }
   if (Error::isOK(err)) {
     err = loadChildren();
@@ -212,12 +548,20 @@ ErrorPtr PersistentParams::loadFromStore(const char *aParentIdentifier)
 void PersistentParams::markDirty()
 {
   dirty = true;
+  if (!queuedDirty) paramStore.enqueueDirty(this);
 }
 
 
 void PersistentParams::markClean()
+{
+  setClean();
+}
+
+
+void PersistentParams::setClean()
 {
   dirty = false;
+  if (queuedDirty) paramStore.dequeueDirty(this);
 }
 
 
@@ -234,17 +578,36 @@ ErrorPtr PersistentParams::saveToStore(const char *aParentIdentifier, bool aMult
 {
   ErrorPtr err;
   if (dirty) {
-    sqlite3pp::command cmd(paramStore);
+    sqlite3pp::command *cmdP;
     string sql;
+    // preloaded rows for this parent are no longer valid
+    paramStore.invalidatePreload(tableName(), aParentIdentifier, 0);
+    // Existing rows can be written behind (if enabled), because their ROWID is already known.
+    // New rows must be inserted synchronously to get their ROWID, after all queued writes are done.
+    bool writeBehind = rowid!=0 && paramStore.writeBehindActive();
+    if (!writeBehind) paramStore.flushWriteBehind();
     // cleanup: remove all previous records for that parent if not multiple children allowed
     if (!aMultipleChildrenAllowed) {
-      sql = string_format("DELETE FROM %s WHERE %s='%s'", tableName(), getKeyDef(0)->fieldName, aParentIdentifier);
+      sql = string_format("DELETE FROM %s WHERE %s=?", tableName(), getKeyDef(0)->fieldName);
       if (rowid!=0) {
-        string_format_append(sql, " AND ROWID!=%lld", rowid);
+        sql += " AND ROWID!=?";
       }
       FOCUSLOG("- cleanup before save: %s\n", sql.c_str());
-      if (paramStore.executef(sql.c_str()) != SQLITE_OK) {
-        LOG(LOG_ERR, "- cleanup error (ignored): %s\n", sql.c_str(), paramStore.error()->description().c_str());
+      if (writeBehind) {
+        SQLite3RowSnapshot *snapshotP = paramStore.newRowSnapshot(sql);
+        snapshotP->bind(1, aParentIdentifier, false);
+        snapshotP->bind(2, (long long)rowid);
+        paramStore.queueWrite(snapshotP);
+      }
+      else {
+        cmdP = paramStore.cachedCommand(sql);
+        if (cmdP) {
+          cmdP->bind(1, aParentIdentifier, false); // text not static
+          if (rowid!=0) cmdP->bind(2, (long long)rowid);
+        }
+        if (!cmdP || cmdP->execute()!=SQLITE_OK) {
+          LOG(LOG_ERR, "- cleanup error (ignored): %s - %s\n", sql.c_str(), paramStore.error()->description().c_str());
+        }
       }
     }
     // now save
@@ -254,21 +617,38 @@ ErrorPtr PersistentParams::saveToStore(const char *aParentIdentifier, bool aMult
       // - update all fields, even key fields may change (as long as they don't collide with another entry)
       appendfieldList(sql, true, false, true);
       appendfieldList(sql, false, true, true);
-      string_format_append(sql, " WHERE ROWID=%lld", rowid);
+      sql += " WHERE ROWID=?";
+      if (writeBehind) {
+        // take a snapshot of the values and let the write-behind thread write it
+        FOCUSLOG("saveToStore: queue update of existing row for parent='%s': %s\n", aParentIdentifier, sql.c_str());
+        SQLite3RowSnapshot *snapshotP = paramStore.newRowSnapshot(sql);
+        int index = 1; // SQLite parameter indexes are 1-based!
+        bindToStatement(*snapshotP, index, aParentIdentifier, 0); // no flags yet, class hierarchy will collect them
+        snapshotP->bind(index++, (long long)rowid); // the ROWID for the WHERE clause
+        snapshotP->setOwner(this); // failure to write will mark us dirty again
+        paramStore.accountWrite(tableName(), snapshotP->dataSize(), false);
+        paramStore.queueWrite(snapshotP);
+        setClean(); // write errors will be reported asynchronously via writeBehindFailed()
+        return saveChildren();
+      }
       // now execute command
       FOCUSLOG("saveToStore: update existing row for parent='%s': %s\n", aParentIdentifier, sql.c_str());
-      if (cmd.prepare(sql.c_str())!=SQLITE_OK) {
+      cmdP = paramStore.cachedCommand(sql);
+      if (!cmdP) {
         // error on update is always a real error - if we loaded the params from the DB, schema IS ok!
         err = paramStore.error();
       }
       if (Error::isOK(err)) {
         // bind the values
         int index = 1; // SQLite parameter indexes are 1-based!
-        bindToStatement(cmd, index, aParentIdentifier, 0); // no flags yet, class hierarchy will collect them
+        bindToStatement(*cmdP, index, aParentIdentifier, 0); // no flags yet, class hierarchy will collect them
+        cmdP->bind(index++, (long long)rowid); // the ROWID for the WHERE clause
         // now execute command
-        if (cmd.execute()==SQLITE_OK) {
+        if (cmdP->execute()==SQLITE_OK) {
           // ok, updated ok
-          dirty = false;
+          paramStore.accountWrite(tableName(), cmdP->bound_size(), false);
+          setClean();
+          paramStore.noteSave(this, false);
         }
         else {
           // failed
@@ -291,13 +671,14 @@ ErrorPtr PersistentParams::saveToStore(const char *aParentIdentifier, bool aMult
       sql += ")";
       // prepare
       FOCUSLOG("saveToStore: insert new row for parent='%s': %s\n", aParentIdentifier, sql.c_str());
-      if (cmd.prepare(sql.c_str())!=SQLITE_OK) {
+      cmdP = paramStore.cachedCommand(sql);
+      if (!cmdP) {
         FOCUSLOG("- insert not successful - assume wrong schema -> calling checkAndUpdateSchema()\n");
         // - error on INSERT could mean schema is not up to date
-        cmd.reset();
         checkAndUpdateSchema();
         FOCUSLOG("saveToStore: retrying insert after schema update: %s\n", sql.c_str());
-        if (cmd.prepare(sql.c_str())!=SQLITE_OK) {
+        cmdP = paramStore.cachedCommand(sql);
+        if (!cmdP) {
           // error now means something is really wrong
           err = paramStore.error();
         }
@@ -305,12 +686,14 @@ ErrorPtr PersistentParams::saveToStore(const char *aParentIdentifier, bool aMult
       if (Error::isOK(err)) {
         // bind the values
         int index = 1; // SQLite parameter indexes are 1-based!
-        bindToStatement(cmd, index, aParentIdentifier, 0); // no flags yet, class hierarchy will collect them
+        bindToStatement(*cmdP, index, aParentIdentifier, 0); // no flags yet, class hierarchy will collect them
         // now execute command
-        if (cmd.execute()==SQLITE_OK) {
+        if (cmdP->execute()==SQLITE_OK) {
           // get the new ROWID
           rowid = paramStore.last_insert_rowid();
-          dirty = false;
+          paramStore.accountWrite(tableName(), cmdP->bound_size(), false);
+          setClean();
+          paramStore.noteSave(this, true);
         }
         else {
           // failed
@@ -333,12 +716,14 @@ ErrorPtr PersistentParams::saveToStore(const char *aParentIdentifier, bool aMult
 ErrorPtr PersistentParams::deleteFromStore()
 {
   ErrorPtr err;
-  dirty = false; // forget any unstored changes
+  setClean(); // forget any unstored changes
   if (rowid!=0) {
+    paramStore.invalidatePreload(tableName(), NULL, rowid); // preloaded rows of the parent are no longer valid
     FOCUSLOG("deleteFromStore: deleting row %lld in table %s\n", rowid, tableName());
-    if (paramStore.executef("DELETE FROM %s WHERE ROWID=%lld", tableName(), rowid) != SQLITE_OK) {
-      err = paramStore.error();
-    }
+    SQLite3RowSnapshot *snapshotP = paramStore.newRowSnapshot(string_format("DELETE FROM %s WHERE ROWID=?", tableName()));
+    snapshotP->bind(1, (long long)rowid);
+    paramStore.accountWrite(tableName(), 0, true);
+    err = paramStore.queueWrite(snapshotP); // executes immediately if write-behind is not active
     // deleted, forget
     rowid = 0;
   }
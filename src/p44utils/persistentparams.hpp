@@ -24,6 +24,8 @@
 
 #include "sqlite3persistence.hpp"
 
+#include <set>
+
 using namespace std;
 
 namespace p44 {
@@ -34,9 +36,151 @@ namespace p44 {
   } FieldDefinition;
 
 
+  class PersistentParams;
+
+
+  /// all rows of a table, read in one go and grouped by parent identifier
+  /// @note this is a query object such that it can be returned by PersistentParams::newLoadAllQuery() in place
+  ///   of a real query. Binding the parent identifier (parameter 1) selects the rows that begin() will iterate.
+  class PreloadedRows : public sqlite3pp::query
+  {
+    typedef sqlite3pp::query inherited;
+
+    typedef vector<value_row> RowVector;
+    typedef map<string, RowVector> ParentRowsMap;
+    ParentRowsMap parentRows; ///< copied column values by parent identifier
+    RowVector *currentRowsP; ///< rows for the currently bound parent identifier, NULL if none
+    set<string> invalidParents; ///< parent identifiers changed since preloading
+    map<uint64_t, string> parentOfRow; ///< parent identifier by ROWID
+
+  public:
+
+    PreloadedRows(sqlite3pp::database &aDb);
+    virtual ~PreloadedRows();
+
+    /// read all rows
+    /// @param aSelectAllSQL query returning all rows, with the ROWID in column 0 and the parent identifier in column 1
+    /// @return SQLite result code
+    int load(const char *aSelectAllSQL);
+
+    /// forget rows for a parent identifier, such that it will no longer be served from memory
+    void invalidate(const char *aParentIdentifier);
+
+    /// forget rows for the parent identifier of a given row
+    void invalidateRow(uint64_t aRowId);
+
+    /// @return true if rows for this parent can be served from memory
+    bool covers(const char *aParentIdentifier);
+
+    // query implementation
+    using inherited::bind;
+    virtual int bind(int idx, char const* value, bool fstatic = true);
+    virtual iterator begin();
+
+  };
+
+
+
+  /// write statistics (per table or total)
+  typedef struct {
+    uint64_t rowWrites; ///< number of rows inserted or updated
+    uint64_t rowDeletes; ///< number of rows deleted
+    uint64_t bytesWritten; ///< amount of row data written
+  } ParamWriteStats;
+
+
   class ParamStore : public SQLite3Persistence
   {
     typedef SQLite3Persistence inherited;
+    friend class PersistentParams;
+
+  public:
+
+    typedef map<string, ParamWriteStats> TableWriteStatsMap;
+
+  private:
+
+    PersistentParams *dirtyHead; ///< oldest dirty parameter set, NULL if none
+    PersistentParams *dirtyTail; ///< most recently dirtied parameter set, NULL if none
+    size_t dirtyCount; ///< number of parameter sets in the dirty list
+
+    void enqueueDirty(PersistentParams *aParams);
+    void dequeueDirty(PersistentParams *aParams);
+
+    bool preloading; ///< set while tables are preloaded on first access
+    typedef map<string, PreloadedRows *> PreloadMap;
+    PreloadMap preloads; ///< preloaded tables, by load-all SQL
+
+    PreloadedRows *preloadedRows(const string &aLoadAllSQL, const string &aSelectAllSQL, const char *aParentIdentifier);
+    void invalidatePreload(const char *aTableName, const char *aParentIdentifier, uint64_t aRowId);
+
+    TableWriteStatsMap tableWriteStats; ///< write statistics by table name
+    ParamWriteStats totalWriteStats; ///< write statistics over all tables
+    uint64_t writeBudget; ///< max bytes per hour to write on average, 0 if unlimited
+    double budgetLevel; ///< bytes written but not yet "drained" by the budget (leaky bucket)
+    MLMicroSeconds budgetLevelTime; ///< time when budgetLevel was last updated
+
+    void accountWrite(const char *aTableName, size_t aBytes, bool aDelete);
+    void drainBudget();
+
+    typedef vector<pair<PersistentParams *, bool> > UncommittedSaveVector;
+    UncommittedSaveVector uncommittedSaves; ///< parameter sets saved (and made clean) in the pending transaction, with flag set for inserts
+
+    void noteSave(PersistentParams *aParams, bool aInserted);
+    void forgetSaves(PersistentParams *aParams);
+
+  protected:
+
+    virtual void transactionEnded(bool aCommitted);
+    virtual void writeBehindFailed(SQLite3RowSnapshot &aSnapshot);
+
+  public:
+
+    ParamStore();
+    virtual ~ParamStore();
+
+    /// @return number of parameter sets currently waiting in the dirty list
+    size_t dirtyListLength() { return dirtyCount; };
+
+    /// remove the oldest parameter set from the dirty list
+    /// @return the parameter set, NULL if dirty list is empty
+    /// @note the parameter set is no longer in the dirty list after this call, even if it is still dirty. Calling
+    ///   its saveDirty() will usually make it clean; if not, markDirty() will put it back into the list.
+    PersistentParams *popDirty();
+
+    /// start bulk loading
+    /// @note until endPreload() is called, the first load from a table reads the entire table at once, and all
+    ///   further loads from that table are served from memory. This avoids one query per parameter set when
+    ///   loading the settings of many devices at startup.
+    void startPreload();
+
+    /// end bulk loading and free preloaded data
+    void endPreload();
+
+
+    /// @name write statistics and flash wear budget
+    /// @{
+
+    /// set write budget
+    /// @param aBytesPerHour amount of row data that may be written per hour on average, 0 for unlimited.
+    ///   Up to one hour's budget may be written in a burst.
+    void setWriteBudget(uint64_t aBytesPerHour);
+
+    /// @return write budget in bytes per hour, 0 if unlimited
+    uint64_t getWriteBudget() { return writeBudget; };
+
+    /// @return true if more data was written recently than the write budget allows
+    /// @note callers doing periodic saves should postpone saving while this is true, so repeated changes
+    ///   of the same settings are coalesced in memory instead of wearing the flash.
+    bool writeBudgetExceeded();
+
+    /// @return write statistics over all tables
+    const ParamWriteStats &getTotalWriteStats() { return totalWriteStats; };
+
+    /// @return write statistics by table name
+    const TableWriteStatsMap &getTableWriteStats() { return tableWriteStats; };
+
+    /// @}
   };
 
 
@@ -44,11 +188,18 @@ namespace p44 {
   /// @note this class does NOT derive from P44Obj, so it can be added as "interface" using multiple-inheritance
   class PersistentParams
   {
+    friend class ParamStore;
+
     bool dirty; ///< if set, means that values need to be saved
+    bool queuedDirty; ///< set while this parameter set is linked into the param store's dirty list
+    PersistentParams *nextDirty; ///< next (more recently dirtied) parameter set in the dirty list
+    PersistentParams *prevDirty; ///< previous (less recently dirtied) parameter set in the dirty list
+
   protected:
     ParamStore &paramStore; ///< the associated parameter store
   public:
     PersistentParams(ParamStore &aParamStore);
+    virtual ~PersistentParams();
     uint64_t rowid; ///< ROWID of the persisted data, 0 if not yet persisted
 
     /// @name interface to be implemented for specific parameter sets in subclasses
@@ -107,9 +258,15 @@ namespace p44 {
     /// delete child parameters (if any)
     virtual ErrorPtr deleteChildren() { return ErrorPtr(); };
 
+    /// save this parameter set when it is taken from the param store's dirty list
+    /// @note implementations must call saveToStore() with the same parent identifier they normally use.
+    ///   If the parameter set cannot be saved on its own (yet), it should leave itself dirty.
+    virtual ErrorPtr saveDirty() = 0;
+
     /// @}
 
     /// mark the parameter set dirty (so it will be saved to DB next time saveToStore is called
+    /// @note also puts the parameter set into the param store's dirty list (unless already there)
     virtual void markDirty();
 
     /// @return true if needs to be saved
@@ -144,6 +301,7 @@ namespace p44 {
     /// helper for implementation of loadChildren()
     /// @return a prepared query set up to iterate through all records with a given parent identifier, or NULL on error
     /// @param aParentIdentifier identifies the parent of this parameter set (a string (G)UID or the ROWID of a parent parameter set)
+    /// @note the query is taken from the param store's statement cache. It must NOT be deleted, but should be reset() after use.
     sqlite3pp::query *newLoadAllQuery(const char *aParentIdentifier);
 
   protected:
@@ -153,10 +311,14 @@ namespace p44 {
 
 
   private:
+    /// make clean and remove from the dirty list
+    void setClean();
     /// check and update schema to hold the parameters
     void checkAndUpdateSchema();
     /// append field list
     size_t appendfieldList(string &sql, bool keyFields, bool aAppendFields, bool aWithParamAssignment);
+    /// @return select statement for all fields of all rows, without WHERE clause
+    string selectAllSQL();
 
   };
   
@@ -0,0 +1,210 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "phaseprofiler.hpp"
+
+#include "logger.hpp"
+
+using namespace p44;
+
+p44::PhaseProfiler globalPhaseProfiler;
+
+
+PhaseProfiler::PhaseProfiler() :
+  active(false),
+  finished(false),
+  reportStart(Never),
+  reportEnd(Never),
+  maxReports(0)
+{
+}
+
+
+void PhaseProfiler::setStorage(const string &aPath, size_t aMaxReports)
+{
+  storagePath = aPath;
+  maxReports = aMaxReports;
+  previousReports.clear();
+  FILE *f = fopen(storagePath.c_str(), "r");
+  if (!f) return; // no reports yet
+  string text;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f))>0) {
+    text.append(buf, n);
+  }
+  fclose(f);
+  const char *cursor = text.c_str();
+  string line;
+  while (nextLine(cursor, line)) {
+    if (!line.empty()) previousReports.push_back(line);
+  }
+}
+
+
+void PhaseProfiler::startReport()
+{
+  phases.clear();
+  active = true;
+  finished = false;
+  reportStart = MainLoop::now();
+  reportEnd = Never;
+  char tbuf[32];
+  time_t t = time(NULL);
+  strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+  reportTime = tbuf;
+}
+
+
+void PhaseProfiler::finishReport()
+{
+  if (!recording()) return;
+  reportEnd = MainLoop::now();
+  finished = true;
+  LOG(LOG_NOTICE, "Phase profile finished after %lld mS\n", (long long)(reportEnd-reportStart)/MilliSecond);
+  save();
+}
+
+
+PhaseProfiler::Phase *PhaseProfiler::findPhase(const string &aName)
+{
+  for (PhaseVector::iterator pos = phases.begin(); pos!=phases.end(); ++pos) {
+    if (pos->name==aName) return &(*pos);
+  }
+  return NULL;
+}
+
+
+void PhaseProfiler::addPhase(const string &aName, MLMicroSeconds aStart, MLMicroSeconds aEnd)
+{
+  if (!recording()) return;
+  Phase *p = findPhase(aName);
+  if (p) {
+    // accumulate
+    p->duration += aEnd-aStart;
+    p->count++;
+  }
+  else {
+    Phase ph;
+    ph.name = aName;
+    ph.start = aStart;
+    ph.duration = aEnd-aStart;
+    ph.count = 1;
+    phases.push_back(ph);
+  }
+}
+
+
+void PhaseProfiler::milestone(const string &aName)
+{
+  if (!active || findPhase(aName)) return; // not recording or milestone already reached
+  MLMicroSeconds now = MainLoop::now();
+  Phase ph;
+  ph.name = aName;
+  ph.start = now;
+  ph.duration = 0;
+  ph.count = 1;
+  phases.push_back(ph);
+  if (finished) {
+    // update the already saved report
+    save();
+  }
+}
+
+
+void PhaseProfiler::appendCurrentReportJson(string &aJson)
+{
+  string_format_append(aJson, "{\"time\":\"%s\"", reportTime.c_str());
+  if (reportEnd!=Never) {
+    string_format_append(aJson, ",\"totalMS\":%lld", (long long)(reportEnd-reportStart)/MilliSecond);
+  }
+  aJson += ",\"phases\":[";
+  for (PhaseVector::iterator pos = phases.begin(); pos!=phases.end(); ++pos) {
+    if (pos!=phases.begin()) aJson += ',';
+    aJson += "{\"name\":\"";
+    for (string::const_iterator cp = pos->name.begin(); cp!=pos->name.end(); ++cp) {
+      if (*cp=='"' || *cp=='\\') aJson += '\\';
+      if ((uint8_t)*cp>=0x20) aJson += *cp;
+    }
+    string_format_append(aJson,
+      "\",\"startMS\":%lld,\"durationMS\":%lld,\"count\":%d}",
+      (long long)(pos->start-reportStart)/MilliSecond,
+      (long long)pos->duration/MilliSecond,
+      pos->count
+    );
+  }
+  aJson += "]}";
+}
+
+
+void PhaseProfiler::appendReportsJson(string &aJson)
+{
+  aJson += '[';
+  bool first = true;
+  for (StringList::iterator pos = previousReports.begin(); pos!=previousReports.end(); ++pos) {
+    if (!first) aJson += ',';
+    aJson += *pos;
+    first = false;
+  }
+  if (active) {
+    if (!first) aJson += ',';
+    appendCurrentReportJson(aJson);
+  }
+  aJson += ']';
+}
+
+
+void PhaseProfiler::save()
+{
+  if (storagePath.empty() || maxReports==0) return;
+  // keep maxReports-1 previous reports plus the current one
+  while (previousReports.size()>=maxReports) previousReports.pop_front();
+  FILE *f = fopen(storagePath.c_str(), "w");
+  if (!f) {
+    LOG(LOG_ERR, "Cannot save phase profile to %s\n", storagePath.c_str());
+    return;
+  }
+  for (StringList::iterator pos = previousReports.begin(); pos!=previousReports.end(); ++pos) {
+    fputs(pos->c_str(), f);
+    fputc('\n', f);
+  }
+  string json;
+  appendCurrentReportJson(json);
+  fputs(json.c_str(), f);
+  fputc('\n', f);
+  fclose(f);
+}
+
+
+#pragma mark - phase scope helper
+
+PhaseScope::PhaseScope(const string &aName) :
+  name(aName),
+  start(Never)
+{
+  if (globalPhaseProfiler.recording()) start = MainLoop::now();
+}
+
+
+PhaseScope::~PhaseScope()
+{
+  if (start!=Never) globalPhaseProfiler.addPhase(name, start, MainLoop::now());
+}
@@ -0,0 +1,127 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44utils__phaseprofiler__
+#define __p44utils__phaseprofiler__
+
+#include "p44_common.hpp"
+
+using namespace std;
+
+/// record a phase covering the current C++ scope
+/// @note aName is only evaluated when a report is being recorded
+#define PHASE_SCOPE(aName) p44::PhaseScope __phaseScope(globalPhaseProfiler.recording() ? string(aName) : string())
+
+namespace p44 {
+
+  /// Records the timing of the phases of a process (such as application startup) into a report, and keeps
+  /// the last N reports in a file, so changes in timing can be compared across restarts.
+  /// - between startReport() and finishReport(), phases are recorded with addPhase(), PHASE_SCOPE or
+  ///   beginPhase()/endPhase(). Phases with the same name accumulate (durations add up, count increments).
+  /// - after finishReport(), the report is saved, and only milestone() can add (once per name) to it.
+  /// @note not thread safe, must only be used from the mainloop thread.
+  class PhaseProfiler
+  {
+    struct Phase {
+      string name;
+      MLMicroSeconds start; ///< start of first occurrence
+      MLMicroSeconds duration; ///< accumulated duration
+      int count; ///< number of occurrences
+    };
+    typedef vector<Phase> PhaseVector;
+
+    PhaseVector phases; ///< phases of current report
+    bool active; ///< set while recording phases
+    bool finished; ///< set when current report is finished (but can still receive milestones)
+    MLMicroSeconds reportStart; ///< start of current report
+    MLMicroSeconds reportEnd; ///< end of current report
+    string reportTime; ///< wall clock time of start of the current report
+
+    string storagePath; ///< file to store reports in, one JSON object per line
+    size_t maxReports; ///< max number of reports to keep
+    typedef list<string> StringList;
+    StringList previousReports; ///< JSON text of reports of previous runs
+
+  public:
+
+    PhaseProfiler();
+
+    /// set up file to store reports in, and load previous reports from it
+    /// @param aPath file path
+    /// @param aMaxReports max number of reports (including the current one) to keep
+    void setStorage(const string &aPath, size_t aMaxReports);
+
+    /// start a new report
+    void startReport();
+
+    /// finish current report and save it
+    void finishReport();
+
+    /// @return true if phases are being recorded
+    bool recording() { return active && !finished; };
+
+    /// record a phase
+    /// @param aName name of the phase
+    /// @param aStart start time of the phase
+    /// @param aEnd end time of the phase
+    void addPhase(const string &aName, MLMicroSeconds aStart, MLMicroSeconds aEnd);
+
+    /// begin a phase ending later, possibly in another callback
+    /// @return phase start time, to be passed to endPhase()
+    MLMicroSeconds beginPhase() { return MainLoop::now(); };
+
+    /// end a phase started with beginPhase()
+    /// @param aName name of the phase
+    /// @param aStart start time as returned from beginPhase()
+    void endPhase(const string &aName, MLMicroSeconds aStart) { addPhase(aName, aStart, MainLoop::now()); };
+
+    /// record a milestone, once per report. Milestones are accepted even after the report is finished.
+    /// @param aName name of the milestone
+    void milestone(const string &aName);
+
+    /// append all stored reports plus the current one as JSON array
+    /// @param aJson string to append JSON text to
+    void appendReportsJson(string &aJson);
+
+  private:
+
+    Phase *findPhase(const string &aName);
+    void appendCurrentReportJson(string &aJson);
+    void save();
+
+  };
+
+
+  /// helper for PHASE_SCOPE
+  class PhaseScope
+  {
+    string name;
+    MLMicroSeconds start;
+  public:
+    PhaseScope(const string &aName);
+    ~PhaseScope();
+  };
+
+} // namespace p44
+
+extern p44::PhaseProfiler globalPhaseProfiler;
+
+#endif /* defined(__p44utils__phaseprofiler__) */
@@ -22,6 +22,7 @@
 #include "sqlite3persistence.hpp"
 
 #include "logger.hpp"
+#include "phaseprofiler.hpp"
 
 using namespace p44;
 
@@ -53,14 +54,28 @@ ErrorPtr SQLite3Error::err(int aSQLiteError, const char *aSQLiteMessage, const c
 
 
 SQLite3Persistence::SQLite3Persistence() :
-  initialized(false)
+  initialized(false),
+  transactionNesting(0),
+  realTransaction(false),
+  writer(NULL),
+  writerBusy(false),
+  writerTerminate(false),
+  writerTerminated(false),
+  writerCacheInvalid(false),
+  writeFailures(0)
 {
+  pthread_mutex_init(&writeMutex, NULL);
+  pthread_cond_init(&writeQueueCond, NULL);
+  pthread_cond_init(&writeDoneCond, NULL);
 }
 
 
 SQLite3Persistence::~SQLite3Persistence()
 {
   finalizeAndDisconnect();
+  pthread_cond_destroy(&writeDoneCond);
+  pthread_cond_destroy(&writeQueueCond);
+  pthread_mutex_destroy(&writeMutex);
 }
 
 
@@ -82,6 +97,8 @@ ErrorPtr SQLite3Persistence::connectAndInitialize(const char *aDatabaseFileName,
   ErrorPtr errPtr;
   int currentSchemaVersion;
 
+  dbFileName = nonNullCStr(aDatabaseFileName);
+  PHASE_SCOPE("sqlite "+dbFileName.substr(dbFileName.rfind('/')+1));
   while (true) {
     // assume DB not yet existing
     currentSchemaVersion = 0;
@@ -171,13 +188,462 @@ ErrorPtr SQLite3Persistence::connectAndInitialize(const char *aDatabaseFileName,
 
 void SQLite3Persistence::finalizeAndDisconnect()
 {
+  // make sure all pending writes are done
+  stopWriteBehind();
+  clearStatementCache();
   if (initialized) {
+    if (transactionNesting>0) {
+      // commit what we have before disconnecting
+      transactionNesting = 1;
+      commitTransaction();
+    }
     disconnect();
     initialized = false;
   }
 }
 
 
+sqlite3pp::command *SQLite3Persistence::cachedCommand(const string &aSql)
+{
+  CommandCache::iterator pos = commandCache.find(aSql);
+  if (pos!=commandCache.end()) {
+    pos->second->reset();
+    return pos->second;
+  }
+  sqlite3pp::command *cmdP = new sqlite3pp::command(*this);
+  if (cmdP->prepare(aSql.c_str())!=SQLITE_OK) {
+    delete cmdP;
+    return NULL;
+  }
+  commandCache[aSql] = cmdP;
+  return cmdP;
+}
+
+
+sqlite3pp::query *SQLite3Persistence::cachedQuery(const string &aSql)
+{
+  QueryCache::iterator pos = queryCache.find(aSql);
+  if (pos!=queryCache.end()) {
+    pos->second->reset();
+    return pos->second;
+  }
+  sqlite3pp::query *queryP = new sqlite3pp::query(*this);
+  if (queryP->prepare(aSql.c_str())!=SQLITE_OK) {
+    delete queryP;
+    return NULL;
+  }
+  queryCache[aSql] = queryP;
+  return queryP;
+}
+
+
+void SQLite3Persistence::clearStatementCache()
+{
+  // Note: finalizing returns the error of the statement's last execution, if any. The sqlite3pp statement
+  //   destructor would throw on that, so cached statements must be finalized explicitly before deleting them
+  for (CommandCache::iterator pos = commandCache.begin(); pos!=commandCache.end(); ++pos) {
+    pos->second->finish();
+    delete pos->second;
+  }
+  commandCache.clear();
+  for (QueryCache::iterator pos = queryCache.begin(); pos!=queryCache.end(); ++pos) {
+    pos->second->finish();
+    delete pos->second;
+  }
+  queryCache.clear();
+  if (writer) {
+    // writer connection's statements might be affected as well (schema change), have it clear its cache, too
+    pthread_mutex_lock(&writeMutex);
+    writerCacheInvalid = true;
+    pthread_mutex_unlock(&writeMutex);
+  }
+}
+
+
+ErrorPtr SQLite3Persistence::beginTransaction()
+{
+  if (transactionNesting++>0) return ErrorPtr(); // nested, transaction already open
+  // Note: with write-behind, writes are batched into transactions by the writer thread. A transaction
+  //   on this connection would only block the writer thread
+  if (writeBehindActive()) return ErrorPtr();
+  if (execute("BEGIN")!=SQLITE_OK) {
+    transactionNesting = 0;
+    return error("beginTransaction: ");
+  }
+  realTransaction = true;
+  return ErrorPtr();
+}
+
+
+ErrorPtr SQLite3Persistence::commitTransaction()
+{
+  if (transactionNesting<=0) return ErrorPtr(); // no transaction open
+  if (--transactionNesting>0) return ErrorPtr(); // nested, outermost will commit
+  if (!realTransaction) return ErrorPtr(); // no BEGIN was issued
+  realTransaction = false;
+  if (execute("COMMIT")!=SQLITE_OK) {
+    ErrorPtr err = error("commitTransaction: ");
+    LOG(LOG_ERR, "SQLite3Persistence: commit failed, rolling back: %s\n", err->description().c_str());
+    execute("ROLLBACK");
+    transactionEnded(false);
+    return err;
+  }
+  transactionEnded(true);
+  return ErrorPtr();
+}
+
+
+
+#pragma mark - write-behind
+
+
+#define WRITER_BUSY_TIMEOUT_MS 5000
+
+ErrorPtr SQLite3Persistence::startWriteBehind()
+{
+  if (writer) return ErrorPtr(); // already running
+  if (!initialized) return SQLite3Error::err(SQLITE_MISUSE, "database not initialized", "startWriteBehind: ");
+  // WAL mode allows reading on this connection while the writer thread writes on its own connection
+  if (execute("PRAGMA journal_mode=WAL")!=SQLITE_OK) {
+    return error("Cannot enable WAL mode: ");
+  }
+  set_busy_timeout(WRITER_BUSY_TIMEOUT_MS);
+  // separate connection for the writer thread
+  SQLite3Persistence *w = new SQLite3Persistence;
+  if (w->connect(dbFileName.c_str())!=SQLITE_OK) {
+    ErrorPtr err = w->error("Cannot open write-behind connection: ");
+    delete w;
+    return err;
+  }
+  w->set_busy_timeout(WRITER_BUSY_TIMEOUT_MS);
+  writer = w;
+  writerBusy = false;
+  writerTerminate = false;
+  writerTerminated = false;
+  writerCacheInvalid = false;
+  writerThread = MainLoop::currentMainLoop().executeInThread(
+    boost::bind(&SQLite3Persistence::writerThreadRoutine, this, _1),
+    boost::bind(&SQLite3Persistence::writerThreadSignal, this, _1, _2)
+  );
+  LOG(LOG_INFO, "SQLite3Persistence: write-behind thread started for %s\n", dbFileName.c_str());
+  return ErrorPtr();
+}
+
+
+void SQLite3Persistence::stopWriteBehind()
+{
+  if (!writer) return; // not running
+  // request termination (writer thread writes everything still queued before terminating)
+  pthread_mutex_lock(&writeMutex);
+  writerTerminate = true;
+  pthread_cond_signal(&writeQueueCond);
+  while (!writerTerminated) {
+    pthread_cond_wait(&writeDoneCond, &writeMutex);
+  }
+  pthread_mutex_unlock(&writeMutex);
+  // thread routine has finished, just synchronize with the actual end of the thread
+  writerThread->cancel();
+  // report failures of the last batches
+  writerThreadSignal(*writerThread, threadSignalUserSignal);
+  writerThread.reset();
+  // close writer connection
+  delete writer;
+  writer = NULL;
+  LOG(LOG_INFO, "SQLite3Persistence: write-behind thread stopped, all queued writes done\n");
+}
+
+
+void SQLite3Persistence::flushWriteBehind()
+{
+  if (!writer) return;
+  pthread_mutex_lock(&writeMutex);
+  while ((!writeQueue.empty() || writerBusy) && !writerTerminated) {
+    pthread_cond_wait(&writeDoneCond, &writeMutex);
+  }
+  pthread_mutex_unlock(&writeMutex);
+}
+
+
+ErrorPtr SQLite3Persistence::queueWrite(SQLite3RowSnapshot *aSnapshot)
+{
+  if (!writer) {
+    // no write-behind, execute now
+    ErrorPtr err = executeSnapshot(aSnapshot);
+    delete aSnapshot;
+    return err;
+  }
+  pthread_mutex_lock(&writeMutex);
+  writeQueue.push_back(aSnapshot);
+  pthread_cond_signal(&writeQueueCond);
+  pthread_mutex_unlock(&writeMutex);
+  return ErrorPtr();
+}
+
+
+void SQLite3Persistence::forgetWriteOwner(void *aOwner)
+{
+  if (!writer) return;
+  pthread_mutex_lock(&writeMutex);
+  for (WriteQueue::iterator pos = writeQueue.begin(); pos!=writeQueue.end(); ++pos) {
+    if ((*pos)->owner==aOwner) (*pos)->owner = NULL;
+  }
+  for (WriteQueue::iterator pos = currentBatch.begin(); pos!=currentBatch.end(); ++pos) {
+    if ((*pos)->owner==aOwner) (*pos)->owner = NULL;
+  }
+  for (WriteQueue::iterator pos = failedWrites.begin(); pos!=failedWrites.end(); ++pos) {
+    if ((*pos)->owner==aOwner) (*pos)->owner = NULL;
+  }
+  pthread_mutex_unlock(&writeMutex);
+}
+
+
+ErrorPtr SQLite3Persistence::executeSnapshot(SQLite3RowSnapshot *aSnapshot)
+{
+  sqlite3pp::command *cmdP = cachedCommand(aSnapshot->getSql());
+  if (!cmdP || aSnapshot->bindTo(*cmdP)!=SQLITE_OK || cmdP->execute()!=SQLITE_OK) {
+    return error();
+  }
+  return ErrorPtr();
+}
+
+
+// runs on the writer thread. Note: must not use any P44Obj refcounting or logging shared with the main thread
+void SQLite3Persistence::writerThreadRoutine(ChildThreadWrapper &aThread)
+{
+  while (true) {
+    pthread_mutex_lock(&writeMutex);
+    while (writeQueue.empty() && !writerTerminate) {
+      pthread_cond_wait(&writeQueueCond, &writeMutex);
+    }
+    if (writeQueue.empty()) {
+      // terminate requested, and everything written
+      writerTerminated = true;
+      pthread_cond_broadcast(&writeDoneCond);
+      pthread_mutex_unlock(&writeMutex);
+      break;
+    }
+    // take all queued writes as one batch
+    currentBatch.swap(writeQueue);
+    writerBusy = true;
+    bool clearCache = writerCacheInvalid;
+    writerCacheInvalid = false;
+    pthread_mutex_unlock(&writeMutex);
+    // write batch in a single transaction
+    if (clearCache) writer->clearStatementCache();
+    long failures = 0;
+    string errMsg;
+    if (writer->execute("BEGIN")!=SQLITE_OK) {
+      failures++;
+      errMsg = writer->error_msg();
+    }
+    // Note: currentBatch is not modified by other threads while writerBusy is set
+    for (WriteQueue::iterator pos = currentBatch.begin(); pos!=currentBatch.end(); ++pos) {
+      sqlite3pp::command *cmdP = writer->cachedCommand((*pos)->getSql());
+      if (!cmdP || (*pos)->bindTo(*cmdP)!=SQLITE_OK || cmdP->execute()!=SQLITE_OK) {
+        failures++;
+        (*pos)->failed = true;
+        errMsg = string_format("%s : %s", (*pos)->getSql().c_str(), writer->error_msg());
+      }
+    }
+    if (writer->execute("COMMIT")!=SQLITE_OK) {
+      // nothing of the batch was written
+      failures += currentBatch.size();
+      errMsg = string_format("commit failed : %s", writer->error_msg());
+      writer->execute("ROLLBACK");
+      for (WriteQueue::iterator pos = currentBatch.begin(); pos!=currentBatch.end(); ++pos) {
+        (*pos)->failed = true;
+      }
+    }
+    // done with batch
+    pthread_mutex_lock(&writeMutex);
+    // - keep failed snapshots with an owner for reporting, dispose of the others
+    for (WriteQueue::iterator pos = currentBatch.begin(); pos!=currentBatch.end(); ++pos) {
+      if ((*pos)->failed && (*pos)->owner)
+        failedWrites.push_back(*pos);
+      else
+        delete *pos;
+    }
+    currentBatch.clear();
+    writerBusy = false;
+    if (failures>0) {
+      writeFailures += failures;
+      lastWriteError = errMsg;
+    }
+    pthread_cond_broadcast(&writeDoneCond);
+    pthread_mutex_unlock(&writeMutex);
+    // report failures asynchronously
+    if (failures>0) aThread.signalParentThread(threadSignalUserSignal);
+  }
+}
+
+
+// runs on the main thread
+void SQLite3Persistence::writerThreadSignal(ChildThreadWrapper &aChildThread, ThreadSignals aSignalCode)
+{
+  if (aSignalCode==threadSignalUserSignal) {
+    pthread_mutex_lock(&writeMutex);
+    long failures = writeFailures;
+    string errMsg = lastWriteError;
+    writeFailures = 0;
+    WriteQueue failed;
+    failed.swap(failedWrites);
+    pthread_mutex_unlock(&writeMutex);
+    // let owners of failed snapshots know (owners that have gone away have been set to NULL by forgetWriteOwner())
+    for (WriteQueue::iterator pos = failed.begin(); pos!=failed.end(); ++pos) {
+      if ((*pos)->owner) writeBehindFailed(**pos);
+      delete *pos;
+    }
+    if (failures>0) {
+      ErrorPtr err = SQLite3Error::err(SQLITE_ERROR, errMsg.c_str(), string_format("%ld write-behind writes failed, last error: ", failures).c_str());
+      LOG(LOG_ERR, "SQLite3Persistence: %s\n", err->description().c_str());
+      if (writeErrorHandler) writeErrorHandler(err);
+    }
+  }
+  else if (aSignalCode==threadSignalFailedToStart) {
+    LOG(LOG_ERR, "SQLite3Persistence: write-behind thread failed to start, writing synchronously\n");
+    delete writer;
+    writer = NULL;
+    writerThread.reset();
+  }
+}
+
+
+
+#pragma mark - SQLite3RowSnapshot
+
+
+SQLite3RowSnapshot::SQLite3RowSnapshot(sqlite3pp::database &aDatabase, const string &aSql) :
+  inherited(aDatabase),
+  sql(aSql),
+  owner(NULL),
+  failed(false)
+{
+}
+
+
+SQLite3RowSnapshot::BoundValue &SQLite3RowSnapshot::valueAt(int aIdx)
+{
+  if (aIdx>(int)values.size()) {
+    BoundValue nullValue;
+    nullValue.type = SQLITE_NULL;
+    values.resize(aIdx, nullValue);
+  }
+  return values[aIdx-1];
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, int value)
+{
+  return bind(idx, (long long int)value);
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, double value)
+{
+  if (idx<1) return SQLITE_RANGE;
+  BoundValue &v = valueAt(idx);
+  v.type = SQLITE_FLOAT;
+  v.doubleValue = value;
+  return SQLITE_OK;
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, long long int value)
+{
+  if (idx<1) return SQLITE_RANGE;
+  BoundValue &v = valueAt(idx);
+  v.type = SQLITE_INTEGER;
+  v.intValue = value;
+  return SQLITE_OK;
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, char const* value, bool fstatic)
+{
+  if (idx<1) return SQLITE_RANGE;
+  BoundValue &v = valueAt(idx);
+  v.type = SQLITE_TEXT;
+  v.data = value; // always copied
+  return SQLITE_OK;
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, void const* value, int n, bool fstatic)
+{
+  if (idx<1) return SQLITE_RANGE;
+  BoundValue &v = valueAt(idx);
+  v.type = SQLITE_BLOB;
+  v.data.assign((const char *)value, n); // always copied
+  return SQLITE_OK;
+}
+
+
+int SQLite3RowSnapshot::bind(int idx)
+{
+  if (idx<1) return SQLITE_RANGE;
+  valueAt(idx).type = SQLITE_NULL;
+  return SQLITE_OK;
+}
+
+
+int SQLite3RowSnapshot::bind(int idx, sqlite3pp::null_type)
+{
+  return bind(idx);
+}
+
+
+size_t SQLite3RowSnapshot::dataSize() const
+{
+  size_t sz = 0;
+  for (BoundValueVector::const_iterator pos = values.begin(); pos!=values.end(); ++pos) {
+    switch (pos->type) {
+      case SQLITE_INTEGER:
+      case SQLITE_FLOAT: sz += 8; break;
+      case SQLITE_TEXT:
+      case SQLITE_BLOB: sz += pos->data.size(); break;
+      default: break;
+    }
+  }
+  return sz;
+}
+
+
+bool SQLite3RowSnapshot::sameValues(const SQLite3RowSnapshot &aOther) const
+{
+  if (values.size()!=aOther.values.size()) return false;
+  for (size_t i=0; i<values.size(); i++) {
+    const BoundValue &v = values[i];
+    const BoundValue &o = aOther.values[i];
+    if (v.type!=o.type) return false;
+    switch (v.type) {
+      case SQLITE_INTEGER: if (v.intValue!=o.intValue) return false; break;
+      case SQLITE_FLOAT: if (v.doubleValue!=o.doubleValue) return false; break;
+      case SQLITE_TEXT:
+      case SQLITE_BLOB: if (v.data!=o.data) return false; break;
+      default: break;
+    }
+  }
+  return true;
+}
+
+
+int SQLite3RowSnapshot::bindTo(sqlite3pp::statement &aStatement) const
+{
+  int rc = SQLITE_OK;
+  for (int i=0; i<(int)values.size() && rc==SQLITE_OK; i++) {
+    const BoundValue &v = values[i];
+    switch (v.type) {
+      case SQLITE_INTEGER: rc = aStatement.bind(i+1, v.intValue); break;
+      case SQLITE_FLOAT: rc = aStatement.bind(i+1, v.doubleValue); break;
+      case SQLITE_TEXT: rc = aStatement.bind(i+1, v.data.c_str(), true); break; // snapshot outlives execution
+      case SQLITE_BLOB: rc = aStatement.bind(i+1, (const void *)v.data.c_str(), (int)v.data.size(), true); break;
+      default: rc = aStatement.bind(i+1); break;
+    }
+  }
+  return rc;
+}
+
+
 
 string SQLite3Persistence::dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion)
 {
@@ -45,16 +45,117 @@ namespace p44 {
   };
 
 
+  /// Immutable snapshot of a single write statement: the SQL text plus copies of all values bound to its parameters.
+  /// Binding to a snapshot does not touch the database at all, so snapshots can be created on the main thread
+  /// and executed later by the write-behind thread (see SQLite3Persistence::queueWrite())
+  class SQLite3RowSnapshot : public sqlite3pp::statement
+  {
+    typedef sqlite3pp::statement inherited;
+    friend class SQLite3Persistence;
+
+    typedef struct {
+      int type; ///< SQLITE_NULL, SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT or SQLITE_BLOB
+      long long int intValue;
+      double doubleValue;
+      string data; ///< text or blob data
+    } BoundValue;
+    typedef vector<BoundValue> BoundValueVector;
+
+    string sql; ///< the SQL text with parameters
+    BoundValueVector values; ///< the values bound to the parameters, index 0 is parameter 1
+    void *owner; ///< opaque pointer to the object that must be notified when writing this snapshot fails, NULL if none
+    bool failed; ///< set by the writer thread when writing this snapshot failed
+
+    BoundValue &valueAt(int aIdx);
+
+  public:
+
+    /// create snapshot for a statement
+    /// @param aDatabase the database the snapshot will be executed on
+    /// @param aSql the SQL text of the statement, with parameters
+    SQLite3RowSnapshot(sqlite3pp::database &aDatabase, const string &aSql);
+
+    /// @return the SQL text
+    const string &getSql() const { return sql; };
+
+    /// set the owner to be notified (via SQLite3Persistence::writeBehindFailed()) when writing this snapshot fails
+    /// @param aOwner opaque pointer to the owner, NULL if none
+    void setOwner(void *aOwner) { owner = aOwner; };
+
+    /// @return the owner, NULL if none
+    void *getOwner() const { return owner; };
+
+    /// @return number of bytes of data bound (text/blob length, 8 for numbers)
+    size_t dataSize() const;
+
+    /// compare bound values
+    /// @param aOther another snapshot
+    /// @return true if both snapshots have the same values bound (SQL text is not compared)
+    bool sameValues(const SQLite3RowSnapshot &aOther) const;
+
+    // capturing binds
+    using inherited::bind;
+    virtual int bind(int idx, int value);
+    virtual int bind(int idx, double value);
+    virtual int bind(int idx, long long int value);
+    virtual int bind(int idx, char const* value, bool fstatic = true);
+    virtual int bind(int idx, void const* value, int n, bool fstatic = true);
+    virtual int bind(int idx);
+    virtual int bind(int idx, sqlite3pp::null_type);
+
+    /// bind the captured values to a prepared statement
+    /// @param aStatement a statement prepared from the same SQL text
+    /// @return SQLITE_OK or SQLite error code
+    int bindTo(sqlite3pp::statement &aStatement) const;
+  };
+
+
   class SQLite3Persistence : public sqlite3pp::database
   {
     typedef sqlite3pp::database inherited;
     bool initialized;
+    int transactionNesting; ///< number of currently open (nested) beginTransaction() calls
+    bool realTransaction; ///< set if the current transaction actually issued a BEGIN
+    string dbFileName; ///< the database file
+
+    // write-behind
+    typedef std::list<SQLite3RowSnapshot *> WriteQueue;
+    SQLite3Persistence *writer; ///< separate connection used by the write-behind thread, NULL if write-behind is not active
+    ChildThreadWrapperPtr writerThread; ///< the write-behind thread
+    pthread_mutex_t writeMutex; ///< protects the write queue and writer state
+    pthread_cond_t writeQueueCond; ///< signalled when writes are queued or writer must terminate
+    pthread_cond_t writeDoneCond; ///< signalled when the writer has completed a batch or terminated
+    WriteQueue writeQueue; ///< snapshots waiting to be written
+    WriteQueue currentBatch; ///< snapshots being written by the writer thread
+    WriteQueue failedWrites; ///< snapshots with an owner that failed to write, to be reported to the main thread
+    bool writerBusy; ///< set while the writer thread is executing a batch
+    bool writerTerminate; ///< set to request the writer thread to terminate
+    bool writerTerminated; ///< set by the writer thread when it has terminated
+    bool writerCacheInvalid; ///< set to make the writer clear its statement cache before the next batch
+    long writeFailures; ///< number of failed writes not yet reported to the main thread
+    string lastWriteError; ///< description of the last write failure
+    StatusCB writeErrorHandler; ///< called on the main thread when write-behind fails
+
+    typedef map<string, sqlite3pp::command *> CommandCache;
+    typedef map<string, sqlite3pp::query *> QueryCache;
+    CommandCache commandCache; ///< prepared commands by SQL text
+    QueryCache queryCache; ///< prepared queries by SQL text
   protected:
     /// Get DB Schema upgrade SQL statements
     /// @param aFromVersion current version (0=no database)
     /// @param aToVersion input: desired version, output: version that is generated by returned SQL
     /// @return SQL statements needed to get to aToVersion, empty string if no migration is possible
     virtual string dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion);
+
+    /// called on the main thread for every snapshot with an owner whose write-behind execution has failed
+    /// (including snapshots executed successfully in a batch whose COMMIT failed)
+    /// @param aSnapshot the snapshot that failed to write
+    virtual void writeBehindFailed(SQLite3RowSnapshot &aSnapshot) { /* NOP in base class */ };
+
+    /// called when the outermost transaction that actually issued a BEGIN has ended
+    /// @param aCommitted true if the transaction was committed, false if it was rolled back
+    virtual void transactionEnded(bool aCommitted) { /* NOP in base class */ };
+
   public:
     SQLite3Persistence();
     virtual ~SQLite3Persistence();
@@ -75,6 +176,91 @@ namespace p44 {
 
     /// disconnect and finalize
     void finalizeAndDisconnect();
+
+    /// begin a transaction
+    /// @return empty or Error object
+    /// @note calls can be nested, only the outermost beginTransaction()/commitTransaction() pair actually
+    ///   begins and commits the transaction. This allows wrapping many single-row updates (each of which
+    ///   would otherwise be a separate autocommit transaction, causing a sync to disk each) into one transaction.
+    ErrorPtr beginTransaction();
+
+    /// commit a transaction started with beginTransaction()
+    /// @return empty or Error object. If commit fails, the transaction is rolled back
+    ErrorPtr commitTransaction();
+
+    /// @return true if a transaction is open
+    bool inTransaction() { return transactionNesting>0; };
+
+    /// @return true if writes on this connection are currently part of a transaction not yet committed
+    ///   (i.e. they will be lost if committing fails)
+    bool transactionPending() { return realTransaction; };
+
+    /// get a prepared command from the statement cache, preparing it on first use
+    /// @param aSql the SQL text. Should not contain literal values, but parameters, such that the
+    ///   same prepared statement can be re-used with different values bound
+    /// @return prepared command, reset and ready for binding, or NULL if the command could not be prepared
+    /// @note the returned command is owned by the cache and must not be deleted by the caller.
+    ///   It remains valid until clearStatementCache() is called.
+    sqlite3pp::command *cachedCommand(const string &aSql);
+
+    /// get a prepared query from the statement cache, preparing it on first use
+    /// @param aSql the SQL text. Should not contain literal values, but parameters
+    /// @return prepared query, reset and ready for binding, or NULL if the query could not be prepared
+    /// @note the returned query is owned by the cache and must not be deleted by the caller.
+    ///   Callers should reset() it after use, so it does not keep the database locked.
+    sqlite3pp::query *cachedQuery(const string &aSql);
+
+    /// finalize and forget all cached statements
+    /// @note must be called after schema changes, as prepared statements are not automatically re-prepared
+    void clearStatementCache();
+
+
+    /// @name write-behind
+    /// @{
+
+    /// start write-behind thread
+    /// @return empty or Error object
+    /// @note switches the database to WAL mode, so the main thread can read while the write-behind thread writes.
+    ///   Writes queued with queueWrite() are executed in the order queued, in batched transactions.
+    ErrorPtr startWriteBehind();
+
+    /// stop write-behind thread, after all queued writes have been written
+    void stopWriteBehind();
+
+    /// @return true if write-behind thread is active
+    bool writeBehindActive() { return writer!=NULL; };
+
+    /// create a snapshot for a write statement
+    /// @param aSql the SQL text, with parameters
+    /// @return new snapshot, to be bound and then passed to queueWrite()
+    SQLite3RowSnapshot *newRowSnapshot(const string &aSql) { return new SQLite3RowSnapshot(*this, aSql); };
+
+    /// queue a write for the write-behind thread
+    /// @param aSnapshot the snapshot to write. Ownership passes to the write queue.
+    /// @note if write-behind is not active, the snapshot is executed immediately
+    /// @return empty or Error object (only for immediate execution - write-behind errors are reported via writeErrorHandler)
+    ErrorPtr queueWrite(SQLite3RowSnapshot *aSnapshot);
+
+    /// wait until all queued writes are written
+    /// @note must be called before synchronous writes or reads depending on queued writes
+    void flushWriteBehind();
+
+    /// set handler for write-behind errors
+    /// @param aWriteErrorHandler will be called on the main thread when queued writes have failed
+    void setWriteErrorHandler(StatusCB aWriteErrorHandler) { writeErrorHandler = aWriteErrorHandler; };
+
+    /// make sure no write-behind failure will be reported for an owner any more (because it is going away)
+    /// @param aOwner the owner as set with SQLite3RowSnapshot::setOwner()
+    void forgetWriteOwner(void *aOwner);
+
+    /// @}
+
+  private:
+
+    ErrorPtr executeSnapshot(SQLite3RowSnapshot *aSnapshot);
+    void writerThreadRoutine(ChildThreadWrapper &aThread);
+    void writerThreadSignal(ChildThreadWrapper &aChildThread, ThreadSignals aSignalCode);
+
   };
 
 }
@@ -0,0 +1,153 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "tracer.hpp"
+
+using namespace p44;
+
+p44::Tracer globalTracer;
+
+
+Tracer::Tracer() :
+  nextEvent(0),
+  numEvents(0),
+  lastId(0),
+  currentId(0)
+{
+}
+
+
+void Tracer::setBufferSize(size_t aMaxEvents)
+{
+  if (aMaxEvents>TRACE_MAX_EVENTS) aMaxEvents = TRACE_MAX_EVENTS;
+  ring.clear();
+  ring.resize(aMaxEvents);
+  nextEvent = 0;
+  numEvents = 0;
+}
+
+
+void Tracer::event(char aPhase, const char *aName, uint32_t aId, const char *aDetail)
+{
+  if (ring.empty()) return;
+  TraceEvent &e = ring[nextEvent];
+  e.timestamp = MainLoop::now();
+  e.name = aName;
+  e.id = aId;
+  e.phase = aPhase;
+  if (aDetail) {
+    strncpy(e.detail, aDetail, TRACE_DETAIL_LEN-1);
+    e.detail[TRACE_DETAIL_LEN-1] = 0;
+  }
+  else {
+    e.detail[0] = 0;
+  }
+  if (++nextEvent>=ring.size()) nextEvent = 0;
+  if (numEvents<ring.size()) numEvents++;
+}
+
+
+static void appendJsonString(string &aJson, const char *aStr)
+{
+  aJson += '"';
+  for (const char *p = aStr; *p; p++) {
+    char c = *p;
+    if (c=='"' || c=='\\') { aJson += '\\'; aJson += c; }
+    else if ((uint8_t)c<0x20) string_format_append(aJson, "\\u%04x", (int)c);
+    else aJson += c;
+  }
+  aJson += '"';
+}
+
+
+void Tracer::appendChromeTrace(string &aJson)
+{
+  aJson += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  // oldest event first
+  size_t i = numEvents<ring.size() ? 0 : nextEvent;
+  for (size_t n=0; n<numEvents; n++) {
+    const TraceEvent &e = ring[i];
+    if (n>0) aJson += ",\n";
+    aJson += "{\"name\":";
+    appendJsonString(aJson, e.name);
+    string_format_append(aJson, ",\"cat\":\"vdcd\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":1,\"id\":%u", e.phase, e.timestamp, e.id);
+    if (e.detail[0]) {
+      aJson += ",\"args\":{\"detail\":";
+      appendJsonString(aJson, e.detail);
+      aJson += "}";
+    }
+    aJson += "}";
+    if (++i>=ring.size()) i = 0;
+  }
+  aJson += "]}\n";
+}
+
+
+ErrorPtr Tracer::writeChromeTrace(const string &aPath)
+{
+  string json;
+  appendChromeTrace(json);
+  FILE *f = fopen(aPath.c_str(), "w");
+  if (!f) return SysError::errNo("cannot open trace file: ");
+  size_t written = fwrite(json.c_str(), 1, json.size(), f);
+  ErrorPtr err;
+  if (written!=json.size()) err = SysError::errNo("cannot write trace file: ");
+  fclose(f);
+  return err;
+}
+
+
+#pragma mark - trace scope helpers
+
+TraceIdScope::TraceIdScope(uint32_t aId)
+{
+  previousId = globalTracer.getCurrentId();
+  globalTracer.setCurrentId(aId);
+}
+
+
+TraceIdScope::~TraceIdScope()
+{
+  globalTracer.setCurrentId(previousId);
+}
+
+
+TraceScope::TraceScope(const char *aName, const string &aDetail) :
+  name(aName),
+  id(0)
+{
+  previousId = globalTracer.getCurrentId();
+  if (globalTracer.enabled()) {
+    // start new trace if none is running
+    id = previousId ? previousId : globalTracer.newId();
+    globalTracer.setCurrentId(id);
+    globalTracer.event('b', name, id, aDetail.c_str());
+  }
+}
+
+
+TraceScope::~TraceScope()
+{
+  if (id) {
+    globalTracer.event('e', name, id, NULL);
+    globalTracer.setCurrentId(previousId);
+  }
+}
@@ -0,0 +1,142 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of p44utils.
+//
+//  p44utils is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  p44utils is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with p44utils. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __p44utils__tracer__
+#define __p44utils__tracer__
+
+#include "p44_common.hpp"
+
+using namespace std;
+
+/// record a span covering the current C++ scope, attributed to the current trace id (a new one if none is set)
+/// @note aDetail is only evaluated when tracing is enabled
+#define TRACE_SCOPE(aName,aDetail) p44::TraceScope p44TraceScope_(aName, globalTracer.enabled() ? string(aDetail) : string())
+/// record an instant event for the current trace id
+#define TRACE_INSTANT(aName,aDetail) { if (globalTracer.enabled()) globalTracer.event('n', aName, globalTracer.getCurrentId(), string(aDetail).c_str()); }
+/// begin/end async span (which can end in another callback) for the given trace id
+#define TRACE_ASYNC_BEGIN(aName,aId,aDetail) { if (globalTracer.enabled()) globalTracer.event('b', aName, aId, string(aDetail).c_str()); }
+#define TRACE_ASYNC_END(aName,aId) { if (globalTracer.enabled()) globalTracer.event('e', aName, aId, NULL); }
+/// make aId the current trace id within the current C++ scope
+#define TRACE_ID_SCOPE(aId) p44::TraceIdScope p44TraceIdScope_(aId)
+
+namespace p44 {
+
+  /// max length of the detail text of a trace event
+  #define TRACE_DETAIL_LEN 48
+  /// max number of events in the ring buffer (one event takes around 70 bytes)
+  #define TRACE_MAX_EVENTS 200000
+
+  /// In-memory ring buffer of trace events, which can be written out in Chrome Trace Event format
+  /// (load into chrome://tracing or ui.perfetto.dev).
+  /// Events are grouped by a trace id, which usually represents one externally triggered operation
+  /// (such as a vDC API notification) and is followed through the code by keeping it as the
+  /// "current id" while processing the operation synchronously, and passing it explicitly to
+  /// asynchronous continuations.
+  /// @note tracing is disabled (and costs only a check of enabled()) until a buffer size is set.
+  /// @note not thread safe, must only be used from the mainloop thread.
+  class Tracer
+  {
+    struct TraceEvent {
+      MLMicroSeconds timestamp;
+      const char *name; ///< must be a static string
+      uint32_t id;
+      char phase; ///< Chrome trace phase: 'b'=async begin, 'e'=async end, 'n'=async instant
+      char detail[TRACE_DETAIL_LEN]; ///< NUL terminated
+    };
+    typedef vector<TraceEvent> TraceEventVector;
+    TraceEventVector ring; ///< ring buffer
+    size_t nextEvent; ///< index of next event to write in ring
+    size_t numEvents; ///< number of valid events in ring
+    uint32_t lastId; ///< last trace id generated
+    uint32_t currentId; ///< current trace id, 0 if none
+
+  public:
+
+    Tracer();
+
+    /// @return true if tracing is enabled
+    bool enabled() { return !ring.empty(); };
+
+    /// set size of the ring buffer
+    /// @param aMaxEvents max number of events to keep, 0 to disable tracing. Values above TRACE_MAX_EVENTS are limited to TRACE_MAX_EVENTS
+    /// @note clears all events recorded so far
+    void setBufferSize(size_t aMaxEvents);
+
+    /// @return size of the ring buffer (0 if disabled)
+    size_t bufferSize() { return ring.size(); };
+
+    /// @return number of events currently in the buffer
+    size_t eventCount() { return numEvents; };
+
+    /// @return a new, unique trace id
+    uint32_t newId() { if (++lastId==0) ++lastId; return lastId; };
+
+    /// @return current trace id, 0 if none
+    uint32_t getCurrentId() { return currentId; };
+
+    /// set current trace id
+    void setCurrentId(uint32_t aId) { currentId = aId; };
+
+    /// record an event
+    /// @param aPhase Chrome trace event phase
+    /// @param aName name of the event, must be a static string
+    /// @param aId trace id to attribute the event to
+    /// @param aDetail detail text, can be NULL. Will be truncated to TRACE_DETAIL_LEN-1
+    void event(char aPhase, const char *aName, uint32_t aId, const char *aDetail);
+
+    /// append buffer contents to a string as Chrome Trace Event JSON
+    /// @param aJson string to append JSON text to
+    void appendChromeTrace(string &aJson);
+
+    /// write buffer contents as Chrome Trace Event JSON file
+    /// @param aPath file path
+    /// @return ok or SysError
+    ErrorPtr writeChromeTrace(const string &aPath);
+
+  };
+
+
+  /// helper for TRACE_ID_SCOPE
+  class TraceIdScope
+  {
+    uint32_t previousId;
+  public:
+    TraceIdScope(uint32_t aId);
+    ~TraceIdScope();
+  };
+
+
+  /// helper for TRACE_SCOPE
+  class TraceScope
+  {
+    const char *name;
+    uint32_t id;
+    uint32_t previousId;
+  public:
+    TraceScope(const char *aName, const string &aDetail);
+    ~TraceScope();
+  };
+
+} // namespace p44
+
+extern p44::Tracer globalTracer;
+
+#endif /* defined(__p44utils__tracer__) */
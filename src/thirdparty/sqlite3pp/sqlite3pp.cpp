@@ -184,7 +184,7 @@ namespace sqlite3pp
   }
 
 
-  statement::statement(database& db, char const* stmt) : db_(db), stmt_(0), tail_(0)
+  statement::statement(database& db, char const* stmt) : db_(db), stmt_(0), tail_(0), bound_size_(0)
   {
     if (stmt) {
       int rc = prepare(stmt);
@@ -211,6 +211,7 @@ namespace sqlite3pp
 
   int statement::prepare_impl(char const* stmt)
   {
+    bound_size_ = 0;
     return sqlite3_prepare(db_.db_, stmt, strlen(stmt), &stmt_, &tail_);
   }
 
@@ -238,31 +239,38 @@ namespace sqlite3pp
 
   int statement::reset()
   {
+    bound_size_ = 0;
     return sqlite3_reset(stmt_);
   }
 
   int statement::bind(int idx, int value)
   {
+    bound_size_ += 8;
     return sqlite3_bind_int(stmt_, idx, value);
   }
 
   int statement::bind(int idx, double value)
   {
+    bound_size_ += 8;
     return sqlite3_bind_double(stmt_, idx, value);
   }
 
   int statement::bind(int idx, long long int value)
   {
+    bound_size_ += 8;
     return sqlite3_bind_int64(stmt_, idx, value);
   }
 
   int statement::bind(int idx, char const* value, bool fstatic)
   {
-    return sqlite3_bind_text(stmt_, idx, value, strlen(value), fstatic ? SQLITE_STATIC : SQLITE_TRANSIENT);
+    size_t n = strlen(value);
+    bound_size_ += n;
+    return sqlite3_bind_text(stmt_, idx, value, n, fstatic ? SQLITE_STATIC : SQLITE_TRANSIENT);
   }
 
   int statement::bind(int idx, void const* value, int n, bool fstatic)
   {
+    bound_size_ += n;
     return sqlite3_bind_blob(stmt_, idx, value, n, fstatic ? SQLITE_STATIC : SQLITE_TRANSIENT);
   }
 
@@ -368,42 +376,53 @@ namespace sqlite3pp
   {
   }
 
-  query::rows::rows(sqlite3_stmt* stmt) : stmt_(stmt)
+  query::rows::rows(sqlite3_stmt* stmt) : stmt_(stmt), values_(0)
+  {
+  }
+
+  query::rows::rows(value_row const* values) : stmt_(0), values_(values)
   {
   }
 
   int query::rows::data_count() const
   {
+    if (values_) return (int)values_->size();
     return sqlite3_data_count(stmt_);
   }
 
   int query::rows::column_type(int idx) const
   {
+    if (values_) return sqlite3_value_type((*values_)[idx]);
     return sqlite3_column_type(stmt_, idx);
   }
 
   int query::rows::column_bytes(int idx) const
   {
+    if (values_) return sqlite3_value_bytes((*values_)[idx]);
     return sqlite3_column_bytes(stmt_, idx);
   }
 
   int query::rows::get(int idx, int) const
   {
+    if (values_) return sqlite3_value_int((*values_)[idx]);
     return sqlite3_column_int(stmt_, idx);
   }
 
   double query::rows::get(int idx, double) const
   {
+    if (values_) return sqlite3_value_double((*values_)[idx]);
     return sqlite3_column_double(stmt_, idx);
   }
 
   long long int query::rows::get(int idx, long long int) const
   {
+    if (values_) return sqlite3_value_int64((*values_)[idx]);
     return sqlite3_column_int64(stmt_, idx);
   }
 
   char const* query::rows::get(int idx, char const*) const
   {
+    if (values_) return reinterpret_cast<char const*>(sqlite3_value_text((*values_)[idx]));
     return reinterpret_cast<char const*>(sqlite3_column_text(stmt_, idx));
   }
 
@@ -414,6 +433,7 @@ namespace sqlite3pp
 
   void const* query::rows::get(int idx, void const*) const
   {
+    if (values_) return sqlite3_value_blob((*values_)[idx]);
     return sqlite3_column_blob(stmt_, idx);
   }
 
@@ -427,19 +447,29 @@ namespace sqlite3pp
   }
 
 
-  query::query_iterator::query_iterator() : cmd_(0)
+  query::query_iterator::query_iterator() : cmd_(0), row_(0), lastrow_(0)
   {
     rc_ = SQLITE_DONE;
   }
 
-  query::query_iterator::query_iterator(query* cmd) : cmd_(cmd) {
+  query::query_iterator::query_iterator(query* cmd) : cmd_(cmd), row_(0), lastrow_(0) {
     rc_ = cmd_->step();
     if (rc_ != SQLITE_ROW && rc_ != SQLITE_DONE)
       throw database_error(cmd_->db_);
   }
 
+  query::query_iterator::query_iterator(value_row const* first, value_row const* last) : cmd_(0), row_(first), lastrow_(last)
+  {
+    rc_ = row_ != lastrow_ ? SQLITE_ROW : SQLITE_DONE;
+  }
+
   void query::query_iterator::increment()
   {
+    if (row_) {
+      ++row_;
+      rc_ = row_ != lastrow_ ? SQLITE_ROW : SQLITE_DONE;
+      return;
+    }
     rc_ = cmd_->step();
     if (rc_ != SQLITE_ROW && rc_ != SQLITE_DONE)
       throw database_error(cmd_->db_);
@@ -452,6 +482,7 @@ namespace sqlite3pp
 
   query::rows query::query_iterator::dereference() const
   {
+    if (row_) return rows(row_);
     return rows(cmd_->stmt_);
   }
 
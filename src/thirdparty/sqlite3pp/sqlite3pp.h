@@ -26,6 +26,7 @@
 #define SQLITE3PP_H
 
 #include <string>
+#include <vector>
 #include <stdexcept>
 #include <sqlite3.h>
 #include <boost/utility.hpp>
@@ -109,13 +110,14 @@ namespace sqlite3pp
     int prepare(char const* stmt);
     int finish();
 
-    int bind(int idx, int value);
-    int bind(int idx, double value);
-    int bind(int idx, long long int value);
-    int bind(int idx, char const* value, bool fstatic = true);
-    int bind(int idx, void const* value, int n, bool fstatic = true);
-    int bind(int idx);
-    int bind(int idx, null_type);
+    // Note: index based binds are virtual to allow capturing bound values (p44 SQLite3RowSnapshot)
+    virtual int bind(int idx, int value);
+    virtual int bind(int idx, double value);
+    virtual int bind(int idx, long long int value);
+    virtual int bind(int idx, char const* value, bool fstatic = true);
+    virtual int bind(int idx, void const* value, int n, bool fstatic = true);
+    virtual int bind(int idx);
+    virtual int bind(int idx, null_type);
 
     int bind(char const* name, int value);
     int bind(char const* name, double value);
@@ -128,6 +130,9 @@ namespace sqlite3pp
     int step();
     int reset();
 
+    // Note: number of data bytes bound since last reset (text/blob length, 8 for numbers), for p44 ParamStore write accounting
+    size_t bound_size() const { return bound_size_; }
+
    protected:
     explicit statement(database& db, char const* stmt = 0);
     virtual ~statement();
@@ -139,6 +144,7 @@ namespace sqlite3pp
     database& db_;
     sqlite3_stmt* stmt_;
     char const* tail_;
+    size_t bound_size_;
   };
 
   class command : public statement
@@ -175,6 +181,9 @@ namespace sqlite3pp
   class query : public statement
   {
    public:
+    // Note: a row of column values copied out of a result (sqlite3_value_dup), for p44 ParamStore preloading
+    typedef std::vector<sqlite3_value*> value_row;
+
     class rows
     {
      public:
@@ -196,6 +205,7 @@ namespace sqlite3pp
       };
 
       explicit rows(sqlite3_stmt* stmt);
+      explicit rows(value_row const* values);
 
       int data_count() const;
       int column_type(int idx) const;
@@ -259,6 +269,7 @@ namespace sqlite3pp
 
      private:
       sqlite3_stmt* stmt_;
+      value_row const* values_;
     };
 
     class query_iterator
@@ -267,6 +278,7 @@ namespace sqlite3pp
      public:
       query_iterator();
       explicit query_iterator(query* cmd);
+      query_iterator(value_row const* first, value_row const* last);
 
      private:
       friend class boost::iterator_core_access;
@@ -278,6 +290,8 @@ namespace sqlite3pp
 
       query* cmd_;
       int rc_;
+      value_row const* row_;
+      value_row const* lastrow_;
     };
 
     explicit query(database& db, char const* stmt = 0);
@@ -289,7 +303,8 @@ namespace sqlite3pp
 
     typedef query_iterator iterator;
 
-    iterator begin();
+    // Note: virtual to allow serving rows from memory (p44 ParamStore preloading)
+    virtual iterator begin();
     iterator end();
   };
 
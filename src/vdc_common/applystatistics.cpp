@@ -0,0 +1,188 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "applystatistics.hpp"
+
+using namespace p44;
+
+
+// upper limits of the latency histogram buckets (last bucket has no upper limit)
+static const MLMicroSeconds bucketLimits[APPLY_LATENCY_BUCKETS-1] = {
+  5*MilliSecond, 10*MilliSecond, 20*MilliSecond, 50*MilliSecond, 100*MilliSecond,
+  200*MilliSecond, 500*MilliSecond, 1*Second, 2*Second, 5*Second
+};
+
+
+ApplyStatistics::ApplyStatistics()
+{
+  reset();
+}
+
+
+void ApplyStatistics::reset()
+{
+  applies = 0;
+  superseded = 0;
+  suppressed = 0;
+  watchdogFirings = 0;
+  latencySum = 0;
+  maxLatency = 0;
+  for (int i=0; i<APPLY_LATENCY_BUCKETS; i++) latencyHistogram[i] = 0;
+  commits = 0;
+  lastCommitSkew = 0;
+  maxCommitSkew = 0;
+}
+
+
+void ApplyStatistics::record(ApplyStatEvent aEvent, MLMicroSeconds aLatency)
+{
+  switch (aEvent) {
+    case applystat_applied: {
+      applies++;
+      latencySum += aLatency;
+      if (aLatency>maxLatency) maxLatency = aLatency;
+      int b = 0;
+      while (b<APPLY_LATENCY_BUCKETS-1 && aLatency>=bucketLimits[b]) b++;
+      latencyHistogram[b]++;
+      break;
+    }
+    case applystat_superseded: superseded++; break;
+    case applystat_suppressed: suppressed++; break;
+    case applystat_watchdog: watchdogFirings++; break;
+  }
+}
+
+
+void ApplyStatistics::recordCommit(MLMicroSeconds aSkew)
+{
+  commits++;
+  lastCommitSkew = aSkew;
+  if (aSkew>maxCommitSkew) maxCommitSkew = aSkew;
+}
+
+
+#pragma mark - property access
+
+static char applystats_key;
+static char applystats_histogram_key;
+
+enum {
+  applies_key,
+  superseded_key,
+  suppressed_key,
+  watchdogFirings_key,
+  avgLatency_key,
+  maxLatency_key,
+  latencyHistogram_key,
+  commits_key,
+  lastCommitSkew_key,
+  maxCommitSkew_key,
+  reset_key,
+  numApplyStatsProperties
+};
+
+
+int ApplyStatistics::numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor)
+{
+  if (aParentDescriptor && aParentDescriptor->hasObjectKey(applystats_histogram_key)) {
+    return APPLY_LATENCY_BUCKETS;
+  }
+  return numApplyStatsProperties;
+}
+
+
+PropertyDescriptorPtr ApplyStatistics::getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor)
+{
+  static const PropertyDescription properties[numApplyStatsProperties] = {
+    { "applies", apivalue_uint64, applies_key, OKEY(applystats_key) },
+    { "superseded", apivalue_uint64, superseded_key, OKEY(applystats_key) },
+    { "suppressed", apivalue_uint64, suppressed_key, OKEY(applystats_key) },
+    { "watchdogFirings", apivalue_uint64, watchdogFirings_key, OKEY(applystats_key) },
+    { "avgLatencyMS", apivalue_double, avgLatency_key, OKEY(applystats_key) },
+    { "maxLatencyMS", apivalue_double, maxLatency_key, OKEY(applystats_key) },
+    { "latencyHistogram", apivalue_object+propflag_container, latencyHistogram_key, OKEY(applystats_histogram_key) },
+    { "commits", apivalue_uint64, commits_key, OKEY(applystats_key) },
+    { "lastCommitSkewMS", apivalue_double, lastCommitSkew_key, OKEY(applystats_key) },
+    { "maxCommitSkewMS", apivalue_double, maxCommitSkew_key, OKEY(applystats_key) },
+    { "reset", apivalue_bool, reset_key, OKEY(applystats_key) }
+  };
+  // histogram buckets, named by their upper limit
+  static const PropertyDescription histogramProperties[APPLY_LATENCY_BUCKETS] = {
+    { "lt5ms", apivalue_uint64, 0, OKEY(applystats_histogram_key) },
+    { "lt10ms", apivalue_uint64, 1, OKEY(applystats_histogram_key) },
+    { "lt20ms", apivalue_uint64, 2, OKEY(applystats_histogram_key) },
+    { "lt50ms", apivalue_uint64, 3, OKEY(applystats_histogram_key) },
+    { "lt100ms", apivalue_uint64, 4, OKEY(applystats_histogram_key) },
+    { "lt200ms", apivalue_uint64, 5, OKEY(applystats_histogram_key) },
+    { "lt500ms", apivalue_uint64, 6, OKEY(applystats_histogram_key) },
+    { "lt1s", apivalue_uint64, 7, OKEY(applystats_histogram_key) },
+    { "lt2s", apivalue_uint64, 8, OKEY(applystats_histogram_key) },
+    { "lt5s", apivalue_uint64, 9, OKEY(applystats_histogram_key) },
+    { "ge5s", apivalue_uint64, 10, OKEY(applystats_histogram_key) }
+  };
+  if (aParentDescriptor && aParentDescriptor->hasObjectKey(applystats_histogram_key)) {
+    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&histogramProperties[aPropIndex], aParentDescriptor));
+  }
+  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+}
+
+
+PropertyContainerPtr ApplyStatistics::getContainer(PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain)
+{
+  if (aPropertyDescriptor->isArrayContainer()) {
+    // histogram
+    return PropertyContainerPtr(this); // handle myself
+  }
+  return NULL;
+}
+
+
+bool ApplyStatistics::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor)
+{
+  if (aPropertyDescriptor->hasObjectKey(applystats_key)) {
+    if (aMode==access_read) {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case applies_key: aPropValue->setUint64Value(applies); return true;
+        case superseded_key: aPropValue->setUint64Value(superseded); return true;
+        case suppressed_key: aPropValue->setUint64Value(suppressed); return true;
+        case watchdogFirings_key: aPropValue->setUint64Value(watchdogFirings); return true;
+        case avgLatency_key: aPropValue->setDoubleValue(applies>0 ? (double)latencySum/applies/MilliSecond : 0); return true;
+        case maxLatency_key: aPropValue->setDoubleValue((double)maxLatency/MilliSecond); return true;
+        case commits_key: aPropValue->setUint64Value(commits); return true;
+        case lastCommitSkew_key: aPropValue->setDoubleValue((double)lastCommitSkew/MilliSecond); return true;
+        case maxCommitSkew_key: aPropValue->setDoubleValue((double)maxCommitSkew/MilliSecond); return true;
+        case reset_key: aPropValue->setBoolValue(false); return true;
+      }
+    }
+    else {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case reset_key: if (aPropValue->boolValue()) reset(); return true;
+      }
+    }
+  }
+  else if (aPropertyDescriptor->hasObjectKey(applystats_histogram_key)) {
+    if (aMode==access_read) {
+      aPropValue->setUint64Value(latencyHistogram[aPropertyDescriptor->fieldKey()]);
+      return true;
+    }
+  }
+  return inherited::accessField(aMode, aPropValue, aPropertyDescriptor);
+}
@@ -0,0 +1,91 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __vdcd__applystatistics__
+#define __vdcd__applystatistics__
+
+#include "propertycontainer.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  /// events counted by ApplyStatistics
+  typedef enum {
+    applystat_applied, ///< applying channel values to hardware has completed
+    applystat_superseded, ///< a pending apply request was superseded by a newer one before it was applied
+    applystat_suppressed, ///< an apply request was not executed because the hardware already shows the requested values
+    applystat_watchdog, ///< serializer watchdog had to force-end a hardware request
+  } ApplyStatEvent;
+
+  /// number of latency histogram buckets
+  #define APPLY_LATENCY_BUCKETS 11
+
+  class ApplyStatistics;
+  typedef boost::intrusive_ptr<ApplyStatistics> ApplyStatisticsPtr;
+
+  /// Statistics about applying channel values to hardware.
+  /// Every DsAddressable has one: devices count their own applies, vDCs and the vDC host the applies of
+  /// all their devices. Exposed as the "x-p44-applyStats" property, to help finding slow buses/devices.
+  class ApplyStatistics : public PropertyContainer
+  {
+    typedef PropertyContainer inherited;
+
+    uint32_t applies; ///< number of completed applies
+    uint32_t superseded; ///< number of superseded apply requests
+    uint32_t suppressed; ///< number of apply requests suppressed because they would not change the hardware
+    uint32_t watchdogFirings; ///< number of serializer watchdog timeouts
+    MLMicroSeconds latencySum; ///< sum of all apply latencies (for average)
+    MLMicroSeconds maxLatency; ///< max apply latency seen
+    uint32_t latencyHistogram[APPLY_LATENCY_BUCKETS]; ///< apply counts per latency range
+    uint32_t commits; ///< number of synchronized multi-device commits
+    MLMicroSeconds lastCommitSkew; ///< skew (first to last device applied) of the most recent commit
+    MLMicroSeconds maxCommitSkew; ///< max commit skew seen
+
+  public:
+
+    ApplyStatistics();
+
+    /// record an event
+    /// @param aEvent what happened
+    /// @param aLatency for applystat_applied: time the apply took
+    void record(ApplyStatEvent aEvent, MLMicroSeconds aLatency = 0);
+
+    /// record a synchronized commit of preloaded channel values to a set of devices
+    /// @param aSkew time between the first and the last device of the set completing its apply
+    void recordCommit(MLMicroSeconds aSkew);
+
+    /// reset all counters
+    void reset();
+
+  protected:
+
+    // property access implementation
+    virtual int numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor);
+    virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor);
+    virtual PropertyContainerPtr getContainer(PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain);
+    virtual bool accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor);
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__vdcd__applystatistics__) */
@@ -29,13 +29,15 @@ using namespace p44;
 
 ChannelBehaviour::ChannelBehaviour(OutputBehaviour &aOutput) :
   output(aOutput),
+  resolution(1), // dummy default resolution (derived classes must provide sensible defaults)
   channelUpdatePending(false), // no output update pending
-  nextTransitionTime(0), // none
-  channelLastSync(Never), // we don't known nor have we sent the output state
   cachedChannelValue(0), // channel output value cache
   previousChannelValue(0), // previous output value
   transitionProgress(1), // no transition in progress
-  resolution(1) // dummy default resolution (derived classes must provide sensible defaults)
+  channelLastSync(Never), // we don't known nor have we sent the output state
+  nextTransitionTime(0), // none
+  appliedHardwareLevel(HARDWARE_LEVEL_UNKNOWN), // we don't know what the hardware shows
+  sentHardwareLevel(HARDWARE_LEVEL_UNKNOWN) // nothing being sent
 {
 }
 
@@ -163,10 +165,27 @@ void ChannelBehaviour::syncChannelValue(double aActualChannelValue, bool aAlways
     transitionProgress = 1; // not in transition
     channelUpdatePending = false; // we are in sync
     channelLastSync = MainLoop::now(); // value is current
+    appliedHardwareLevel = HARDWARE_LEVEL_UNKNOWN; // hardware might have been changed from outside
+    output.channelStateChanged();
   }
 }
 
 
+void ChannelBehaviour::restoreChannelValue(double aChannelValue)
+{
+  // make sure value is within bounds
+  if (aChannelValue>getMax())
+    aChannelValue = getMax();
+  else if (aChannelValue<getMin())
+    aChannelValue = getMin();
+  cachedChannelValue = aChannelValue;
+  previousChannelValue = aChannelValue;
+  transitionProgress = 1; // not in transition
+  channelUpdatePending = false; // nothing to apply
+  // Note: channelLastSync remains Never, value is not yet confirmed by hardware
+}
+
+
 
 void ChannelBehaviour::setChannelValue(double aNewValue, MLMicroSeconds aTransitionTimeUp, MLMicroSeconds aTransitionTimeDown, bool aAlwaysApply)
 {
@@ -248,6 +267,7 @@ void ChannelBehaviour::channelValueApplied(bool aAnyWay)
   if (channelUpdatePending || aAnyWay) {
     channelUpdatePending = false; // applied (might still be in transition, though)
     channelLastSync = MainLoop::now(); // now we know that we are in sync
+    output.channelStateChanged();
     if (!aAnyWay) {
       // only log when actually of importance (to prevent messages for devices that apply mostly immediately)
       if (LOGENABLED(LOG_INFO)) {
@@ -70,6 +70,8 @@ namespace p44 {
     double transitionProgress; ///< how much the transition has progressed so far (0..1)
     MLMicroSeconds channelLastSync; ///< Never if the cachedChannelValue is not yet applied to the hardware or retrieved from hardware, otherwise when it was last synchronized
     MLMicroSeconds nextTransitionTime; ///< the transition time to use for the next channel value change
+    long appliedHardwareLevel; ///< quantized hardware level the hardware is known to show, HARDWARE_LEVEL_UNKNOWN if not known
+    long sentHardwareLevel; ///< quantized hardware level being sent by the running apply, HARDWARE_LEVEL_UNKNOWN if none
     /// @}
 
   public:
@@ -106,6 +108,12 @@ namespace p44 {
     ///   NOT to be used to change the hardware output value!
     void syncChannelValue(double aActualChannelValue, bool aAlwaysSync=false);
 
+    /// restore channel value as persisted in a previous run
+    /// @param aChannelValue the value last known to be applied to or synced from the hardware
+    /// @note the value is not considered synchronized with the hardware, the hardware still needs to be queried
+    ///   (if possible) to confirm it
+    void restoreChannelValue(double aChannelValue);
+
     /// set new channel value and transition time to be applied with next device-level applyChannelValues()
     /// @param aValue the new output value
     /// @param aTransitionTime time in microseconds to be spent on transition from current to new channel value
@@ -178,6 +186,20 @@ namespace p44 {
     /// @param aAnyWay if true, lastSent state will be set even if channel was not in needsApplying() state
     void channelValueApplied(bool aAnyWay = false);
 
+    /// @return quantized hardware level the hardware is known to show, HARDWARE_LEVEL_UNKNOWN if not known
+    long getAppliedHardwareLevel() { return appliedHardwareLevel; };
+
+    /// remember the quantized hardware level the hardware shows
+    /// @param aLevel the level as returned by Device::channelHardwareLevel(), HARDWARE_LEVEL_UNKNOWN to forget
+    void setAppliedHardwareLevel(long aLevel) { appliedHardwareLevel = aLevel; };
+
+    /// @return quantized hardware level being sent by the running apply, HARDWARE_LEVEL_UNKNOWN if none
+    long getSentHardwareLevel() { return sentHardwareLevel; };
+
+    /// remember the quantized hardware level being sent to the hardware (becomes the applied level once the apply has completed)
+    /// @param aLevel the level as returned by Device::channelHardwareLevel(), HARDWARE_LEVEL_UNKNOWN if none
+    void setSentHardwareLevel(long aLevel) { sentHardwareLevel = aLevel; };
+
     /// @}
 
 
@@ -35,6 +35,8 @@
 #include "outputbehaviour.hpp"
 #include "sensorbehaviour.hpp"
 
+#include "tracer.hpp"
+
 using namespace p44;
 
 
@@ -42,19 +44,25 @@ using namespace p44;
 
 
 Device::Device(DeviceClassContainer *aClassContainerP) :
+  DsAddressable(&aClassContainerP->getDeviceContainer()),
+  classContainerP(aClassContainerP),
   progMode(false),
-  isDimming(false),
-  dimHandlerTicket(0),
+  primaryGroup(group_black_joker),
   dimTimeoutTicket(0),
   currentDimMode(dimmode_stop),
   currentDimChannel(channeltype_default),
-  classContainerP(aClassContainerP),
-  DsAddressable(&aClassContainerP->getDeviceContainer()),
-  primaryGroup(group_black_joker),
+  dimHandlerTicket(0),
+  isDimming(false),
+  dimStepInterval(0),
   applyInProgress(false),
   missedApplyAttempts(0),
   updateInProgress(false),
-  serializerWatchdogTicket(0)
+  serializerWatchdogTicket(0),
+  applyStartedAt(Never),
+  applyLatency(0),
+  applyTraceId(0),
+  appliedHardwareMode(HARDWARE_LEVEL_UNKNOWN),
+  sentHardwareMode(HARDWARE_LEVEL_UNKNOWN)
 {
 }
 
@@ -154,6 +162,12 @@ DsGroup Device::getDominantGroup()
 }
 
 
+int Device::getZoneID()
+{
+  return deviceSettings ? deviceSettings->zoneID : 0;
+}
+
+
 bool Device::getDeviceIcon(string &aIcon, bool aWithData, const char *aResolutionPrefix)
 {
   if (getGroupColoredIcon("vdsd", getDominantGroup(), aIcon, aWithData, aResolutionPrefix))
@@ -173,6 +187,8 @@ void Device::installSettings(DeviceSettingsPtr aDeviceSettings)
     // use standard settings
     deviceSettings = DeviceSettingsPtr(new DeviceSettings(*this));
   }
+  // cache scene table access
+  sceneSettings = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
 }
 
 
@@ -262,7 +278,7 @@ Tristate Device::hasModelFeature(DsModelFeatures aFeatureIndex)
   switch (aFeatureIndex) {
     case modelFeature_dontcare:
       // Generic: all devices with scene table have the ability to set scene's don't care flag
-      return boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings)!=NULL ? yes : no;
+      return sceneSettings!=NULL ? yes : no;
     case modelFeature_ledauto:
     case modelFeature_leddark:
       // Virtual devices do not have the standard dS LED at all
@@ -394,151 +410,159 @@ ErrorPtr Device::handleMethod(VdcApiRequestPtr aRequest, const string &aMethod,
 #define LEGACY_DIM_STEP_TIMEOUT (400*MilliSecond)
 
 
-void Device::handleNotification(const string &aMethod, ApiValuePtr aParams)
+#pragma mark - device level notifications
+
+
+DeviceNotification::DeviceNotification(const string &aMethod, ApiValuePtr aParams) :
+  method(aMethod),
+  params(aParams),
+  kind(notify_other),
+  sceneNo(0),
+  force(false),
+  channel(channeltype_default),
+  dimMode(dimmode_stop),
+  area(0),
+  value(0),
+  applyNow(true)
 {
-  ErrorPtr err;
-  if (aMethod=="callScene") {
-    // call scene
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "scene", o))) {
-      SceneNo sceneNo = (SceneNo)o->int32Value();
-      bool force = false;
+  ApiValuePtr o;
+  if (method=="callScene") {
+    kind = notify_callScene;
+    if (Error::isOK(err = DsAddressable::checkParam(params, "scene", o))) {
+      sceneNo = (SceneNo)o->int32Value();
       // check for force flag
-      if (Error::isOK(err = checkParam(aParams, "force", o))) {
+      if (Error::isOK(err = DsAddressable::checkParam(params, "force", o))) {
         force = o->boolValue();
-        // now call
-        callScene(sceneNo, force);
       }
     }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "callScene error: %s\n", err->description().c_str());
-    }
-  }
-  else if (aMethod=="saveScene") {
-    // save scene
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "scene", o))) {
-      SceneNo sceneNo = (SceneNo)o->int32Value();
-      // now save
-      saveScene(sceneNo);
-    }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "saveScene error: %s\n", err->description().c_str());
-    }
   }
-  else if (aMethod=="undoScene") {
-    // save scene
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "scene", o))) {
-      SceneNo sceneNo = (SceneNo)o->int32Value();
-      // now save
-      undoScene(sceneNo);
-    }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "undoScene error: %s\n", err->description().c_str());
+  else if (method=="saveScene" || method=="undoScene" || method=="setLocalPriority" || method=="callSceneMin") {
+    if (method=="saveScene") kind = notify_saveScene;
+    else if (method=="undoScene") kind = notify_undoScene;
+    else if (method=="setLocalPriority") kind = notify_setLocalPriority;
+    else kind = notify_callSceneMin;
+    if (Error::isOK(err = DsAddressable::checkParam(params, "scene", o))) {
+      sceneNo = (SceneNo)o->int32Value();
     }
   }
-  else if (aMethod=="setLocalPriority") {
-    // set local priority
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "scene", o))) {
-      SceneNo sceneNo = (SceneNo)o->int32Value();
-      // now save
-      setLocalPriority(sceneNo);
-    }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "setLocalPriority error: %s\n", err->description().c_str());
-    }
-  }
-  else if (aMethod=="setControlValue") {
-    // set control value
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "name", o))) {
-      string controlValueName = o->stringValue();
-      if (Error::isOK(err = checkParam(aParams, "value", o))) {
-        // get value
-        double value = o->doubleValue();
-        // now process the value (updates channel values, but does not yet apply them)
-        LOG(LOG_NOTICE, "processControlValue(%s, %f) in device %s:\n", controlValueName.c_str(), value, shortDesc().c_str());
-        processControlValue(controlValueName, value);
-        // apply the values
-        requestApplyingChannels(NULL, false);
+  else if (method=="setControlValue") {
+    kind = notify_setControlValue;
+    if (Error::isOK(err = DsAddressable::checkParam(params, "name", o))) {
+      name = o->stringValue();
+      if (Error::isOK(err = DsAddressable::checkParam(params, "value", o))) {
+        value = o->doubleValue();
       }
     }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "setControlValue error: %s\n", err->description().c_str());
-    }
-  }
-  else if (aMethod=="callSceneMin") {
-    // switch device on with minimum output level if not already on (=prepare device for dimming from zero)
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "scene", o))) {
-      SceneNo sceneNo = (SceneNo)o->int32Value();
-      // now call
-      callSceneMin(sceneNo);
-    }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "callSceneMin error: %s\n", err->description().c_str());
-    }
   }
-  else if (aMethod=="dimChannel") {
-    // start or stop dimming a channel
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "channel", o))) {
-      DsChannelType channel = (DsChannelType)o->int32Value();
-      if (Error::isOK(err = checkParam(aParams, "mode", o))) {
+  else if (method=="dimChannel") {
+    kind = notify_dimChannel;
+    if (Error::isOK(err = DsAddressable::checkParam(params, "channel", o))) {
+      channel = (DsChannelType)o->int32Value();
+      if (Error::isOK(err = DsAddressable::checkParam(params, "mode", o))) {
         int mode = o->int32Value();
-        int area = 0;
-        o = aParams->get("area");
+        dimMode = mode==0 ? dimmode_stop : (mode<0 ? dimmode_down : dimmode_up);
+        o = params->get("area");
         if (o) {
           area = o->int32Value();
         }
-        // start/stop dimming
-        dimChannelForArea(channel,mode==0 ? dimmode_stop : (mode<0 ? dimmode_down : dimmode_up), area, MOC_DIM_STEP_TIMEOUT);
       }
     }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "callSceneMin error: %s\n", err->description().c_str());
-    }
   }
-  else if (aMethod=="setOutputChannelValue") {
-    // set output channel value (alias for setProperty outputStates)
-    ApiValuePtr o;
-    if (Error::isOK(err = checkParam(aParams, "channel", o))) {
-      DsChannelType channel = (DsChannelType)o->int32Value();
-      if (Error::isOK(err = checkParam(aParams, "value", o))) {
-        double value = o->doubleValue();
+  else if (method=="setOutputChannelValue") {
+    kind = notify_setOutputChannelValue;
+    if (Error::isOK(err = DsAddressable::checkParam(params, "channel", o))) {
+      channel = (DsChannelType)o->int32Value();
+      if (Error::isOK(err = DsAddressable::checkParam(params, "value", o))) {
+        value = o->doubleValue();
         // check optional apply_now flag
-        bool apply_now = true; // non-buffered write by default
-        o = aParams->get("apply_now");
+        o = params->get("apply_now");
         if (o) {
-          apply_now = o->boolValue();
+          applyNow = o->boolValue(); // non-buffered write by default
         }
-        // reverse build the correctly structured property value: { channelStates: { <channel>: { value:<value> } } }
-        // - value
-        o = aParams->newObject();
-        o->add("value", o->newDouble(value));
-        // - channel id
-        ApiValuePtr ch = o->newObject();
-        ch->add(string_format("%d",channel), o);
-        // - channelStates
-        ApiValuePtr propValue = ch->newObject();
-        propValue->add("channelStates", ch);
-        // now access the property
-        err = accessProperty(apply_now ? access_write : access_write_preload, propValue, ApiValuePtr(), VDC_API_DOMAIN, PropertyDescriptorPtr());
       }
     }
-    if (!Error::isOK(err)) {
-      LOG(LOG_WARNING, "setOutputChannelValue error: %s\n", err->description().c_str());
-    }
   }
-  else if (aMethod=="identify") {
-    // identify to user
-    LOG(LOG_NOTICE, "Identify in device %s:\n", shortDesc().c_str());
-    identifyToUser();
+  else if (method=="identify") {
+    kind = notify_identify;
   }
-  else {
-    inherited::handleNotification(aMethod, aParams);
+  else if (method=="x-p44-commitPreloaded") {
+    kind = notify_commitPreloaded;
+  }
+}
+
+
+void Device::handleNotification(const string &aMethod, ApiValuePtr aParams)
+{
+  DeviceNotification notification(aMethod, aParams);
+  handleDeviceNotification(notification);
+}
+
+
+void Device::handleDeviceNotification(DeviceNotification &aNotification)
+{
+  if (!Error::isOK(aNotification.err)) {
+    LOG(LOG_WARNING, "%s error: %s\n", aNotification.method.c_str(), aNotification.err->description().c_str());
+    return;
+  }
+  switch (aNotification.kind) {
+    case DeviceNotification::notify_callScene:
+      callScene(aNotification.sceneNo, aNotification.force);
+      break;
+    case DeviceNotification::notify_saveScene:
+      saveScene(aNotification.sceneNo);
+      break;
+    case DeviceNotification::notify_undoScene:
+      undoScene(aNotification.sceneNo);
+      break;
+    case DeviceNotification::notify_setLocalPriority:
+      setLocalPriority(aNotification.sceneNo);
+      break;
+    case DeviceNotification::notify_setControlValue:
+      // process the value (updates channel values, but does not yet apply them)
+      LOG(LOG_NOTICE, "processControlValue(%s, %f) in device %s:\n", aNotification.name.c_str(), aNotification.value, shortDesc().c_str());
+      processControlValue(aNotification.name, aNotification.value);
+      // apply the values
+      requestApplyingChannels(NULL, false);
+      break;
+    case DeviceNotification::notify_callSceneMin:
+      // switch device on with minimum output level if not already on (=prepare device for dimming from zero)
+      callSceneMin(aNotification.sceneNo);
+      break;
+    case DeviceNotification::notify_dimChannel:
+      // start/stop dimming
+      dimChannelForArea(aNotification.channel, aNotification.dimMode, aNotification.area, MOC_DIM_STEP_TIMEOUT);
+      break;
+    case DeviceNotification::notify_setOutputChannelValue: {
+      // set output channel value (alias for setProperty outputStates)
+      // reverse build the correctly structured property value: { channelStates: { <channel>: { value:<value> } } }
+      // - value
+      ApiValuePtr o = aNotification.params->newObject();
+      o->add("value", o->newDouble(aNotification.value));
+      // - channel id
+      ApiValuePtr ch = o->newObject();
+      ch->add(string_format("%d",aNotification.channel), o);
+      // - channelStates
+      ApiValuePtr propValue = ch->newObject();
+      propValue->add("channelStates", ch);
+      // now access the property
+      ErrorPtr err = accessProperty(aNotification.applyNow ? access_write : access_write_preload, propValue, ApiValuePtr(), VDC_API_DOMAIN, PropertyDescriptorPtr());
+      if (!Error::isOK(err)) {
+        LOG(LOG_WARNING, "setOutputChannelValue error: %s\n", err->description().c_str());
+      }
+      break;
+    }
+    case DeviceNotification::notify_identify:
+      // identify to user
+      LOG(LOG_NOTICE, "Identify in device %s:\n", shortDesc().c_str());
+      identifyToUser();
+      break;
+    case DeviceNotification::notify_commitPreloaded:
+      // apply preloaded channel values
+      requestApplyingChannels(NULL, false);
+      break;
+    default:
+      inherited::handleNotification(aNotification.method, aNotification.params);
+      break;
   }
 }
 
@@ -606,11 +630,11 @@ void Device::dimChannelForArea(DsChannelType aChannel, DsDimMode aDimMode, int a
   }
   // check area if any
   if (aArea>0) {
-    SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+    SceneDeviceSettingsPtr scenes = getScenes();
     if (scenes) {
       // check area first
       SceneNo areaScene = mainSceneForArea(aArea);
-      DsScenePtr scene = scenes->getScene(areaScene);
+      DsScenePtr scene = scenes->getSceneForCall(areaScene);
       if (scene->isDontCare()) {
         LOG(LOG_DEBUG, "- area main scene(%d) is dontCare -> suppress dimChannel for Area %d\n", areaScene, aArea);
         return; // not in this area, suppress dimming
@@ -675,9 +699,6 @@ void Device::dimAutostopHandler(DsChannelType aChannel)
 
 
 
-#define DIM_STEP_INTERVAL_MS 300.0
-#define DIM_STEP_INTERVAL (DIM_STEP_INTERVAL_MS*MilliSecond)
-
 // actual dimming implementation, usually overridden by subclasses to provide more optimized/precise dimming
 void Device::dimChannel(DsChannelType aChannelType, DsDimMode aDimMode)
 {
@@ -695,40 +716,54 @@ void Device::dimChannel(DsChannelType aChannelType, DsDimMode aDimMode)
       // make sure the start point is calculated if needed
       ch->getChannelValueCalculated();
       ch->setNeedsApplying(0); // force re-applying start point, no transition time
-      // calculate increment
-      double increment = (aDimMode==dimmode_up ? DIM_STEP_INTERVAL_MS : -DIM_STEP_INTERVAL_MS) * ch->getDimPerMS();
+      // dim rate, actual increment per step depends on the step interval
+      double dimPerMS = aDimMode==dimmode_up ? ch->getDimPerMS() : -ch->getDimPerMS();
+      dimStepInterval = adaptedDimStepInterval();
       // start ticking
       isDimming = true;
       // wait for all apply operations to really complete before starting to dim
-      SimpleCB dd = boost::bind(&Device::dimDoneHandler, this, ch, increment, MainLoop::now()+10*MilliSecond);
+      SimpleCB dd = boost::bind(&Device::dimDoneHandler, this, ch, dimPerMS, MainLoop::now()+10*MilliSecond);
       waitForApplyComplete(boost::bind(&Device::requestApplyingChannels, this, dd, false, false));
     }
   }
 }
 
 
-void Device::dimHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNow)
+MLMicroSeconds Device::adaptedDimStepInterval()
+{
+  // step as fast as the hardware can apply values, within the limits of the device class
+  return dimStepIntervalFor(applyLatency, classContainerP->minDimStepInterval(), classContainerP->maxDimStepInterval());
+}
+
+
+void Device::dimHandler(ChannelBehaviourPtr aChannel, double aDimPerMS, MLMicroSeconds aNow)
 {
   // increment channel value
-  aChannel->dimChannelValue(aIncrement, DIM_STEP_INTERVAL);
+  aChannel->dimChannelValue(aDimPerMS*dimStepInterval/MilliSecond, dimStepInterval);
   // apply to hardware
-  requestApplyingChannels(boost::bind(&Device::dimDoneHandler, this, aChannel, aIncrement, aNow+DIM_STEP_INTERVAL), true); // apply in dimming mode
+  requestApplyingChannels(boost::bind(&Device::dimDoneHandler, this, aChannel, aDimPerMS, aNow+dimStepInterval), true); // apply in dimming mode
 }
 
 
-void Device::dimDoneHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNextDimAt)
+void Device::dimDoneHandler(ChannelBehaviourPtr aChannel, double aDimPerMS, MLMicroSeconds aNextDimAt)
 {
   // keep up with actual dim time
   MLMicroSeconds now = MainLoop::now();
   while (aNextDimAt<now) {
     // missed this step - simply increment channel and target time, but do not cause re-apply
     LOG(LOG_DEBUG, "dimChannel: applyChannelValues() was too slow while dimming channel=%d -> skipping next dim step\n", aChannel->getChannelType());
-    aChannel->dimChannelValue(aIncrement, DIM_STEP_INTERVAL);
-    aNextDimAt += DIM_STEP_INTERVAL;
+    aChannel->dimChannelValue(aDimPerMS*dimStepInterval/MilliSecond, dimStepInterval);
+    aNextDimAt += dimStepInterval;
   }
   if (isDimming) {
+    // adapt step interval (and thus step size) to latest apply latency
+    MLMicroSeconds interval = adaptedDimStepInterval();
+    if (interval!=dimStepInterval) {
+      LOG(LOG_DEBUG, "dimChannel: apply latency %lld mS -> dim step interval now %lld mS\n", applyLatency/MilliSecond, interval/MilliSecond);
+      dimStepInterval = interval;
+    }
     // now schedule next inc/update step
-    dimHandlerTicket = MainLoop::currentMainLoop().executeOnceAt(boost::bind(&Device::dimHandler, this, aChannel, aIncrement, _1), aNextDimAt);
+    dimHandlerTicket = MainLoop::currentMainLoop().executeOnceAt(boost::bind(&Device::dimHandler, this, aChannel, aDimPerMS, _1), aNextDimAt);
   }
 }
 
@@ -746,6 +781,18 @@ void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForD
     // - just call back immediately
     if (aAppliedOrSupersededCB) aAppliedOrSupersededCB();
   }
+  if (!aModeChange && !updateInProgress && !applyWouldChangeHardware()) {
+    // pending values would not change the hardware output -> no need to bother the hardware
+    FOCUSLOG("requestApplyingChannels: hardware already has requested values in device %s -> suppressed\n", shortDesc().c_str());
+    recordApplyStat(applystat_suppressed);
+    for (int i=0; i<numChannels(); i++) {
+      ChannelBehaviourPtr ch = getChannelByIndex(i, true);
+      if (ch) ch->channelValueApplied(true);
+    }
+    // - just call back immediately
+    if (aAppliedOrSupersededCB) aAppliedOrSupersededCB();
+    return;
+  }
   FOCUSLOG("requestApplyingChannels entered in device %s\n", shortDesc().c_str());
   // Caller wants current channel values applied to hardware
   // Three possible cases:
@@ -767,6 +814,8 @@ void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForD
     }
     // - when previous request actually terminates, we need another update to make sure finally settled values are correct
     missedApplyAttempts++;
+    recordApplyStat(applystat_superseded);
+    TRACE_INSTANT("apply superseded", shortDesc());
     FOCUSLOG("- missed requestApplyingChannels requests now %d\n", missedApplyAttempts);
   }
   else if (updateInProgress) {
@@ -786,8 +835,14 @@ void Device::requestApplyingChannels(SimpleCB aAppliedOrSupersededCB, bool aForD
     FOCUSLOG("+++++ Serializer watchdog started for apply with ticket #%ld\n", serializerWatchdogTicket);
     #endif
     // - start applying
+    if (globalTracer.enabled()) {
+      applyTraceId = globalTracer.getCurrentId() ? globalTracer.getCurrentId() : globalTracer.newId();
+      TRACE_ASYNC_BEGIN("apply", applyTraceId, shortDesc());
+    }
     appliedOrSupersededCB = aAppliedOrSupersededCB;
     applyInProgress = true;
+    applyStartedAt = MainLoop::now();
+    noteSentHardwareLevels(!aModeChange);
     applyChannelValues(boost::bind(&Device::applyingChannelsComplete, this), aForDimming);
   }
 }
@@ -831,9 +886,13 @@ void Device::serializerWatchdog()
   #if SERIALIZER_WATCHDOG
   FOCUSLOG("##### Serializer watchdog ticket #%ld expired\n", serializerWatchdogTicket);
   serializerWatchdogTicket = 0;
+  if (applyInProgress || updateInProgress) {
+    recordApplyStat(applystat_watchdog);
+  }
   if (applyInProgress) {
     LOG(LOG_WARNING, "##### Serializer watchdog force-ends apply with %d missed attempts in device %s\n", missedApplyAttempts, shortDesc().c_str());
     missedApplyAttempts = 0;
+    applyStartedAt = Never; // do not count watchdog timeout as apply latency
     applyingChannelsComplete();
     FOCUSLOG("##### Force-ending apply complete\n");
   }
@@ -846,6 +905,87 @@ void Device::serializerWatchdog()
 }
 
 
+void Device::recordApplyStat(ApplyStatEvent aEvent, MLMicroSeconds aLatency)
+{
+  // count for the device itself, its vDC and the vDC host
+  getApplyStats().record(aEvent, aLatency);
+  classContainerP->getApplyStats().record(aEvent, aLatency);
+  getDeviceContainer().getApplyStats().record(aEvent, aLatency);
+}
+
+
+bool Device::applyWouldChangeHardware()
+{
+  // a different mode (e.g. color mode) must reach the hardware, even if all levels are the same
+  if (output && output->hardwareChannelMode()!=appliedHardwareMode) return true;
+  bool anyPending = false;
+  for (int i=0; i<numChannels(); i++) {
+    ChannelBehaviourPtr ch = getChannelByIndex(i, true);
+    if (!ch) continue; // not pending
+    anyPending = true;
+    if (ch->inTransition()) return true; // transitions must run
+    long level = ch->getAppliedHardwareLevel();
+    if (level==HARDWARE_LEVEL_UNKNOWN || channelHardwareLevel(*ch, ch->getChannelValue())!=level) {
+      // unknown or different level
+      return true;
+    }
+  }
+  // nothing pending must still be passed on to applyChannelValues() as before
+  return !anyPending;
+}
+
+
+void Device::forgetAppliedHardwareLevels()
+{
+  for (int i=0; i<numChannels(); i++) {
+    ChannelBehaviourPtr ch = getChannelByIndex(i);
+    ch->setAppliedHardwareLevel(HARDWARE_LEVEL_UNKNOWN);
+    ch->setSentHardwareLevel(HARDWARE_LEVEL_UNKNOWN); // an apply still running must not confirm its levels later
+  }
+  appliedHardwareMode = HARDWARE_LEVEL_UNKNOWN;
+  sentHardwareMode = HARDWARE_LEVEL_UNKNOWN;
+}
+
+
+void Device::noteSentHardwareLevels(bool aKnown)
+{
+  if (!aKnown) {
+    // e.g. output mode change, hardware output might differ from channel values
+    forgetAppliedHardwareLevels();
+    return;
+  }
+  for (int i=0; i<numChannels(); i++) {
+    ChannelBehaviourPtr ch = getChannelByIndex(i);
+    if (ch->needsApplying()) {
+      // hardware is in flux until the apply has completed
+      ch->setAppliedHardwareLevel(HARDWARE_LEVEL_UNKNOWN);
+      ch->setSentHardwareLevel(channelHardwareLevel(*ch, ch->getChannelValue()));
+    }
+    else {
+      // not changed by this apply
+      ch->setSentHardwareLevel(HARDWARE_LEVEL_UNKNOWN);
+    }
+  }
+  appliedHardwareMode = HARDWARE_LEVEL_UNKNOWN;
+  sentHardwareMode = output ? output->hardwareChannelMode() : HARDWARE_LEVEL_UNKNOWN;
+}
+
+
+void Device::confirmAppliedHardwareLevels()
+{
+  for (int i=0; i<numChannels(); i++) {
+    ChannelBehaviourPtr ch = getChannelByIndex(i);
+    long level = ch->getSentHardwareLevel();
+    if (level!=HARDWARE_LEVEL_UNKNOWN) {
+      ch->setAppliedHardwareLevel(level);
+      ch->setSentHardwareLevel(HARDWARE_LEVEL_UNKNOWN);
+    }
+  }
+  appliedHardwareMode = sentHardwareMode;
+  sentHardwareMode = HARDWARE_LEVEL_UNKNOWN;
+}
+
+
 bool Device::checkForReapply()
 {
   LOG(LOG_DEBUG, "checkForReapply in device %s - missed %d apply attempts in between\n", shortDesc().c_str(), missedApplyAttempts);
@@ -875,6 +1015,19 @@ void Device::applyingChannelsComplete()
   }
   #endif
   applyInProgress = false;
+  if (applyTraceId) {
+    TRACE_ASYNC_END("apply", applyTraceId);
+    applyTraceId = 0;
+  }
+  if (applyStartedAt!=Never) {
+    // update smoothed apply latency
+    MLMicroSeconds latency = MainLoop::now()-applyStartedAt;
+    applyLatency = applyLatency>0 ? (7*applyLatency+latency)/8 : latency;
+    applyStartedAt = Never;
+    recordApplyStat(applystat_applied, latency);
+    // the hardware now shows the sent levels
+    confirmAppliedHardwareLevels();
+  }
   // if more apply request have happened in the meantime, we need to reapply now
   if (!checkForReapply()) {
     // apply complete and no final re-apply pending
@@ -985,10 +1138,12 @@ void Device::updatingChannelsComplete()
 
 void Device::callScene(SceneNo aSceneNo, bool aForce)
 {
+  TRACE_SCOPE("callScene", string_format("%d %s", aSceneNo, shortDesc().c_str()));
   // see if we have a scene table at all
   SceneDeviceSettingsPtr scenes = getScenes();
   if (scenes) {
-    DsScenePtr scene = scenes->getScene(aSceneNo);
+    // Note: the scene is only read here, so the kept default scenes can be used (no allocation)
+    DsScenePtr scene = scenes->getSceneForCall(aSceneNo);
     SceneCmd cmd = scene->sceneCmd;
     SceneArea area = scene->sceneArea;
     // check special scene commands first
@@ -1024,7 +1179,7 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
     if (area) {
       LOG(LOG_INFO, "- callScene(%d): is area #%d scene\n", aSceneNo, area);
       // check if device is in area (criteria used is dontCare flag OF THE AREA ON SCENE (other don't care flags are irrelevant!)
-      DsScenePtr areamainscene = scenes->getScene(mainSceneForArea(area));
+      DsScenePtr areamainscene = scenes->getSceneForCall(mainSceneForArea(area));
       if (areamainscene->isDontCare()) {
         LOG(LOG_INFO, "- area main scene(%d) is dontCare -> suppress\n", areamainscene->sceneNo);
         return; // not in this area, suppress callScene entirely
@@ -1051,6 +1206,9 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
           output->setLocalPriority(false);
         }
       }
+      // - forced scene calls must reach the hardware even if it seems to show the scene's values already
+      //   (e.g. because the light was changed outside vdcd)
+      if (aForce) forgetAppliedHardwareLevels();
       // - make sure we have the lastState pseudo-scene for undo
       if (!previousState)
         previousState = scenes->newDefaultScene(aSceneNo);
@@ -1062,13 +1220,13 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
         // Note: the actual updating might happen later (when the hardware responds) but
         //   implementations must make sure access to the hardware is serialized such that
         //   the values are captured before values from applyScene() below are applied.
-        output->captureScene(previousState, true, boost::bind(&Device::outputUndoStateSaved,this,output,scene)); // apply only after capture is complete
+        output->captureScene(previousState, true, boost::bind(&Device::outputUndoStateSaved, this, scene)); // apply only after capture is complete
       } // if output
     } // not dontCare
     else {
       // do other scene actions now, as dontCare prevented applying scene above
       if (output) {
-        output->performSceneActions(scene, boost::bind(&Device::sceneActionsComplete, this, scene));
+        output->performSceneActions(scene, boost::bind(&Device::sceneActionsComplete, this));
       } // if output
     }
   } // device with scenes
@@ -1077,9 +1235,8 @@ void Device::callScene(SceneNo aSceneNo, bool aForce)
 
 
 // deferred applying of state, after current state has been captured for this output
-void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene)
+void Device::outputUndoStateSaved(DsScenePtr aScene)
 {
-  OutputBehaviourPtr output = boost::dynamic_pointer_cast<OutputBehaviour>(aOutput);
   if (output) {
     // apply scene logically
     if (output->applyScene(aScene)) {
@@ -1097,14 +1254,13 @@ void Device::outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene)
 void Device::sceneValuesApplied(DsScenePtr aScene)
 {
   // now perform scene special actions such as blinking
-  output->performSceneActions(aScene, boost::bind(&Device::sceneActionsComplete, this, aScene));
+  output->performSceneActions(aScene, boost::bind(&Device::sceneActionsComplete, this));
 }
 
 
-void Device::sceneActionsComplete(DsScenePtr aScene)
+void Device::sceneActionsComplete()
 {
-  // now perform scene special actions such as blinking
-  LOG(LOG_DEBUG, "- scene actions for scene %d complete\n", aScene->sceneNo);
+  LOG(LOG_DEBUG, "- scene actions complete in device %s\n", shortDesc().c_str());
 }
 
 
@@ -1128,7 +1284,7 @@ void Device::undoScene(SceneNo aSceneNo)
 
 void Device::setLocalPriority(SceneNo aSceneNo)
 {
-  SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+  SceneDeviceSettingsPtr scenes = getScenes();
   if (scenes) {
     LOG(LOG_NOTICE, "SetLocalPriority(%d) in device %s:\n", aSceneNo, shortDesc().c_str());
     // we have a device-wide scene table, get the scene object
@@ -1143,7 +1299,7 @@ void Device::setLocalPriority(SceneNo aSceneNo)
 
 void Device::callSceneMin(SceneNo aSceneNo)
 {
-  SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+  SceneDeviceSettingsPtr scenes = getScenes();
   if (scenes) {
     LOG(LOG_NOTICE, "CallSceneMin(%d) in device %s:\n", aSceneNo, shortDesc().c_str());
     // we have a device-wide scene table, get the scene object
@@ -1177,7 +1333,7 @@ void Device::saveScene(SceneNo aSceneNo)
 {
   // see if we have a scene table at all
   LOG(LOG_NOTICE, "SaveScene(%d) in device: %s\n", aSceneNo, shortDesc().c_str());
-  SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+  SceneDeviceSettingsPtr scenes = getScenes();
   if (scenes) {
     // we have a device-wide scene table, get the scene object
     DsScenePtr scene = scenes->getScene(aSceneNo);
@@ -1207,7 +1363,7 @@ void Device::outputSceneValueSaved(DsScenePtr aScene)
         // update this main scene's dontCare
         aScene->setDontCare(mustBeDontCare);
         // also update the off scene's dontCare
-        SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+        SceneDeviceSettingsPtr scenes = getScenes();
         DsScenePtr offScene = scenes->getScene(offSceneForArea(area));
         if (offScene) {
           offScene->setDontCare(mustBeDontCare);
@@ -1224,7 +1380,7 @@ void Device::outputSceneValueSaved(DsScenePtr aScene)
 
 void Device::updateSceneIfDirty(DsScenePtr aScene)
 {
-  SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+  SceneDeviceSettingsPtr scenes = getScenes();
   if (scenes && aScene->isDirty()) {
     scenes->updateScene(aScene);
   }
@@ -1264,7 +1420,11 @@ ErrorPtr Device::load()
   for (BehaviourVector::iterator pos = buttons.begin(); pos!=buttons.end(); ++pos) (*pos)->load();
   for (BehaviourVector::iterator pos = binaryInputs.begin(); pos!=binaryInputs.end(); ++pos) (*pos)->load();
   for (BehaviourVector::iterator pos = sensors.begin(); pos!=sensors.end(); ++pos) (*pos)->load();
-  if (output) output->load();
+  if (output) {
+    output->load();
+    // restore last known output state (will be confirmed from hardware later, if possible)
+    output->restoreLastState();
+  }
   return ErrorPtr();
 }
 
@@ -1292,7 +1452,10 @@ ErrorPtr Device::forget()
   for (BehaviourVector::iterator pos = buttons.begin(); pos!=buttons.end(); ++pos) (*pos)->forget();
   for (BehaviourVector::iterator pos = binaryInputs.begin(); pos!=binaryInputs.end(); ++pos) (*pos)->forget();
   for (BehaviourVector::iterator pos = sensors.begin(); pos!=sensors.end(); ++pos) (*pos)->forget();
-  if (output) output->forget();
+  if (output) {
+    output->forget();
+    output->forgetLastState();
+  }
   return ErrorPtr();
 }
 
@@ -1360,7 +1523,7 @@ int Device::numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor)
     return numChannels(); // if no output, this returns 0
   }
   else if (aParentDescriptor->hasObjectKey(device_scenes_key)) {
-    SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+    SceneDeviceSettingsPtr scenes = getScenes();
     if (scenes)
       return MAX_SCENE_NO;
     else
@@ -1514,7 +1677,7 @@ PropertyContainerPtr Device::getContainer(PropertyDescriptorPtr &aPropertyDescri
     return output->getChannelByIndex(aPropertyDescriptor->fieldKey());
   }
   else if (aPropertyDescriptor->hasObjectKey(device_scenes_key)) {
-    SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+    SceneDeviceSettingsPtr scenes = getScenes();
     if (scenes) {
       return scenes->getScene(aPropertyDescriptor->fieldKey());
     }
@@ -1528,8 +1691,8 @@ PropertyContainerPtr Device::getContainer(PropertyDescriptorPtr &aPropertyDescri
       return previousState;
     }
   }
-  // unknown here
-  return NULL;
+  // unknown here, let base class handle it
+  return inherited::getContainer(aPropertyDescriptor, aDomain);
 }
 
 
@@ -1568,6 +1731,7 @@ bool Device::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prope
         case zoneID_key:
           if (deviceSettings) {
             deviceSettings->setPVar(deviceSettings->zoneID, aPropValue->int32Value());
+            getDeviceContainer().invalidateLocalClickIndex(); // zone membership changed
           }
           return true;
         case progMode_key:
@@ -1598,7 +1762,7 @@ ErrorPtr Device::writtenProperty(PropertyAccessMode aMode, PropertyDescriptorPtr
   if (aPropertyDescriptor->hasObjectKey(device_scenes_key)) {
     // a scene was written, update needed if dirty
     DsScenePtr scene = boost::dynamic_pointer_cast<DsScene>(aContainer);
-    SceneDeviceSettingsPtr scenes = boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings);
+    SceneDeviceSettingsPtr scenes = getScenes();
     if (scenes && scene && scene->isDirty()) {
       scenes->updateScene(scene);
       return ErrorPtr();
@@ -36,10 +36,58 @@ namespace p44 {
   class ChannelBehaviour;
   typedef boost::intrusive_ptr<ChannelBehaviour> ChannelBehaviourPtr;
 
+  /// hardware level value meaning "not known", see Device::channelHardwareLevel()
+  #define HARDWARE_LEVEL_UNKNOWN (-1)
+
+  #define DIM_STEP_INTERVAL (300*MilliSecond) ///< dim step interval used as long as apply latency is unknown
+  #define DIM_STEP_LATENCY_FACTOR 1.5 ///< dim step interval relative to apply latency, leaves some headroom for other traffic
+
   typedef vector<DsBehaviourPtr> BehaviourVector;
 
   typedef boost::intrusive_ptr<OutputBehaviour> OutputBehaviourPtr;
 
+
+  /// device level notification, with method and parameters parsed once. A notification addressed to many
+  /// devices is parsed only once and then just dispatched to each device.
+  class DeviceNotification
+  {
+  public:
+
+    typedef enum {
+      notify_other, ///< not a device level notification, must be handled via DsAddressable::handleNotification()
+      notify_callScene,
+      notify_saveScene,
+      notify_undoScene,
+      notify_setLocalPriority,
+      notify_setControlValue,
+      notify_callSceneMin,
+      notify_dimChannel,
+      notify_setOutputChannelValue,
+      notify_identify,
+      notify_commitPreloaded, ///< apply channel values preloaded with setOutputChannelValue(apply_now=false)
+    } NotificationKind;
+
+    /// parse notification
+    /// @param aMethod the notification
+    /// @param aParams the parameters object
+    DeviceNotification(const string &aMethod, ApiValuePtr aParams);
+
+    string method; ///< the notification method name
+    ApiValuePtr params; ///< the original parameters
+    NotificationKind kind; ///< the notification
+    ErrorPtr err; ///< set if parameters are missing or invalid for the notification
+
+    // parsed parameters (only those relevant for kind are valid)
+    SceneNo sceneNo;
+    bool force;
+    DsChannelType channel;
+    DsDimMode dimMode;
+    int area;
+    double value;
+    string name;
+    bool applyNow;
+  };
+
   /// base class representing a virtual digitalSTROM device.
   /// For each type of subsystem (EnOcean, DALI, ...) this class is subclassed to implement
   /// the device class' specifics, in particular the interface with the hardware.
@@ -70,6 +118,7 @@ namespace p44 {
     /// @note devices assign this with a derived class which is specialized
     ///   for the device type and, if needed, proper type of scenes (light, blinds, RGB light etc. have different scene tables)
     DeviceSettingsPtr deviceSettings;
+    SceneDeviceSettingsPtr sceneSettings; ///< deviceSettings as SceneDeviceSettings (NULL if device has no scene table), cached by installSettings()
 
     // volatile r/w properties
     bool progMode; ///< if set, device is in programming mode
@@ -84,6 +133,7 @@ namespace p44 {
     DsChannelType currentDimChannel; ///< currently dimmed channel (if dimming in progress)
     long dimHandlerTicket; ///< for standard dimming
     bool isDimming; ///< if set, dimming is in progress
+    MLMicroSeconds dimStepInterval; ///< current interval between dim steps, adapted to apply latency
 
     // hardware access serializer/pacer
     SimpleCB appliedOrSupersededCB; ///< will be called when values are either applied or ignored because a subsequent change is already pending
@@ -93,6 +143,11 @@ namespace p44 {
     SimpleCB updatedOrCachedCB; ///< will be called when current values are either read from hardware, or new values have been requested for applying
     bool updateInProgress; ///< set when updating channel values from hardware is in progress
     long serializerWatchdogTicket; ///< watchdog terminating non-responding hardware requests
+    MLMicroSeconds applyStartedAt; ///< time when currently running applyChannelValues() was started, Never if none
+    MLMicroSeconds applyLatency; ///< smoothed time applyChannelValues() takes to complete, 0 if not yet measured
+    uint32_t applyTraceId; ///< trace id of the currently running apply, 0 if none
+    long appliedHardwareMode; ///< output's hardwareChannelMode() the hardware is known to be in, HARDWARE_LEVEL_UNKNOWN if not known
+    long sentHardwareMode; ///< output's hardwareChannelMode() of the running apply, HARDWARE_LEVEL_UNKNOWN if none
 
   public:
     Device(DeviceClassContainer *aClassContainerP);
@@ -153,6 +208,10 @@ namespace p44 {
     /// get dominant group (i.e. the group that should color the icon)
     DsGroup getDominantGroup();
 
+    /// get zone the device is assigned to
+    /// @return zoneID, 0 if none assigned
+    int getZoneID();
+
     /// report that device has vanished (disconnected without being told so via vDC API)
     /// This will call disconnect() on the device, and remove it from all vDC container lists
     /// @param aForgetParams if set, not only the connection to the device is removed, but also all parameters related to it
@@ -170,6 +229,9 @@ namespace p44 {
     /// get reference to device container
     DeviceContainer &getDeviceContainer() { return classContainerP->getDeviceContainer(); };
 
+    /// get reference to the device class container (vDC) this device belongs to
+    DeviceClassContainer &getClassContainer() { return *classContainerP; };
+
     /// install specific or standard device settings
     /// @param aDeviceSettings specific device settings, if NULL, standard minimal settings will be used
     void installSettings(DeviceSettingsPtr aDeviceSettings = DeviceSettingsPtr());
@@ -181,7 +243,7 @@ namespace p44 {
 
     /// get scenes
     /// @return NULL if device has no scenes, scene device settings otherwise 
-    SceneDeviceSettingsPtr getScenes() { return boost::dynamic_pointer_cast<SceneDeviceSettings>(deviceSettings); };
+    SceneDeviceSettingsPtr getScenes() { return sceneSettings; };
 
     /// this will be called just before a device is added to the vdc, and thus needs to be fully constructed
     /// (settings, scenes, behaviours) and MUST have determined the henceforth invariable dSUID.
@@ -220,6 +282,10 @@ namespace p44 {
     ///   used already to route the notification to this device.
     virtual void handleNotification(const string &aMethod, ApiValuePtr aParams);
 
+    /// called to let device handle an already parsed device-level notification
+    /// @param aNotification the notification, possibly shared with other devices addressed by the same notification
+    virtual void handleDeviceNotification(DeviceNotification &aNotification);
+
     /// call scene on this device
     /// @param aSceneNo the scene to call.
     void callScene(SceneNo aSceneNo, bool aForce);
@@ -285,6 +351,11 @@ namespace p44 {
     /// @param aApplyCompleteCB will called when values are applied and no other change is pending
     void waitForApplyComplete(SimpleCB aApplyCompleteCB);
 
+    /// forget the hardware levels known to be applied, so the next apply reaches the hardware in any case
+    /// @note must be called whenever the hardware might have changed its output without vdcd knowing, such as
+    ///   after the device was not present, or the bus or bridge connection was lost
+    void forgetAppliedHardwareLevels();
+
     /// request that channel values are updated by reading them back from the device's hardware
     /// @param aUpdatedOrCachedCB will be called when values are updated with actual hardware values
     ///   or pending values are in process to be applied to the hardware and thus these cached values can be considered current.
@@ -304,6 +375,19 @@ namespace p44 {
     ///   class makes sure these cases (which may occur at the vDC API level) are not passed on to dimChannel()
     virtual void dimChannel(DsChannelType aChannelType, DsDimMode aDimMode);
 
+    /// calculate the standard dim step interval
+    /// @param aApplyLatency the measured apply latency, 0 if not yet known
+    /// @param aMinInterval minimum interval (see DeviceClassContainer::minDimStepInterval())
+    /// @param aMaxInterval maximum interval (see DeviceClassContainer::maxDimStepInterval())
+    /// @return DIM_STEP_LATENCY_FACTOR times the apply latency (DIM_STEP_INTERVAL as long as it is unknown), within the limits
+    static MLMicroSeconds dimStepIntervalFor(MLMicroSeconds aApplyLatency, MLMicroSeconds aMinInterval, MLMicroSeconds aMaxInterval)
+    {
+      MLMicroSeconds interval = aApplyLatency>0 ? aApplyLatency*DIM_STEP_LATENCY_FACTOR : DIM_STEP_INTERVAL;
+      if (interval<aMinInterval) interval = aMinInterval;
+      if (interval>aMaxInterval) interval = aMaxInterval;
+      return interval;
+    };
+
     /// identify the device to the user
     /// @note for lights, this is usually implemented as a blink operation, but depending on the device type,
     ///   this can be anything.
@@ -409,7 +493,21 @@ namespace p44 {
     ///   a direct remote control for a lamp) are included. Just reading a channel state does not call this method.
     /// @note implementation must use channel's syncChannelValue() method
     virtual void syncChannelValues(SimpleCB aDoneCB) { if (aDoneCB) aDoneCB(); /* assume caches up-to-date */ };
-    
+
+    /// @return true if syncChannelValues() actually reads back the output state from the hardware
+    /// @note used to skip devices that cannot report their state when re-synchronizing restored output states
+    virtual bool canSyncChannelValues() { return false; };
+
+    /// get the quantized level the hardware would actually output for a channel value
+    /// @param aChannel the channel
+    /// @param aValue the channel value
+    /// @return hardware level (e.g. DALI arc power, DMX value), or HARDWARE_LEVEL_UNKNOWN if the device can't tell
+    /// @note requestApplyingChannels() skips calling applyChannelValues() when all pending channels would result
+    ///   in the same hardware levels as last applied. Device classes with coarse outputs (8-bit DALI, DMX, hue)
+    ///   should override this to avoid bus traffic for changes that are not visible. Base class returns
+    ///   HARDWARE_LEVEL_UNKNOWN, which means every apply is executed.
+    virtual long channelHardwareLevel(ChannelBehaviour &aChannel, double aValue) { return HARDWARE_LEVEL_UNKNOWN; };
+
     /// @}
 
 
@@ -435,17 +533,22 @@ namespace p44 {
     DsGroupMask behaviourGroups();
 
     void dimAutostopHandler(DsChannelType aChannel);
-    void dimHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNow);
-    void dimDoneHandler(ChannelBehaviourPtr aChannel, double aIncrement, MLMicroSeconds aNextDimAt);
+    MLMicroSeconds adaptedDimStepInterval();
+    void recordApplyStat(ApplyStatEvent aEvent, MLMicroSeconds aLatency = 0);
+    void dimHandler(ChannelBehaviourPtr aChannel, double aDimPerMS, MLMicroSeconds aNow);
+    void dimDoneHandler(ChannelBehaviourPtr aChannel, double aDimPerMS, MLMicroSeconds aNextDimAt);
     void outputSceneValueSaved(DsScenePtr aScene);
-    void outputUndoStateSaved(DsBehaviourPtr aOutput, DsScenePtr aScene);
+    void outputUndoStateSaved(DsScenePtr aScene);
     void sceneValuesApplied(DsScenePtr aScene);
-    void sceneActionsComplete(DsScenePtr aScene);
+    void sceneActionsComplete();
 
     void applyingChannelsComplete();
     void updatingChannelsComplete();
     void serializerWatchdog();
     bool checkForReapply();
+    bool applyWouldChangeHardware();
+    void noteSentHardwareLevels(bool aKnown);
+    void confirmAppliedHardwareLevels();
     void forkDoneCB(SimpleCB aOriginalCB, SimpleCB aNewCallback);
 
   };
@@ -27,12 +27,13 @@ using namespace p44;
 
 
 DeviceClassContainer::DeviceClassContainer(int aInstanceNumber, DeviceContainer *aDeviceContainerP, int aTag) :
-  inherited(aDeviceContainerP),
   inheritedParams(aDeviceContainerP->getDsParamStore()),
+  inherited(aDeviceContainerP),
   instanceNumber(aInstanceNumber),
-  defaultZoneID(0),
+  tag(aTag),
   vdcFlags(0),
-  tag(aTag)
+  defaultZoneID(0),
+  collecting(false)
 {
 }
 
@@ -214,6 +215,94 @@ void DeviceClassContainer::removeDevice(DevicePtr aDevice, bool aForget)
 }
 
 
+void DeviceClassContainer::callSceneOnDevices(DeviceVector &aDevices, SceneNo aSceneNo, bool aForce)
+{
+  // base class: no native group addressing, just call scene on every device
+  for (DeviceVector::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+    (*pos)->callScene(aSceneNo, aForce);
+  }
+}
+
+
+void DeviceClassContainer::forgetAppliedHardwareLevels()
+{
+  for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
+    (*pos)->forgetAppliedHardwareLevels();
+  }
+}
+
+
+namespace p44 {
+
+  /// tracks completion of a commit of preloaded channel values to a set of devices
+  class PreparedCommit : public P44Obj
+  {
+  public:
+    DeviceClassContainer *classContainerP;
+    int pending; ///< number of devices not yet done applying
+    MLMicroSeconds startedAt; ///< when commit was started
+    MLMicroSeconds dispatchedAt; ///< when the last device's apply was started
+    MLMicroSeconds firstDoneAt; ///< when the first device was done applying
+    MLMicroSeconds lastDoneAt; ///< when the last device was done applying
+
+    PreparedCommit(DeviceClassContainer *aClassContainerP, int aNumDevices) :
+      classContainerP(aClassContainerP),
+      pending(aNumDevices+1), // one extra to prevent finishing while still dispatching
+      startedAt(MainLoop::now()),
+      dispatchedAt(Never),
+      firstDoneAt(Never),
+      lastDoneAt(Never)
+    {
+    }
+
+    /// called when one device has applied its values (or the apply request was superseded)
+    void deviceApplied()
+    {
+      lastDoneAt = MainLoop::now();
+      if (firstDoneAt==Never) firstDoneAt = lastDoneAt;
+      checkDone();
+    }
+
+    /// called when all devices have been asked to apply
+    void dispatched()
+    {
+      dispatchedAt = MainLoop::now();
+      checkDone();
+    }
+
+  private:
+
+    void checkDone()
+    {
+      if (--pending>0) return;
+      MLMicroSeconds skew = lastDoneAt-firstDoneAt;
+      classContainerP->getApplyStats().recordCommit(skew);
+      LOG(LOG_INFO,
+        "Committed preloaded values in vDC %s: dispatching took %lld uS, commit skew %lld uS\n",
+        classContainerP->shortDesc().c_str(), dispatchedAt-startedAt, skew
+      );
+    }
+  };
+  typedef boost::intrusive_ptr<PreparedCommit> PreparedCommitPtr;
+
+} // namespace p44
+
+
+void DeviceClassContainer::commitPreparedDevices(DeviceVector &aDevices)
+{
+  if (aDevices.empty()) return;
+  // base class: start applying on all devices as closely together as possible
+  PreparedCommitPtr commit = PreparedCommitPtr(new PreparedCommit(this, (int)aDevices.size()));
+  for (DeviceVector::iterator pos = aDevices.begin(); pos!=aDevices.end(); ++pos) {
+    (*pos)->requestApplyingChannels(boost::bind(&PreparedCommit::deviceApplied, commit), false);
+  }
+  // let device classes which batch hardware updates push them now
+  transitionFrameDone();
+  commit->dispatched();
+}
+
+
+
 void DeviceClassContainer::removeDevices(bool aForget)
 {
 	for (DeviceVector::iterator pos = devices.begin(); pos!=devices.end(); ++pos) {
@@ -251,6 +340,12 @@ ErrorPtr DeviceClassContainer::save()
 }
 
 
+ErrorPtr DeviceClassContainer::saveDirty()
+{
+  return save();
+}
+
+
 ErrorPtr DeviceClassContainer::forget()
 {
   // delete the vdc settings
@@ -324,8 +419,8 @@ PropertyContainerPtr DeviceClassContainer::getContainer(PropertyDescriptorPtr &a
     aPropertyDescriptor.reset(); // next level is "root" again (is a DsAddressable)
     return container;
   }
-  // unknown here
-  return NULL;
+  // unknown here, let base class handle it
+  return inherited::getContainer(aPropertyDescriptor, aDomain);
 }
 
 
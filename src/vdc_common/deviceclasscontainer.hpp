@@ -27,6 +27,7 @@
 #include "devicecontainer.hpp"
 
 #include "dsuid.hpp"
+#include "dsscene.hpp"
 
 using namespace std;
 
@@ -66,6 +67,8 @@ namespace p44 {
     typedef DsAddressable inherited;
     typedef PersistentParams inheritedParams;
 
+    friend class DeviceClassCollector;
+
     int instanceNumber; ///< the instance number identifying this instance among other instances of this class
     int tag; ///< tag used to in self test failures for showing on LEDs
 
@@ -73,6 +76,8 @@ namespace p44 {
     int vdcFlags;
     /// default dS zone ID
     int defaultZoneID;
+    /// set while devices of this class are being collected and initialized
+    bool collecting;
 
   protected:
   
@@ -108,6 +113,10 @@ namespace p44 {
 
     /// get number of devices
     size_t getNumberOfDevices() const { return devices.size(); };
+
+    /// @return true while devices of this class are being collected and initialized.
+    ///   The container and its devices are not announced before this is finished.
+    bool isCollecting() const { return collecting; };
 		
     /// @}
 		
@@ -140,6 +149,31 @@ namespace p44 {
     /// @return if true, this device class should not be announced towards the dS system when it has no devices
     virtual bool invisibleWhenEmpty() { return false; }
 
+    /// @name limits for adaptive standard dimming
+    /// @note Device::dimChannel() adapts the dim step interval to the measured apply latency of each device,
+    ///   within these limits. Device classes with fast outputs can lower the minimum for smoother dimming,
+    ///   classes with slow or shared bus access should raise it to avoid overloading the bus.
+    /// @{
+
+    /// @return minimum interval between dim steps
+    /// @note defaults to the fixed step interval used before dimming was adaptive, so device classes
+    ///   must explicitly opt in to faster dimming (and the additional traffic it causes)
+    virtual MLMicroSeconds minDimStepInterval() { return 300*MilliSecond; }
+
+    /// @return maximum interval between dim steps
+    virtual MLMicroSeconds maxDimStepInterval() { return 1*Second; }
+
+    /// @}
+
+    /// @return max number of devices of this class initialized concurrently after collecting
+    /// @note device classes sharing a slow bus among all devices should return 1
+    virtual int maxParallelDeviceInits() { return 4; }
+
+    /// @return min interval between presence checks of devices of this class
+    /// @note the PresenceScheduler adds a random jitter of up to half the interval. Device classes checking presence
+    ///   without any bus traffic can return 0, classes with slow or shared bus access should raise it.
+    virtual MLMicroSeconds presenceCheckInterval() { return 100*MilliSecond; }
+
     /// get user assigned name of the device class container, or if there is none, a synthesized default name
     /// @return name string
     virtual string getName();
@@ -223,6 +257,35 @@ namespace p44 {
     ///   the device is not disconnected (=unlearned) by this.
     virtual void removeDevice(DevicePtr aDevice, bool aForget = false);
 
+    /// call a scene on a set of devices of this class at once
+    /// @param aDevices the devices of this class container addressed by the same callScene notification
+    /// @param aSceneNo the scene to call
+    /// @param aForce true if the scene should be called with force flag
+    /// @note this is called by the DeviceContainer once per class container when a callScene notification
+    ///   addresses multiple devices. Base class just calls callScene() on every device in turn. Device classes
+    ///   which can address sets of devices natively (e.g. DALI group commands, hue groups) can override this
+    ///   to map the set to a single bus operation instead of applying one device after the other.
+    virtual void callSceneOnDevices(DeviceVector &aDevices, SceneNo aSceneNo, bool aForce);
+
+    /// forget the hardware levels known to be applied in all devices of this class container
+    /// @note device classes must call this when the connection to the bus or bridge is re-established, as the
+    ///   hardware might have changed its outputs in the meantime. DeviceContainer calls it before collecting devices.
+    void forgetAppliedHardwareLevels();
+
+    /// apply previously preloaded channel values of a set of devices of this class at once
+    /// @param aDevices the devices of this class container to commit
+    /// @note this is called by the DeviceContainer once per class container in the same mainloop cycle for all
+    ///   class containers involved, after all channel values have been preloaded (setOutputChannelValue with
+    ///   apply_now=false). Base class starts applying on all devices in a tight loop, then calls transitionFrameDone()
+    ///   so batching device classes push the changes in one go. The skew between the first and the last device
+    ///   completing the apply is logged and recorded in the x-p44-applyStats of this container.
+    virtual void commitPreparedDevices(DeviceVector &aDevices);
+
+    /// called by the TransitionEngine after a frame has stepped transitions of devices in this container
+    /// @note device classes which can update outputs of multiple devices at once (e.g. a LED chain or DMX universe)
+    ///   can override this to push all changes of a frame to the hardware in one batch.
+    virtual void transitionFrameDone() { /* NOP in base class */ };
+
 		/// @}
 
 
@@ -305,6 +368,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex);
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
+    virtual ErrorPtr saveDirty();
 
     // derive dSUID
     void deriveDsUid();
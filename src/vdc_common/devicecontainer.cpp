@@ -29,6 +29,8 @@
 
 #include "macaddress.hpp"
 #include "fnv.hpp"
+#include "tracer.hpp"
+#include "phaseprofiler.hpp"
 
 // for local behaviour
 #include "buttonbehaviour.hpp"
@@ -45,12 +47,21 @@ using namespace p44;
 // how often to write mainloop statistics into log output
 #define DEFAULT_MAINLOOP_STATS_INTERVAL (60) // every 5 min (with periodic activity every 5 seconds: 60*5 = 300 = 5min)
 
-// how long vDC waits after receiving ok from one announce until it fires the next
+// how long vDC waits after receiving ok from one announce until it refills the announcement window
 #define ANNOUNCE_PAUSE (10*MilliSecond)
 
-// how long until a not acknowledged registrations is considered timed out (and next device can be attempted)
+// how many announcements can be outstanding (sent, but not yet acknowledged) at the same time by default
+#define DEFAULT_ANNOUNCE_WINDOW 10
+
+// how long until a not acknowledged registrations is considered timed out (and frees its slot in the announcement window)
 #define ANNOUNCE_TIMEOUT (30*Second)
 
+// default interval between two background re-syncs of restored output states with the hardware
+#define DEFAULT_OUTPUT_RESYNC_INTERVAL (1*Second)
+
+// how many startup phase profiles to keep
+#define STARTUP_PROFILES_KEPT 10
+
 // how long until a not acknowledged announcement for a device is retried again for the same device
 #define ANNOUNCE_RETRY_TIMEOUT (300*Second)
 
@@ -67,18 +78,33 @@ DeviceContainer::DeviceContainer() :
   lastPeriodicRun(0),
   learningMode(false),
   announcementTicket(0),
+  announceWindow(DEFAULT_ANNOUNCE_WINDOW),
+  announceRefillScheduled(false),
+  outputResyncInterval(DEFAULT_OUTPUT_RESYNC_INTERVAL),
+  outputResyncTicket(0),
   periodicTaskTicket(0),
+  saveSweepIncomplete(false),
+  deferredSaveSweeps(0),
   localDimDirection(0), // undefined
+  localClickIndexValid(false),
   mainloopStatsInterval(DEFAULT_MAINLOOP_STATS_INTERVAL),
   mainLoopStatsCounter(0),
   productName(DEFAULT_PRODUCT_NAME)
 {
+  presenceScheduler = PresenceSchedulerPtr(new PresenceScheduler);
   // obtain MAC address
   mac = macAddress();
   deriveDsUid(); // make sure we have a vdc host dSUID FROM THE BEGINNING. Usually, setIdMode derives it again, but just in case...
 }
 
 
+DeviceContainer::~DeviceContainer()
+{
+  // make sure all settings queued for write-behind are written
+  dsParamStore.stopWriteBehind();
+}
+
+
 void DeviceContainer::setName(const string &aName)
 {
   if (aName!=getAssignedName()) {
@@ -141,6 +167,8 @@ void DeviceContainer::setIdMode(DsUidPtr aExternalDsUid)
 void DeviceContainer::addDeviceClassContainer(DeviceClassContainerPtr aDeviceClassContainerPtr)
 {
   deviceClassContainers[aDeviceClassContainerPtr->getDsUid()] = aDeviceClassContainerPtr;
+  addressableIndex[aDeviceClassContainerPtr->getDsUid()] = aDeviceClassContainerPtr;
+  lastAddressed.reset(); // invalidate lookup cache
 }
 
 
@@ -190,6 +218,7 @@ class DeviceClassInitializer
   ContainerMap::iterator nextContainer;
   DeviceContainer &deviceContainer;
   bool factoryReset;
+  MLMicroSeconds containerStart;
 public:
   static void initialize(DeviceContainer &aDeviceContainer, StatusCB aCallback, bool aFactoryReset)
   {
@@ -209,14 +238,18 @@ private:
 
   void initNextContainer(ErrorPtr aError)
   {
-    if ((!aError || factoryReset) && nextContainer!=deviceContainer.deviceClassContainers.end())
+    if ((!aError || factoryReset) && nextContainer!=deviceContainer.deviceClassContainers.end()) {
+      containerStart = globalPhaseProfiler.beginPhase();
       nextContainer->second->initialize(boost::bind(&DeviceClassInitializer::containerInitialized, this, _1), factoryReset);
+    }
     else
       completed(aError);
   }
 
   void containerInitialized(ErrorPtr aError)
   {
+    DeviceClassContainerPtr vdc = nextContainer->second;
+    globalPhaseProfiler.endPhase(string_format("vdc init %s#%d", vdc->deviceClassIdentifier(), vdc->getInstanceNumber()), containerStart);
     // check next
     ++nextContainer;
     initNextContainer(aError);
@@ -258,12 +291,25 @@ string DsParamStore::dbSchemaUpgradeSQL(int aFromVersion, int &aToVersion)
 
 void DeviceContainer::initialize(StatusCB aCompletedCB, bool aFactoryReset)
 {
+  // profile startup phases
+  globalPhaseProfiler.setStorage(string(getPersistentDataDir())+"startupprofiles.json", STARTUP_PROFILES_KEPT);
+  globalPhaseProfiler.startReport();
   // initialize dsParamsDB database
 	string databaseName = getPersistentDataDir();
 	string_format_append(databaseName, "DsParams.sqlite3");
   ErrorPtr error = dsParamStore.connectAndInitialize(databaseName.c_str(), DSPARAMS_SCHEMA_VERSION, DSPARAMS_SCHEMA_MIN_VERSION, aFactoryReset);
+  if (Error::isOK(error)) {
+    // have settings written by a separate thread, so slow flash writes do not block the mainloop
+    error = dsParamStore.startWriteBehind();
+    if (!Error::isOK(error)) {
+      LOG(LOG_ERR, "Cannot start write-behind for settings, writing synchronously: %s\n", error->description().c_str());
+    }
+  }
   // load the vdc host settings
-  load();
+  {
+    PHASE_SCOPE("settings load");
+    load();
+  }
   // Log start message
   LOG(LOG_NOTICE,"\n****** starting vdcd (vdc host) initialisation, MAC: %s, dSUID (%s) = %s, IP = %s\n", macAddressString().c_str(), externalDsuid ? "external" : "MAC-derived", shortDesc().c_str(), ipv4AddressString().c_str());
   // start the API server
@@ -289,15 +335,34 @@ void DeviceContainer::startRunning()
 namespace p44 {
 
 /// collects and initializes all devices
+/// @note all device class containers collect concurrently. As soon as a container has collected its devices,
+///   these are initialized (up to maxParallelDeviceInits() at a time), and the container becomes ready for
+///   being announced independently of the others.
 class DeviceClassCollector
 {
   StatusCB callback;
   bool exhaustive;
   bool incremental;
   bool clear;
-  ContainerMap::iterator nextContainer;
   DeviceContainer *deviceContainerP;
-  DsDeviceMap::iterator nextDevice;
+
+  /// collecting/initializing state of one device class container
+  typedef struct {
+    DeviceClassContainerPtr vdc;
+    bool queried; ///< set when collecting is done (successful or not), so the devices of the container can be initialized
+    size_t nextDevice; ///< index of next device in the container's (live) device list to initialize
+    int initsRunning; ///< number of device initialisations in progress
+    int starting; ///< nesting level of initializeNextDevices()
+    MLMicroSeconds started; ///< when collecting started
+    MLMicroSeconds collected; ///< when collecting was done
+    MLMicroSeconds initialized; ///< when initializing devices was done
+  } ContainerCollection;
+  typedef vector<ContainerCollection> ContainerCollectionVector;
+  ContainerCollectionVector collections;
+  int containersPending; ///< number of containers not yet completely collected and initialized
+  ErrorPtr firstError;
+  MLMicroSeconds started;
+
 public:
   static void collectDevices(DeviceContainer *aDeviceContainerP, StatusCB aCallback, bool aIncremental, bool aExhaustive, bool aClearSettings)
   {
@@ -310,70 +375,156 @@ private:
     deviceContainerP(aDeviceContainerP),
     incremental(aIncremental),
     exhaustive(aExhaustive),
-    clear(aClearSettings)
+    clear(aClearSettings),
+    containersPending(1) // held while starting, to prevent completing before all containers are started
   {
-    nextContainer = deviceContainerP->deviceClassContainers.begin();
-    queryNextContainer(ErrorPtr());
-  }
-
-
-  void queryNextContainer(ErrorPtr aError)
-  {
-    if (!aError && nextContainer!=deviceContainerP->deviceClassContainers.end()) {
-      DeviceClassContainerPtr vdc = nextContainer->second;
+    started = MainLoop::now();
+    for (ContainerMap::iterator pos = deviceContainerP->deviceClassContainers.begin(); pos!=deviceContainerP->deviceClassContainers.end(); ++pos) {
+      ContainerCollection c;
+      c.vdc = pos->second;
+      c.queried = false;
+      c.nextDevice = 0;
+      c.initsRunning = 0;
+      c.starting = 0;
+      c.started = Never;
+      c.collected = Never;
+      c.initialized = Never;
+      c.vdc->collecting = true;
+      collections.push_back(c);
+      containersPending++;
+    }
+    // now start all of them
+    for (size_t i=0; i<collections.size(); i++) {
+      DeviceClassContainerPtr vdc = collections[i].vdc;
       LOG(LOG_NOTICE,
         "=== collecting devices from vdc %s #%d with dSUID = %s\n",
         vdc->deviceClassIdentifier(),
         vdc->getInstanceNumber(),
         vdc->getDsUid().getString().c_str()
       );
-      nextContainer->second->collectDevices(boost::bind(&DeviceClassCollector::containerQueried, this, _1), incremental, exhaustive, clear);
+      collections[i].started = MainLoop::now();
+      // devices kept by an incremental collect might have changed outputs while the bus or bridge was gone
+      vdc->forgetAppliedHardwareLevels();
+      vdc->collectDevices(boost::bind(&DeviceClassCollector::containerQueried, this, i, _1), incremental, exhaustive, clear);
     }
-    else
-      collectedAll(aError);
+    // all started
+    containerDone();
   }
 
-  void containerQueried(ErrorPtr aError)
+
+  void containerQueried(size_t aIndex, ErrorPtr aError)
   {
+    ContainerCollection &c = collections[aIndex];
+    c.collected = MainLoop::now();
     // load persistent params
-    nextContainer->second->load();
-    // check next
-    ++nextContainer;
-    queryNextContainer(aError);
+    {
+      PHASE_SCOPE("settings load");
+      c.vdc->load();
+    }
+    if (!Error::isOK(aError)) {
+      LOG(LOG_ERR, "=== collecting devices from vdc %s #%d failed: %s\n", c.vdc->deviceClassIdentifier(), c.vdc->getInstanceNumber(), aError->description().c_str());
+      if (!firstError) firstError = aError;
+    }
+    // now have its devices initialized
+    // - even after an error: devices collected before the error are already in the live device list, and would
+    //   otherwise never get initialized and announced (later collects would not retry them either)
+    // Note: devices added to the container until initialisation is complete will be initialized as well,
+    //   because addDevice() does not initialize them as long as the container is collecting
+    c.queried = true;
+    initializeNextDevices(aIndex);
   }
 
 
-  void collectedAll(ErrorPtr aError)
+  /// @return number of devices to initialize in total
+  size_t devicesToInitialize(ContainerCollection &c)
   {
-    // now have each of them initialized
-    nextDevice = deviceContainerP->dSDevices.begin();
-    initializeNextDevice(ErrorPtr());
+    return c.queried ? c.vdc->devices.size() : 0;
   }
 
 
-  void initializeNextDevice(ErrorPtr aError)
+  void initializeNextDevices(size_t aIndex)
   {
-    if (!aError && nextDevice!=deviceContainerP->dSDevices.end())
+    ContainerCollection &c = collections[aIndex];
+    c.starting++; // prevent completing the container from callbacks nested in initializeDevice()
+    int maxInits = c.vdc->maxParallelDeviceInits();
+    while (c.initsRunning<maxInits && c.nextDevice<devicesToInitialize(c)) {
+      DevicePtr dev = c.vdc->devices[c.nextDevice++];
+      c.initsRunning++;
       // TODO: now never doing factory reset init, maybe parametrize later
-      nextDevice->second->initializeDevice(boost::bind(&DeviceClassCollector::deviceInitialized, this, _1), false);
-    else
-      completed(aError);
+      dev->initializeDevice(boost::bind(&DeviceClassCollector::deviceInitialized, this, aIndex, dev, _1), false);
+    }
+    c.starting--;
+    checkContainerReady(aIndex);
   }
 
 
-  void deviceInitialized(ErrorPtr aError)
+  void deviceInitialized(size_t aIndex, DevicePtr aDevice, ErrorPtr aError)
   {
-    LOG(LOG_NOTICE, "--- initialized device: %s",nextDevice->second->description().c_str());
-    // check next
-    ++nextDevice;
-    initializeNextDevice(aError);
+    LOG(LOG_NOTICE, "--- initialized device: %s",aDevice->description().c_str());
+    ContainerCollection &c = collections[aIndex];
+    c.initsRunning--;
+    if (c.nextDevice<devicesToInitialize(c)) {
+      // more to initialize, start next in the slot that just got free
+      initializeNextDevices(aIndex);
+    }
+    else {
+      checkContainerReady(aIndex);
+    }
+  }
+
+
+  void checkContainerReady(size_t aIndex)
+  {
+    ContainerCollection &c = collections[aIndex];
+    if (c.starting>0 || c.initsRunning>0 || c.nextDevice<devicesToInitialize(c)) return; // not yet done
+    c.initialized = MainLoop::now();
+    c.vdc->collecting = false;
+    LOG(LOG_NOTICE,
+      "=== vdc %s #%d ready: %d devices, collected in %lld mS, initialized in %lld mS\n",
+      c.vdc->deviceClassIdentifier(),
+      c.vdc->getInstanceNumber(),
+      (int)c.vdc->devices.size(),
+      (long long)(c.collected-c.started)/MilliSecond,
+      (long long)(c.initialized-c.collected)/MilliSecond
+    );
+    // this container and its devices can be announced now
+    deviceContainerP->startAnnouncing();
+    containerDone();
+  }
+
+
+  void containerDone()
+  {
+    if (--containersPending>0) return; // not all containers done yet
+    completed(firstError);
   }
 
 
   void completed(ErrorPtr aError)
   {
+    // startup timing breakdown
+    for (ContainerCollectionVector::iterator pos = collections.begin(); pos!=collections.end(); ++pos) {
+      string vdcid = string_format("%s#%d", pos->vdc->deviceClassIdentifier(), pos->vdc->getInstanceNumber());
+      globalPhaseProfiler.addPhase("collect "+vdcid, pos->started, pos->collected);
+      globalPhaseProfiler.addPhase("device init "+vdcid, pos->collected, pos->initialized);
+    }
+    globalPhaseProfiler.finishReport();
+    LOG(LOG_NOTICE, "=== collecting and initializing all devices took %lld mS\n", (long long)(MainLoop::now()-started)/MilliSecond);
+    for (ContainerCollectionVector::iterator pos = collections.begin(); pos!=collections.end(); ++pos) {
+      LOG(LOG_NOTICE,
+        "- vdc %s #%d: %d devices, collected after %lld mS, ready after %lld mS\n",
+        pos->vdc->deviceClassIdentifier(),
+        pos->vdc->getInstanceNumber(),
+        (int)pos->vdc->devices.size(),
+        (long long)(pos->collected-started)/MilliSecond,
+        (long long)(pos->initialized-started)/MilliSecond
+      );
+    }
+    deviceContainerP->dsParamStore.endPreload(); // free preloaded settings
     callback(aError);
     deviceContainerP->collecting = false;
+    // confirm restored output states with actual hardware in the background
+    deviceContainerP->startOutputResync();
     // done, delete myself
     delete this;
   }
@@ -394,7 +545,16 @@ void DeviceContainer::collectDevices(StatusCB aCompletedCB, bool aIncremental, b
         resetAnnouncing();
         activeSessionConnection.reset(); // forget connection
       }
-      dSDevices.clear(); // forget existing ones
+      // forget existing ones
+      for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
+        addressableIndex.erase(pos->first);
+      }
+      dSDevices.clear();
+      lastAddressed.reset(); // invalidate lookup cache
+      localClickIndex.clear(); // release devices
+      localClickIndexValid = false;
+      // all devices will load their settings: read settings tables at once rather than one query per device
+      dsParamStore.startPreload();
     }
     DeviceClassCollector::collectDevices(this, aCompletedCB, aIncremental, aExhaustive, aClearSettings);
   }
@@ -414,19 +574,24 @@ bool DeviceContainer::addDevice(DevicePtr aDevice)
   if (!aDevice)
     return false; // no device, nothing added
   // check if device with same dSUID already exists
-  DsDeviceMap::iterator pos = dSDevices.find(aDevice->getDsUid());
-  if (pos!=dSDevices.end()) {
+  if (addressableIndex.find(aDevice->getDsUid())!=addressableIndex.end()) {
     LOG(LOG_INFO, "- device %s already registered, not added again\n",aDevice->shortDesc().c_str());
     return false; // duplicate dSUID, not added
   }
-  // set for given dSUID in the container-wide map of devices
+  // set for given dSUID in the container-wide map of devices and the lookup index
   dSDevices[aDevice->getDsUid()] = aDevice;
+  addressableIndex[aDevice->getDsUid()] = aDevice;
+  lastAddressed.reset(); // invalidate lookup cache
   LOG(LOG_NOTICE,"--- added device: %s (not yet initialized)\n",aDevice->shortDesc().c_str());
   // load the device's persistent params
-  aDevice->load();
+  {
+    PHASE_SCOPE("settings load");
+    aDevice->load();
+  }
+  localClickIndexValid = false; // new device might be a light
   // if not collecting, initialize device right away.
-  // Otherwise, initialisation will be done when collecting is complete
-  if (!collecting) {
+  // Otherwise, initialisation will be done when collecting its class container is complete
+  if (!collecting || !aDevice->classContainerP->isCollecting()) {
     aDevice->initializeDevice(boost::bind(&DeviceContainer::deviceInitialized, this, aDevice), false);
   }
   return true;
@@ -453,8 +618,13 @@ void DeviceContainer::removeDevice(DevicePtr aDevice, bool aForget)
     // save, as we don't want to forget the settings associated with the device
     aDevice->save();
   }
-  // remove from container-wide map of devices
+  // remove from container-wide map of devices and the lookup index
   dSDevices.erase(aDevice->getDsUid());
+  addressableIndex.erase(aDevice->getDsUid());
+  lastAddressed.reset(); // invalidate lookup cache
+  localClickIndex.clear(); // release device
+  localClickIndexValid = false;
+  presenceScheduler->forget(aDevice->getDsUid());
   LOG(LOG_NOTICE,"--- removed device: %s\n", aDevice->shortDesc().c_str());
 }
 
@@ -559,6 +729,8 @@ bool DeviceContainer::signalDeviceUserAction(Device &aDevice, bool aRegular)
 #define PERIODIC_TASK_FORCE_INTERVAL (1*Minute)
 
 #define ACTIVITY_PAUSE_INTERVAL (1*Second)
+#define SAVE_SWEEP_TIME_BUDGET (50*MilliSecond) ///< max time spent saving in one periodic run
+#define SAVE_SWEEP_CONTINUE_INTERVAL (500*MilliSecond) ///< interval for continuing an incomplete save sweep
 
 void DeviceContainer::periodicTask(MLMicroSeconds aCycleStartTime)
 {
@@ -573,23 +745,26 @@ void DeviceContainer::periodicTask(MLMicroSeconds aCycleStartTime)
     if (!collecting) {
       // check again for devices that need to be announced
       startAnnouncing();
-      // do a save run as well
-      // - myself
-      save();
-      // - device containers
-      for (ContainerMap::iterator pos = deviceClassContainers.begin(); pos!=deviceClassContainers.end(); ++pos) {
-        pos->second->save();
+      // do a save run as well, unless too much has been written recently
+      if (dsParamStore.writeBudgetExceeded()) {
+        // postpone, changes accumulate in memory meanwhile
+        deferredSaveSweeps++;
+        saveSweepIncomplete = false; // no point in retrying at the faster rate
       }
-      // - devices
-      for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
-        pos->second->save();
+      else {
+        saveSweepIncomplete = !saveSweep();
       }
     }
   }
+  else {
+    // sweep deferred because of activity, continue at the normal interval
+    saveSweepIncomplete = false;
+  }
   if (mainloopStatsInterval>0) {
     // show mainloop statistics
     if (mainLoopStatsCounter<=0) {
       LOG(LOG_INFO, "%s", MainLoop::currentMainLoop().description().c_str());
+      LOG(LOG_INFO, "Settings dirty list length: %d", (int)dsParamStore.dirtyListLength());
       MainLoop::currentMainLoop().statistics_reset();
       mainLoopStatsCounter = mainloopStatsInterval;
     }
@@ -598,7 +773,59 @@ void DeviceContainer::periodicTask(MLMicroSeconds aCycleStartTime)
     }
   }
   // schedule next run
-  periodicTaskTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::periodicTask, this, _1), PERIODIC_TASK_INTERVAL);
+  periodicTaskTicket = MainLoop::currentMainLoop().executeOnce(
+    boost::bind(&DeviceContainer::periodicTask, this, _1),
+    saveSweepIncomplete ? SAVE_SWEEP_CONTINUE_INTERVAL : PERIODIC_TASK_INTERVAL
+  );
+}
+
+
+bool DeviceContainer::saveSweep()
+{
+  // all saves of one sweep are done in a single transaction, so dirty rows do not cause a disk sync each
+  dsParamStore.beginTransaction();
+  MLMicroSeconds budgetEnd = MainLoop::now()+SAVE_SWEEP_TIME_BUDGET;
+  // only parameter sets which have changed are in the dirty list, so there's no need to visit every device.
+  // Only process what was dirty at the start of the sweep, everything dirtied while saving waits for the next sweep.
+  size_t toSave = dsParamStore.dirtyListLength();
+  size_t failed = 0;
+  while (toSave>0) {
+    if (MainLoop::now()>budgetEnd) break; // time budget exhausted, continue in next run
+    PersistentParams *paramsP = dsParamStore.popDirty();
+    if (!paramsP) break; // list got shorter because parents also saved dirty children
+    --toSave;
+    ErrorPtr err = paramsP->saveDirty();
+    if (!Error::isOK(err) && paramsP->isDirty()) {
+      // could not save, retry in a later sweep
+      paramsP->markDirty();
+      failed++;
+    }
+  }
+  ErrorPtr err = dsParamStore.commitTransaction();
+  if (!Error::isOK(err)) {
+    // Note: the param store has marked all parameter sets saved in the failed transaction dirty again
+    LOG(LOG_ERR, "Error committing settings save sweep: %s\n", err->description().c_str());
+  }
+  // complete if nothing but failed saves remain (no point in retrying these at a faster rate)
+  return dsParamStore.dirtyListLength()<=failed;
+}
+
+
+void DeviceContainer::flushSettings()
+{
+  dsParamStore.beginTransaction();
+  // saving parents also saves their dirty children, and children might need their parent saved first,
+  // so allow for some extra rounds, but not forever in case saves fail
+  size_t maxSaves = 2*dsParamStore.dirtyListLength();
+  PersistentParams *paramsP;
+  while (maxSaves-->0 && (paramsP = dsParamStore.popDirty())!=NULL) {
+    paramsP->saveDirty();
+  }
+  ErrorPtr err = dsParamStore.commitTransaction();
+  if (!Error::isOK(err)) {
+    LOG(LOG_ERR, "Error committing settings flush: %s\n", err->description().c_str());
+  }
+  dsParamStore.flushWriteBehind();
 }
 
 
@@ -659,38 +886,44 @@ void DeviceContainer::handleClickLocally(ButtonBehaviour &aButtonBehaviour, DsCl
       channeltype = aButtonBehaviour.buttonChannel;
     }
     signalActivity(); // local activity
-    // some action to perform on every light device
-    for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
-      DevicePtr dev = pos->second;
+    TRACE_SCOPE("localClick", string_format("%d zone-lookup", scene));
+    // target lights: all lights in the button's zone (zone 0 = all lights)
+    if (!localClickIndexValid)
+      updateLocalClickIndex();
+    int zone = aButtonBehaviour.device.getZoneID();
+    LocalClickIndex::iterator zpos = localClickIndex.find(zone);
+    if (zpos==localClickIndex.end())
+      return; // no lights in this zone
+    LocalClickTargets &targets = zpos->second;
+    for (LocalClickTargets::iterator pos = targets.begin(); pos!=targets.end(); ++pos) {
+      Device *dev = pos->first.get();
+      LightBehaviour *l = pos->second;
       if (scene==STOP_S) {
         // stop dimming
         dev->dimChannelForArea(channeltype, dimmode_stop, 0, 0);
       }
       else {
         // call scene or start dimming
-        LightBehaviourPtr l = boost::dynamic_pointer_cast<LightBehaviour>(dev->output);
-        if (l) {
-          // - figure out direction if not already known
-          if (localDimDirection==0 && l->brightness->getLastSync()!=Never) {
-            // get initial direction from current value of first encountered light with synchronized brightness value
-            localDimDirection = l->brightness->getChannelValue() >= l->brightness->getMinDim() ? -1 : 1;
-          }
-          if (scene==INC_S) {
-            // Start dimming
-            // - minimum scene if not already there
-            if (localDimDirection>0 && l->brightness->getChannelValue()==0) {
-              // starting dimming up from 0, first call MIN_S
-              dev->callScene(MIN_S, true);
-            }
-            // now dim (safety timeout after 10 seconds)
-            dev->dimChannelForArea(channeltype, localDimDirection>0 ? dimmode_up : dimmode_down, 0, 10*Second);
-          }
-          else {
-            // call a scene
-            if (localDimDirection<0)
-              scene = T0_S0; // switching off a scene = call off scene
-            dev->callScene(scene, true);
+        // - figure out direction if not already known
+        if (localDimDirection==0 && l->brightness->getLastSync()!=Never) {
+          // get initial direction from current value of first encountered light with synchronized brightness value
+          localDimDirection = l->brightness->getChannelValue() >= l->brightness->getMinDim() ? -1 : 1;
+        }
+        if (scene==INC_S) {
+          // Start dimming
+          // - minimum scene if not already there
+          if (localDimDirection>0 && l->brightness->getChannelValue()==0) {
+            // starting dimming up from 0, first call MIN_S
+            dev->callScene(MIN_S, true);
           }
+          // now dim (safety timeout after 10 seconds)
+          dev->dimChannelForArea(channeltype, localDimDirection>0 ? dimmode_up : dimmode_down, 0, 10*Second);
+        }
+        else {
+          // call a scene
+          if (localDimDirection<0)
+            scene = T0_S0; // switching off a scene = call off scene
+          dev->callScene(scene, true);
         }
       }
     }
@@ -698,6 +931,25 @@ void DeviceContainer::handleClickLocally(ButtonBehaviour &aButtonBehaviour, DsCl
 }
 
 
+void DeviceContainer::updateLocalClickIndex()
+{
+  localClickIndex.clear();
+  LocalClickTargets &allLights = localClickIndex[0]; // zone 0 is the broadcast zone, contains all lights
+  for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
+    DevicePtr dev = pos->second;
+    LightBehaviour *l = dynamic_cast<LightBehaviour *>(dev->output.get());
+    if (!l) continue; // only lights are operated locally
+    allLights.push_back(make_pair(dev, l));
+    int zone = dev->getZoneID();
+    if (zone!=0) {
+      localClickIndex[zone].push_back(make_pair(dev, l));
+    }
+  }
+  localClickIndexValid = true;
+  LOG(LOG_DEBUG, "local click index rebuilt: %zu lights in %zu zones\n", allLights.size(), localClickIndex.size()-1);
+}
+
+
 
 #pragma mark - vDC API
 
@@ -777,21 +1029,8 @@ void DeviceContainer::vdcApiRequestHandler(VdcApiConnectionPtr aApiConnection, V
       ApiValuePtr o;
       respErr = checkParam(aParams, "dSUID", o);
       if (Error::isOK(respErr)) {
-        DsUid dsuid;
         // can be single dSUID or array of dSUIDs
-        if (o->isType(apivalue_array)) {
-          // array of dSUIDs
-          for (int i=0; i<o->arrayLength(); i++) {
-            ApiValuePtr e = o->arrayGet(i);
-            dsuid.setAsBinary(e->binaryValue());
-            handleNotificationForDsUid(aMethod, dsuid, aParams);
-          }
-        }
-        else {
-          // single dSUID
-          dsuid.setAsBinary(o->binaryValue());
-          handleNotificationForDsUid(aMethod, dsuid, aParams);
-        }
+        handleNotificationForDsUids(aMethod, o, aParams);
       }
     }
     else {
@@ -919,17 +1158,16 @@ DsAddressablePtr DeviceContainer::addressableForParams(const DsUid &aDsUid, ApiV
   }
   else {
     // Must be device or deviceClassContainer level method
-    // - find device to handle it (more probable case)
-    DsDeviceMap::iterator pos = dSDevices.find(aDsUid);
-    if (pos!=dSDevices.end()) {
-      return pos->second;
+    // - consecutive requests (e.g. grouped members of a batch) often address the same entity
+    if (lastAddressed && aDsUid==lastAddressedDsUid) {
+      return lastAddressed;
     }
-    else {
-      // is not a device, try deviceClassContainer
-      ContainerMap::iterator pos = deviceClassContainers.find(aDsUid);
-      if (pos!=deviceClassContainers.end()) {
-        return pos->second;
-      }
+    // - find device or deviceClassContainer to handle it (hashed, one lookup for both)
+    DsAddressableIndex::iterator pos = addressableIndex.find(aDsUid);
+    if (pos!=addressableIndex.end()) {
+      lastAddressed = pos->second;
+      lastAddressedDsUid = aDsUid;
+      return lastAddressed;
     }
   }
   // not found
@@ -960,6 +1198,7 @@ ErrorPtr DeviceContainer::handleMethodForDsUid(const string &aMethod, VdcApiRequ
 
 void DeviceContainer::handleNotificationForDsUid(const string &aMethod, const DsUid &aDsUid, ApiValuePtr aParams)
 {
+  TRACE_SCOPE("handleNotification", aMethod+" "+aDsUid.getString());
   DsAddressablePtr addressable = addressableForParams(aDsUid, aParams);
   if (addressable) {
     addressable->handleNotification(aMethod, aParams);
@@ -970,6 +1209,140 @@ void DeviceContainer::handleNotificationForDsUid(const string &aMethod, const Ds
 }
 
 
+void DeviceContainer::resolveNotificationTargets(const string &aMethod, ApiValuePtr aDsUids, ApiValuePtr aParams, DsAddressableVector &aTargets)
+{
+  DsUid dsuid;
+  DsAddressablePtr itemSpecTarget; // empty dSUIDs all resolve to the same x-p44-itemSpec/root target
+  bool itemSpecResolved = false;
+  aTargets.reserve(aDsUids->arrayLength());
+  for (int i=0; i<aDsUids->arrayLength(); i++) {
+    dsuid.setAsBinary(aDsUids->arrayGet(i)->binaryValue());
+    DsAddressablePtr addressable;
+    if (dsuid.empty()) {
+      if (!itemSpecResolved) {
+        itemSpecTarget = addressableForParams(dsuid, aParams);
+        itemSpecResolved = true;
+      }
+      addressable = itemSpecTarget;
+    }
+    else {
+      addressable = addressableForParams(dsuid, aParams);
+    }
+    if (addressable) {
+      aTargets.push_back(addressable);
+    }
+    else {
+      LOG(LOG_WARNING, "Target entity %s not found for notification '%s'\n", dsuid.getString().c_str(), aMethod.c_str());
+    }
+  }
+}
+
+
+void DeviceContainer::handleNotificationForDsUids(const string &aMethod, ApiValuePtr aDsUids, ApiValuePtr aParams)
+{
+  if (!aDsUids->isType(apivalue_array)) {
+    // single dSUID
+    DsUid dsuid;
+    dsuid.setAsBinary(aDsUids->binaryValue());
+    handleNotificationForDsUid(aMethod, dsuid, aParams);
+    return;
+  }
+  TRACE_SCOPE("handleNotification", string_format("%s x %d", aMethod.c_str(), aDsUids->arrayLength()));
+  // resolve all targets and parse the parameters once, then just dispatch
+  DsAddressableVector targets;
+  resolveNotificationTargets(aMethod, aDsUids, aParams, targets);
+  DeviceNotification notification(aMethod, aParams);
+  if (Error::isOK(notification.err) && targets.size()>1) {
+    if (notification.kind==DeviceNotification::notify_callScene) {
+      // callScene for multiple targets: let vDCs apply scene to their set of devices at once
+      DeviceSetVector sets;
+      DsAddressableVector others;
+      groupDevicesByClass(targets, sets, &others);
+      for (DsAddressableVector::iterator tpos = others.begin(); tpos!=others.end(); ++tpos) {
+        (*tpos)->handleNotification(aMethod, aParams);
+      }
+      for (DeviceSetVector::iterator pos = sets.begin(); pos!=sets.end(); ++pos) {
+        LOG(LOG_DEBUG, "callScene %d for set of %d devices in vDC %s\n", notification.sceneNo, (int)pos->second.size(), pos->first->shortDesc().c_str());
+        pos->first->callSceneOnDevices(pos->second, notification.sceneNo, notification.force);
+      }
+      return;
+    }
+    if (
+      notification.kind==DeviceNotification::notify_commitPreloaded ||
+      (notification.kind==DeviceNotification::notify_setOutputChannelValue && notification.applyNow)
+    ) {
+      // applying values to multiple targets: first prepare all, then commit all in the same mainloop cycle,
+      // so outputs spanning multiple vDCs change as simultaneously as possible
+      DeviceSetVector sets;
+      DsAddressableVector others;
+      groupDevicesByClass(targets, sets, &others);
+      // targets not being devices just get the notification as usual
+      for (DsAddressableVector::iterator tpos = others.begin(); tpos!=others.end(); ++tpos) {
+        (*tpos)->handleNotification(aMethod, aParams);
+      }
+      if (notification.kind==DeviceNotification::notify_setOutputChannelValue) {
+        // preload the new value into all devices first
+        notification.applyNow = false;
+        for (DeviceSetVector::iterator pos = sets.begin(); pos!=sets.end(); ++pos) {
+          for (DeviceVector::iterator dpos = pos->second.begin(); dpos!=pos->second.end(); ++dpos) {
+            (*dpos)->handleDeviceNotification(notification);
+          }
+        }
+      }
+      commitPreparedDeviceSets(sets);
+      return;
+    }
+  }
+  // dispatch one by one
+  for (DsAddressableVector::iterator tpos = targets.begin(); tpos!=targets.end(); ++tpos) {
+    Device *dev = dynamic_cast<Device *>(tpos->get());
+    if (dev) {
+      // device: dispatch already parsed notification
+      dev->handleDeviceNotification(notification);
+    }
+    else {
+      (*tpos)->handleNotification(aMethod, aParams);
+    }
+  }
+}
+
+
+void DeviceContainer::groupDevicesByClass(DsAddressableVector &aTargets, DeviceSetVector &aSets, DsAddressableVector *aNonDevicesP)
+{
+  // sets in order of first appearance of their class container in aTargets
+  for (DsAddressableVector::iterator tpos = aTargets.begin(); tpos!=aTargets.end(); ++tpos) {
+    Device *dev = dynamic_cast<Device *>(tpos->get());
+    if (!dev) {
+      // not a device
+      if (aNonDevicesP) aNonDevicesP->push_back(*tpos);
+      continue;
+    }
+    DeviceClassContainer *cc = &dev->getClassContainer();
+    DeviceSetVector::iterator pos;
+    for (pos = aSets.begin(); pos!=aSets.end(); ++pos) {
+      if (pos->first==cc) break;
+    }
+    if (pos==aSets.end()) {
+      aSets.push_back(make_pair(cc, DeviceVector()));
+      pos = aSets.end()-1;
+    }
+    pos->second.push_back(DevicePtr(dev));
+  }
+}
+
+
+void DeviceContainer::commitPreparedDeviceSets(DeviceSetVector &aSets)
+{
+  // all values are prepared now, let all class containers commit their sets back-to-back
+  TRACE_SCOPE("commitPrepared", string_format("%d vDCs", (int)aSets.size()));
+  MLMicroSeconds start = MainLoop::now();
+  for (DeviceSetVector::iterator pos = aSets.begin(); pos!=aSets.end(); ++pos) {
+    pos->first->commitPreparedDevices(pos->second);
+  }
+  LOG(LOG_INFO, "Committed preloaded values to %d vDCs, dispatching took %lld uS\n", (int)aSets.size(), MainLoop::now()-start);
+}
+
+
 
 #pragma mark - vDC level methods and notifications
 
@@ -1006,6 +1379,8 @@ void DeviceContainer::resetAnnouncing()
 {
   // end pending announcement
   MainLoop::currentMainLoop().cancelExecutionTicket(announcementTicket);
+  announceRefillScheduled = false;
+  pendingAnnouncements.clear();
   // end all device sessions
   for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
     DevicePtr dev = pos->second;
@@ -1025,55 +1400,136 @@ void DeviceContainer::resetAnnouncing()
 /// start announcing all not-yet announced entities to the vdSM
 void DeviceContainer::startAnnouncing()
 {
-  if (!collecting && announcementTicket==0 && activeSessionConnection) {
+  if (announcementTicket==0 && activeSessionConnection) {
     announceNext();
   }
 }
 
 
+void DeviceContainer::setAnnounceWindow(int aWindow)
+{
+  announceWindow = aWindow>0 ? aWindow : 1;
+}
+
+
+
+#pragma mark - background re-sync of restored output states
+
+
+void DeviceContainer::setOutputResyncInterval(MLMicroSeconds aInterval)
+{
+  outputResyncInterval = aInterval;
+}
+
+
+void DeviceContainer::startOutputResync()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(outputResyncTicket);
+  if (outputResyncInterval<=0) return; // background re-sync disabled
+  outputResyncPos = DsUid(); // start from beginning
+  outputResyncTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::outputResyncNext, this), outputResyncInterval);
+}
+
+
+void DeviceContainer::outputResyncNext()
+{
+  outputResyncTicket = 0;
+  // find next device still showing restored rather than actual output values, and able to read back actual values
+  // Note: iterating by dSUID rather than keeping an iterator, as devices might get removed in between
+  DsDeviceMap::iterator pos = outputResyncPos.empty() ? dSDevices.begin() : dSDevices.upper_bound(outputResyncPos);
+  while (pos!=dSDevices.end()) {
+    OutputBehaviourPtr o = pos->second->output;
+    if (o && o->hasRestoredState() && pos->second->canSyncChannelValues()) break;
+    ++pos;
+  }
+  if (pos==dSDevices.end()) {
+    LOG(LOG_INFO, "Background re-sync of restored output states complete\n");
+    return;
+  }
+  outputResyncPos = pos->first;
+  LOG(LOG_INFO, "Background re-sync of restored output state for device %s\n", pos->second->shortDesc().c_str());
+  pos->second->requestUpdatingChannels(boost::bind(&DeviceContainer::outputResyncDone, this));
+}
+
+
+void DeviceContainer::outputResyncDone()
+{
+  // rate limit: next device only after interval
+  if (outputResyncTicket==0) {
+    outputResyncTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::outputResyncNext, this), outputResyncInterval);
+  }
+}
+
+
+/// announce as many not-yet announced entities as the announcement window allows
+/// @note vdcs are announced first, devices only after their vdc's announcement has been acknowledged
 void DeviceContainer::announceNext()
 {
-  if (collecting) return; // prevent announcements during collect.
   // cancel re-announcing
   MainLoop::currentMainLoop().cancelExecutionTicket(announcementTicket);
+  announceRefillScheduled = false;
+  if (!activeSessionConnection) return; // no session to announce to
+  MLMicroSeconds now = MainLoop::now();
+  MLMicroSeconds nextCheck = Never;
+  // expire announcements not acknowledged in time, freeing their slot in the window
+  // Note: these remain marked as announcing and will be retried after ANNOUNCE_RETRY_TIMEOUT
+  for (DsAddressableVector::iterator pos = pendingAnnouncements.begin(); pos!=pendingAnnouncements.end();) {
+    if (now>(*pos)->announcing+ANNOUNCE_TIMEOUT) {
+      LOG(LOG_WARNING, "Announcement for %s %s not acknowledged in time, will be retried later\n", (*pos)->entityType(), (*pos)->shortDesc().c_str());
+      pos = pendingAnnouncements.erase(pos);
+    }
+    else {
+      ++pos;
+    }
+  }
   // announce vdcs first
   for (ContainerMap::iterator pos = deviceClassContainers.begin(); pos!=deviceClassContainers.end(); ++pos) {
+    if ((int)pendingAnnouncements.size()>=announceWindow) break; // window full
     DeviceClassContainerPtr vdc = pos->second;
     if (
+      !vdc->isCollecting() && // only when collecting and initializing devices is complete
       vdc->announced==Never &&
-      (vdc->announcing==Never || MainLoop::now()>vdc->announcing+ANNOUNCE_RETRY_TIMEOUT) &&
       (!vdc->invisibleWhenEmpty() || vdc->getNumberOfDevices()>0)
     ) {
+      if (vdc->announcing!=Never && now<=vdc->announcing+ANNOUNCE_RETRY_TIMEOUT) {
+        // in progress or failed, remember when to retry
+        if (nextCheck==Never || vdc->announcing+ANNOUNCE_RETRY_TIMEOUT<nextCheck) nextCheck = vdc->announcing+ANNOUNCE_RETRY_TIMEOUT;
+        continue;
+      }
       // mark device as being in process of getting announced
-      vdc->announcing = MainLoop::now();
+      vdc->announcing = now;
       // call announcevdc method (need to construct here, because dSUID must be sent as vdcdSUID)
       ApiValuePtr params = getSessionConnection()->newApiValue();
       params->setType(apivalue_object);
       params->add("dSUID", params->newBinary(vdc->getDsUid().getBinary()));
       if (!sendApiRequest("announcevdc", params, boost::bind(&DeviceContainer::announceResultHandler, this, vdc, _2, _3, _4))) {
         LOG(LOG_ERR, "Could not send vdc announcement message for %s %s\n", vdc->entityType(), vdc->shortDesc().c_str());
-        vdc->announcing = Never; // not registering
+        // remains marked as announcing, make sure it gets retried after ANNOUNCE_RETRY_TIMEOUT
+        if (nextCheck==Never || now+ANNOUNCE_RETRY_TIMEOUT<nextCheck) nextCheck = now+ANNOUNCE_RETRY_TIMEOUT;
       }
       else {
         LOG(LOG_NOTICE, "Sent vdc announcement for %s %s\n", vdc->entityType(), vdc->shortDesc().c_str());
+        pendingAnnouncements.push_back(vdc);
       }
-      // schedule a retry
-      announcementTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::announceNext, this), ANNOUNCE_TIMEOUT);
-      // done for now, continues after ANNOUNCE_TIMEOUT or when registration acknowledged
-      return;
     }
   }
   // check all devices for unnannounced ones and announce those
   for (DsDeviceMap::iterator pos = dSDevices.begin(); pos!=dSDevices.end(); ++pos) {
+    if ((int)pendingAnnouncements.size()>=announceWindow) break; // window full
     DevicePtr dev = pos->second;
     if (
       dev->isPublicDS() && // only public ones
+      !dev->classContainerP->isCollecting() && // not while class container is (re-)collecting
       (dev->classContainerP->announced!=Never) && // class container must have already completed an announcement
-      dev->announced==Never &&
-      (dev->announcing==Never || MainLoop::now()>dev->announcing+ANNOUNCE_RETRY_TIMEOUT)
+      dev->announced==Never
     ) {
+      if (dev->announcing!=Never && now<=dev->announcing+ANNOUNCE_RETRY_TIMEOUT) {
+        // in progress or failed, remember when to retry
+        if (nextCheck==Never || dev->announcing+ANNOUNCE_RETRY_TIMEOUT<nextCheck) nextCheck = dev->announcing+ANNOUNCE_RETRY_TIMEOUT;
+        continue;
+      }
       // mark device as being in process of getting announced
-      dev->announcing = MainLoop::now();
+      dev->announcing = now;
       // call announce method
       ApiValuePtr params = getSessionConnection()->newApiValue();
       params->setType(apivalue_object);
@@ -1081,32 +1537,52 @@ void DeviceContainer::announceNext()
       params->add("vdc_dSUID", params->newBinary(dev->classContainerP->getDsUid().getBinary()));
       if (!dev->sendRequest("announcedevice", params, boost::bind(&DeviceContainer::announceResultHandler, this, dev, _2, _3, _4))) {
         LOG(LOG_ERR, "Could not send device announcement message for %s %s\n", dev->entityType(), dev->shortDesc().c_str());
-        dev->announcing = Never; // not registering
+        // remains marked as announcing, make sure it gets retried after ANNOUNCE_RETRY_TIMEOUT
+        if (nextCheck==Never || now+ANNOUNCE_RETRY_TIMEOUT<nextCheck) nextCheck = now+ANNOUNCE_RETRY_TIMEOUT;
       }
       else {
         LOG(LOG_NOTICE, "Sent device announcement for %s %s\n", dev->entityType(), dev->shortDesc().c_str());
+        pendingAnnouncements.push_back(dev);
       }
-      // schedule a retry
-      announcementTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::announceNext, this), ANNOUNCE_TIMEOUT);
-      // done for now, continues after ANNOUNCE_TIMEOUT or when registration acknowledged
-      return;
     }
   }
+  // check again when the first outstanding announcement times out, or a failed one is due for retry
+  for (DsAddressableVector::iterator pos = pendingAnnouncements.begin(); pos!=pendingAnnouncements.end(); ++pos) {
+    if (nextCheck==Never || (*pos)->announcing+ANNOUNCE_TIMEOUT<nextCheck) nextCheck = (*pos)->announcing+ANNOUNCE_TIMEOUT;
+  }
+  if (nextCheck!=Never) {
+    announcementTicket = MainLoop::currentMainLoop().executeOnceAt(boost::bind(&DeviceContainer::announceNext, this), nextCheck+1);
+  }
+  // continues when announcements are acknowledged or at nextCheck
 }
 
 
 void DeviceContainer::announceResultHandler(DsAddressablePtr aAddressable, VdcApiRequestPtr aRequest, ErrorPtr &aError, ApiValuePtr aResultOrErrorData)
 {
+  // free the slot in the window (unless already expired)
+  for (DsAddressableVector::iterator pos = pendingAnnouncements.begin(); pos!=pendingAnnouncements.end(); ++pos) {
+    if (*pos==aAddressable) {
+      pendingAnnouncements.erase(pos);
+      break;
+    }
+  }
   if (Error::isOK(aError)) {
     // set device announced successfully
     LOG(LOG_NOTICE, "Announcement for %s %s acknowledged by vdSM\n", aAddressable->entityType(), aAddressable->shortDesc().c_str());
     aAddressable->announced = MainLoop::now();
     aAddressable->announcing = Never; // not announcing any more
+    globalPhaseProfiler.milestone("first announcement");
+  }
+  else {
+    // remains marked as announcing, will be retried after ANNOUNCE_RETRY_TIMEOUT
+    LOG(LOG_WARNING, "Announcement for %s %s failed: %s\n", aAddressable->entityType(), aAddressable->shortDesc().c_str(), aError ? aError->description().c_str() : "<no error info>");
+  }
+  // refill window after a pause (not postponed by more acknowledgements arriving in the meantime)
+  if (!announceRefillScheduled) {
+    MainLoop::currentMainLoop().cancelExecutionTicket(announcementTicket);
+    announcementTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::announceNext, this), ANNOUNCE_PAUSE);
+    announceRefillScheduled = true;
   }
-  // cancel retry timer
-  MainLoop::currentMainLoop().cancelExecutionTicket(announcementTicket);
-  // try next announcement, after a pause
-  announcementTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&DeviceContainer::announceNext, this), ANNOUNCE_PAUSE);
 }
 
 
@@ -1133,13 +1609,38 @@ void DeviceContainer::handleNotification(const string &aMethod, ApiValuePtr aPar
 static char devicecontainer_key;
 static char vdc_container_key;
 static char vdc_key;
+static char settingswrites_key;
+static char settingswrites_tables_key;
+static char settingswrites_table_key;
+static char settingswrites_tablestats_key;
 
 enum {
   vdcs_key,
   webui_url_key,
+  dirtySettings_key,
+  settingsWrites_key,
+  presenceChecks_key,
   numDeviceContainerProperties
 };
 
+enum {
+  rowWrites_key,
+  rowDeletes_key,
+  bytesWritten_key,
+  writeBudget_key,
+  writeBudgetExceeded_key,
+  deferredSaveSweeps_key,
+  tables_key,
+  numSettingsWritesProperties
+};
+
+enum {
+  tableRowWrites_key,
+  tableRowDeletes_key,
+  tableBytesWritten_key,
+  numTableWritesProperties
+};
+
 
 
 int DeviceContainer::numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor)
@@ -1147,6 +1648,15 @@ int DeviceContainer::numProps(int aDomain, PropertyDescriptorPtr aParentDescript
   if (aParentDescriptor && aParentDescriptor->hasObjectKey(vdc_container_key)) {
     return (int)deviceClassContainers.size();
   }
+  else if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_key)) {
+    return numSettingsWritesProperties;
+  }
+  else if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_tables_key)) {
+    return (int)dsParamStore.getTableWriteStats().size();
+  }
+  else if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_table_key)) {
+    return numTableWritesProperties;
+  }
   return inherited::numProps(aDomain, aParentDescriptor)+numDeviceContainerProperties;
 }
 
@@ -1156,8 +1666,45 @@ PropertyDescriptorPtr DeviceContainer::getDescriptorByIndex(int aPropIndex, int
 {
   static const PropertyDescription properties[numDeviceContainerProperties] = {
     { "x-p44-vdcs", apivalue_object+propflag_container, vdcs_key, OKEY(vdc_container_key) },
-    { "configURL", apivalue_string, webui_url_key, OKEY(devicecontainer_key) }
+    { "configURL", apivalue_string, webui_url_key, OKEY(devicecontainer_key) },
+    { "x-p44-dirtySettings", apivalue_uint64, dirtySettings_key, OKEY(devicecontainer_key) },
+    { "x-p44-settingsWrites", apivalue_object+propflag_container, settingsWrites_key, OKEY(settingswrites_key) },
+    { "x-p44-presenceChecks", apivalue_object, presenceChecks_key, OKEY(devicecontainer_key) }
   };
+  static const PropertyDescription settingsWritesProperties[numSettingsWritesProperties] = {
+    { "rowWrites", apivalue_uint64, rowWrites_key, OKEY(settingswrites_key) },
+    { "rowDeletes", apivalue_uint64, rowDeletes_key, OKEY(settingswrites_key) },
+    { "bytesWritten", apivalue_uint64, bytesWritten_key, OKEY(settingswrites_key) },
+    { "writeBudget", apivalue_uint64, writeBudget_key, OKEY(settingswrites_key) },
+    { "writeBudgetExceeded", apivalue_bool, writeBudgetExceeded_key, OKEY(settingswrites_key) },
+    { "deferredSaveSweeps", apivalue_uint64, deferredSaveSweeps_key, OKEY(settingswrites_key) },
+    { "tables", apivalue_object+propflag_container, tables_key, OKEY(settingswrites_tables_key) }
+  };
+  static const PropertyDescription tableWritesProperties[numTableWritesProperties] = {
+    { "rowWrites", apivalue_uint64, tableRowWrites_key, OKEY(settingswrites_tablestats_key) },
+    { "rowDeletes", apivalue_uint64, tableRowDeletes_key, OKEY(settingswrites_tablestats_key) },
+    { "bytesWritten", apivalue_uint64, tableBytesWritten_key, OKEY(settingswrites_tablestats_key) }
+  };
+  if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_key)) {
+    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&settingsWritesProperties[aPropIndex], aParentDescriptor));
+  }
+  else if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_tables_key)) {
+    // per-table statistics, named after the table
+    const ParamStore::TableWriteStatsMap &stats = dsParamStore.getTableWriteStats();
+    ParamStore::TableWriteStatsMap::const_iterator pos = stats.begin();
+    for (int i=0; i<aPropIndex && pos!=stats.end(); i++) ++pos;
+    if (pos==stats.end()) return PropertyDescriptorPtr();
+    DynamicPropertyDescriptor *descP = new DynamicPropertyDescriptor(aParentDescriptor);
+    descP->propertyName = pos->first;
+    descP->propertyType = apivalue_object;
+    descP->propertyFieldKey = aPropIndex;
+    descP->propertyObjectKey = OKEY(settingswrites_table_key);
+    descP->arrayContainer = true; // handled by myself
+    return descP;
+  }
+  else if (aParentDescriptor && aParentDescriptor->hasObjectKey(settingswrites_table_key)) {
+    return PropertyDescriptorPtr(new StaticPropertyDescriptor(&tableWritesProperties[aPropIndex], aParentDescriptor));
+  }
   int n = inherited::numProps(aDomain, aParentDescriptor);
   if (aPropIndex<n)
     return inherited::getDescriptorByIndex(aPropIndex, aDomain, aParentDescriptor); // base class' property
@@ -1186,6 +1733,9 @@ PropertyContainerPtr DeviceContainer::getContainer(PropertyDescriptorPtr &aPrope
     // local container
     return PropertyContainerPtr(this); // handle myself
   }
+  else if (aPropertyDescriptor->hasObjectKey(devicecontainer_key) && aPropertyDescriptor->fieldKey()==presenceChecks_key) {
+    return presenceScheduler;
+  }
   else if (aPropertyDescriptor->hasObjectKey(vdc_key)) {
     // - just iterate into map, we'll never have more than a few logical vdcs!
     int i = 0;
@@ -1198,8 +1748,8 @@ PropertyContainerPtr DeviceContainer::getContainer(PropertyDescriptorPtr &aPrope
       i++;
     }
   }
-  // unknown here
-  return NULL;
+  // unknown here, let base class handle it
+  return inherited::getContainer(aPropertyDescriptor, aDomain);
 }
 
 
@@ -1211,6 +1761,42 @@ bool DeviceContainer::accessField(PropertyAccessMode aMode, ApiValuePtr aPropVal
         case webui_url_key:
           aPropValue->setStringValue(webuiURLString());
           return true;
+        case dirtySettings_key:
+          aPropValue->setUint64Value(dsParamStore.dirtyListLength());
+          return true;
+      }
+    }
+  }
+  else if (aPropertyDescriptor->hasObjectKey(settingswrites_key)) {
+    const ParamWriteStats &stats = dsParamStore.getTotalWriteStats();
+    if (aMode==access_read) {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case rowWrites_key: aPropValue->setUint64Value(stats.rowWrites); return true;
+        case rowDeletes_key: aPropValue->setUint64Value(stats.rowDeletes); return true;
+        case bytesWritten_key: aPropValue->setUint64Value(stats.bytesWritten); return true;
+        case writeBudget_key: aPropValue->setUint64Value(dsParamStore.getWriteBudget()); return true;
+        case writeBudgetExceeded_key: aPropValue->setBoolValue(dsParamStore.writeBudgetExceeded()); return true;
+        case deferredSaveSweeps_key: aPropValue->setUint64Value(deferredSaveSweeps); return true;
+      }
+    }
+    else {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case writeBudget_key: dsParamStore.setWriteBudget(aPropValue->uint64Value()); return true;
+      }
+    }
+  }
+  else if (aPropertyDescriptor->hasObjectKey(settingswrites_tablestats_key)) {
+    if (aMode==access_read) {
+      // table is identified by the parent descriptor's index
+      const ParamStore::TableWriteStatsMap &tables = dsParamStore.getTableWriteStats();
+      ParamStore::TableWriteStatsMap::const_iterator pos = tables.begin();
+      for (size_t i=0; i<aPropertyDescriptor->parentDescriptor->fieldKey() && pos!=tables.end(); i++) ++pos;
+      if (pos!=tables.end()) {
+        switch (aPropertyDescriptor->fieldKey()) {
+          case tableRowWrites_key: aPropValue->setUint64Value(pos->second.rowWrites); return true;
+          case tableRowDeletes_key: aPropValue->setUint64Value(pos->second.rowDeletes); return true;
+          case tableBytesWritten_key: aPropValue->setUint64Value(pos->second.bytesWritten); return true;
+        }
       }
     }
   }
@@ -1240,6 +1826,12 @@ ErrorPtr DeviceContainer::save()
 }
 
 
+ErrorPtr DeviceContainer::saveDirty()
+{
+  return save();
+}
+
+
 ErrorPtr DeviceContainer::forget()
 {
   // delete the vdc settings
@@ -31,6 +31,10 @@
 #include "digitalio.hpp"
 
 #include "vdcapi.hpp"
+#include "transitionengine.hpp"
+#include "presencescheduler.hpp"
+
+#include <boost/unordered_map.hpp>
 
 
 using namespace std;
@@ -40,6 +44,7 @@ namespace p44 {
   class DeviceClassContainer;
   class Device;
   class ButtonBehaviour;
+  class LightBehaviour;
   class DsUid;
 
   typedef boost::intrusive_ptr<DeviceClassContainer> DeviceClassContainerPtr;
@@ -70,6 +75,9 @@ namespace p44 {
   typedef boost::intrusive_ptr<DeviceContainer> DeviceContainerPtr;
   typedef map<DsUid, DeviceClassContainerPtr> ContainerMap;
   typedef map<DsUid, DevicePtr> DsDeviceMap;
+  typedef boost::unordered_map<DsUid, DsAddressablePtr, DsUidHash> DsAddressableIndex;
+  typedef vector<DsAddressablePtr> DsAddressableVector;
+  typedef vector<pair<DeviceClassContainer *, vector<DevicePtr> > > DeviceSetVector; ///< devices grouped per class container
 
 
   /// container for all devices hosted by this application
@@ -90,8 +98,13 @@ namespace p44 {
     bool externalDsuid; ///< set when dSUID is set to a external value (usually UUIDv1 based)
     uint64_t mac; ///< MAC address as found at startup
 
-    DsDeviceMap dSDevices; ///< available devices by API-exposed ID (dSUID or derived dsid)
+    DsDeviceMap dSDevices; ///< available devices by API-exposed ID (dSUID or derived dsid), ordered for announcing and enumerating
+    DsAddressableIndex addressableIndex; ///< hashed index of all devices and vdcs by dSUID, for fast lookup of API requests and notifications
+    DsUid lastAddressedDsUid; ///< dSUID of last addressable looked up by addressableForParams()
+    DsAddressablePtr lastAddressed; ///< last addressable looked up, re-used for consecutive requests to the same dSUID
     DsParamStore dsParamStore; ///< the database for storing dS device parameters
+    TransitionEngine transitionEngine; ///< the engine stepping all output transitions
+    PresenceSchedulerPtr presenceScheduler; ///< spreads presence checks of all addressables over time
 
     string iconDir; ///< the directory where to load icons from
     string persistentDataDir; ///< the directory for the vdcd to store SQLite DBs and possibly other persistent data
@@ -102,11 +115,23 @@ namespace p44 {
 
     bool collecting;
     long announcementTicket;
+    int announceWindow; ///< max number of announcements outstanding at the same time
+    bool announceRefillScheduled; ///< set when announceNext() is scheduled to refill the window after an acknowledgement
+    DsAddressableVector pendingAnnouncements; ///< announcements sent but not yet acknowledged
+    MLMicroSeconds outputResyncInterval; ///< min time between background re-syncs of restored output states, 0=none
+    long outputResyncTicket;
+    DsUid outputResyncPos; ///< dSUID of the device last re-synced
     long periodicTaskTicket;
     MLMicroSeconds lastActivity;
     MLMicroSeconds lastPeriodicRun;
+    bool saveSweepIncomplete; ///< set if last save sweep ran out of time budget
+    long deferredSaveSweeps; ///< number of save sweeps postponed because the write budget was exceeded
 
     int8_t localDimDirection;
+    typedef vector<pair<DevicePtr, LightBehaviour *> > LocalClickTargets;
+    typedef map<int, LocalClickTargets> LocalClickIndex;
+    LocalClickIndex localClickIndex; ///< light devices by zoneID for local click handling, zone 0 contains all lights
+    bool localClickIndexValid; ///< set when localClickIndex reflects the current devices and zones
 
     // learning
     bool learningMode;
@@ -130,6 +155,7 @@ namespace p44 {
   public:
 
     DeviceContainer();
+    virtual ~DeviceContainer();
 
     /// the list of containers by API-exposed ID (dSUID or derived dsid)
     ContainerMap deviceClassContainers;
@@ -177,6 +203,25 @@ namespace p44 {
     /// @param aInterval 0=none, N=every PERIODIC_TASK_INTERVAL*N seconds
     void setMainloopStatsInterval(int aInterval) { mainloopStatsInterval = aInterval; };
 
+    /// Set how many announcements may be outstanding (sent but not yet acknowledged by the vdSM) at the same time
+    /// @param aWindow max number of outstanding announcements, 1 means strictly one after the other
+    void setAnnounceWindow(int aWindow);
+
+    /// Set how fast restored output states are confirmed by reading back actual values from the hardware
+    /// @param aInterval min time between re-syncing two devices in the background after startup, 0=no background re-sync
+    /// @note outputs show the last known state from the previous run right after startup, and devices which can
+    ///   read back their output state do so in the background, one by one, to keep the load on the buses low.
+    void setOutputResyncInterval(MLMicroSeconds aInterval);
+
+    /// Set flash write budget for saving settings
+    /// @param aBytesPerHour amount of settings data that may be written per hour on average, 0=unlimited.
+    ///   When exceeded, periodic saving of settings is postponed until the budget allows writing again.
+    void setSettingsWriteBudget(uint64_t aBytesPerHour) { dsParamStore.setWriteBudget(aBytesPerHour); };
+
+    /// save all unsaved settings now, regardless of write budget, and wait until they are written
+    /// @note to be called before exiting, such that no settings are lost on a clean shutdown
+    void flushSettings();
+
     /// @return MAC address as 12 char hex string (6 bytes)
     string macAddressString();
 
@@ -246,6 +291,12 @@ namespace p44 {
     /// get the dsParamStore
     DsParamStore &getDsParamStore() { return dsParamStore; }
 
+    /// get the transition engine
+    TransitionEngine &getTransitionEngine() { return transitionEngine; }
+
+    /// get the presence check scheduler
+    PresenceScheduler &getPresenceScheduler() { return *presenceScheduler; }
+
     /// @}
 
 
@@ -258,6 +309,8 @@ namespace p44 {
     /// @}
 
     /// have button clicks checked for local handling
+    /// @note clicks are only handled locally when no vdSM is connected. A button in zone 0 acts on all lights,
+    ///   a button in any other zone only acts on the lights in the same zone.
     void checkForLocalClickHandling(ButtonBehaviour &aButtonBehaviour, DsClickType aClickType);
 
     /// description of object, mainly for debug and logging
@@ -292,6 +345,10 @@ namespace p44 {
     /// @param aForget if set, parameters stored for the device will be deleted
     void removeDevice(DevicePtr aDevice, bool aForget);
 
+    /// called when a device's zone assignment has changed
+    /// @note the zone index used for local click handling is rebuilt on the next local click
+    void invalidateLocalClickIndex() { localClickIndexValid = false; };
+
     /// @}
 
 
@@ -383,11 +440,16 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex);
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
+    virtual ErrorPtr saveDirty();
 
     // method and notification dispatching
     ErrorPtr handleMethodForDsUid(const string &aMethod, VdcApiRequestPtr aRequest, const DsUid &aDsUid, ApiValuePtr aParams);
     void handleNotificationForDsUid(const string &aMethod, const DsUid &aDsUid, ApiValuePtr aParams);
+    void handleNotificationForDsUids(const string &aMethod, ApiValuePtr aDsUids, ApiValuePtr aParams);
     DsAddressablePtr addressableForParams(const DsUid &aDsUid, ApiValuePtr aParams);
+    void resolveNotificationTargets(const string &aMethod, ApiValuePtr aDsUids, ApiValuePtr aParams, DsAddressableVector &aTargets);
+    void groupDevicesByClass(DsAddressableVector &aTargets, DeviceSetVector &aSets, DsAddressableVector *aNonDevicesP);
+    void commitPreparedDeviceSets(DeviceSetVector &aSets);
 
   private:
 
@@ -397,6 +459,7 @@ namespace p44 {
     // local operation mode
     void handleClickLocally(ButtonBehaviour &aButtonBehaviour, DsClickType aClickType);
     void localDimHandler();
+    void updateLocalClickIndex();
 
     // API connection status handling
     void vdcApiConnectionStatusHandler(VdcApiConnectionPtr aApiConnection, ErrorPtr &aError);
@@ -417,11 +480,17 @@ namespace p44 {
     void announceNext();
     void announceResultHandler(DsAddressablePtr aAddressable, VdcApiRequestPtr aRequest, ErrorPtr &aError, ApiValuePtr aResultOrErrorData);
 
+    // background output re-sync
+    void startOutputResync();
+    void outputResyncNext();
+    void outputResyncDone();
+
     // activity monitor
     void signalActivity();
 
     // periodic task
     void periodicTask(MLMicroSeconds aCycleStartTime);
+    bool saveSweep();
 
     // getting MAC
     void getMyMac(StatusCB aCompletedCB, bool aFactoryReset);
@@ -89,3 +89,12 @@ void DeviceSettings::bindToStatement(sqlite3pp::statement &aStatement, int &aInd
   aStatement.bind(aIndex++, device.getAssignedName().c_str());
   aStatement.bind(aIndex++, zoneID);
 }
+
+
+ErrorPtr DeviceSettings::saveDirty()
+{
+  // same as in Device::save(): only one record per device
+  ErrorPtr err = saveToStore(device.getDsUid().getString().c_str(), false);
+  if (!Error::isOK(err)) LOG(LOG_ERR,"Error saving settings for device %s: %s", device.shortDesc().c_str(), err->description().c_str());
+  return err;
+}
@@ -41,6 +41,7 @@ DsAddressable::DsAddressable(DeviceContainer *aDeviceContainerP) :
   announced(Never),
   announcing(Never)
 {
+  applyStats = ApplyStatisticsPtr(new ApplyStatistics);
 }
 
 
@@ -205,7 +206,7 @@ void DsAddressable::handleNotification(const string &aMethod, ApiValuePtr aParam
   if (aMethod=="ping") {
     // issue device ping (which will issue a pong when device is reachable)
     LOG(LOG_INFO,"ping to %s %s -> checking presence...\n", entityType(), shortDesc().c_str());
-    checkPresence(boost::bind(&DsAddressable::presenceResultHandler, this, _1));
+    getDeviceContainer().getPresenceScheduler().requestCheck(DsAddressablePtr(this), boost::bind(&DsAddressable::presenceResultHandler, this, _1));
   }
   else {
     // unknown notification
@@ -273,6 +274,7 @@ enum {
   deviceIcon16_key,
   iconName_key,
   name_key,
+  applyStats_key,
   numDsAddressableProperties
 };
 
@@ -302,7 +304,8 @@ PropertyDescriptorPtr DsAddressable::getDescriptorByIndex(int aPropIndex, int aD
     { "x-p44-description", apivalue_string, objectDescription_key, OKEY(dsAddressable_key) },
     { "deviceIcon16", apivalue_binary, deviceIcon16_key, OKEY(dsAddressable_key) },
     { "deviceIconName", apivalue_string, iconName_key, OKEY(dsAddressable_key) },
-    { "name", apivalue_string, name_key, OKEY(dsAddressable_key) }
+    { "name", apivalue_string, name_key, OKEY(dsAddressable_key) },
+    { "x-p44-applyStats", apivalue_object, applyStats_key, OKEY(dsAddressable_key) }
   };
   int n = inherited::numProps(aDomain, aParentDescriptor);
   if (aPropIndex<n)
@@ -312,6 +315,15 @@ PropertyDescriptorPtr DsAddressable::getDescriptorByIndex(int aPropIndex, int aD
 }
 
 
+PropertyContainerPtr DsAddressable::getContainer(PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain)
+{
+  if (aPropertyDescriptor->hasObjectKey(dsAddressable_key) && aPropertyDescriptor->fieldKey()==applyStats_key) {
+    return applyStats;
+  }
+  return inherited::getContainer(aPropertyDescriptor, aDomain);
+}
+
+
 bool DsAddressable::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor)
 {
   if (aPropertyDescriptor->hasObjectKey(dsAddressable_key)) {
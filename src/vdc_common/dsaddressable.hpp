@@ -24,6 +24,7 @@
 
 #include "dsuid.hpp"
 #include "propertycontainer.hpp"
+#include "applystatistics.hpp"
 #include "dsdefs.h"
 
 #include "vdcapi.hpp"
@@ -52,6 +53,9 @@ namespace p44 {
     MLMicroSeconds announced; ///< set when last announced to the vdSM
     MLMicroSeconds announcing; ///< set when announcement has been started (but not yet confirmed)
 
+    /// statistics about applying channel values (of the device itself, or all devices of a vDC/vDC host)
+    ApplyStatisticsPtr applyStats;
+
   protected:
     DeviceContainer *deviceContainerP;
 
@@ -68,6 +72,9 @@ namespace p44 {
     /// get reference to device container
     DeviceContainer &getDeviceContainer() { return *deviceContainerP; };
 
+    /// get apply statistics
+    ApplyStatistics &getApplyStats() { return *applyStats; };
+
     /// get user assigned name of the addressable
     /// @return name string
     virtual string getAssignedName() { return name; };
@@ -284,6 +291,7 @@ namespace p44 {
     // property access implementation
     virtual int numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor);
     virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor);
+    virtual PropertyContainerPtr getContainer(PropertyDescriptorPtr &aPropertyDescriptor, int &aDomain);
     virtual bool accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor);
 
   private:
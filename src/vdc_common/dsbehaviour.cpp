@@ -97,6 +97,12 @@ ErrorPtr DsBehaviour::save()
 }
 
 
+ErrorPtr DsBehaviour::saveDirty()
+{
+  return save();
+}
+
+
 ErrorPtr DsBehaviour::forget()
 {
   return deleteFromStore();
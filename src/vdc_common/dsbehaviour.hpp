@@ -138,6 +138,9 @@ namespace p44 {
     /// save unsaved behaviour parameters to persistent DB
     ErrorPtr save();
 
+    /// save behaviour parameters when taken from the param store's dirty list
+    virtual ErrorPtr saveDirty();
+
     /// forget any parameters stored in persistent DB
     ErrorPtr forget();
 
@@ -203,11 +206,13 @@ namespace p44 {
     /// only for deeper levels
     virtual int numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor);
 
-  private:
+  protected:
 
     // key for saving this behaviour in the DB
     string getDbKey();
 
+  private:
+
     // property access basic dispatcher implementation
     virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor);
     int numLocalProps(PropertyDescriptorPtr aParentDescriptor);
@@ -275,6 +275,24 @@ void DsScene::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, con
 }
 
 
+ErrorPtr DsScene::saveDirty()
+{
+  // only scenes in the scene table are persisted, default scenes created on the fly are not
+  DsSceneMap::iterator pos = sceneDeviceSettings.scenes.find(sceneNo);
+  if (pos==sceneDeviceSettings.scenes.end() || pos->second.get()!=this) {
+    return ErrorPtr();
+  }
+  if (sceneDeviceSettings.rowid==0) {
+    // settings must be saved first to get the ROWID we need as parent key, settings will save this scene as a child
+    sceneDeviceSettings.markDirty();
+    return ErrorPtr();
+  }
+  ErrorPtr err = saveToStore(string_format("%d",sceneDeviceSettings.rowid).c_str(), true); // multiple children of same parent allowed
+  if (!Error::isOK(err)) LOG(LOG_ERR,"Error saving scene %d for device %s: %s", sceneNo, sceneDeviceSettings.device.shortDesc().c_str(), err->description().c_str());
+  return err;
+}
+
+
 #pragma mark - scene flags
 
 bool DsScene::isDontCare()
@@ -438,7 +456,8 @@ bool DsScene::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, Prop
 
 
 SceneDeviceSettings::SceneDeviceSettings(Device &aDevice) :
-  inherited(aDevice)
+  inherited(aDevice),
+  nextCalledDefaultScene(0)
 {
 }
 
@@ -468,9 +487,34 @@ DsScenePtr SceneDeviceSettings::getScene(SceneNo aSceneNo)
 }
 
 
+DsScenePtr SceneDeviceSettings::getSceneForCall(SceneNo aSceneNo)
+{
+  DsSceneMap::iterator pos = scenes.find(aSceneNo);
+  if (pos!=scenes.end()) {
+    // found scene params in map
+    return pos->second;
+  }
+  // default values: reuse a default scene created for a previous call
+  for (int i=0; i<2; i++) {
+    if (calledDefaultScenes[i] && calledDefaultScenes[i]->sceneNo==aSceneNo)
+      return calledDefaultScenes[i];
+  }
+  // not recently used, create it and replace the older of the two kept default scenes
+  DsScenePtr defaultScene = newDefaultScene(aSceneNo);
+  calledDefaultScenes[nextCalledDefaultScene] = defaultScene;
+  nextCalledDefaultScene = 1-nextCalledDefaultScene;
+  return defaultScene;
+}
+
 
 void SceneDeviceSettings::updateScene(DsScenePtr aScene)
 {
+  if (isDefaultScene(aScene)) {
+    // (back to) default values, no need to keep or persist it
+    aScene->markClean();
+    resetScene(aScene->sceneNo);
+    return;
+  }
   if (aScene->rowid==0) {
     // unstored so far, add to map of non-default scenes
     scenes[aScene->sceneNo] = aScene;
@@ -482,6 +526,31 @@ void SceneDeviceSettings::updateScene(DsScenePtr aScene)
 }
 
 
+void SceneDeviceSettings::resetScene(SceneNo aSceneNo)
+{
+  DsSceneMap::iterator pos = scenes.find(aSceneNo);
+  if (pos!=scenes.end()) {
+    // forget non-default scene, getScene() will return default values from now on
+    pos->second->deleteFromStore();
+    scenes.erase(pos);
+  }
+}
+
+
+bool SceneDeviceSettings::isDefaultScene(DsScenePtr aScene)
+{
+  DsScenePtr defaultScene = newDefaultScene(aScene->sceneNo);
+  // compare the values as they would be persisted
+  SQLite3RowSnapshot sceneValues(paramStore, "");
+  SQLite3RowSnapshot defaultValues(paramStore, "");
+  int index = 1;
+  aScene->bindToStatement(sceneValues, index, "", 0);
+  index = 1;
+  defaultScene->bindToStatement(defaultValues, index, "", 0);
+  return sceneValues.sameValues(defaultValues);
+}
+
+
 
 
 
@@ -503,18 +572,30 @@ ErrorPtr SceneDeviceSettings::loadChildren()
     err = paramStore.error();
   }
   else {
+    DsSceneVector defaultScenes;
     for (sqlite3pp::query::iterator row = queryP->begin(); row!=queryP->end(); ++row) {
       // got record
       // - load record fields into scene object
       int index = 0;
       uint64_t flags;
       scene->loadFromRow(row, index, &flags);
-      // - put scene into map of non-default scenes
-      scenes[scene->sceneNo] = scene;
+      scene->markClean(); // just loaded, is clean
+      if (isDefaultScene(scene)) {
+        // stored, but has default values (e.g. from earlier versions): remove from DB after loading
+        defaultScenes.push_back(scene);
+      }
+      else {
+        // - put scene into map of non-default scenes
+        scenes[scene->sceneNo] = scene;
+      }
       // - fresh object for next row
       scene = newDefaultScene(0);
     }
-    delete queryP; queryP = NULL;
+    queryP->reset(); // done with the cached query
+    queryP = NULL;
+    for (DsSceneVector::iterator pos = defaultScenes.begin(); pos!=defaultScenes.end(); ++pos) {
+      (*pos)->deleteFromStore();
+    }
   }
   return err;
 }
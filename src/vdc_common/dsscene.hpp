@@ -207,6 +207,7 @@ namespace p44 {
     virtual const FieldDefinition *getFieldDef(size_t aIndex);
     virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
     virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
+    virtual ErrorPtr saveDirty();
 
   private:
 
@@ -215,6 +216,7 @@ namespace p44 {
   };
   typedef boost::intrusive_ptr<DsScene> DsScenePtr;
   typedef map<SceneNo, DsScenePtr> DsSceneMap;
+  typedef vector<DsScenePtr> DsSceneVector;
 
 
 
@@ -235,6 +237,8 @@ namespace p44 {
     friend class SceneChannels;
 
     DsSceneMap scenes; ///< the user defined scenes (default scenes will be created on the fly)
+    DsScenePtr calledDefaultScenes[2]; ///< default scenes last returned by getSceneForCall(), for reuse without allocation
+    int nextCalledDefaultScene; ///< slot in calledDefaultScenes to replace next
 
   public:
     SceneDeviceSettings(Device &aDevice);
@@ -249,11 +253,18 @@ namespace p44 {
     ///   created on the fly). Scene modifications must be posted using updateScene()
     DsScenePtr getScene(SceneNo aSceneNo);
 
+    /// get the parameters for the scene for read-only use, such as calling the scene
+    /// @param aSceneNo the scene to get current settings for.
+    /// @note unlike getScene(), the default scenes of the last two scene numbers looked up are kept, so
+    ///   repeatedly calling the same scenes (and checking their area's main scene) does not allocate.
+    ///   The returned object must NOT be modified.
+    DsScenePtr getSceneForCall(SceneNo aSceneNo);
+
     /// update scene (mark dirty, add to list of non-default scene objects)
     /// @param aSceneNo the scene to save modified settings for.
-    /// @note call updateScene only if scene values are changed from defaults, because
-    ///   updating a scene creates DB records and needs more run-time memory.
     /// @note always updates the scene and causes write to DB even if scene was not marked dirty already
+    /// @note if the scene has the default values for its scene number, it is not kept as a non-default scene,
+    ///   but reset (see resetScene()), so memory and DB records are needed only for scenes which differ from defaults.
     void updateScene(DsScenePtr aScene);
 
     /// reset scene to default values
@@ -261,6 +272,11 @@ namespace p44 {
     /// @note database records will be deleted if the scene had non-default values before.
     void resetScene(SceneNo aSceneNo);
 
+    /// check if a scene has the default values for its scene number
+    /// @param aScene the scene to check
+    /// @return true if all persistent values of aScene are equal to those of a default scene with the same number
+    bool isDefaultScene(DsScenePtr aScene);
+
     /// factory method to create the correct subclass type of DsScene with default values
     /// @param aSceneNo the scene number to create a scene object with proper default values for.
     /// @note this method can be derived in concrete subclasses to return the appropriate scene object.
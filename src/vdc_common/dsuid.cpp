@@ -46,6 +46,15 @@ void DsUid::internalInit()
   // init such that what we'd read out will be all-zero dSUID
   idBytes = dsuidBytes;
   memset(raw, 0, sizeof(raw));
+  updateHash();
+}
+
+
+void DsUid::updateHash()
+{
+  Fnv32 h;
+  h.addBytes(idBytes, raw);
+  hashValue = h.getHash();
 }
 
 
@@ -102,6 +111,7 @@ void DsUid::setSubdeviceIndex(uint8_t aSubDeviceIndex)
   if (idBytes==dsuidBytes) {
     // is a dSUID, can set subdevice index
     raw[16] = aSubDeviceIndex;
+    updateHash();
   }
 }
 
@@ -140,6 +150,7 @@ void DsUid::setGTIN(uint64_t aGCP, uint64_t aItemRef, uint8_t aPartition)
   // - raw[10..11] contain more GTIN information
   raw[10] = (binaryGtin>>2) & 0xFF;
   raw[11] = (raw[11] & 0x3F) | ((binaryGtin & 0x03)<<6); // combine lowest 2 bits of GTIN with highest 6 of serial
+  updateHash();
 }
 
 
@@ -152,6 +163,7 @@ void DsUid::setSerial(uint64_t aSerial)
   raw[13] = (aSerial>>16)&0xFF;
   raw[14] = (aSerial>>8)&0xFF;
   raw[15] = aSerial&0xFF;
+  updateHash();
 }
 
 
@@ -225,6 +237,7 @@ void DsUid::setNameInSpace(const string &aName, const DsUid &aNameSpace)
   // - Set the two most significant bits (bits 6 and 7) of the clock_seq_hi_and_reserved to zero and one, respectively.
   // ...means: mark the UUID as RFC4122 type/variant
   raw[8] = (raw[8] & 0xC0) | (0x2<<6);
+  updateHash();
 }
 
 
@@ -237,6 +250,7 @@ bool DsUid::setAsBinary(const string &aBinary)
     idBytes = dsuidBytes;
     memcpy(raw, aBinary.c_str(), idBytes);
     detectSubType();
+    updateHash();
     return true;
   }
   return false;
@@ -319,10 +333,12 @@ bool DsUid::setAsString(const string &aString)
     detectSubType();
     if (byteIndex==uuidBytes)
       raw[16] = 0; // specified as pure UUID, set subdevice index == 0
+    updateHash();
   }
   else {
     // unknown format
     setIdType(idtype_undefined);
+    updateHash();
     return false;
   }
   return true;
@@ -349,7 +365,7 @@ string DsUid::getString() const
 
 bool DsUid::operator== (const DsUid &aDsUid) const
 {
-  if (idType!=aDsUid.idType) return false;
+  if (idType!=aDsUid.idType || hashValue!=aDsUid.hashValue) return false;
   return memcmp(raw, aDsUid.raw, idBytes)==0;
 }
 
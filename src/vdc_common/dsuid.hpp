@@ -84,9 +84,12 @@ namespace p44 {
     DsUidType idType; ///< the type of ID
     uint8_t idBytes; ///< the length of the ID in bytes
     RawID raw; ///< the raw dSUID
+    uint32_t hashValue; ///< FNV hash over the raw dSUID, updated whenever raw changes
 
     void internalInit();
 
+    void updateHash();
+
     void setIdType(DsUidType aIdType);
 
     void detectSubType();
@@ -141,6 +144,10 @@ namespace p44 {
     bool operator== (const DsUid &aDsUid) const;
     bool operator< (const DsUid &aDsUid) const;
 
+    /// get precomputed hash of the dSUID
+    /// @return hash value, suitable for hashed containers (equal dSUIDs always have equal hashes)
+    uint32_t hash() const { return hashValue; };
+
     // test
     // @return true if empty (no value assigned)
     bool empty() const;
@@ -199,6 +206,13 @@ namespace p44 {
   typedef boost::intrusive_ptr<DsUid> DsUidPtr;
 
 
+  /// hash functor for using DsUid as key in hashed containers
+  struct DsUidHash
+  {
+    size_t operator() (const DsUid &aDsUid) const { return aDsUid.hash(); };
+  };
+
+
 } // namespace p44
 
 #endif /* defined(__vdcd__dsid__) */
@@ -21,20 +21,34 @@
 
 #include "jsonvdcapi.hpp"
 
+#include "tracer.hpp"
+
 using namespace p44;
 
 
 
 #pragma mark - JsonApiValue
 
-JsonApiValue::JsonApiValue()
+JsonApiValue::JsonApiValue() :
+  nextMember(NULL)
+{
+  arena = JsonArenaPtr(new JsonArena);
+  node = arena->newNull();
+}
+
+
+JsonApiValue::JsonApiValue(JsonNode *aJsonNode) :
+  nextMember(NULL)
 {
+  arena = JsonArenaPtr(&aJsonNode->getArena());
+  setJsonNode(aJsonNode);
 }
 
 
 ApiValuePtr JsonApiValue::newValue(ApiValueType aObjectType)
 {
-  ApiValuePtr newVal = ApiValuePtr(new JsonApiValue);
+  // new values live in the same arena
+  ApiValuePtr newVal = ApiValuePtr(new JsonApiValue(arena->newNull()));
   newVal->setType(aObjectType);
   return newVal;
 }
@@ -45,15 +59,15 @@ void JsonApiValue::clear()
 {
   switch (getType()) {
     case apivalue_object:
-      // just assign new object and forget old one
-      jsonObj = JsonObject::newObj();
+      // just make node an empty object, old members are orphaned
+      node->setObject();
       break;
     case apivalue_array:
-      jsonObj = JsonObject::newArray();
+      node->setArray();
       break;
-    // for unstuctured values, the json obj will be created on assign, so clear it now
+    // for unstuctured values, the json node will get its value on assign, until then, it is null
     default:
-      jsonObj.reset();
+      node->setNull();
       break;
   }
 }
@@ -62,7 +76,7 @@ void JsonApiValue::clear()
 bool JsonApiValue::setStringValue(const string &aString)
 {
   if (getType()==apivalue_string || getType()==apivalue_binary) {
-    jsonObj = JsonObject::newString(aString, false);
+    node->setString(aString);
     return true;
   }
   else
@@ -80,33 +94,45 @@ void JsonApiValue::setBinaryValue(const string &aBinary)
 string JsonApiValue::binaryValue()
 {
   // parse binary string as hex
-  return hexToBinaryString(stringValue().c_str());
+  return hexToBinaryString(node->c_strValue());
+}
+
+
+
+bool JsonApiValue::nextKeyValue(string &aKey, ApiValuePtr &aValue)
+{
+  if (!nextMember) return false;
+  aKey = nextMember->keyName();
+  aValue = ApiValuePtr(new JsonApiValue(nextMember));
+  nextMember = nextMember->nextSibling();
+  return true;
 }
 
 
+JsonNode *JsonApiValue::nodeFor(ApiValuePtr aObj)
+{
+  JsonApiValue *javP = dynamic_cast<JsonApiValue *>(aObj.get());
+  if (javP) return javP->node;
+  return NULL;
+}
 
 
 
-void JsonApiValue::setJsonObject(JsonObjectPtr aJsonObject)
+void JsonApiValue::setJsonNode(JsonNode *aJsonNode)
 {
-  jsonObj = aJsonObject;
+  node = aJsonNode;
   // derive type
-  if (!jsonObj) {
-    setType(apivalue_null);
-  }
-  else {
-    switch (jsonObj->type()) {
-      case json_type_boolean: objectType = apivalue_bool; break;
-      case json_type_double: objectType = apivalue_double; break;
-      case json_type_int: objectType = apivalue_int64; break;
-      case json_type_object: objectType = apivalue_object; break;
-      case json_type_array: objectType = apivalue_array; break;
-      case json_type_string: objectType = apivalue_string; break;
-      case json_type_null:
-      default:
-        setType(apivalue_null);
-        break;
-    }
+  switch (node->type()) {
+    case jsonnode_boolean: objectType = apivalue_bool; break;
+    case jsonnode_double: objectType = apivalue_double; break;
+    case jsonnode_int: objectType = apivalue_int64; break;
+    case jsonnode_object: objectType = apivalue_object; break;
+    case jsonnode_array: objectType = apivalue_array; break;
+    case jsonnode_string: objectType = apivalue_string; break;
+    case jsonnode_null:
+    default:
+      objectType = apivalue_null;
+      break;
   }
 }
 
@@ -114,19 +140,23 @@ void JsonApiValue::setJsonObject(JsonObjectPtr aJsonObject)
 void JsonApiValue::operator=(ApiValue &aApiValue)
 {
   JsonApiValue *javP = dynamic_cast<JsonApiValue *>(&aApiValue);
-  if (javP)
-    setJsonObject(javP->jsonObj);
+  if (javP) {
+    arena = javP->arena;
+    setJsonNode(javP->node);
+  }
   else
     setNull(); // not assignable
 }
 
 
 
-ApiValuePtr JsonApiValue::newValueFromJson(JsonObjectPtr aJsonObject)
+ApiValuePtr JsonApiValue::newValueFromJson(JsonNode *aJsonNode, JsonArenaPtr aArena)
 {
-  JsonApiValue *javP = new JsonApiValue;
-  javP->setJsonObject(aJsonObject);
-  return ApiValuePtr(javP);
+  if (!aJsonNode) {
+    if (!aArena) aArena = JsonArenaPtr(new JsonArena);
+    aJsonNode = aArena->newNull();
+  }
+  return ApiValuePtr(new JsonApiValue(aJsonNode));
 }
 
 
@@ -145,10 +175,21 @@ VdcApiConnectionPtr VdcJsonApiServer::newConnection()
 #pragma mark - VdcJsonApiRequest
 
 
-VdcJsonApiRequest::VdcJsonApiRequest(VdcJsonApiConnectionPtr aConnection, const char *aJsonRpcId)
+VdcJsonApiRequest::VdcJsonApiRequest(VdcJsonApiConnectionPtr aConnection, const char *aJsonRpcId, JsonArenaPtr aArena)
 {
   jsonConnection = aConnection;
   jsonRpcId = aJsonRpcId ? aJsonRpcId : ""; // empty if none passed
+  arena = aArena;
+}
+
+
+ApiValuePtr VdcJsonApiRequest::newApiValue()
+{
+  if (arena) {
+    // build answer in the same arena as the request
+    return ApiValuePtr(new JsonApiValue(arena->newNull()));
+  }
+  return inherited::newApiValue();
 }
 
 
@@ -163,7 +204,7 @@ ErrorPtr VdcJsonApiRequest::sendResult(ApiValuePtr aResult)
 {
   LOG(LOG_INFO,"vdSM <- vDC (JSON) result sent: requestid='%s', result=%s\n", requestId().c_str(), aResult ? aResult->description().c_str() : "<none>");
   JsonApiValuePtr result = boost::dynamic_pointer_cast<JsonApiValue>(aResult);
-  return jsonConnection->jsonRpcComm->sendResult(requestId().c_str(), result ? result->jsonObject() : NULL);
+  return jsonConnection->jsonRpcComm->sendResult(requestId().c_str(), result ? result->jsonNode() : NULL);
 }
 
 
@@ -173,7 +214,7 @@ ErrorPtr VdcJsonApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
   JsonApiValuePtr errorData;
   if (aErrorData)
     errorData = boost::dynamic_pointer_cast<JsonApiValue>(aErrorData);
-  return jsonConnection->jsonRpcComm->sendError(requestId().c_str(), aErrorCode, aErrorMessage.size()>0 ? aErrorMessage.c_str() : NULL, errorData ? errorData->jsonObject() : JsonObjectPtr());
+  return jsonConnection->jsonRpcComm->sendError(requestId().c_str(), aErrorCode, aErrorMessage.size()>0 ? aErrorMessage.c_str() : NULL, errorData ? errorData->jsonNode() : NULL);
 }
 
 
@@ -185,22 +226,24 @@ VdcJsonApiConnection::VdcJsonApiConnection()
 {
   jsonRpcComm = JsonRpcCommPtr(new JsonRpcComm(MainLoop::currentMainLoop()));
   // install JSON request handler locally
-  jsonRpcComm->setRequestHandler(boost::bind(&VdcJsonApiConnection::jsonRequestHandler, this, _1, _2, _3));
+  jsonRpcComm->setArenaRequestHandler(boost::bind(&VdcJsonApiConnection::jsonRequestHandler, this, _1, _2, _3));
+  // dispatch members of batch requests grouped by target entity
+  jsonRpcComm->setBatchGroupingParam("dSUID");
 }
 
 
 
-void VdcJsonApiConnection::jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonObjectPtr aParams)
+void VdcJsonApiConnection::jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonNode *aParams)
 {
   ErrorPtr respErr;
   if (apiRequestHandler) {
-    // create params API value
+    // create params API value, directly accessing the parsed message
     ApiValuePtr params = JsonApiValue::newValueFromJson(aParams);
     VdcApiRequestPtr request;
     // create request object in case this request expects an answer
     if (aJsonRpcId) {
       // Method
-      request = VdcJsonApiRequestPtr(new VdcJsonApiRequest(VdcJsonApiConnectionPtr(this), aJsonRpcId));
+      request = VdcJsonApiRequestPtr(new VdcJsonApiRequest(VdcJsonApiConnectionPtr(this), aJsonRpcId, aParams ? JsonArenaPtr(&aParams->getArena()) : JsonArenaPtr()));
       LOG(LOG_INFO,"vdSM -> vDC (JSON) method call '%s' received: requestid='%s', params=%s\n", aMethod, request->requestId().c_str(), params ? params->description().c_str() : "<none>");
     }
     else {
@@ -208,6 +251,7 @@ void VdcJsonApiConnection::jsonRequestHandler(const char *aMethod, const char *a
       LOG(LOG_INFO,"vdSM -> vDC (JSON) notification '%s' received: params=%s\n", aMethod, params ? params->description().c_str() : "<none>");
     }
     // call handler
+    TRACE_SCOPE("vdcapi JSON message", aMethod);
     apiRequestHandler(VdcJsonApiConnectionPtr(this), request, aMethod, params);
   }
 }
@@ -231,25 +275,25 @@ ErrorPtr VdcJsonApiConnection::sendRequest(const string &aMethod, ApiValuePtr aP
   ErrorPtr err;
   if (aResponseHandler) {
     // method call expecting response
-    err = jsonRpcComm->sendRequest(aMethod.c_str(), params->jsonObject(), boost::bind(&VdcJsonApiConnection::jsonResponseHandler, this, aResponseHandler, _1, _2, _3));
+    err = jsonRpcComm->sendRequest(aMethod.c_str(), params ? params->jsonNode() : NULL, boost::bind(&VdcJsonApiConnection::jsonResponseHandler, this, aResponseHandler, _1, _2, _3));
     LOG(LOG_INFO,"vdSM <- vDC (JSON) method call sent: requestid='%d', method='%s', params=%s\n", jsonRpcComm->lastRequestId(), aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
   }
   else {
     // notification
-    err = jsonRpcComm->sendRequest(aMethod.c_str(), params->jsonObject(), NULL);
+    err = jsonRpcComm->sendRequest(aMethod.c_str(), params ? params->jsonNode() : NULL, JsonRpcArenaResponseCB());
     LOG(LOG_INFO,"vdSM <- vDC (JSON) notification sent: method='%s', params=%s\n", aMethod.c_str(), aParams ? aParams->description().c_str() : "<none>");
   }
   return err;
 }
 
 
-void VdcJsonApiConnection::jsonResponseHandler(VdcApiResponseCB aResponseHandler, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData)
+void VdcJsonApiConnection::jsonResponseHandler(VdcApiResponseCB aResponseHandler, int32_t aResponseId, ErrorPtr &aError, JsonNode *aResultOrErrorData)
 {
   if (aResponseHandler) {
     // create request object just to hold the response ID
     string respId = string_format("%d", aResponseId);
     ApiValuePtr resultOrErrorData = JsonApiValue::newValueFromJson(aResultOrErrorData);
-    VdcApiRequestPtr request = VdcJsonApiRequestPtr(new VdcJsonApiRequest(VdcJsonApiConnectionPtr(this), respId.c_str()));
+    VdcApiRequestPtr request = VdcJsonApiRequestPtr(new VdcJsonApiRequest(VdcJsonApiConnectionPtr(this), respId.c_str(), JsonArenaPtr()));
     if (Error::isOK(aError)) {
       LOG(LOG_INFO,"vdSM -> vDC (JSON) result received: id='%s', result=%s\n", request->requestId().c_str(), resultOrErrorData ? resultOrErrorData->description().c_str() : "<none>");
     }
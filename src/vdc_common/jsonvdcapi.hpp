@@ -47,57 +47,72 @@ namespace p44 {
   typedef boost::intrusive_ptr<JsonApiValue> JsonApiValuePtr;
 
   /// JSON specific implementation of ApiValue
+  /// @note values are nodes in a JsonArena. Values created via newValue() live in the same arena as
+  ///   the value they were created from, so an entire API response is built in a single arena, and
+  ///   parsed API requests are accessed directly without any conversion.
   class JsonApiValue : public ApiValue
   {
     typedef ApiValue inherited;
 
-    // using an embedded Json Object
-    JsonObjectPtr jsonObj;
+    // the arena the node lives in (keeps it alive)
+    JsonArenaPtr arena;
+    // the node in the arena
+    JsonNode *node;
+    // iterator for resetKeyIteration()/nextKeyValue()
+    JsonNode *nextMember;
 
-    // set value from a JsonObject
-    void setJsonObject(JsonObjectPtr aJsonObject);
+    // set the node (and derive type from it)
+    void setJsonNode(JsonNode *aJsonNode);
+
+    // get a node for linking into this value's node
+    JsonNode *nodeFor(ApiValuePtr aObj);
 
   public:
 
+    /// create null value in a new arena
     JsonApiValue();
 
+    /// create value from existing arena node
+    /// @param aJsonNode the node, which must not be NULL. The JsonApiValue keeps the node's arena alive.
+    JsonApiValue(JsonNode *aJsonNode);
+
     virtual ApiValuePtr newValue(ApiValueType aObjectType);
 
-    static ApiValuePtr newValueFromJson(JsonObjectPtr aJsonObject);
+    /// create API value from arena node
+    /// @param aJsonNode the node, can be NULL (null value)
+    /// @param aArena the arena to create the null value in if aJsonNode is NULL. If NULL, a new arena will be created.
+    static ApiValuePtr newValueFromJson(JsonNode *aJsonNode, JsonArenaPtr aArena = JsonArenaPtr());
 
     virtual void clear();
     virtual void operator=(ApiValue &aApiValue);
 
-    virtual void add(const string &aKey, ApiValuePtr aObj) { JsonApiValuePtr o = boost::dynamic_pointer_cast<JsonApiValue>(aObj); if (jsonObj && o) jsonObj->add(aKey.c_str(), o->jsonObject()); };
-    virtual ApiValuePtr get(const string &aKey)  { JsonObjectPtr o; if (jsonObj && jsonObj->get(aKey.c_str(), o)) return newValueFromJson(o); else return ApiValuePtr(); };
-    virtual void del(const string &aKey) { if (jsonObj) jsonObj->del(aKey.c_str()); };
-    virtual int arrayLength() { return jsonObj ? jsonObj->arrayLength() : 0; };
-    virtual void arrayAppend(ApiValuePtr aObj) { JsonApiValuePtr o = boost::dynamic_pointer_cast<JsonApiValue>(aObj); if (jsonObj && o) jsonObj->arrayAppend(o->jsonObject()); };
-    virtual ApiValuePtr arrayGet(int aAtIndex) { if (jsonObj) { JsonObjectPtr o = jsonObj->arrayGet(aAtIndex); return newValueFromJson(o); } else return ApiValuePtr(); };
-    virtual void arrayPut(int aAtIndex, ApiValuePtr aObj) { JsonApiValuePtr o = boost::dynamic_pointer_cast<JsonApiValue>(aObj); if (jsonObj && o) jsonObj->arrayPut(aAtIndex, o->jsonObject()); };
-    virtual bool resetKeyIteration() { if (jsonObj) return jsonObj->resetKeyIteration(); else return false; };
-    virtual bool nextKeyValue(string &aKey, ApiValuePtr &aValue) { if (jsonObj) { JsonObjectPtr o; bool gotone = jsonObj->nextKeyValue(aKey, o); aValue = newValueFromJson(o); return gotone; } else return false; };
-
-    virtual uint64_t uint64Value() { return jsonObj ? (uint64_t)jsonObj->int64Value() : 0; };
-    virtual int64_t int64Value() { return jsonObj ? jsonObj->int64Value() : 0; };
-    virtual double doubleValue() { return jsonObj ? jsonObj->doubleValue() : 0; };
-    virtual bool boolValue() { return jsonObj ? jsonObj->boolValue() : false; };
+    virtual void add(const string &aKey, ApiValuePtr aObj) { if (node->isType(jsonnode_object)) node->add(aKey.c_str(), nodeFor(aObj)); };
+    virtual ApiValuePtr get(const string &aKey)  { JsonNode *n = node->findMember(aKey.c_str()); if (n) return ApiValuePtr(new JsonApiValue(n)); else return ApiValuePtr(); };
+    virtual void del(const string &aKey) { node->del(aKey.c_str()); };
+    virtual int arrayLength() { return node->arrayLength(); };
+    virtual void arrayAppend(ApiValuePtr aObj) { if (node->isType(jsonnode_array)) node->arrayAppend(nodeFor(aObj)); };
+    virtual ApiValuePtr arrayGet(int aAtIndex) { JsonNode *n = node->arrayGet(aAtIndex); if (n) return ApiValuePtr(new JsonApiValue(n)); else return ApiValuePtr(); };
+    virtual void arrayPut(int aAtIndex, ApiValuePtr aObj) { if (node->isType(jsonnode_array)) node->arrayPut(aAtIndex, nodeFor(aObj)); };
+    virtual bool resetKeyIteration() { nextMember = node->isType(jsonnode_object) ? node->firstChild() : NULL; return node->isType(jsonnode_object); };
+    virtual bool nextKeyValue(string &aKey, ApiValuePtr &aValue);
+
+    virtual uint64_t uint64Value() { return (uint64_t)node->int64Value(); };
+    virtual int64_t int64Value() { return node->int64Value(); };
+    virtual double doubleValue() { return node->doubleValue(); };
+    virtual bool boolValue() { return node->boolValue(); };
     virtual string binaryValue();
-    virtual string stringValue() { if (getType()==apivalue_string) { return jsonObj ? jsonObj->stringValue() : ""; } else return inherited::stringValue(); };
+    virtual string stringValue() { if (getType()==apivalue_string) { return node->isType(jsonnode_string) ? node->stringValue() : ""; } else return inherited::stringValue(); };
 
-    virtual void setUint64Value(uint64_t aUint64) { jsonObj = JsonObject::newInt64(aUint64); }
-    virtual void setInt64Value(int64_t aInt64) { jsonObj = JsonObject::newInt64(aInt64); };
-    virtual void setDoubleValue(double aDouble) { jsonObj = JsonObject::newDouble(aDouble); };
-    virtual void setBoolValue(bool aBool) { jsonObj = JsonObject::newBool(aBool); };
+    virtual void setUint64Value(uint64_t aUint64) { node->setInt64(aUint64); }
+    virtual void setInt64Value(int64_t aInt64) { node->setInt64(aInt64); };
+    virtual void setDoubleValue(double aDouble) { node->setDouble(aDouble); };
+    virtual void setBoolValue(bool aBool) { node->setBool(aBool); };
     virtual void setBinaryValue(const string &aBinary);
     virtual bool setStringValue(const string &aString);
-    virtual void setNull() { jsonObj.reset(); }
 
-    JsonObjectPtr jsonObject() { return jsonObj; };
+    /// @return the arena node representing this value
+    JsonNode *jsonNode() { return node; };
 
-  protected:
-    
-    
   };
 
 
@@ -123,11 +138,15 @@ namespace p44 {
 
     string jsonRpcId;
     VdcJsonApiConnectionPtr jsonConnection;
+    JsonArenaPtr arena; ///< arena of the request message, used to build the answer
 
   public:
 
     /// constructor
-    VdcJsonApiRequest(VdcJsonApiConnectionPtr aConnection, const char *aJsonRpcId);
+    /// @param aConnection the connection the request was received on
+    /// @param aJsonRpcId the JSON-RPC id of the request
+    /// @param aArena the arena of the request message. If set, answer values will be created in the same arena
+    VdcJsonApiRequest(VdcJsonApiConnectionPtr aConnection, const char *aJsonRpcId, JsonArenaPtr aArena);
 
     /// return the request ID as a string
     /// @return request ID as string
@@ -137,6 +156,10 @@ namespace p44 {
     /// @return API connection
     virtual VdcApiConnectionPtr connection();
 
+    /// get a new API value suitable for answering this request
+    /// @return new API value, living in the same arena as the request if possible
+    virtual ApiValuePtr newApiValue();
+
     /// send a vDC API result (answer for successful method call)
     /// @param aResult the result as a ApiValue. Can be NULL for procedure calls without return value
     /// @result empty or Error object in case of error sending result response
@@ -188,8 +211,8 @@ namespace p44 {
 
   private:
 
-    void jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonObjectPtr aParams);
-    void jsonResponseHandler(VdcApiResponseCB aResponseHandler, int32_t aResponseId, ErrorPtr &aError, JsonObjectPtr aResultOrErrorData);
+    void jsonRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonNode *aParams);
+    void jsonResponseHandler(VdcApiResponseCB aResponseHandler, int32_t aResponseId, ErrorPtr &aError, JsonNode *aResultOrErrorData);
 
   };
 
@@ -37,7 +37,9 @@ OutputBehaviour::OutputBehaviour(Device &aDevice) :
   pushChanges(false), // do not push changes
   outputGroups(1<<group_variable), // all devices are in group 0 by default
   // volatile state
-  localPriority(false) // no local priority
+  localPriority(false), // no local priority
+  lastState(aDevice.getDeviceContainer().getDsParamStore(), *this),
+  lastStateRestored(false)
 {
   // set default hardware default configuration
   setHardwareOutputConfig(outputFunction_switch, usage_undefined, false, -1);
@@ -319,6 +321,117 @@ void OutputBehaviour::bindToStatement(sqlite3pp::statement &aStatement, int &aIn
 
 
 
+#pragma mark - last known output state
+
+
+OutputLastState::OutputLastState(ParamStore &aParamStore, OutputBehaviour &aOutput) :
+  inherited(aParamStore),
+  output(aOutput)
+{
+}
+
+
+ErrorPtr OutputLastState::saveDirty()
+{
+  return output.saveLastState();
+}
+
+
+const char *OutputLastState::tableName()
+{
+  return "OutputStates";
+}
+
+
+// data field definitions
+
+static const size_t numLastStateFields = 1;
+
+size_t OutputLastState::numFieldDefs()
+{
+  return inherited::numFieldDefs()+numLastStateFields;
+}
+
+
+const FieldDefinition *OutputLastState::getFieldDef(size_t aIndex)
+{
+  static const FieldDefinition dataDefs[numLastStateFields] = {
+    { "channelValues", SQLITE_TEXT }
+  };
+  if (aIndex<inherited::numFieldDefs())
+    return inherited::getFieldDef(aIndex);
+  aIndex -= inherited::numFieldDefs();
+  if (aIndex<numLastStateFields)
+    return &dataDefs[aIndex];
+  return NULL;
+}
+
+
+void OutputLastState::loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP)
+{
+  inherited::loadFromRow(aRow, aIndex, aCommonFlagsP);
+  channelValues = nonNullCStr(aRow->get<const char *>(aIndex++));
+}
+
+
+void OutputLastState::bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags)
+{
+  inherited::bindToStatement(aStatement, aIndex, aParentIdentifier, aCommonFlags);
+  // always save the current values
+  channelValues.clear();
+  for (size_t i=0; i<output.numChannels(); i++) {
+    if (i>0) channelValues += ';';
+    string_format_append(channelValues, "%g", output.getChannelByIndex(i)->getChannelValue());
+  }
+  aStatement.bind(aIndex++, channelValues.c_str());
+}
+
+
+void OutputBehaviour::restoreLastState()
+{
+  ErrorPtr err = lastState.loadFromStore(getDbKey().c_str());
+  if (!Error::isOK(err)) {
+    LOG(LOG_ERR, "Error loading last output state for device %s: %s\n", device.shortDesc().c_str(), err->description().c_str());
+    return;
+  }
+  const char *p = lastState.getChannelValues().c_str();
+  if (!*p) return; // no last state known
+  for (size_t i=0; i<numChannels(); i++) {
+    char *e;
+    double v = strtod(p, &e);
+    if (e==p) break; // no more values
+    getChannelByIndex(i)->restoreChannelValue(v);
+    lastStateRestored = true;
+    p = e;
+    if (*p!=';') break;
+    p++;
+  }
+  if (lastStateRestored) {
+    LOG(LOG_INFO, "Device %s: restored last known output state: %s\n", device.shortDesc().c_str(), lastState.getChannelValues().c_str());
+  }
+}
+
+
+void OutputBehaviour::channelStateChanged()
+{
+  lastStateRestored = false;
+  lastState.markDirty();
+}
+
+
+ErrorPtr OutputBehaviour::saveLastState()
+{
+  return lastState.saveToStore(getDbKey().c_str(), false); // only one record per dbkey (=per device+behaviourindex)
+}
+
+
+ErrorPtr OutputBehaviour::forgetLastState()
+{
+  return lastState.deleteFromStore();
+}
+
+
+
 #pragma mark - output property access
 
 static char output_key;
@@ -29,6 +29,38 @@ using namespace std;
 
 namespace p44 {
 
+  class OutputBehaviour;
+
+  /// last known channel values of an output, persisted for restoring the output state right away after a restart.
+  /// @note kept in a separate table from the output settings, so frequently changing values do not cause re-writing
+  ///   the settings. Saving happens with the regular batched settings save, and when settings are flushed at exit.
+  class OutputLastState : public PersistentParams
+  {
+    typedef PersistentParams inherited;
+
+    OutputBehaviour &output;
+    string channelValues; ///< channel values as loaded, semicolon separated, in channel index order
+
+  public:
+
+    OutputLastState(ParamStore &aParamStore, OutputBehaviour &aOutput);
+
+    /// @return channel values as loaded from the store, semicolon separated, empty if none
+    const string &getChannelValues() { return channelValues; };
+
+    virtual ErrorPtr saveDirty();
+
+  protected:
+
+    virtual const char *tableName();
+    virtual size_t numFieldDefs();
+    virtual const FieldDefinition *getFieldDef(size_t aIndex);
+    virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP);
+    virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags);
+
+  };
+
+
   /// Implements the basic behaviour of an output with one or multiple output channels
   class OutputBehaviour : public DsBehaviour
   {
@@ -60,6 +92,8 @@ namespace p44 {
     /// @name internal volatile state
     /// @{
     bool localPriority; ///< if set device is in local priority mode
+    OutputLastState lastState; ///< last known channel values, persisted
+    bool lastStateRestored; ///< set if channel values are restored from last run and not yet confirmed by hardware
     /// @}
 
   public:
@@ -118,6 +152,30 @@ namespace p44 {
     /// @}
 
 
+    /// @name last known output state
+    /// @{
+
+    /// restore channel values from the last known state persisted in the previous run
+    /// @note this is called by Device::load(), so the device can report plausible output values before
+    ///   the hardware has been queried
+    void restoreLastState();
+
+    /// @return true if channel values were restored from the last run and have not been applied to or synced from hardware since
+    bool hasRestoredState() { return lastStateRestored; };
+
+    /// to be called when channel values have been applied to or synced from hardware
+    /// @note just marks the last state dirty, it will be saved with the next batched settings save
+    void channelStateChanged();
+
+    /// save the last known state (called from the settings save)
+    ErrorPtr saveLastState();
+
+    /// delete the last known state from persistent storage
+    ErrorPtr forgetLastState();
+
+    /// @}
+
+
     /// @name interaction with digitalSTROM system
     /// @{
 
@@ -175,6 +233,11 @@ namespace p44 {
     /// @param aChannelType the channel to check
     virtual bool canDim(DsChannelType aChannelType) { return true; /* in base class, nothing prevents dimming */ };
 
+    /// get the mode in which the hardware will interpret the channel values once pending values are applied
+    /// @return mode identifier (>=0), such as the color mode of color lights. Applying values in a different mode than
+    ///   the last applied one always reaches the hardware, even if no channel's hardware level changes.
+    virtual long hardwareChannelMode() { return 0; /* base class has no modes */ };
+
 
     /// Process a named control value. The type, color and settings of the output determine if at all,
     /// and if, how the value affects the output
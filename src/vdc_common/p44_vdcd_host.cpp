@@ -25,6 +25,8 @@
 #include "device.hpp"
 
 #include "jsonvdcapi.hpp"
+#include "tracer.hpp"
+#include "phaseprofiler.hpp"
 
 using namespace p44;
 
@@ -44,11 +46,12 @@ ErrorPtr P44JsonApiRequest::sendResult(ApiValuePtr aResult)
   LOG(LOG_INFO,"cfg <- vdcd (JSON) result sent: result=%s\n", aResult ? aResult->description().c_str() : "<none>");
   JsonApiValuePtr result = boost::dynamic_pointer_cast<JsonApiValue>(aResult);
   if (result) {
-    P44VdcHost::sendCfgApiResponse(jsonComm, result->jsonObject(), ErrorPtr());
+    P44VdcHost::sendCfgApiResponse(jsonComm, result->jsonNode(), ErrorPtr());
   }
   else {
     // always return SOMETHING
-    P44VdcHost::sendCfgApiResponse(jsonComm, JsonObject::newNull(), ErrorPtr());
+    JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+    P44VdcHost::sendCfgApiResponse(jsonComm, arena->newNull(), ErrorPtr());
   }
   return ErrorPtr();
 }
@@ -59,7 +62,7 @@ ErrorPtr P44JsonApiRequest::sendError(uint32_t aErrorCode, string aErrorMessage,
 {
   LOG(LOG_INFO,"cfg <- vdcd (JSON) error sent: error=%d (%s)\n", aErrorCode, aErrorMessage.c_str());
   ErrorPtr err = ErrorPtr(new Error(aErrorCode, aErrorMessage));
-  P44VdcHost::sendCfgApiResponse(jsonComm, JsonObjectPtr(), err);
+  P44VdcHost::sendCfgApiResponse(jsonComm, NULL, err);
   return ErrorPtr();
 }
 
@@ -217,13 +220,13 @@ void P44VdcHost::startConfigApi()
 SocketCommPtr P44VdcHost::configApiConnectionHandler(SocketCommPtr aServerSocketCommP)
 {
   JsonCommPtr conn = JsonCommPtr(new JsonComm(MainLoop::currentMainLoop()));
-  conn->setMessageHandler(boost::bind(&P44VdcHost::configApiRequestHandler, this, conn, _1, _2));
+  conn->setArenaMessageHandler(boost::bind(&P44VdcHost::configApiRequestHandler, this, conn, _1, _2));
   conn->setClearHandlersAtClose(); // close must break retain cycles so this object won't cause a mem leak
   return conn;
 }
 
 
-void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError, JsonObjectPtr aJsonObject)
+void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError, JsonArenaPtr aArena)
 {
   ErrorPtr err;
   // when coming from mg44, requests have the following form
@@ -240,13 +243,14 @@ void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError,
   // - "uri" selects one of possibly multiple APIs
   if (Error::isOK(aError)) {
     // not JSON level error, try to process
-    LOG(LOG_INFO,"cfg -> vdcd (JSON) request received: %s\n", aJsonObject->c_strValue());
+    JsonNode *message = aArena->root();
+    LOG(LOG_INFO,"cfg -> vdcd (JSON) request received: %s\n", message->c_strValue());
     // find out which one is our actual JSON request
     // - try POST data first
-    JsonObjectPtr request = aJsonObject->get("data");
+    JsonNode *request = message->get("data");
     if (!request) {
       // no POST data, try uri_params
-      request = aJsonObject->get("uri_params");
+      request = message->get("uri_params");
     }
     if (!request) {
       // empty query, that's an error
@@ -255,7 +259,7 @@ void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError,
     else {
       // have the request processed
       string apiselector;
-      JsonObjectPtr uri = aJsonObject->get("uri");
+      JsonNode *uri = message->get("uri");
       if (uri) apiselector = uri->stringValue();
       // dispatch according to API
       if (apiselector=="vdc") {
@@ -278,20 +282,21 @@ void P44VdcHost::configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError,
   }
   // if error or explicit OK, send response now. Otherwise, request processing will create and send the response
   if (aError) {
-    sendCfgApiResponse(aJsonComm, JsonObjectPtr(), aError);
+    sendCfgApiResponse(aJsonComm, NULL, aError);
   }
 }
 
 
-void P44VdcHost::sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult, ErrorPtr aError)
+void P44VdcHost::sendCfgApiResponse(JsonCommPtr aJsonComm, JsonNode *aResult, ErrorPtr aError)
 {
-  // create response
-  JsonObjectPtr response = JsonObject::newObj();
+  // create response (in the same arena as the result, if any)
+  JsonArenaPtr arena = aResult ? JsonArenaPtr(&aResult->getArena()) : JsonArenaPtr(new JsonArena);
+  JsonNode *response = arena->newObj();
   if (!Error::isOK(aError)) {
     // error, return error response
-    response->add("error", JsonObject::newInt32((int32_t)aError->getErrorCode()));
-    response->add("errormessage", JsonObject::newString(aError->getErrorMessage()));
-    response->add("errordomain", JsonObject::newString(aError->getErrorDomain()));
+    response->add("error", arena->newInt32((int32_t)aError->getErrorCode()));
+    response->add("errormessage", arena->newString(aError->getErrorMessage()));
+    response->add("errordomain", arena->newString(aError->getErrorDomain()));
   }
   else {
     // no error, return result (if any)
@@ -303,13 +308,13 @@ void P44VdcHost::sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult
 
 
 // access to vdc API methods and notifications via web requests
-ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aRequest)
+ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonNode *aRequest)
 {
   ErrorPtr err;
   string cmd;
   bool isMethod = false;
   // get method/notification and params
-  JsonObjectPtr m = aRequest->get("method");
+  JsonNode *m = aRequest->get("method");
   if (m) {
     // is a method call, expects answer
     isMethod = true;
@@ -361,19 +366,7 @@ ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aReq
       else {
         // handle notification
         // dSUID param can be single dSUID or array of dSUIDs
-        if (o->isType(apivalue_array)) {
-          // array of dSUIDs
-          for (int i=0; i<o->arrayLength(); i++) {
-            ApiValuePtr e = o->arrayGet(i);
-            dsuid.setAsBinary(e->binaryValue());
-            handleNotificationForDsUid(cmd, dsuid, params);
-          }
-        }
-        else {
-          // single dSUID
-          dsuid.setAsBinary(o->binaryValue());
-          handleNotificationForDsUid(cmd, dsuid, params);
-        }
+        handleNotificationForDsUids(cmd, o, params);
         // notifications are always successful
         err = ErrorPtr(new Error(ErrorOK));
       }
@@ -386,10 +379,10 @@ ErrorPtr P44VdcHost::processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aReq
 
 
 // access to plan44 extras that are not part of the vdc API
-ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aRequest)
+ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonNode *aRequest)
 {
   ErrorPtr err;
-  JsonObjectPtr m = aRequest->get("method");
+  JsonNode *m = aRequest->get("method");
   if (!m) {
     err = ErrorPtr(new P44VdcError(400, "missing 'method'"));
   }
@@ -398,7 +391,7 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
     if (method=="learn") {
       // check proximity check disabling
       bool disableProximity = false;
-      JsonObjectPtr o = aRequest->get("disableProximityCheck");
+      JsonNode *o = aRequest->get("disableProximityCheck");
       if (o) {
         disableProximity = o->boolValue();
       }
@@ -416,7 +409,7 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
           learnIdentifyRequest.reset();
         }
         // - confirm abort with no result
-        sendCfgApiResponse(aJsonComm, JsonObjectPtr(), ErrorPtr());
+        sendCfgApiResponse(aJsonComm, NULL, ErrorPtr());
       }
       else {
         // start learning
@@ -427,7 +420,7 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
     }
     else if (method=="identify") {
       // get timeout
-      JsonObjectPtr o = aRequest->get("seconds");
+      JsonNode *o = aRequest->get("seconds");
       int seconds = 30; // default to 30
       if (o) seconds = o->int32Value();
       if (seconds==0) {
@@ -440,7 +433,7 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
           learnIdentifyRequest.reset();
         }
         // - confirm abort with no result
-        sendCfgApiResponse(aJsonComm, JsonObjectPtr(), ErrorPtr());
+        sendCfgApiResponse(aJsonComm, NULL, ErrorPtr());
       }
       else {
         // wait for next user activity
@@ -451,7 +444,7 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
     }
     else if (method=="logLevel") {
       // get or set logging level for vdcd
-      JsonObjectPtr o = aRequest->get("value");
+      JsonNode *o = aRequest->get("value");
       if (o) {
         // set new value first
         int newLevel = o->int32Value();
@@ -460,7 +453,45 @@ ErrorPtr P44VdcHost::processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aReq
         LOG(LOG_WARNING,"\n========== changed log level from %d to %d ===============\n", oldLevel, newLevel);
       }
       // anyway: return current value
-      sendCfgApiResponse(aJsonComm, JsonObject::newInt32(LOGLEVEL), ErrorPtr());
+      sendCfgApiResponse(aJsonComm, aRequest->getArena().newInt32(LOGLEVEL), ErrorPtr());
+    }
+    else if (method=="trace") {
+      // enable/disable tracing and/or write trace in Chrome trace format
+      JsonNode *o = aRequest->get("events");
+      if (o) {
+        // set new ring buffer size (0=disable), clears trace
+        int32_t events = o->int32Value();
+        if (events<0 || events>TRACE_MAX_EVENTS) {
+          err = ErrorPtr(new P44VdcError(400, string_format("events must be 0..%d", TRACE_MAX_EVENTS)));
+        }
+        else {
+          globalTracer.setBufferSize(events);
+        }
+      }
+      o = aRequest->get("file");
+      if (o && Error::isOK(err)) {
+        err = globalTracer.writeChromeTrace(o->stringValue());
+      }
+      if (Error::isOK(err)) {
+        // return tracing status
+        JsonArena &arena = aRequest->getArena();
+        JsonNode *status = arena.newObj();
+        status->add("bufferSize", arena.newInt64(globalTracer.bufferSize()));
+        status->add("events", arena.newInt64(globalTracer.eventCount()));
+        sendCfgApiResponse(aJsonComm, status, ErrorPtr());
+      }
+    }
+    else if (method=="startupProfile") {
+      // return the phase timing reports of the last startups
+      string json;
+      globalPhaseProfiler.appendReportsJson(json);
+      JsonArenaPtr reports = JsonArena::arenaFromText(json.c_str(), json.size());
+      if (reports) {
+        sendCfgApiResponse(aJsonComm, reports->root(), ErrorPtr());
+      }
+      else {
+        err = ErrorPtr(new P44VdcError(500, "invalid stored startup profiles"));
+      }
     }
     else {
       err = ErrorPtr(new P44VdcError(400, "unknown method"));
@@ -474,7 +505,8 @@ void P44VdcHost::learnHandler(JsonCommPtr aJsonComm, bool aLearnIn, ErrorPtr aEr
 {
   MainLoop::currentMainLoop().cancelExecutionTicket(learnIdentifyTicket);
   stopLearning();
-  sendCfgApiResponse(aJsonComm, JsonObject::newBool(aLearnIn), aError);
+  JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+  sendCfgApiResponse(aJsonComm, arena->newBool(aLearnIn), aError);
   learnIdentifyRequest.reset();
 }
 
@@ -483,12 +515,13 @@ void P44VdcHost::identifyHandler(JsonCommPtr aJsonComm, DevicePtr aDevice)
 {
   MainLoop::currentMainLoop().cancelExecutionTicket(learnIdentifyTicket);
   if (aDevice) {
-    sendCfgApiResponse(aJsonComm, JsonObject::newString(aDevice->getDsUid().getString()), ErrorPtr());
+    JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+    sendCfgApiResponse(aJsonComm, arena->newString(aDevice->getDsUid().getString()), ErrorPtr());
     // end monitor mode
     setUserActionMonitor(NULL);
   }
   else {
-    sendCfgApiResponse(aJsonComm, JsonObjectPtr(), ErrorPtr(new P44VdcError(408, "identify timeout")));
+    sendCfgApiResponse(aJsonComm, NULL, ErrorPtr(new P44VdcError(408, "identify timeout")));
     setUserActionMonitor(NULL);
   }
   learnIdentifyRequest.reset();
@@ -114,15 +114,15 @@ namespace p44 {
   private:
 
     SocketCommPtr configApiConnectionHandler(SocketCommPtr aServerSocketComm);
-    void configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError, JsonObjectPtr aJsonObject);
+    void configApiRequestHandler(JsonCommPtr aJsonComm, ErrorPtr aError, JsonArenaPtr aArena);
     void learnHandler(JsonCommPtr aJsonComm, bool aLearnIn, ErrorPtr aError);
     void identifyHandler(JsonCommPtr aJsonComm, DevicePtr aDevice);
     void endIdentify();
 
-    ErrorPtr processVdcRequest(JsonCommPtr aJsonComm, JsonObjectPtr aRequest);
-    ErrorPtr processP44Request(JsonCommPtr aJsonComm, JsonObjectPtr aRequest);
+    ErrorPtr processVdcRequest(JsonCommPtr aJsonComm, JsonNode *aRequest);
+    ErrorPtr processP44Request(JsonCommPtr aJsonComm, JsonNode *aRequest);
 
-    static void sendCfgApiResponse(JsonCommPtr aJsonComm, JsonObjectPtr aResult, ErrorPtr aError);
+    static void sendCfgApiResponse(JsonCommPtr aJsonComm, JsonNode *aResult, ErrorPtr aError);
 
   };
   typedef boost::intrusive_ptr<P44VdcHost> P44VdcHostPtr;
@@ -28,6 +28,8 @@
 
 #include "pbufvdcapi.hpp"
 
+#include "tracer.hpp"
+
 
 using namespace p44;
 
@@ -1106,7 +1108,10 @@ void VdcPbufApiConnection::gotData(ErrorPtr aError)
           if (expectedMsgBytes && (receivedMessage.size()>=expectedMsgBytes)) {
             FOCUSLOG("gotData: receivedMessage.size()=%d >= expectedMsgBytes=%d -> process\n", receivedMessage.size(), expectedMsgBytes);
             // process message
-            aError = processMessage((uint8_t *)receivedMessage.c_str(),expectedMsgBytes);
+            {
+              TRACE_SCOPE("vdcapi pbuf message", string_format("%d bytes", expectedMsgBytes));
+              aError = processMessage((uint8_t *)receivedMessage.c_str(),expectedMsgBytes);
+            }
             // erase processed message
             receivedMessage.erase(0,expectedMsgBytes);
             DBGFOCUSLOG("gotData: after removing message: receivedMessage.size()=%d\n", receivedMessage.size());
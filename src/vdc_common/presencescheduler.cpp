@@ -0,0 +1,307 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "presencescheduler.hpp"
+
+#include "device.hpp"
+#include "deviceclasscontainer.hpp"
+
+using namespace p44;
+
+
+PresenceScheduler::PresenceScheduler()
+{
+  reset();
+}
+
+
+PresenceScheduler::~PresenceScheduler()
+{
+  for (LaneMap::iterator pos = lanes.begin(); pos!=lanes.end(); ++pos) {
+    MainLoop::currentMainLoop().cancelExecutionTicket(pos->second.ticket);
+    if (pos->second.running) {
+      MainLoop::currentMainLoop().cancelExecutionTicket(pos->second.running->timeoutTicket);
+    }
+  }
+}
+
+
+void PresenceScheduler::reset()
+{
+  requested = 0;
+  coalesced = 0;
+  started = 0;
+  completed = 0;
+  absent = 0;
+  timedOut = 0;
+  waitSum = 0;
+  maxWait = 0;
+  recentStarts.clear();
+}
+
+
+void PresenceScheduler::requestCheck(DsAddressablePtr aAddressable, DsAddressable::PresenceCB aPresenceResultHandler)
+{
+  requested++;
+  // devices are queued per class container, vdcs and the vdc host share a lane
+  Device *dev = dynamic_cast<Device *>(aAddressable.get());
+  DeviceClassContainer *laneKey = dev ? &dev->getClassContainer() : NULL;
+  Lane &lane = lanes[laneKey];
+  // attach to check already running or queued for the same addressable
+  if (lane.running && !lane.running->done && lane.running->addressable==aAddressable) {
+    lane.running->handlers.push_back(aPresenceResultHandler);
+    coalesced++;
+    return;
+  }
+  for (PresenceCheckList::iterator pos = lane.pending.begin(); pos!=lane.pending.end(); ++pos) {
+    if ((*pos)->addressable==aAddressable) {
+      (*pos)->handlers.push_back(aPresenceResultHandler);
+      coalesced++;
+      return;
+    }
+  }
+  // queue new check
+  PresenceCheckPtr check = PresenceCheckPtr(new PresenceCheck(aAddressable));
+  check->handlers.push_back(aPresenceResultHandler);
+  lane.pending.push_back(check);
+  scheduleLane(laneKey, 0);
+}
+
+
+void PresenceScheduler::forget(const DsUid &aDsUid)
+{
+  lastChecked.erase(aDsUid);
+  for (LaneMap::iterator lpos = lanes.begin(); lpos!=lanes.end(); ++lpos) {
+    PresenceCheckPtr running = lpos->second.running;
+    if (running && running->addressable->getDsUid()==aDsUid) running->forgotten = true;
+    PresenceCheckList &pending = lpos->second.pending;
+    for (PresenceCheckList::iterator pos = pending.begin(); pos!=pending.end(); ) {
+      if ((*pos)->addressable->getDsUid()==aDsUid)
+        pos = pending.erase(pos);
+      else
+        ++pos;
+    }
+  }
+}
+
+
+void PresenceScheduler::scheduleLane(DeviceClassContainer *aLaneKey, MLMicroSeconds aDelay)
+{
+  Lane &lane = lanes[aLaneKey];
+  if (lane.ticket) return; // already scheduled
+  // always run from mainloop, to avoid recursion with checks reporting back synchronously
+  lane.ticket = MainLoop::currentMainLoop().executeOnce(boost::bind(&PresenceScheduler::runLane, this, aLaneKey), aDelay);
+}
+
+
+void PresenceScheduler::runLane(DeviceClassContainer *aLaneKey)
+{
+  Lane &lane = lanes[aLaneKey];
+  lane.ticket = 0;
+  if (lane.running || lane.pending.empty()) return; // busy or nothing to do
+  MLMicroSeconds now = MainLoop::now();
+  if (lane.nextStart!=Never && now<lane.nextStart) {
+    // rate limited, try again later
+    scheduleLane(aLaneKey, lane.nextStart-now);
+    return;
+  }
+  // pick the check for the addressable whose last check is the oldest (never checked ones first)
+  PresenceCheckList::iterator stalest = lane.pending.begin();
+  MLMicroSeconds stalestCheck = lastCheckOf((*stalest)->addressable->getDsUid());
+  for (PresenceCheckList::iterator pos = ++lane.pending.begin(); pos!=lane.pending.end(); ++pos) {
+    MLMicroSeconds t = lastCheckOf((*pos)->addressable->getDsUid());
+    if (t<stalestCheck) {
+      stalest = pos;
+      stalestCheck = t;
+    }
+  }
+  PresenceCheckPtr check = *stalest;
+  lane.pending.erase(stalest);
+  // rate limit for next check of this lane: class specific interval plus up to 50% random jitter
+  MLMicroSeconds interval = aLaneKey ? aLaneKey->presenceCheckInterval() : 0;
+  if (interval>0) interval += random() % (interval/2+1);
+  lane.nextStart = now+interval;
+  lane.running = check;
+  // metrics
+  started++;
+  MLMicroSeconds wait = now-check->requestedAt;
+  waitSum += wait;
+  if (wait>maxWait) maxWait = wait;
+  recentStarts.push_back(now);
+  pruneRecentStarts();
+  // start the check
+  LOG(LOG_DEBUG, "presence check for %s %s started after waiting %.3f S in queue\n", check->addressable->entityType(), check->addressable->shortDesc().c_str(), (double)wait/Second);
+  check->timeoutTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&PresenceScheduler::checkTimeout, this, aLaneKey, check), PRESENCE_CHECK_TIMEOUT);
+  check->addressable->checkPresence(boost::bind(&PresenceScheduler::checkDone, this, aLaneKey, check, _1));
+}
+
+
+void PresenceScheduler::checkTimeout(DeviceClassContainer *aLaneKey, PresenceCheckPtr aCheck)
+{
+  aCheck->timeoutTicket = 0;
+  if (!aCheck->forgotten) {
+    LOG(LOG_WARNING, "presence check for %s %s did not report back -> assuming not present\n", aCheck->addressable->entityType(), aCheck->addressable->shortDesc().c_str());
+    timedOut++;
+  }
+  checkDone(aLaneKey, aCheck, false);
+}
+
+
+void PresenceScheduler::checkDone(DeviceClassContainer *aLaneKey, PresenceCheckPtr aCheck, bool aPresent)
+{
+  if (aCheck->done) return; // late or repeated result of an already completed check
+  aCheck->done = true;
+  MainLoop::currentMainLoop().cancelExecutionTicket(aCheck->timeoutTicket);
+  // free the lane for the next check
+  Lane &lane = lanes[aLaneKey];
+  if (lane.running==aCheck) lane.running.reset();
+  if (!lane.pending.empty()) scheduleLane(aLaneKey, 0);
+  if (aCheck->forgotten) return; // addressable has gone away meanwhile, drop result
+  lastChecked[aCheck->addressable->getDsUid()] = MainLoop::now();
+  completed++;
+  if (!aPresent) {
+    absent++;
+    // device might come back with different output state (e.g. DALI power-on level), must not suppress applies then
+    Device *dev = dynamic_cast<Device *>(aCheck->addressable.get());
+    if (dev) dev->forgetAppliedHardwareLevels();
+  }
+  // report to all requesters
+  for (list<DsAddressable::PresenceCB>::iterator pos = aCheck->handlers.begin(); pos!=aCheck->handlers.end(); ++pos) {
+    if (*pos) (*pos)(aPresent);
+  }
+}
+
+
+MLMicroSeconds PresenceScheduler::lastCheckOf(const DsUid &aDsUid)
+{
+  CheckTimeMap::iterator pos = lastChecked.find(aDsUid);
+  return pos!=lastChecked.end() ? pos->second : Never;
+}
+
+
+size_t PresenceScheduler::pendingChecks()
+{
+  size_t n = 0;
+  for (LaneMap::iterator pos = lanes.begin(); pos!=lanes.end(); ++pos) {
+    n += pos->second.pending.size();
+  }
+  return n;
+}
+
+
+void PresenceScheduler::pruneRecentStarts()
+{
+  MLMicroSeconds oneMinuteAgo = MainLoop::now()-1*Minute;
+  while (!recentStarts.empty() && recentStarts.front()<oneMinuteAgo) {
+    recentStarts.pop_front();
+  }
+}
+
+
+#pragma mark - property access
+
+static char presencechecks_key;
+
+enum {
+  requested_key,
+  coalesced_key,
+  completed_key,
+  absent_key,
+  timedOut_key,
+  pending_key,
+  checksPerMinute_key,
+  avgWait_key,
+  maxWait_key,
+  oldestCheckAge_key,
+  avgCheckAge_key,
+  reset_key,
+  numPresenceChecksProperties
+};
+
+
+int PresenceScheduler::numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor)
+{
+  return numPresenceChecksProperties;
+}
+
+
+PropertyDescriptorPtr PresenceScheduler::getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor)
+{
+  static const PropertyDescription properties[numPresenceChecksProperties] = {
+    { "requested", apivalue_uint64, requested_key, OKEY(presencechecks_key) },
+    { "coalesced", apivalue_uint64, coalesced_key, OKEY(presencechecks_key) },
+    { "completed", apivalue_uint64, completed_key, OKEY(presencechecks_key) },
+    { "absent", apivalue_uint64, absent_key, OKEY(presencechecks_key) },
+    { "timedOut", apivalue_uint64, timedOut_key, OKEY(presencechecks_key) },
+    { "pending", apivalue_uint64, pending_key, OKEY(presencechecks_key) },
+    { "checksPerMinute", apivalue_uint64, checksPerMinute_key, OKEY(presencechecks_key) },
+    { "avgWaitMS", apivalue_double, avgWait_key, OKEY(presencechecks_key) },
+    { "maxWaitMS", apivalue_double, maxWait_key, OKEY(presencechecks_key) },
+    { "oldestCheckAgeS", apivalue_double, oldestCheckAge_key, OKEY(presencechecks_key) },
+    { "avgCheckAgeS", apivalue_double, avgCheckAge_key, OKEY(presencechecks_key) },
+    { "reset", apivalue_bool, reset_key, OKEY(presencechecks_key) }
+  };
+  return PropertyDescriptorPtr(new StaticPropertyDescriptor(&properties[aPropIndex], aParentDescriptor));
+}
+
+
+bool PresenceScheduler::accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor)
+{
+  if (aPropertyDescriptor->hasObjectKey(presencechecks_key)) {
+    if (aMode==access_read) {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case requested_key: aPropValue->setUint64Value(requested); return true;
+        case coalesced_key: aPropValue->setUint64Value(coalesced); return true;
+        case completed_key: aPropValue->setUint64Value(completed); return true;
+        case absent_key: aPropValue->setUint64Value(absent); return true;
+        case timedOut_key: aPropValue->setUint64Value(timedOut); return true;
+        case pending_key: aPropValue->setUint64Value(pendingChecks()); return true;
+        case checksPerMinute_key: pruneRecentStarts(); aPropValue->setUint64Value(recentStarts.size()); return true;
+        case avgWait_key: aPropValue->setDoubleValue(started>0 ? (double)waitSum/started/MilliSecond : 0); return true;
+        case maxWait_key: aPropValue->setDoubleValue((double)maxWait/MilliSecond); return true;
+        case oldestCheckAge_key:
+        case avgCheckAge_key: {
+          // age of the results of the most recent checks of all checked addressables
+          MLMicroSeconds now = MainLoop::now();
+          MLMicroSeconds oldest = 0;
+          MLMicroSeconds sum = 0;
+          for (CheckTimeMap::iterator pos = lastChecked.begin(); pos!=lastChecked.end(); ++pos) {
+            MLMicroSeconds age = now-pos->second;
+            sum += age;
+            if (age>oldest) oldest = age;
+          }
+          if (aPropertyDescriptor->fieldKey()==oldestCheckAge_key)
+            aPropValue->setDoubleValue((double)oldest/Second);
+          else
+            aPropValue->setDoubleValue(lastChecked.size()>0 ? (double)sum/lastChecked.size()/Second : 0);
+          return true;
+        }
+        case reset_key: aPropValue->setBoolValue(false); return true;
+      }
+    }
+    else {
+      switch (aPropertyDescriptor->fieldKey()) {
+        case reset_key: if (aPropValue->boolValue()) reset(); return true;
+      }
+    }
+  }
+  return inherited::accessField(aMode, aPropValue, aPropertyDescriptor);
+}
@@ -0,0 +1,131 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __vdcd__presencescheduler__
+#define __vdcd__presencescheduler__
+
+#include "dsaddressable.hpp"
+
+#include <deque>
+
+using namespace std;
+
+namespace p44 {
+
+  /// time after which a presence check that did not report back is considered failed
+  #define PRESENCE_CHECK_TIMEOUT (30*Second)
+
+  class DeviceClassContainer;
+  class PresenceScheduler;
+  typedef boost::intrusive_ptr<PresenceScheduler> PresenceSchedulerPtr;
+
+  /// Central scheduler for presence checks of all addressables of a vdc host.
+  /// Presence checks (e.g. triggered by vdSM pings, which arrive for all devices at once after a reconnect)
+  /// are queued per device class container and started one at a time, at most one per
+  /// DeviceClassContainer::presenceCheckInterval() plus random jitter, so buses and bridges do not get flooded.
+  /// Among the queued checks of a class, the one for the addressable with the oldest previous check is run first.
+  /// Exposed as the "x-p44-presenceChecks" property of the vdc host.
+  class PresenceScheduler : public PropertyContainer
+  {
+    typedef PropertyContainer inherited;
+
+    /// a queued or running check, possibly with multiple requesters waiting for its result
+    class PresenceCheck : public P44Obj
+    {
+    public:
+      DsAddressablePtr addressable;
+      list<DsAddressable::PresenceCB> handlers; ///< all requesters of this check
+      MLMicroSeconds requestedAt; ///< when the check was first requested
+      long timeoutTicket;
+      bool done; ///< set when the result is in (later, repeated results are ignored)
+      bool forgotten; ///< set when the addressable has gone away while the check was running, result will be dropped
+      PresenceCheck(DsAddressablePtr aAddressable) : addressable(aAddressable), requestedAt(MainLoop::now()), timeoutTicket(0), done(false), forgotten(false) {};
+    };
+    typedef boost::intrusive_ptr<PresenceCheck> PresenceCheckPtr;
+    typedef list<PresenceCheckPtr> PresenceCheckList;
+
+    /// checks of one device class container
+    struct Lane {
+      PresenceCheckList pending; ///< checks waiting to be started
+      PresenceCheckPtr running; ///< the check currently running, if any
+      MLMicroSeconds nextStart; ///< earliest time the next check may start
+      long ticket; ///< ticket for starting the next check
+      Lane() : nextStart(Never), ticket(0) {};
+    };
+    typedef map<DeviceClassContainer *, Lane> LaneMap;
+    LaneMap lanes; ///< lanes by class container, NULL for addressables not being devices (vdcs, vdc host)
+
+    typedef map<DsUid, MLMicroSeconds> CheckTimeMap;
+    CheckTimeMap lastChecked; ///< time of the last completed check by dSUID
+
+    // metrics
+    uint32_t requested; ///< number of checks requested
+    uint32_t coalesced; ///< number of requests merged into an already queued or running check
+    uint32_t started; ///< number of checks started
+    uint32_t completed; ///< number of completed checks
+    uint32_t absent; ///< number of checks that reported the addressable not present
+    uint32_t timedOut; ///< number of checks that did not report back within PRESENCE_CHECK_TIMEOUT
+    MLMicroSeconds waitSum; ///< sum of queue waiting times of started checks
+    MLMicroSeconds maxWait; ///< max queue waiting time seen
+    deque<MLMicroSeconds> recentStarts; ///< start times of the checks within the last minute
+
+  public:
+
+    PresenceScheduler();
+    virtual ~PresenceScheduler();
+
+    /// request a presence check
+    /// @param aAddressable the addressable to check
+    /// @param aPresenceResultHandler will be called with the result once the check has run
+    /// @note if a check for the same addressable is already queued or running, the handler is attached to it
+    void requestCheck(DsAddressablePtr aAddressable, DsAddressable::PresenceCB aPresenceResultHandler);
+
+    /// forget queued checks and check history of an addressable (which is going away)
+    /// @param aDsUid dSUID of the addressable
+    /// @note a check already running for the addressable still occupies its lane until it reports back or times out,
+    ///   but its result is dropped
+    void forget(const DsUid &aDsUid);
+
+    /// reset all counters
+    void reset();
+
+  protected:
+
+    // property access implementation
+    virtual int numProps(int aDomain, PropertyDescriptorPtr aParentDescriptor);
+    virtual PropertyDescriptorPtr getDescriptorByIndex(int aPropIndex, int aDomain, PropertyDescriptorPtr aParentDescriptor);
+    virtual bool accessField(PropertyAccessMode aMode, ApiValuePtr aPropValue, PropertyDescriptorPtr aPropertyDescriptor);
+
+  private:
+
+    void scheduleLane(DeviceClassContainer *aLaneKey, MLMicroSeconds aDelay);
+    void runLane(DeviceClassContainer *aLaneKey);
+    void checkDone(DeviceClassContainer *aLaneKey, PresenceCheckPtr aCheck, bool aPresent);
+    void checkTimeout(DeviceClassContainer *aLaneKey, PresenceCheckPtr aCheck);
+    MLMicroSeconds lastCheckOf(const DsUid &aDsUid);
+    size_t pendingChecks();
+    void pruneRecentStarts();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__vdcd__presencescheduler__) */
@@ -0,0 +1,179 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "transitionengine.hpp"
+
+#include "device.hpp"
+#include "tracer.hpp"
+
+using namespace p44;
+
+
+TransitionEngine::TransitionEngine(MLMicroSeconds aFrameInterval) :
+  frameInterval(aFrameInterval),
+  nextFrame(Never),
+  frameTicket(0),
+  stepping(false)
+{
+}
+
+
+TransitionEngine::~TransitionEngine()
+{
+  MainLoop::currentMainLoop().cancelExecutionTicket(frameTicket);
+}
+
+
+void TransitionEngine::startTransition(Device &aDevice, MLMicroSeconds aTransitionTime, TransitionStepCB aStepper)
+{
+  size_t i;
+  for (i=0; i<transitions.size(); i++) {
+    if (transitions[i].device.get()==&aDevice) break;
+  }
+  if (i>=transitions.size()) {
+    Transition nt;
+    nt.device = DevicePtr(&aDevice);
+    transitions.push_back(nt);
+  }
+  transitions[i].stepper = aStepper;
+  transitions[i].transitionTime = aTransitionTime;
+  transitions[i].active = true;
+  transitions[i].traceId = globalTracer.getCurrentId();
+  // make sure frame clock is running
+  if (!frameTicket) {
+    nextFrame = MainLoop::now()+frameInterval;
+    frameTicket = MainLoop::currentMainLoop().executeOnceAt(boost::bind(&TransitionEngine::frame, this), nextFrame);
+  }
+  // first step right now, aligned to the shared frame clock from then on
+  bool wasStepping = stepping;
+  stepping = true;
+  step(i, MainLoop::now());
+  stepping = wasStepping;
+  if (!stepping) removeInactive();
+  // push out the initial step right away
+  aDevice.getClassContainer().transitionFrameDone();
+}
+
+
+void TransitionEngine::stopTransition(Device &aDevice)
+{
+  for (TransitionVector::iterator pos = transitions.begin(); pos!=transitions.end(); ++pos) {
+    if (pos->device.get()==&aDevice) {
+      if (stepping) {
+        // just mark stopped, will be removed after stepping
+        pos->active = false;
+        pos->stepper = NULL;
+      }
+      else {
+        transitions.erase(pos);
+      }
+      break;
+    }
+  }
+}
+
+
+bool TransitionEngine::isTransitionRunning(Device &aDevice)
+{
+  for (TransitionVector::iterator pos = transitions.begin(); pos!=transitions.end(); ++pos) {
+    if (pos->device.get()==&aDevice) return pos->active;
+  }
+  return false;
+}
+
+
+size_t TransitionEngine::activeTransitions()
+{
+  return transitions.size();
+}
+
+
+bool TransitionEngine::step(size_t aIndex, MLMicroSeconds aNow)
+{
+  Transition &t = transitions[aIndex];
+  if (!t.active) return false;
+  TRACE_ID_SCOPE(t.traceId); // attribute output of the steps to the operation that started the transition
+  // step size is the progress to be reached at the next frame
+  double stepSize = 1;
+  if (t.transitionTime>0) {
+    MLMicroSeconds toNext = nextFrame-aNow;
+    if (toNext<=0 || toNext>frameInterval) toNext = frameInterval;
+    stepSize = (double)toNext/t.transitionTime;
+  }
+  // Note: stepper might start or stop transitions, which could modify or reallocate the vector,
+  //   so it must not be called while still stored in the vector (swapping is cheap, no allocation)
+  TransitionStepCB stepper;
+  stepper.swap(t.stepper);
+  bool more = stepper(stepSize);
+  Transition &ta = transitions[aIndex]; // re-fetch, vector might have been reallocated
+  if (ta.active && ta.stepper.empty()) {
+    // not stopped or replaced from within the stepper
+    if (more)
+      ta.stepper.swap(stepper); // keep for next frame
+    else
+      ta.active = false; // transition complete
+  }
+  return ta.active;
+}
+
+
+void TransitionEngine::removeInactive()
+{
+  TransitionVector::iterator pos = transitions.begin();
+  while (pos!=transitions.end()) {
+    if (!pos->active)
+      pos = transitions.erase(pos);
+    else
+      ++pos;
+  }
+}
+
+
+void TransitionEngine::frame()
+{
+  frameTicket = 0;
+  MLMicroSeconds now = MainLoop::now();
+  nextFrame = now+frameInterval;
+  // step all transitions
+  typedef vector<DeviceClassContainer *> ContainerVector;
+  ContainerVector steppedContainers;
+  stepping = true;
+  // Note: index based, as steppers might start new transitions (appending to the vector)
+  for (size_t i=0; i<transitions.size(); i++) {
+    if (!transitions[i].active) continue; // stopped within this frame
+    DevicePtr dev = transitions[i].device; // keep device alive while stepping
+    step(i, now);
+    DeviceClassContainer *cc = &dev->getClassContainer();
+    if (find(steppedContainers.begin(), steppedContainers.end(), cc)==steppedContainers.end()) {
+      steppedContainers.push_back(cc);
+    }
+  }
+  stepping = false;
+  removeInactive();
+  // let containers push outputs of this frame in one batch
+  for (ContainerVector::iterator pos = steppedContainers.begin(); pos!=steppedContainers.end(); ++pos) {
+    (*pos)->transitionFrameDone();
+  }
+  // next frame if any transitions are still running
+  if (transitions.size()>0) {
+    frameTicket = MainLoop::currentMainLoop().executeOnceAt(boost::bind(&TransitionEngine::frame, this), nextFrame);
+  }
+}
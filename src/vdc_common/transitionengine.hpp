@@ -0,0 +1,99 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef __vdcd__transitionengine__
+#define __vdcd__transitionengine__
+
+#include "p44_common.hpp"
+
+using namespace std;
+
+namespace p44 {
+
+  class Device;
+  typedef boost::intrusive_ptr<Device> DevicePtr;
+
+  /// callback for stepping a transition
+  /// @param aStepSize progress increment (0..1 of the entire transition) to advance by after applying the current
+  ///   transitional value, i.e. the progress the transition should have reached at the next frame.
+  /// @return must return true when more steps are needed, false when the transition has completed
+  typedef boost::function<bool (double aStepSize)> TransitionStepCB;
+
+
+  /// Central engine stepping all running output transitions on a shared frame clock.
+  /// Instead of every device running its own transition timer, devices register their stepper with the engine,
+  /// which calls all of them from a single timer per frame. After each frame, the device class containers of
+  /// all devices stepped in that frame are notified via DeviceClassContainer::transitionFrameDone(), so they
+  /// can push the updated outputs to the hardware in one batch.
+  class TransitionEngine
+  {
+    struct Transition {
+      DevicePtr device; ///< the device running this transition (kept alive while transition runs)
+      TransitionStepCB stepper; ///< the stepper
+      MLMicroSeconds transitionTime; ///< overall transition time
+      bool active; ///< cleared when transition has completed or was stopped
+      uint32_t traceId; ///< trace id of the operation that started the transition
+    };
+    typedef vector<Transition> TransitionVector;
+    TransitionVector transitions; ///< currently running transitions
+
+    MLMicroSeconds frameInterval; ///< time between frames
+    MLMicroSeconds nextFrame; ///< time of next frame
+    long frameTicket; ///< the shared frame timer
+    bool stepping; ///< set while steppers are being called
+
+  public:
+
+    /// @param aFrameInterval time between two transition steps
+    TransitionEngine(MLMicroSeconds aFrameInterval = 10*MilliSecond);
+    ~TransitionEngine();
+
+    /// start a transition for a device
+    /// @param aDevice the device
+    /// @param aTransitionTime overall time for the transition, 0 for immediate
+    /// @param aStepper will be called for the first time right away, and then once per frame
+    ///   until it returns false
+    /// @note a transition already running for aDevice is replaced
+    void startTransition(Device &aDevice, MLMicroSeconds aTransitionTime, TransitionStepCB aStepper);
+
+    /// stop a running transition for a device (NOP if no transition is running)
+    /// @param aDevice the device
+    void stopTransition(Device &aDevice);
+
+    /// check if a transition is running for a device
+    /// @param aDevice the device
+    /// @return true if a transition is currently running for aDevice
+    bool isTransitionRunning(Device &aDevice);
+
+    /// @return number of currently running transitions
+    size_t activeTransitions();
+
+  private:
+
+    bool step(size_t aIndex, MLMicroSeconds aNow);
+    void removeInactive();
+    void frame();
+
+  };
+
+} // namespace p44
+
+#endif /* defined(__vdcd__transitionengine__) */
@@ -0,0 +1,1769 @@
+//
+//  Copyright (c) 2013-2015 plan44.ch / Lukas Zeller, Zurich, Switzerland
+//
+//  Author: Lukas Zeller <luz@plan44.ch>
+//
+//  This file is part of vdcd.
+//
+//  vdcd is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  vdcd is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with vdcd. If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Checks for logic that can be tested without hardware, run by "make check"
+// (a stub vdSM on a local TCP connection stands in for the real one where needed)
+
+#include "application.hpp"
+
+#include "jsonarena.hpp"
+#include "jsoncomm.hpp"
+#include "jsonrpccomm.hpp"
+#include "persistentparams.hpp"
+#include "devicecontainer.hpp"
+#include "deviceclasscontainer.hpp"
+#include "device.hpp"
+#include "lightbehaviour.hpp"
+#include "buttonbehaviour.hpp"
+#include "jsonvdcapi.hpp"
+#include "jsonobject.hpp"
+
+#include <boost/unordered_map.hpp>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define MAINLOOP_CYCLE_TIME_uS 10000 // 10mS
+#define DEFAULT_LOGLEVEL LOG_WARNING
+
+#define ASYNC_STEP_SETTLE_TIME (200*MilliSecond) // time for async steps to deliver all results
+
+#define LOCAL_HOST_LIGHTS 500 // number of test lights in the host without vdSM connection (all of them fade at once in the fade checks)
+#define CALLSCENE_BENCHMARK_CALLS 20000 // number of scene calls for measuring callScene performance
+#define DIM_APPLY_LATENCY (100*MilliSecond) // simulated apply latency of the dimmed light
+#define DIM_MIN_STEP_INTERVAL (50*MilliSecond) // minimum dim step interval of the test device class while dimming
+#define DIM_TIME (3*Second) // how long to dim
+#define CLICK_ZONE 5 // zone for the lights and the button of the local click checks
+#define CLICK_ZONE_LIGHTS 16 // number of lights in CLICK_ZONE
+#define EMPTY_ZONE 7 // zone without lights
+#define FADE_TIME (1*Second) // transition time for the simultaneous fades
+#define FADE_TARGET 30 // brightness to fade to
+#define SCENE_HOST_LIGHTS 2000 // number of lights for measuring scene table memory
+#define SCENE_TABLE_SIZE 128 // number of scene numbers per light
+#define DIRTY_SETTINGS 1000 // number of changed device settings to save at once
+#define SAVE_SWEEP_BUDGET (50*MilliSecond) // time budget of one periodic settings save sweep of the vdc host
+#define STARTUP_HOST_LIGHTS 5000 // number of lights for measuring startup time
+#define SESSION_HOST_LIGHTS 5000 // number of lights of the host connected to the stub vdSM
+#define SESSION_TIMEOUT (30*Second) // max time for operations in the vdSM session
+#define NOTIFICATION_TARGETS 500 // number of dSUIDs in one callScene notification
+#define SCENE_CALL_FIRST_LIGHT 1000 // first light of the group for the scene call latency check
+#define SCENE_CALL_TARGETS 64 // number of lights in the group for the scene call latency check
+
+using namespace p44;
+
+
+static unsigned long heapAllocations = 0; ///< number of operator new calls so far, for checking allocations of code paths
+
+void *operator new(size_t aSize) throw(std::bad_alloc)
+{
+  heapAllocations++;
+  void *p = malloc(aSize>0 ? aSize : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *aPtr) throw()
+{
+  free(aPtr);
+}
+
+
+/// @return directory for temporary files, tmpfs if available to keep "make check" from wearing flash or waiting for disk syncs
+/// @return bytes currently allocated from the heap, -1 if not known on this platform
+static long heapInUse()
+{
+  #if defined(__GLIBC__) && (__GLIBC__>2 || (__GLIBC__==2 && __GLIBC_MINOR__>=33))
+  return (long)mallinfo2().uordblks;
+  #elif defined(__GLIBC__)
+  return mallinfo().uordblks;
+  #else
+  return -1;
+  #endif
+}
+
+
+static string tempDir()
+{
+  struct stat st;
+  return stat("/dev/shm", &st)==0 && S_ISDIR(st.st_mode) ? "/dev/shm" : "/tmp";
+}
+
+
+/// feeds data into a (non-blocking) fd from the mainloop, in chunks, without blocking the mainloop
+class FdFeeder : public P44Obj
+{
+  int fd;
+  string pending;
+
+public:
+
+  FdFeeder(int aFd) : fd(aFd) {};
+
+  /// append data to be written
+  void feed(const string &aData)
+  {
+    bool idle = pending.empty();
+    pending.append(aData);
+    if (idle) writeMore();
+  };
+
+private:
+
+  void writeMore()
+  {
+    if (pending.empty()) return;
+    ssize_t n = write(fd, pending.c_str(), pending.size());
+    if (n>0) pending.erase(0, n);
+    if (!pending.empty()) {
+      // socket buffer full, wait for reader
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&FdFeeder::writeMore, boost::intrusive_ptr<FdFeeder>(this)), 1*MilliSecond);
+    }
+  };
+
+};
+typedef boost::intrusive_ptr<FdFeeder> FdFeederPtr;
+
+
+
+/// minimal parameter set for checking ParamStore
+class TestParams : public PersistentParams
+{
+  typedef PersistentParams inheritedParams;
+
+public:
+
+  string parentId;
+  int value;
+  string text;
+
+  TestParams(ParamStore &aParamStore, const char *aParentId) :
+    inheritedParams(aParamStore),
+    parentId(aParentId),
+    value(0)
+  {
+  };
+
+  virtual const char *tableName() { return "testParams"; };
+
+  static const size_t numFields = 2;
+
+  virtual size_t numFieldDefs() { return inheritedParams::numFieldDefs()+numFields; };
+
+  virtual const FieldDefinition *getFieldDef(size_t aIndex)
+  {
+    static const FieldDefinition dataDefs[numFields] = {
+      { "value", SQLITE_INTEGER },
+      { "text", SQLITE_TEXT }
+    };
+    if (aIndex<inheritedParams::numFieldDefs())
+      return inheritedParams::getFieldDef(aIndex);
+    aIndex -= inheritedParams::numFieldDefs();
+    if (aIndex<numFields)
+      return &dataDefs[aIndex];
+    return NULL;
+  };
+
+  virtual void loadFromRow(sqlite3pp::query::iterator &aRow, int &aIndex, uint64_t *aCommonFlagsP)
+  {
+    inheritedParams::loadFromRow(aRow, aIndex, aCommonFlagsP);
+    value = aRow->get<int>(aIndex++);
+    text = nonNullCStr(aRow->get<const char *>(aIndex++));
+  };
+
+  virtual void bindToStatement(sqlite3pp::statement &aStatement, int &aIndex, const char *aParentIdentifier, uint64_t aCommonFlags)
+  {
+    inheritedParams::bindToStatement(aStatement, aIndex, aParentIdentifier, aCommonFlags);
+    aStatement.bind(aIndex++, value);
+    aStatement.bind(aIndex++, text.c_str(), false);
+  };
+
+  virtual ErrorPtr saveDirty() { return saveToStore(parentId.c_str(), false); };
+
+  void set(int aValue, const string &aText) { setPVar(value, aValue); setPVar(text, aText); };
+
+  /// @return number of bytes an insert of this parameter set binds (updates bind the ROWID in addition)
+  size_t rowSize() { return parentId.size()+8+text.size(); };
+};
+
+
+
+/// a param store in a temporary database
+class TestParamStore : public ParamStore
+{
+  typedef ParamStore inherited;
+
+public:
+
+  string dbPath;
+
+  TestParamStore()
+  {
+    dbPath = string_format("%s/vdcdtests_%d.sqlite3", tempDir().c_str(), (int)getpid());
+    removeFiles();
+  };
+
+  virtual ~TestParamStore()
+  {
+    stopWriteBehind();
+    finalizeAndDisconnect();
+    removeFiles();
+  };
+
+  ErrorPtr open() { return connectAndInitialize(dbPath.c_str(), 1, 0, true); };
+
+private:
+
+  void removeFiles()
+  {
+    unlink(dbPath.c_str());
+    unlink((dbPath+"-wal").c_str());
+    unlink((dbPath+"-shm").c_str());
+    unlink((dbPath+"-journal").c_str());
+  };
+};
+
+
+
+class TestVdc;
+
+/// dimmable light without hardware, counting its applies
+class TestLight : public Device
+{
+  typedef Device inherited;
+
+  int lightNo;
+
+public:
+
+  int applies; ///< number of applyChannelValues() calls
+  MLMicroSeconds firstApplyAt; ///< time of the first applyChannelValues() call, Never if none
+  MLMicroSeconds lastApplyAt; ///< time of the last applyChannelValues() call, Never if none
+  MLMicroSeconds simulatedLatency; ///< time applyChannelValues() takes to complete, 0 = completes immediately
+  bool applying; ///< set while a (delayed) apply is in progress
+  int overlappingApplies; ///< number of applyChannelValues() calls while another apply was still in progress
+  bool fading; ///< if set, brightness changes are output in steps by the transition engine, like PWM dimmers do
+  double hardwareBrightness; ///< brightness last output to the (simulated) hardware
+
+  TestLight(DeviceClassContainer *aClassContainerP, int aLightNo) :
+    Device(aClassContainerP),
+    lightNo(aLightNo),
+    applies(0),
+    firstApplyAt(Never),
+    lastApplyAt(Never),
+    simulatedLatency(0),
+    applying(false),
+    overlappingApplies(0),
+    fading(false),
+    hardwareBrightness(0)
+  {
+    primaryGroup = group_yellow_light;
+    installSettings(DeviceSettingsPtr(new LightDeviceSettings(*this)));
+    LightBehaviourPtr l = LightBehaviourPtr(new LightBehaviour(*this));
+    l->setHardwareOutputConfig(outputFunction_dimmer, usage_undefined, true, -1);
+    addBehaviour(l);
+    dSUID.setNameInSpace(string_format("%s::TestLight%d", classContainerP->deviceClassContainerInstanceIdentifier().c_str(), aLightNo), DsUid(DSUID_P44VDC_NAMESPACE_UUID));
+  };
+
+  virtual const char *deviceTypeIdentifier() { return "test"; };
+  virtual string modelName() { return "Test Light"; };
+
+  LightBehaviour &light() { return *static_cast<LightBehaviour *>(output.get()); };
+
+protected:
+
+  virtual void applyChannelValues(SimpleCB aDoneCB, bool aForDimming)
+  {
+    if (applying) overlappingApplies++;
+    applies++;
+    lastApplyAt = MainLoop::now();
+    if (firstApplyAt==Never) firstApplyAt = lastApplyAt;
+    if (fading && light().brightnessNeedsApplying()) {
+      MLMicroSeconds transitionTime = light().transitionTimeToNewBrightness();
+      light().brightnessTransitionStep(); // init
+      getDeviceContainer().getTransitionEngine().startTransition(*this, transitionTime, boost::bind(&TestLight::fadeStep, this, _1));
+    }
+    else {
+      hardwareBrightness = light().brightnessForHardware();
+    }
+    light().brightnessApplied();
+    if (simulatedLatency>0) {
+      // simulate slow hardware
+      applying = true;
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&TestLight::simulatedApplyDone, this, aDoneCB, aForDimming), simulatedLatency);
+      return;
+    }
+    inherited::applyChannelValues(aDoneCB, aForDimming);
+  };
+
+private:
+
+  bool fadeStep(double aStepSize)
+  {
+    hardwareBrightness = light().brightnessForHardware();
+    return light().brightnessTransitionStep(aStepSize);
+  };
+
+  void simulatedApplyDone(SimpleCB aDoneCB, bool aForDimming)
+  {
+    applying = false;
+    inherited::applyChannelValues(aDoneCB, aForDimming);
+  };
+
+};
+typedef boost::intrusive_ptr<TestLight> TestLightPtr;
+
+
+/// single "up" button without hardware
+class TestButton : public Device
+{
+  typedef Device inherited;
+
+public:
+
+  TestButton(DeviceClassContainer *aClassContainerP, int aButtonNo) :
+    Device(aClassContainerP)
+  {
+    primaryGroup = group_yellow_light;
+    installSettings();
+    ButtonBehaviourPtr b = ButtonBehaviourPtr(new ButtonBehaviour(*this));
+    b->setHardwareButtonConfig(0, buttonType_single, buttonElement_up, false, 0, true); // up: local clicks always switch on
+    b->setGroup(group_yellow_light);
+    addBehaviour(b);
+    dSUID.setNameInSpace(string_format("%s::TestButton%d", classContainerP->deviceClassContainerInstanceIdentifier().c_str(), aButtonNo), DsUid(DSUID_P44VDC_NAMESPACE_UUID));
+  };
+
+  virtual const char *deviceTypeIdentifier() { return "test"; };
+  virtual string modelName() { return "Test Button"; };
+
+  ButtonBehaviour &button() { return *static_cast<ButtonBehaviour *>(buttons[0].get()); };
+
+};
+typedef boost::intrusive_ptr<TestButton> TestButtonPtr;
+
+
+/// device class container with a given number of test lights
+class TestVdc : public DeviceClassContainer
+{
+  typedef DeviceClassContainer inherited;
+
+  int numLights;
+  int numButtons;
+
+public:
+
+  vector<TestLightPtr> lights; ///< the lights, by light number
+  vector<TestButtonPtr> buttons; ///< the buttons, by button number
+  MLMicroSeconds minDimInterval; ///< minimum dim step interval of the lights, Never for the default
+  int sceneCallSets; ///< number of callSceneOnDevices() calls
+  size_t lastSceneCallSetSize; ///< number of devices in the last callSceneOnDevices() call
+
+  TestVdc(int aInstanceNumber, DeviceContainer *aDeviceContainerP, int aNumLights, int aNumButtons = 0) :
+    inherited(aInstanceNumber, aDeviceContainerP, aInstanceNumber),
+    numLights(aNumLights),
+    numButtons(aNumButtons),
+    minDimInterval(Never),
+    sceneCallSets(0),
+    lastSceneCallSetSize(0)
+  {
+  };
+
+  virtual const char *deviceClassIdentifier() const { return "Test_Device_Container"; };
+  virtual string vdcModelSuffix() { return "Test"; };
+  virtual MLMicroSeconds minDimStepInterval() { return minDimInterval!=Never ? minDimInterval : inherited::minDimStepInterval(); };
+
+  virtual void callSceneOnDevices(DeviceVector &aDevices, SceneNo aSceneNo, bool aForce)
+  {
+    sceneCallSets++;
+    lastSceneCallSetSize = aDevices.size();
+    inherited::callSceneOnDevices(aDevices, aSceneNo, aForce);
+  };
+
+  virtual void collectDevices(StatusCB aCompletedCB, bool aIncremental, bool aExhaustive, bool aClearSettings)
+  {
+    if (!aIncremental) {
+      removeDevices(aClearSettings);
+      lights.clear();
+      for (int i=0; i<numLights; i++) {
+        TestLightPtr l = TestLightPtr(new TestLight(this, i));
+        lights.push_back(l);
+        addDevice(l);
+      }
+      buttons.clear();
+      for (int i=0; i<numButtons; i++) {
+        TestButtonPtr b = TestButtonPtr(new TestButton(this, i));
+        buttons.push_back(b);
+        addDevice(b);
+      }
+    }
+    aCompletedCB(ErrorPtr());
+  };
+
+  /// reset the apply counters of all lights
+  void resetApplies()
+  {
+    for (vector<TestLightPtr>::iterator pos = lights.begin(); pos!=lights.end(); ++pos) {
+      (*pos)->applies = 0;
+      (*pos)->firstApplyAt = Never;
+      (*pos)->lastApplyAt = Never;
+      (*pos)->overlappingApplies = 0;
+    }
+  };
+
+  /// @return total number of applies of all lights
+  int totalApplies()
+  {
+    int n = 0;
+    for (vector<TestLightPtr>::iterator pos = lights.begin(); pos!=lights.end(); ++pos) n += (*pos)->applies;
+    return n;
+  };
+
+};
+typedef boost::intrusive_ptr<TestVdc> TestVdcPtr;
+
+
+/// vdc host keeping its settings in a temporary directory
+class TestHost : public DeviceContainer
+{
+  typedef DeviceContainer inherited;
+
+  string dataDir;
+
+public:
+
+  /// @param aName name for the data directory, hosts with the same name share their settings
+  TestHost(const char *aName)
+  {
+    dataDir = string_format("%s/vdcdtests_%d_%s", tempDir().c_str(), (int)getpid(), aName);
+    mkdir(dataDir.c_str(), 0700);
+    setPersistentDataDir(dataDir.c_str());
+    setOutputResyncInterval(0); // test lights cannot read back their state anyway
+  };
+
+  /// delete the data directory (the host must not be used afterwards)
+  void removeDataDir()
+  {
+    getDsParamStore().stopWriteBehind();
+    DIR *dir = opendir(dataDir.c_str());
+    if (dir) {
+      struct dirent *e;
+      while ((e = readdir(dir))!=NULL) {
+        if (e->d_name[0]!='.') unlink((dataDir+"/"+e->d_name).c_str());
+      }
+      closedir(dir);
+    }
+    rmdir(dataDir.c_str());
+  };
+
+};
+typedef boost::intrusive_ptr<TestHost> TestHostPtr;
+
+
+
+class VdcdTests : public Application
+{
+  int checks;
+  int failures;
+
+  typedef boost::function<void ()> TestStep;
+  typedef list<TestStep> TestStepList;
+  TestStepList asyncSteps; ///< steps that need the mainloop, run one after another
+
+  // JsonComm checks
+  int sockets[2];
+  JsonCommPtr jsonComm;
+  FdFeederPtr feeder;
+  vector<string> received; ///< received messages (JSON text) or errors ("error:<code>")
+
+  // JsonRpcComm checks
+  string dispatched; ///< methods and grouping params in order of dispatching
+
+  // write-behind checks
+  TestParamStore *writeBehindStore;
+  TestParams *refusedParams;
+  TestParams *acceptedParams;
+  int writeErrors; ///< number of write-behind error reports
+
+  // device level checks
+  list<TestHostPtr> hosts; ///< all vdc hosts created, for removing their data at cleanup
+  TestHostPtr localHost; ///< vdc host not connected to a vdSM
+  TestVdcPtr localVdc; ///< the test lights of localHost
+  TestHostPtr sceneHost; ///< vdc host for scene table memory checks
+  TestVdcPtr sceneVdc; ///< the test lights of sceneHost
+  TestHostPtr firstStartHost; ///< vdc host starting with no stored settings
+  TestVdcPtr firstStartVdc; ///< the test lights of firstStartHost
+  TestHostPtr restartHost; ///< vdc host starting with the settings stored by firstStartHost
+  TestVdcPtr restartVdc; ///< the test lights of restartHost
+  TestHostPtr sessionHost; ///< vdc host with a vDC API server the stub vdSM connects to
+  TestVdcPtr sessionVdc; ///< the test lights of sessionHost
+  JsonRpcCommPtr vdsm; ///< stub vdSM connection to sessionHost
+  set<string> announcedDsUids; ///< dSUIDs of the devices announced to the stub vdSM
+  int announcedVdcs; ///< number of vdc announcements received by the stub vdSM
+  bool vdsmConnectDone; ///< set when the stub vdSM's connection attempt has completed (successfully or not)
+  bool vdsmSession; ///< set when sessionHost has accepted the stub vdSM's hello
+  long vdsmHelloTicket; ///< times out an unanswered hello (port might be used by something else)
+
+public:
+
+  VdcdTests() :
+    checks(0),
+    failures(0),
+    writeBehindStore(NULL),
+    refusedParams(NULL),
+    acceptedParams(NULL),
+    writeErrors(0),
+    announcedVdcs(0),
+    vdsmConnectDone(false),
+    vdsmSession(false),
+    vdsmHelloTicket(0)
+  {
+  }
+
+
+  void usage(char *name)
+  {
+    fprintf(stderr, "usage:\n");
+    fprintf(stderr, "  %s [options]\n", name);
+    fprintf(stderr, "    -l loglevel     : set loglevel (default = %d)\n", DEFAULT_LOGLEVEL);
+  };
+
+
+  virtual int main(int argc, char **argv)
+  {
+    int loglevel = DEFAULT_LOGLEVEL;
+    int c;
+    while ((c = getopt(argc, argv, "l:")) != -1)
+    {
+      switch (c) {
+        case 'l':
+          loglevel = atoi(optarg);
+          break;
+        default:
+          usage(argv[0]);
+          exit(-1);
+      }
+    }
+    SETLOGLEVEL(loglevel);
+    setvbuf(stdout, NULL, _IOLBF, 0); // keep check results in order with log output (on stderr)
+    // synchronous checks
+    arenaChecks();
+    paramStoreChecks();
+    paramStoreRollbackChecks();
+    paramStorePreloadChecks();
+    dimIntervalChecks();
+    dsUidChecks();
+    // asynchronous checks run from initialize()
+    asyncSteps.push_back(boost::bind(&VdcdTests::jsonCommChunkChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::jsonCommSizeCapChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::batchChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::batchTimeoutChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::writeBehindChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::localHostChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::callSceneBenchmark, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::dimChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::localClickChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::fadeChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::sceneMemoryChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::settingsSaveChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::startupChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::announceChecks, this));
+    asyncSteps.push_back(boost::bind(&VdcdTests::callSceneNotificationChecks, this, 0, NOTIFICATION_TARGETS));
+    asyncSteps.push_back(boost::bind(&VdcdTests::callSceneNotificationChecks, this, SCENE_CALL_FIRST_LIGHT, SCENE_CALL_TARGETS));
+    return run();
+  }
+
+
+  virtual void initialize()
+  {
+    nextStep();
+  }
+
+
+  virtual void cleanup(int aExitCode)
+  {
+    for (list<TestHostPtr>::iterator pos = hosts.begin(); pos!=hosts.end(); ++pos) {
+      (*pos)->removeDataDir();
+    }
+    printf("%d checks, %d failed\n", checks, failures);
+  }
+
+
+  void check(bool aOk, const string &aWhat)
+  {
+    checks++;
+    if (aOk) {
+      printf("ok   - %s\n", aWhat.c_str());
+    }
+    else {
+      failures++;
+      printf("FAIL - %s\n", aWhat.c_str());
+    }
+  }
+
+
+  void nextStep()
+  {
+    if (asyncSteps.empty()) {
+      terminateApp(failures>0 ? EXIT_FAILURE : EXIT_SUCCESS);
+      return;
+    }
+    TestStep step = asyncSteps.front();
+    asyncSteps.pop_front();
+    MainLoop::currentMainLoop().executeOnce(boost::bind(step));
+  }
+
+
+  #pragma mark - JsonArena parser
+
+
+  JsonArenaErrors parseError(const char *aText, size_t aLen, JsonNode *&aRoot)
+  {
+    JsonArenaPtr arena = JsonArenaPtr(new JsonArena);
+    ErrorPtr err = arena->parse(aText, aLen, aRoot);
+    if (Error::isOK(err)) return JsonArenaErrorOK;
+    if (!err->isDomain(JsonArenaError::domain())) return JsonArenaErrorSyntax;
+    return (JsonArenaErrors)err->getErrorCode();
+  }
+
+
+  void arenaChecks()
+  {
+    const char *text = "{\"a\":[1,2.5,true,null,\"x\\\"y\\u00e4\"],\"b\":{\"c\":-3},\"d\":\"\"}";
+    size_t len = strlen(text);
+    JsonArenaPtr arena = JsonArena::arenaFromText(text);
+    check(arena && arena->root(), "arena: parse object");
+    if (!arena || !arena->root()) return;
+    JsonNode *root = arena->root();
+    JsonNode *a = root->get("a");
+    check(a && a->arrayLength()==5, "arena: array length");
+    check(a && a->arrayGet(0)->int64Value()==1 && a->arrayGet(1)->doubleValue()==2.5 && a->arrayGet(2)->boolValue(), "arena: array values");
+    check(a && a->arrayGet(3) && a->arrayGet(3)->isType(jsonnode_null), "arena: null array element");
+    check(a && a->arrayGet(4) && a->arrayGet(4)->stringValue()=="x\"y\xC3\xA4", "arena: string escapes");
+    check(root->get("b") && root->get("b")->get("c") && root->get("b")->get("c")->int32Value()==-3, "arena: nested object");
+    check(root->get("d") && root->get("d")->stringLength()==0, "arena: empty string");
+    // round trip
+    string json = root->json_str();
+    JsonArenaPtr arena2 = JsonArena::arenaFromText(json.c_str());
+    check(arena2 && arena2->root()->json_str()==json, "arena: json_str() round trip");
+    // doubles must read back exactly, even those needing 17 significant digits
+    const double doubles[] = { 0.1, 1.0/3, 2.0/3*100, 0.30000000000000004, 1e-300, 123456789.123456789, -0.5 };
+    bool doublesOk = true;
+    for (size_t i=0; i<sizeof(doubles)/sizeof(double); i++) {
+      string dj = arena->newDouble(doubles[i])->json_str();
+      JsonArenaPtr da = JsonArena::arenaFromText(dj.c_str());
+      if (!da || da->root()->doubleValue()!=doubles[i]) {
+        doublesOk = false;
+        printf("     %.17g generated as %s\n", doubles[i], dj.c_str());
+      }
+    }
+    check(doublesOk, "arena: doubles round trip");
+    // every proper prefix of the text must be incomplete (that's what JsonComm relies on before EOM)
+    bool allIncomplete = true;
+    JsonNode *r;
+    for (size_t i=0; i<len; i++) {
+      if (parseError(text, i, r)!=JsonArenaErrorIncomplete || r!=NULL) {
+        allIncomplete = false;
+        printf("     prefix of length %zu not reported incomplete\n", i);
+      }
+    }
+    check(allIncomplete, "arena: all prefixes incomplete");
+    check(parseError(text, len, r)==JsonArenaErrorOK && r, "arena: complete text");
+    // errors
+    check(parseError("{\"a\":}", 6, r)==JsonArenaErrorSyntax && !r, "arena: syntax error");
+    check(parseError("{} x", 4, r)==JsonArenaErrorTrailing && r, "arena: trailing text");
+    check(parseError("{} \n", 4, r)==JsonArenaErrorOK, "arena: trailing whitespace");
+    string deep(1000, '[');
+    check(parseError(deep.c_str(), deep.size(), r)==JsonArenaErrorDepth, "arena: nesting depth limit");
+    // values spanning multiple arena chunks
+    string big = "{\"s\":\"";
+    big.append(200*1024, 'x');
+    big += "\",\"l\":[";
+    for (int i=0; i<10000; i++) {
+      if (i>0) big += ",";
+      big += string_format("%d", i);
+    }
+    big += "]}";
+    arena = JsonArena::arenaFromText(big.c_str(), big.size());
+    check(arena && arena->root()->get("s") && arena->root()->get("s")->stringLength()==200*1024, "arena: string larger than chunk");
+    bool seqOk = arena && arena->root()->get("l") && arena->root()->get("l")->arrayLength()==10000;
+    for (int i=0; seqOk && i<10000; i++) {
+      JsonNode *e = arena->root()->get("l")->arrayGet(i);
+      if (!e || e->int32Value()!=i) seqOk = false;
+    }
+    check(seqOk, "arena: large array across chunks");
+    // linking a node that is already member of another container adds a copy
+    arena = JsonArena::arenaFromText("{\"x\":{\"y\":1}}");
+    JsonArenaPtr other = JsonArenaPtr(new JsonArena);
+    JsonNode *o = other->newObj();
+    JsonNode *x = arena->root()->get("x");
+    o->add("x", x);
+    x->add("z", arena->newInt32(2));
+    check(o->json_str()=="{\"x\":{\"y\":1}}" && arena->root()->json_str()=="{\"x\":{\"y\":1,\"z\":2}}", "arena: linked node is copied when added elsewhere");
+  }
+
+
+  #pragma mark - ParamStore
+
+
+  void paramStoreChecks()
+  {
+    TestParamStore store;
+    ErrorPtr err = store.open();
+    check(Error::isOK(err), "paramstore: open database in "+store.dbPath);
+    if (!Error::isOK(err)) return;
+    // write accounting
+    store.setWriteBudget(60);
+    TestParams p1(store, "p1");
+    p1.set(5, "hello");
+    check(p1.isDirty() && store.dirtyListLength()==1, "paramstore: changed parameter set is dirty");
+    err = p1.saveDirty();
+    check(Error::isOK(err) && !p1.isDirty() && p1.rowid!=0 && store.dirtyListLength()==0, "paramstore: insert");
+    const ParamWriteStats &total = store.getTotalWriteStats();
+    check(total.rowWrites==1 && total.bytesWritten==p1.rowSize(), string_format("paramstore: insert accounted (%llu bytes)", total.bytesWritten));
+    p1.set(6, "hello world");
+    err = p1.saveDirty();
+    check(Error::isOK(err) && total.rowWrites==2 && total.bytesWritten==15+p1.rowSize()+8, string_format("paramstore: update accounted (%llu bytes)", total.bytesWritten));
+    check(store.getTableWriteStats().size()==1 && store.getTableWriteStats().begin()->second.bytesWritten==total.bytesWritten, "paramstore: per table statistics");
+    check(!store.writeBudgetExceeded(), "paramstore: within write budget");
+    p1.set(7, "budget");
+    p1.saveDirty();
+    check(store.writeBudgetExceeded(), "paramstore: write budget exceeded");
+    // read back
+    TestParams p1r(store, "p1");
+    err = p1r.loadFromStore("p1");
+    check(Error::isOK(err) && p1r.rowid==p1.rowid && p1r.value==7 && p1r.text=="budget", "paramstore: read back");
+    err = p1.deleteFromStore();
+    check(Error::isOK(err) && total.rowDeletes==1, "paramstore: delete accounted");
+  }
+
+
+  void paramStoreRollbackChecks()
+  {
+    TestParamStore store;
+    ErrorPtr err = store.open();
+    if (!Error::isOK(err)) { check(false, "paramstore: open database"); return; }
+    TestParams existing(store, "e");
+    existing.set(1, "a");
+    existing.saveDirty();
+    // a constraint that is only checked at COMMIT makes committing the transaction fail
+    store.execute("PRAGMA foreign_keys=ON");
+    store.execute("CREATE TABLE fkParent (id INTEGER PRIMARY KEY)");
+    store.execute("CREATE TABLE fkChild (parentId INTEGER REFERENCES fkParent(id) DEFERRABLE INITIALLY DEFERRED)");
+    store.clearStatementCache(); // schema has changed
+    TestParams fresh(store, "f");
+    fresh.set(2, "b");
+    existing.set(3, "c");
+    store.beginTransaction();
+    fresh.saveDirty();
+    existing.saveDirty();
+    check(!fresh.isDirty() && fresh.rowid!=0 && !existing.isDirty() && store.dirtyListLength()==0, "paramstore: saved within transaction");
+    store.execute("INSERT INTO fkChild (parentId) VALUES (42)");
+    err = store.commitTransaction();
+    check(!Error::isOK(err), "paramstore: commit fails");
+    check(
+      fresh.isDirty() && fresh.rowid==0 && existing.isDirty() && existing.rowid!=0 && store.dirtyListLength()==2,
+      "paramstore: rolled back parameter sets are dirty again, inserted ones lose their ROWID"
+    );
+    // saving again must persist the values
+    fresh.saveDirty();
+    existing.saveDirty();
+    TestParams freshRead(store, "f");
+    TestParams existingRead(store, "e");
+    freshRead.loadFromStore("f");
+    existingRead.loadFromStore("e");
+    check(freshRead.rowid==fresh.rowid && freshRead.value==2 && existingRead.value==3, "paramstore: saved again after rollback");
+    // a committed transaction must not re-dirty anything
+    existing.set(4, "d");
+    store.beginTransaction();
+    existing.saveDirty();
+    err = store.commitTransaction();
+    check(Error::isOK(err) && !existing.isDirty() && store.dirtyListLength()==0, "paramstore: committed transaction leaves parameter sets clean");
+  }
+
+
+  void writeBehindChecks()
+  {
+    writeBehindStore = new TestParamStore;
+    ErrorPtr err = writeBehindStore->open();
+    if (!Error::isOK(err)) { check(false, "paramstore: open database"); nextStep(); return; }
+    writeBehindStore->setWriteErrorHandler(boost::bind(&VdcdTests::writeErrorHandler, this, _1));
+    refusedParams = new TestParams(*writeBehindStore, "r");
+    acceptedParams = new TestParams(*writeBehindStore, "a");
+    TestParams *goneParams = new TestParams(*writeBehindStore, "g");
+    refusedParams->set(1, "r");
+    refusedParams->saveDirty();
+    acceptedParams->set(1, "a");
+    acceptedParams->saveDirty();
+    goneParams->set(1, "g");
+    goneParams->saveDirty();
+    // updates to value 666 fail
+    writeBehindStore->execute("CREATE TRIGGER refuse666 BEFORE UPDATE ON testParams WHEN NEW.value=666 BEGIN SELECT RAISE(ABORT, 'refused'); END");
+    writeBehindStore->clearStatementCache(); // schema has changed
+    err = writeBehindStore->startWriteBehind();
+    check(Error::isOK(err) && writeBehindStore->writeBehindActive(), "writebehind: started");
+    // existing rows are updated by the write-behind thread, parameter sets are clean immediately
+    refusedParams->set(666, "refused");
+    refusedParams->saveDirty();
+    acceptedParams->set(2, "accepted");
+    acceptedParams->saveDirty();
+    goneParams->set(666, "gone");
+    goneParams->saveDirty();
+    check(!refusedParams->isDirty() && !acceptedParams->isDirty() && writeBehindStore->dirtyListLength()==0, "writebehind: clean when queued");
+    // a parameter set going away before its failure is reported must not be notified any more
+    delete goneParams;
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::writeBehindResults, this), ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void writeErrorHandler(ErrorPtr aError)
+  {
+    writeErrors++;
+  }
+
+
+  void writeBehindResults()
+  {
+    writeBehindStore->flushWriteBehind();
+    check(writeErrors==1, "writebehind: failure reported");
+    check(refusedParams->isDirty() && writeBehindStore->dirtyListLength()==1, "writebehind: failed update re-dirties its parameter set");
+    check(!acceptedParams->isDirty(), "writebehind: successful update in same batch stays clean");
+    TestParams acceptedRead(*writeBehindStore, "a");
+    acceptedRead.loadFromStore("a");
+    check(acceptedRead.value==2 && acceptedRead.text=="accepted", "writebehind: successful update written");
+    writeBehindStore->stopWriteBehind();
+    delete refusedParams; refusedParams = NULL;
+    delete acceptedParams; acceptedParams = NULL;
+    delete writeBehindStore; writeBehindStore = NULL;
+    nextStep();
+  }
+
+
+  void paramStorePreloadChecks()
+  {
+    TestParamStore store;
+    ErrorPtr err = store.open();
+    if (!Error::isOK(err)) { check(false, "paramstore: open database"); return; }
+    TestParams p1(store, "p1");
+    p1.set(1, "one");
+    p1.saveDirty();
+    TestParams p2(store, "p2");
+    p2.set(2, "two");
+    p2.saveDirty();
+    store.startPreload();
+    TestParams r1(store, "p1");
+    r1.loadFromStore("p1");
+    check(r1.rowid==p1.rowid && r1.value==1 && r1.text=="one", "preload: first load reads table");
+    // change the database behind the param store's back: preloaded rows must be served from memory
+    store.execute("UPDATE testParams SET value=99 WHERE parentID='p2'");
+    TestParams r2(store, "p2");
+    r2.loadFromStore("p2");
+    check(r2.rowid==p2.rowid && r2.value==2, "preload: further loads served from memory");
+    TestParams rx(store, "px");
+    rx.loadFromStore("px");
+    check(rx.rowid==0, "preload: no rows for unknown parent");
+    // saving invalidates the preloaded rows of the parent
+    p1.set(11, "eleven");
+    p1.saveDirty();
+    r1.loadFromStore("p1");
+    check(r1.value==11 && r1.text=="eleven", "preload: saved parameter set is read from database");
+    store.endPreload();
+    r2.loadFromStore("p2");
+    check(r2.value==99, "preload: database read again after preloading ended");
+  }
+
+
+  #pragma mark - dSUID hashing
+
+
+  void dsUidChecks()
+  {
+    DsUid a("198C033E330755E78015F97AD093DD1C00");
+    DsUid b(string("198C033E330755E78015F97AD093DD1C00"));
+    check(a==b && a.hash()==b.hash(), "dsuid: equal dSUIDs from text have equal hashes");
+    DsUid c;
+    c.setAsBinary(a.getBinary());
+    check(c==a && c.hash()==a.hash(), "dsuid: equal dSUIDs from binary have equal hashes");
+    DsUid d = a;
+    d.setSubdeviceIndex(1);
+    DsUid e("198C033E330755E78015F97AD093DD1C01");
+    check(!(d==a) && d==e && d.hash()==e.hash(), "dsuid: hash follows subdevice index change");
+    DsUid f;
+    f.setNameInSpace("vdcdtests", DsUid(DSUID_P44VDC_NAMESPACE_UUID));
+    DsUid g;
+    g.setNameInSpace("vdcdtests", DsUid(DSUID_P44VDC_NAMESPACE_UUID));
+    check(f==g && f.hash()==g.hash() && !(f==a), "dsuid: name based dSUIDs");
+    c.clear();
+    check(c==DsUid() && c.hash()==DsUid().hash(), "dsuid: cleared dSUID hashes like empty one");
+    // lookup in hashed index, like the vdc host's addressable index
+    typedef boost::unordered_map<DsUid, int, DsUidHash> Index;
+    Index index;
+    for (int i=0; i<200; i++) {
+      DsUid u = a;
+      u.setSubdeviceIndex(i);
+      index[u] = i;
+    }
+    bool found = index.size()==200;
+    for (int i=0; found && i<200; i++) {
+      DsUid u(string_format("198C033E330755E78015F97AD093DD1C%02X", i));
+      Index::iterator pos = index.find(u);
+      if (pos==index.end() || pos->second!=i) found = false;
+    }
+    check(found && index.find(f)==index.end(), "dsuid: hashed index lookup");
+  }
+
+
+  #pragma mark - dimming
+
+
+  void dimIntervalChecks()
+  {
+    // limits of device classes not opting in to faster dimming (DeviceClassContainer defaults)
+    MLMicroSeconds min = 300*MilliSecond;
+    MLMicroSeconds max = 1*Second;
+    check(Device::dimStepIntervalFor(0, min, max)==300*MilliSecond, "dimming: baseline interval while latency unknown");
+    check(Device::dimStepIntervalFor(20*MilliSecond, min, max)==300*MilliSecond, "dimming: fast hardware keeps baseline interval without opt-in");
+    check(Device::dimStepIntervalFor(400*MilliSecond, min, max)==600*MilliSecond, "dimming: interval follows slow apply latency");
+    check(Device::dimStepIntervalFor(2*Second, min, max)==1*Second, "dimming: interval limited to maximum");
+    // device class opting in to faster dimming
+    min = 50*MilliSecond;
+    check(Device::dimStepIntervalFor(0, min, max)==300*MilliSecond, "dimming: opt-in class uses baseline interval while latency unknown");
+    check(Device::dimStepIntervalFor(20*MilliSecond, min, max)==50*MilliSecond, "dimming: opt-in class limited to its minimum");
+    check(Device::dimStepIntervalFor(100*MilliSecond, min, max)==150*MilliSecond, "dimming: opt-in class follows apply latency");
+  }
+
+
+  #pragma mark - JsonComm message framing
+
+
+  bool openJsonComm()
+  {
+    JsonCommPtr comm = JsonCommPtr(new JsonComm(MainLoop::currentMainLoop()));
+    comm->setArenaMessageHandler(boost::bind(&VdcdTests::arenaMessageHandler, this, _1, _2));
+    return openComm(comm);
+  }
+
+
+  /// connect a JsonComm (or subclass) to one end of a socketpair, the test feeds the other end
+  bool openComm(JsonCommPtr aComm)
+  {
+    received.clear();
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)<0) {
+      check(false, "socketpair");
+      return false;
+    }
+    jsonComm = aComm;
+    jsonComm->setFd(sockets[0]);
+    jsonComm->makeNonBlocking();
+    feeder = FdFeederPtr(new FdFeeder(sockets[1]));
+    fcntl(sockets[1], F_SETFL, fcntl(sockets[1], F_GETFL, 0) | O_NONBLOCK);
+    return true;
+  }
+
+
+  void closeJsonComm()
+  {
+    jsonComm->clearCallbacks();
+    jsonComm->setFd(-1);
+    jsonComm.reset();
+    feeder.reset();
+    close(sockets[0]);
+    close(sockets[1]);
+  }
+
+
+  void arenaMessageHandler(ErrorPtr aError, JsonArenaPtr aArena)
+  {
+    if (Error::isOK(aError) && aArena) {
+      received.push_back(aArena->root()->json_str());
+    }
+    else {
+      received.push_back(string_format("error:%ld", aError ? aError->getErrorCode() : -1));
+    }
+  }
+
+
+  /// read what the JsonComm has sent to the peer end of the socketpair into received
+  void readPeerMessages()
+  {
+    received.clear();
+    string text;
+    char buf[1024];
+    ssize_t n;
+    while ((n = read(sockets[1], buf, sizeof(buf)))>0) text.append(buf, n);
+    size_t bom = 0;
+    size_t eom;
+    while ((eom = text.find('\n', bom))!=string::npos) {
+      JsonArenaPtr arena = JsonArena::arenaFromText(text.c_str()+bom, eom-bom);
+      received.push_back(arena ? arena->root()->json_str() : "unparseable:"+text.substr(bom, eom-bom));
+      bom = eom+1;
+    }
+  }
+
+
+  void feedAt(const string &aData, MLMicroSeconds aDelay)
+  {
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&FdFeeder::feed, feeder, aData), aDelay);
+  }
+
+
+  string receivedList()
+  {
+    string s;
+    for (vector<string>::iterator pos = received.begin(); pos!=received.end(); ++pos) {
+      if (!s.empty()) s += " | ";
+      s += *pos;
+    }
+    return s;
+  }
+
+
+  void jsonCommChunkChecks()
+  {
+    if (!openJsonComm()) { nextStep(); return; }
+    // message split within a value
+    feedAt("{\"a\":", 0);
+    feedAt("1}\n", 20*MilliSecond);
+    // two messages, second one split right after its key
+    feedAt("{\"x\":1}\n{\"y\"", 40*MilliSecond);
+    feedAt(":2}\n", 60*MilliSecond);
+    // complete before EOM (parsed early), EOM arrives later and must not produce a duplicate
+    feedAt("[1,2]", 80*MilliSecond);
+    feedAt("\n", 100*MilliSecond);
+    // syntax error, then a good message in the same chunk
+    feedAt("{\"bad\" 1}\n{\"ok\":true}\n", 120*MilliSecond);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::jsonCommChunkResults, this), ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void jsonCommChunkResults()
+  {
+    string r = receivedList();
+    string expected = string_format("{\"a\":1} | {\"x\":1} | {\"y\":2} | [1,2] | error:%d | {\"ok\":true}", JsonArenaErrorSyntax);
+    check(r==expected, "jsoncomm: messages split at arbitrary boundaries");
+    if (r!=expected) printf("     got: %s\n", r.c_str());
+    closeJsonComm();
+    nextStep();
+  }
+
+
+  void jsonCommSizeCapChecks()
+  {
+    if (!openJsonComm()) { nextStep(); return; }
+    // runaway message larger than the limit, followed by a good one
+    string huge = "{\"s\":\"";
+    huge.append(MAX_JSON_MESSAGE_SIZE+1024, 'x');
+    huge += "\"}\n{\"after\":1}\n";
+    feedAt(huge, 0);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::jsonCommSizeCapResults, this), 2*ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void jsonCommSizeCapResults()
+  {
+    string r = receivedList();
+    string expected = string_format("error:%d | {\"after\":1}", JsonArenaErrorSize);
+    check(r==expected, "jsoncomm: message size limit");
+    if (r!=expected) printf("     got: %s\n", r.c_str());
+    closeJsonComm();
+    nextStep();
+  }
+
+
+  #pragma mark - JSON-RPC batches
+
+
+  void batchChecks()
+  {
+    JsonRpcCommPtr rpc = JsonRpcCommPtr(new JsonRpcComm(MainLoop::currentMainLoop()));
+    rpc->setArenaRequestHandler(boost::bind(&VdcdTests::rpcRequestHandler, this, rpc, _1, _2, _3));
+    rpc->setBatchGroupingParam("dSUID");
+    if (!openComm(rpc)) { nextStep(); return; }
+    dispatched.clear();
+    // batch with a call answered immediately, one answered later, a notification and an invalid member,
+    // followed by a single request re-using an id of the still pending batch
+    feedAt(
+      "[{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"params\":{\"dSUID\":\"A\",\"v\":1},\"id\":\"1\"},"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"slow\",\"params\":{\"dSUID\":\"B\",\"v\":2},\"id\":\"2\"},"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"note\",\"params\":{\"dSUID\":\"A\"}},"
+      "{\"foo\":1}]\n"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"params\":{\"v\":3},\"id\":\"1\"}\n",
+      0
+    );
+    // empty batch (must be answered with an error) and batch of notifications only (no response at all)
+    feedAt("[]\n[{\"jsonrpc\":\"2.0\",\"method\":\"note\",\"params\":{}}]\n", 100*MilliSecond);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::batchResults, this), ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void rpcRequestHandler(JsonRpcCommPtr aRpc, const char *aMethod, const char *aJsonRpcId, JsonNode *aParams)
+  {
+    const char *group = aParams ? aParams->getCString("dSUID") : NULL;
+    dispatched += string_format("%s(%s) ", aMethod, group ? group : "");
+    if (strcmp(aMethod, "echo")==0) {
+      aRpc->sendResult(aJsonRpcId, aParams ? aParams->get("v") : NULL);
+    }
+    else if (strcmp(aMethod, "slow")==0) {
+      // answer later, after the single request that follows the batch has been answered
+      JsonArenaPtr result = JsonArenaPtr(new JsonArena);
+      result->setRoot(aParams ? result->copyNode(aParams->get("v")) : NULL);
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::slowAnswer, this, aRpc, string(aJsonRpcId), result), 50*MilliSecond);
+    }
+    else if (strcmp(aMethod, "never")==0) {
+      // answer only long after the batch has timed out
+      JsonArenaPtr result = JsonArenaPtr(new JsonArena);
+      result->setRoot(aParams ? result->copyNode(aParams->get("v")) : NULL);
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::slowAnswer, this, aRpc, string(aJsonRpcId), result), 250*MilliSecond);
+    }
+    else if (strcmp(aMethod, "twice")==0) {
+      // answer now and again later
+      aRpc->sendResult(aJsonRpcId, aParams ? aParams->get("v") : NULL);
+      JsonArenaPtr result = JsonArenaPtr(new JsonArena);
+      result->setRoot(result->newInt32(99));
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::slowAnswer, this, aRpc, string(aJsonRpcId), result), 20*MilliSecond);
+    }
+  }
+
+
+  void slowAnswer(JsonRpcCommPtr aRpc, string aJsonRpcId, JsonArenaPtr aResult)
+  {
+    aRpc->sendResult(aJsonRpcId.c_str(), aResult->root());
+  }
+
+
+  void batchTimeoutChecks()
+  {
+    JsonRpcCommPtr rpc = JsonRpcCommPtr(new JsonRpcComm(MainLoop::currentMainLoop()));
+    rpc->setArenaRequestHandler(boost::bind(&VdcdTests::rpcRequestHandler, this, rpc, _1, _2, _3));
+    rpc->setBatchTimeout(100*MilliSecond);
+    if (!openComm(rpc)) { nextStep(); return; }
+    dispatched.clear();
+    // duplicate id within the batch, a call never answered in time and a call answered twice
+    feedAt(
+      "[{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"params\":{\"v\":1},\"id\":\"7\"},"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"params\":{\"v\":2},\"id\":\"7\"},"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"never\",\"params\":{\"v\":8},\"id\":\"8\"},"
+      "{\"jsonrpc\":\"2.0\",\"method\":\"twice\",\"params\":{\"v\":9},\"id\":\"9\"}]\n",
+      0
+    );
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::batchTimeoutResults, this), 2*ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void batchTimeoutResults()
+  {
+    readPeerMessages();
+    string r = responsesList();
+    string expected = string_format("[7:1,7:2,9:9,8:error%d]", JSONRPC_SERVER_ERROR);
+    check(r==expected, "jsonrpc: batch answered after timeout, duplicate ids answered, late answers dropped");
+    if (r!=expected) printf("     got: %s\n", r.c_str());
+    bool tagLeaked = false;
+    for (vector<string>::iterator pos = received.begin(); pos!=received.end(); ++pos) {
+      if (pos->find(JSONRPC_BATCH_ID_SEPARATOR)!=string::npos) tagLeaked = true;
+    }
+    check(!tagLeaked, "jsonrpc: internal batch id tags never sent to peer");
+    closeJsonComm();
+    nextStep();
+  }
+
+
+  /// @return "id:result" or "id:error code" for a response
+  string responseSummary(JsonNode *aResponse)
+  {
+    JsonNode *id = aResponse->get("id");
+    JsonNode *o;
+    string s = id ? id->stringValue() : "null";
+    if ((o = aResponse->get("error")))
+      return s + ":error" + (o->get("code") ? o->get("code")->stringValue() : "?");
+    return s + ":" + (aResponse->get("result") ? aResponse->get("result")->stringValue() : "null");
+  }
+
+
+  void batchResults()
+  {
+    readPeerMessages();
+    check(dispatched=="echo(A) note(A) slow(B) echo() note() ", "jsonrpc: batch members dispatched grouped by param");
+    if (dispatched!="echo(A) note(A) slow(B) echo() note() ") printf("     got: %s\n", dispatched.c_str());
+    string r = responsesList();
+    string expected = string_format("1:3 | [1:1,null:error%d,2:2] | null:error%d", JSONRPC_INVALID_REQUEST, JSONRPC_INVALID_REQUEST);
+    check(r==expected, "jsonrpc: batch responses routed to their batch, peer ids restored");
+    if (r!=expected) printf("     got: %s\n", r.c_str());
+    closeJsonComm();
+    nextStep();
+  }
+
+
+  /// @return summary of all responses received by the peer, batch responses in brackets
+  string responsesList()
+  {
+    string r;
+    for (vector<string>::iterator pos = received.begin(); pos!=received.end(); ++pos) {
+      JsonArenaPtr arena = JsonArena::arenaFromText(pos->c_str());
+      if (!r.empty()) r += " | ";
+      if (!arena) { r += *pos; continue; }
+      if (arena->root()->isType(jsonnode_array)) {
+        r += "[";
+        for (JsonNode *e = arena->root()->firstChild(); e; e = e->nextSibling()) {
+          if (e!=arena->root()->firstChild()) r += ",";
+          r += responseSummary(e);
+        }
+        r += "]";
+      }
+      else {
+        r += responseSummary(arena->root());
+      }
+    }
+    return r;
+  }
+
+
+
+  #pragma mark - vdc host with test devices
+
+
+  /// create a vdc host with a device class container with test lights
+  /// @note hosts are never deleted, as pending mainloop handlers might still refer to them
+  TestHostPtr newHost(const char *aName, int aNumLights, int aNumButtons, TestVdcPtr &aVdc)
+  {
+    TestHostPtr host = TestHostPtr(new TestHost(aName));
+    hosts.push_back(host);
+    aVdc = TestVdcPtr(new TestVdc(1, host.get(), aNumLights, aNumButtons));
+    aVdc->addClassToDeviceContainer();
+    return host;
+  }
+
+
+  /// initialize a vdc host and collect its devices
+  void startHost(TestHostPtr aHost, StatusCB aDoneCB)
+  {
+    aHost->initialize(boost::bind(&VdcdTests::hostInitialized, this, aHost, aDoneCB, _1), false);
+  }
+
+
+  void hostInitialized(TestHostPtr aHost, StatusCB aDoneCB, ErrorPtr aError)
+  {
+    if (!Error::isOK(aError)) {
+      aDoneCB(aError);
+      return;
+    }
+    aHost->collectDevices(aDoneCB, false, false, false);
+  }
+
+
+  void localHostChecks()
+  {
+    localHost = newHost("local", LOCAL_HOST_LIGHTS, 3, localVdc);
+    startHost(localHost, boost::bind(&VdcdTests::localHostStarted, this, _1));
+  }
+
+
+  void localHostStarted(ErrorPtr aError)
+  {
+    check(Error::isOK(aError) && localVdc->lights.size()==LOCAL_HOST_LIGHTS, "host: test lights collected");
+    nextStep();
+  }
+
+
+  void callSceneBenchmark()
+  {
+    TestLightPtr l = localVdc->lights[0];
+    // first calls create the undo pseudo scene and the default scenes kept for calling
+    l->callScene(T0_S1, false);
+    l->callScene(T0_S0, false);
+    localVdc->resetApplies();
+    unsigned long allocations = heapAllocations;
+    MLMicroSeconds start = MainLoop::now();
+    for (int i=0; i<CALLSCENE_BENCHMARK_CALLS; i++) {
+      l->callScene(i&1 ? T0_S0 : T0_S1, false);
+    }
+    MLMicroSeconds t = MainLoop::now()-start;
+    allocations = heapAllocations-allocations;
+    check(l->applies==CALLSCENE_BENCHMARK_CALLS, "callScene: every call applied");
+    printf(
+      "     %d calls in %lld mS = %.0f calls/sec per device, %.1f heap allocations per call\n",
+      CALLSCENE_BENCHMARK_CALLS, t/MilliSecond, (double)CALLSCENE_BENCHMARK_CALLS*Second/(t>0 ? t : 1),
+      (double)allocations/CALLSCENE_BENCHMARK_CALLS
+    );
+    nextStep();
+  }
+
+
+  void dimChecks()
+  {
+    // dim down from full brightness a light that takes DIM_APPLY_LATENCY for applying
+    TestLightPtr l = localVdc->lights[1];
+    l->callScene(T0_S1, true);
+    l->simulatedLatency = DIM_APPLY_LATENCY;
+    localVdc->minDimInterval = DIM_MIN_STEP_INTERVAL;
+    // - let a few applies measure the latency
+    l->light().brightness->setChannelValue(95);
+    l->requestApplyingChannels(boost::bind(&VdcdTests::dimLatencyMeasured, this, l, 3), false);
+  }
+
+
+  void dimLatencyMeasured(TestLightPtr aLight, int aMoreApplies)
+  {
+    if (aMoreApplies>0) {
+      aLight->light().brightness->setChannelValue(aMoreApplies&1 ? 95 : 100);
+      aLight->requestApplyingChannels(boost::bind(&VdcdTests::dimLatencyMeasured, this, aLight, aMoreApplies-1), false);
+      return;
+    }
+    aLight->light().brightness->setChannelValue(100);
+    aLight->requestApplyingChannels(NULL, false);
+    localVdc->resetApplies();
+    aLight->dimChannelForArea(channeltype_brightness, dimmode_down, 0, 10*Second);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::dimStop, this, aLight), DIM_TIME);
+  }
+
+
+  void dimStop(TestLightPtr aLight)
+  {
+    aLight->dimChannelForArea(channeltype_brightness, dimmode_stop, 0, 0);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::dimStopped, this, aLight), 2*DIM_APPLY_LATENCY);
+  }
+
+
+  void dimStopped(TestLightPtr aLight)
+  {
+    // expected step interval is adapted to the apply latency, within the limits of the device class
+    MLMicroSeconds expected = Device::dimStepIntervalFor(DIM_APPLY_LATENCY, DIM_MIN_STEP_INTERVAL, localVdc->maxDimStepInterval());
+    MLMicroSeconds interval = aLight->applies>1 ? (aLight->lastApplyAt-aLight->firstApplyAt)/(aLight->applies-1) : 0;
+    double appliesPerSec = aLight->applies>1 ? (double)(aLight->applies-1)*Second/(aLight->lastApplyAt-aLight->firstApplyAt) : 0;
+    check(interval>expected*8/10 && interval<expected*12/10, "dimming: step interval adapted to apply latency");
+    check(appliesPerSec*DIM_APPLY_LATENCY/Second<1, "dimming: applies/sec below what the hardware can do");
+    check(aLight->overlappingApplies==0, "dimming: no overlapping applies");
+    check(aLight->light().brightness->getChannelValue()<100, "dimming: brightness changed");
+    printf(
+      "     %d applies in %lld mS, step interval %lld mS (expected %lld mS), %.1f applies/sec at %lld mS latency\n",
+      aLight->applies, DIM_TIME/MilliSecond, interval/MilliSecond, expected/MilliSecond, appliesPerSec, DIM_APPLY_LATENCY/MilliSecond
+    );
+    aLight->simulatedLatency = 0;
+    localVdc->minDimInterval = Never;
+    nextStep();
+  }
+
+
+  /// set a device's zone the way the vdSM does it (via the property API)
+  void setZone(DevicePtr aDevice, int aZoneID)
+  {
+    ApiValuePtr query = ApiValuePtr(new JsonApiValue);
+    query->setType(apivalue_object);
+    query->add("zoneID", query->newUint64(aZoneID));
+    aDevice->accessProperty(access_write, query, ApiValuePtr(), VDC_API_DOMAIN, PropertyDescriptorPtr());
+  }
+
+
+  /// switch all lights off, then click a button and count the lights that switched on
+  /// @return number of applies caused by the click
+  int clickAndCount(TestButtonPtr aButton, MLMicroSeconds &aLatency)
+  {
+    for (vector<TestLightPtr>::iterator pos = localVdc->lights.begin(); pos!=localVdc->lights.end(); ++pos) {
+      (*pos)->callScene(T0_S0, true);
+    }
+    localVdc->resetApplies();
+    MLMicroSeconds clickAt = MainLoop::now();
+    localHost->checkForLocalClickHandling(aButton->button(), ct_tip_1x);
+    aLatency = 0;
+    for (vector<TestLightPtr>::iterator pos = localVdc->lights.begin(); pos!=localVdc->lights.end(); ++pos) {
+      if ((*pos)->lastApplyAt!=Never && (*pos)->lastApplyAt-clickAt>aLatency) aLatency = (*pos)->lastApplyAt-clickAt;
+    }
+    return localVdc->totalApplies();
+  }
+
+
+  void localClickChecks()
+  {
+    // zone 0 is the broadcast zone: a button there acts on all lights,
+    // buttons in other zones act only on the lights in the same zone
+    for (int i=0; i<CLICK_ZONE_LIGHTS; i++) {
+      setZone(localVdc->lights[i], CLICK_ZONE);
+    }
+    TestButtonPtr allButton = localVdc->buttons[0];
+    TestButtonPtr zoneButton = localVdc->buttons[1];
+    TestButtonPtr emptyZoneButton = localVdc->buttons[2];
+    setZone(zoneButton, CLICK_ZONE);
+    setZone(emptyZoneButton, EMPTY_ZONE);
+    MLMicroSeconds zoneLatency, allLatency, emptyLatency;
+    bool zoneOnly = clickAndCount(zoneButton, zoneLatency)==CLICK_ZONE_LIGHTS;
+    for (int i=0; i<LOCAL_HOST_LIGHTS; i++) {
+      if ((localVdc->lights[i]->applies==1) != (i<CLICK_ZONE_LIGHTS)) zoneOnly = false;
+    }
+    check(zoneOnly, "local click: button in a zone switches the lights of that zone only");
+    check(clickAndCount(allButton, allLatency)==LOCAL_HOST_LIGHTS, "local click: button in zone 0 switches all lights");
+    check(clickAndCount(emptyZoneButton, emptyLatency)==0, "local click: button in a zone without lights switches none");
+    printf(
+      "     click to last apply: %lld uS for %d lights in zone %d, %lld uS for all %d lights\n",
+      zoneLatency, CLICK_ZONE_LIGHTS, CLICK_ZONE, allLatency, LOCAL_HOST_LIGHTS
+    );
+    nextStep();
+  }
+
+
+  void fadeChecks()
+  {
+    // all lights at full brightness, without transition
+    for (vector<TestLightPtr>::iterator pos = localVdc->lights.begin(); pos!=localVdc->lights.end(); ++pos) {
+      (*pos)->fading = true;
+      (*pos)->light().brightness->setChannelValue(100, 0, true);
+      (*pos)->requestApplyingChannels(NULL, false);
+    }
+    // now start all fades at once
+    clock_t cpuStart = clock();
+    MLMicroSeconds start = MainLoop::now();
+    for (vector<TestLightPtr>::iterator pos = localVdc->lights.begin(); pos!=localVdc->lights.end(); ++pos) {
+      (*pos)->light().brightness->setChannelValue(FADE_TARGET, FADE_TIME);
+      (*pos)->requestApplyingChannels(NULL, false);
+    }
+    check(localHost->getTransitionEngine().activeTransitions()==LOCAL_HOST_LIGHTS, "fades: all transitions running");
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::fadeWait, this, cpuStart, start), FADE_TIME/10);
+  }
+
+
+  void fadeWait(clock_t aCpuStart, MLMicroSeconds aStart)
+  {
+    if (localHost->getTransitionEngine().activeTransitions()>0 && MainLoop::now()<aStart+3*FADE_TIME) {
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::fadeWait, this, aCpuStart, aStart), FADE_TIME/10);
+      return;
+    }
+    MLMicroSeconds t = MainLoop::now()-aStart;
+    double cpu = (double)(clock()-aCpuStart)/CLOCKS_PER_SEC;
+    bool allReached = true;
+    for (vector<TestLightPtr>::iterator pos = localVdc->lights.begin(); pos!=localVdc->lights.end(); ++pos) {
+      if ((*pos)->hardwareBrightness!=FADE_TARGET) allReached = false;
+      (*pos)->fading = false;
+    }
+    check(localHost->getTransitionEngine().activeTransitions()==0 && t<2*FADE_TIME, "fades: all transitions completed in time");
+    check(allReached, "fades: all lights reached the target brightness");
+    check(cpu*Second<t/2, "fades: stepping uses less than half a CPU core");
+    printf(
+      "     %d simultaneous %lld mS fades took %lld mS, %.0f mS CPU (%.1f%% of one core)\n",
+      LOCAL_HOST_LIGHTS, FADE_TIME/MilliSecond, t/MilliSecond, cpu*1000, cpu*Second/t*100
+    );
+    nextStep();
+  }
+
+
+
+  void sceneMemoryChecks()
+  {
+    sceneHost = newHost("scenes", SCENE_HOST_LIGHTS, 0, sceneVdc);
+    startHost(sceneHost, boost::bind(&VdcdTests::sceneHostStarted, this, heapInUse(), _1));
+  }
+
+
+  void sceneHostStarted(long aHeapBefore, ErrorPtr aError)
+  {
+    check(Error::isOK(aError) && sceneVdc->lights.size()==SCENE_HOST_LIGHTS, "scene memory: test lights collected");
+    if (aHeapBefore<0) {
+      printf("     heap usage not available on this platform, skipping scene memory checks\n");
+      nextStep();
+      return;
+    }
+    long collected = heapInUse();
+    // reading every scene of every light must not keep anything beyond the default scenes kept for calling
+    for (vector<TestLightPtr>::iterator pos = sceneVdc->lights.begin(); pos!=sceneVdc->lights.end(); ++pos) {
+      SceneDeviceSettingsPtr scenes = (*pos)->getScenes();
+      for (int sceneNo=0; sceneNo<SCENE_TABLE_SIZE; sceneNo++) {
+        scenes->getScene(sceneNo);
+      }
+    }
+    long afterGet = heapInUse();
+    for (vector<TestLightPtr>::iterator pos = sceneVdc->lights.begin(); pos!=sceneVdc->lights.end(); ++pos) {
+      SceneDeviceSettingsPtr scenes = (*pos)->getScenes();
+      for (int sceneNo=0; sceneNo<SCENE_TABLE_SIZE; sceneNo++) {
+        scenes->getSceneForCall(sceneNo);
+      }
+    }
+    long afterCall = heapInUse();
+    // one changed scene per light is kept
+    for (vector<TestLightPtr>::iterator pos = sceneVdc->lights.begin(); pos!=sceneVdc->lights.end(); ++pos) {
+      SceneDeviceSettingsPtr scenes = (*pos)->getScenes();
+      DsScenePtr scene = scenes->getScene(T1_S1);
+      scene->setSceneValue(0, 42);
+      scenes->updateScene(scene);
+    }
+    long afterChange = heapInUse();
+    long perLight = (collected-aHeapBefore)/SCENE_HOST_LIGHTS;
+    long getPerLight = (afterGet-collected)/SCENE_HOST_LIGHTS;
+    long callPerLight = (afterCall-afterGet)/SCENE_HOST_LIGHTS;
+    long changePerLight = (afterChange-afterCall)/SCENE_HOST_LIGHTS;
+    check(getPerLight<=0, "scene memory: reading all scenes keeps no scene objects");
+    check(callPerLight<=2*changePerLight, "scene memory: calling all scenes keeps at most two default scenes");
+    check(changePerLight>0 && changePerLight<perLight, "scene memory: a changed scene costs less than a light");
+    printf(
+      "     %d lights x %d scenes: %ld bytes per light, +%ld after reading all scenes, +%ld after calling all scenes, +%ld with one changed scene\n",
+      SCENE_HOST_LIGHTS, SCENE_TABLE_SIZE, perLight, getPerLight, callPerLight, changePerLight
+    );
+    nextStep();
+  }
+
+
+
+  void settingsSaveChecks()
+  {
+    // save what is pending from collecting and the scene checks first
+    sceneHost->flushSettings();
+    for (int i=0; i<DIRTY_SETTINGS; i++) {
+      setZone(sceneVdc->lights[i], 1+i%10);
+    }
+    size_t dirty = sceneHost->getDsParamStore().dirtyListLength();
+    MLMicroSeconds start = MainLoop::now();
+    sceneHost->flushSettings();
+    MLMicroSeconds t = MainLoop::now()-start;
+    check(dirty==DIRTY_SETTINGS, "settings save: changed settings are in the dirty list");
+    check(sceneHost->getDsParamStore().dirtyListLength()==0, "settings save: all changed settings saved");
+    check(t<SAVE_SWEEP_BUDGET, "settings save: fits into the time budget of one save sweep");
+    printf("     %d changed settings saved in one transaction in %lld uS\n", DIRTY_SETTINGS, t);
+    nextStep();
+  }
+
+
+
+  void startupChecks()
+  {
+    firstStartHost = newHost("startup", STARTUP_HOST_LIGHTS, 0, firstStartVdc);
+    startHost(firstStartHost, boost::bind(&VdcdTests::firstStartDone, this, MainLoop::now(), _1));
+  }
+
+
+  void firstStartDone(MLMicroSeconds aStart, ErrorPtr aError)
+  {
+    MLMicroSeconds t = MainLoop::now()-aStart;
+    check(Error::isOK(aError) && firstStartVdc->lights.size()==STARTUP_HOST_LIGHTS, "startup: first start collected all lights");
+    // give every light a non-default setting and store it
+    for (int i=0; i<STARTUP_HOST_LIGHTS; i++) {
+      setZone(firstStartVdc->lights[i], 1+i%10);
+    }
+    MLMicroSeconds flushStart = MainLoop::now();
+    firstStartHost->flushSettings();
+    MLMicroSeconds flushT = MainLoop::now()-flushStart;
+    printf(
+      "     %d lights: first start without stored settings took %lld mS, storing their settings %lld mS\n",
+      STARTUP_HOST_LIGHTS, t/MilliSecond, flushT/MilliSecond
+    );
+    // a second host with the same name uses the same settings database
+    restartHost = newHost("startup", STARTUP_HOST_LIGHTS, 0, restartVdc);
+    startHost(restartHost, boost::bind(&VdcdTests::restartDone, this, MainLoop::now(), _1));
+  }
+
+
+  void restartDone(MLMicroSeconds aStart, ErrorPtr aError)
+  {
+    MLMicroSeconds t = MainLoop::now()-aStart;
+    check(Error::isOK(aError) && restartVdc->lights.size()==STARTUP_HOST_LIGHTS, "startup: restart collected all lights");
+    bool loaded = true;
+    for (int i=0; i<STARTUP_HOST_LIGHTS; i++) {
+      if (restartVdc->lights[i]->getZoneID()!=1+i%10) loaded = false;
+    }
+    check(loaded, "startup: restart loaded the stored settings of all lights");
+    printf("     %d lights: start with stored settings took %lld mS\n", STARTUP_HOST_LIGHTS, t/MilliSecond);
+    nextStep();
+  }
+
+
+
+  #pragma mark - vdc host with stub vdSM
+
+
+  void announceChecks()
+  {
+    string port = string_format("%d", 20000+getpid()%20000);
+    sessionHost = newHost("session", SESSION_HOST_LIGHTS, 0, sessionVdc);
+    sessionHost->vdcApiServer = VdcApiServerPtr(new VdcJsonApiServer());
+    sessionHost->vdcApiServer->setConnectionParams(NULL, port.c_str(), SOCK_STREAM, AF_INET);
+    startHost(sessionHost, boost::bind(&VdcdTests::sessionHostStarted, this, port, _1));
+  }
+
+
+  void sessionHostStarted(string aPort, ErrorPtr aError)
+  {
+    check(Error::isOK(aError) && sessionVdc->lights.size()==SESSION_HOST_LIGHTS, "vdSM session: test lights collected");
+    // connect the stub vdSM
+    vdsm = JsonRpcCommPtr(new JsonRpcComm(MainLoop::currentMainLoop()));
+    vdsm->setConnectionParams("127.0.0.1", aPort.c_str(), SOCK_STREAM, AF_INET);
+    vdsm->setRequestHandler(boost::bind(&VdcdTests::vdsmRequestHandler, this, _1, _2, _3));
+    vdsm->setConnectionStatusHandler(boost::bind(&VdcdTests::vdsmConnectionStatus, this, _2));
+    ErrorPtr err = vdsm->initiateConnection();
+    if (!Error::isOK(err)) {
+      check(false, "vdSM session: connect to vDC API server");
+      nextStep();
+    }
+  }
+
+
+  void vdsmConnectionStatus(ErrorPtr aError)
+  {
+    if (!Error::isOK(aError)) {
+      LOG(LOG_ERR, "stub vdSM connection: %s\n", aError->description().c_str());
+      if (!vdsmConnectDone) {
+        // could not connect at all
+        vdsmConnectDone = true;
+        check(false, "vdSM session: connect to vDC API server");
+        nextStep();
+      }
+      return;
+    }
+    if (vdsmConnectDone) return; // already in session
+    vdsmConnectDone = true;
+    DsUid vdsmDsUid;
+    vdsmDsUid.setNameInSpace("vdcdtests stub vdSM", DsUid(DSUID_P44VDC_NAMESPACE_UUID));
+    JsonObjectPtr params = JsonObject::newObj();
+    params->add("api_version", JsonObject::newInt32(2));
+    params->add("dSUID", JsonObject::newString(vdsmDsUid.getString().c_str()));
+    vdsm->sendRequest("hello", params, boost::bind(&VdcdTests::vdsmHelloAnswered, this, _2));
+    vdsmHelloTicket = MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::vdsmHelloTimeout, this), SESSION_TIMEOUT);
+  }
+
+
+  void vdsmHelloTimeout()
+  {
+    vdsmHelloTicket = 0;
+    check(false, "vdSM session: hello answered");
+    nextStep();
+  }
+
+
+  void vdsmHelloAnswered(ErrorPtr &aError)
+  {
+    if (!vdsmHelloTicket) return; // already timed out
+    MainLoop::currentMainLoop().cancelExecutionTicket(vdsmHelloTicket);
+    vdsmSession = Error::isOK(aError);
+    check(vdsmSession, "vdSM session: hello accepted");
+    if (!vdsmSession) {
+      nextStep();
+      return;
+    }
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::announceWait, this, MainLoop::now()), 10*MilliSecond);
+  }
+
+
+  /// stub vdSM: confirm announcements
+  void vdsmRequestHandler(const char *aMethod, const char *aJsonRpcId, JsonObjectPtr aParams)
+  {
+    if (!aJsonRpcId) return; // notifications from the vdc host are not checked
+    if (strcmp(aMethod, "announcevdc")==0) {
+      announcedVdcs++;
+    }
+    else if (strcmp(aMethod, "announcedevice")==0) {
+      JsonObjectPtr o = aParams ? aParams->get("dSUID") : JsonObjectPtr();
+      if (o) announcedDsUids.insert(o->stringValue());
+    }
+    vdsm->sendResult(aJsonRpcId, JsonObjectPtr());
+  }
+
+
+  void announceWait(MLMicroSeconds aStart)
+  {
+    MLMicroSeconds t = MainLoop::now()-aStart;
+    if (announcedDsUids.size()<SESSION_HOST_LIGHTS && t<SESSION_TIMEOUT) {
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::announceWait, this, aStart), 10*MilliSecond);
+      return;
+    }
+    check(announcedVdcs==1, "vdSM session: vdc announced once");
+    check(announcedDsUids.size()==SESSION_HOST_LIGHTS, "vdSM session: all devices announced");
+    printf(
+      "     %d devices announced in %lld mS = %.0f announcements/sec\n",
+      (int)announcedDsUids.size(), t/MilliSecond, (double)announcedDsUids.size()*Second/(t>0 ? t : 1)
+    );
+    nextStep();
+  }
+
+
+
+  /// stub vdSM calls a scene on a range of lights with a single callScene notification
+  void callSceneNotificationChecks(int aFirstLight, int aNumLights)
+  {
+    if (!vdsmSession) {
+      check(false, string_format("callScene notification to %d targets: vdSM session", aNumLights));
+      nextStep();
+      return;
+    }
+    // targets are off, all other lights unchanged
+    for (int i=aFirstLight; i<aFirstLight+aNumLights; i++) {
+      sessionVdc->lights[i]->callScene(T0_S0, true);
+    }
+    // send when everything caused by preparing is done
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::callSceneNotificationSend, this, aFirstLight, aNumLights), ASYNC_STEP_SETTLE_TIME);
+  }
+
+
+  void callSceneNotificationSend(int aFirstLight, int aNumLights)
+  {
+    sessionVdc->resetApplies();
+    sessionVdc->sceneCallSets = 0;
+    JsonObjectPtr dsuids = JsonObject::newArray();
+    for (int i=aFirstLight; i<aFirstLight+aNumLights; i++) {
+      dsuids->arrayAppend(JsonObject::newString(sessionVdc->lights[i]->getDsUid().getString().c_str()));
+    }
+    JsonObjectPtr params = JsonObject::newObj();
+    params->add("dSUID", dsuids);
+    params->add("scene", JsonObject::newInt32(T0_S1));
+    params->add("force", JsonObject::newBool(false));
+    MLMicroSeconds start = MainLoop::now();
+    vdsm->sendRequest("callScene", params);
+    MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::callSceneNotificationWait, this, aFirstLight, aNumLights, start), 1*MilliSecond);
+  }
+
+
+  void callSceneNotificationWait(int aFirstLight, int aNumLights, MLMicroSeconds aStart)
+  {
+    int applied = 0;
+    MLMicroSeconds firstApply = Never;
+    MLMicroSeconds lastApply = aStart;
+    for (int i=aFirstLight; i<aFirstLight+aNumLights; i++) {
+      TestLightPtr l = sessionVdc->lights[i];
+      if (l->applies>0) {
+        applied++;
+        if (firstApply==Never || l->firstApplyAt<firstApply) firstApply = l->firstApplyAt;
+        if (l->lastApplyAt>lastApply) lastApply = l->lastApplyAt;
+      }
+    }
+    if (applied<aNumLights && MainLoop::now()<aStart+SESSION_TIMEOUT) {
+      MainLoop::currentMainLoop().executeOnce(boost::bind(&VdcdTests::callSceneNotificationWait, this, aFirstLight, aNumLights, aStart), 1*MilliSecond);
+      return;
+    }
+    check(applied==aNumLights, string_format("callScene notification: all %d targets applied", aNumLights));
+    check(sessionVdc->totalApplies()==aNumLights, string_format("callScene notification to %d targets: no other lights applied", aNumLights));
+    check(
+      sessionVdc->sceneCallSets==1 && sessionVdc->lastSceneCallSetSize==aNumLights,
+      string_format("callScene notification to %d targets: passed to the vdc as one set", aNumLights)
+    );
+    printf(
+      "     callScene notification to %d dSUIDs: first target applied %lld uS, last %lld uS after sending\n",
+      aNumLights, firstApply!=Never ? firstApply-aStart : -1, lastApply-aStart
+    );
+    nextStep();
+  }
+
+};
+
+
+int main(int argc, char **argv)
+{
+  // create the mainloop
+  MainLoop::currentMainLoop().setLoopCycleTime(MAINLOOP_CYCLE_TIME_uS);
+  // create app with current mainloop
+  static VdcdTests application;
+  // pass control
+  return application.main(argc, argv);
+}
\ No newline at end of file